@@ -0,0 +1,294 @@
+#ifndef COSMOSIS_BINARY_IO_HH
+#define COSMOSIS_BINARY_IO_HH
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+// Helpers for the little-endian binary formats of DataBlock: the
+// serialization and hashing of serialize.cc and the snapshot files of
+// snapshot.cc.
+// They are not part of the interface of the library.
+
+namespace cosmosis
+{
+  namespace binary_io
+  {
+    inline bool host_is_little_endian()
+    {
+      std::uint16_t const one = 1;
+      unsigned char first;
+      std::memcpy(&first, &one, 1);
+      return first == 1;
+    }
+
+    // Reverse the bytes of each of the n words of the given size at p.
+    inline void swap_words(char* p, std::size_t n, std::size_t size)
+    {
+      for (std::size_t i = 0; i != n; ++i, p += size)
+        for (std::size_t a = 0, b = size - 1; a < b; ++a, --b) std::swap(p[a], p[b]);
+    }
+
+    // The size of the words that make up an element of type T, which
+    // are byte-swapped on big-endian hosts.
+    template <class T> std::size_t word_size() { return sizeof(T); }
+    template <> inline std::size_t word_size<std::complex<double>>() { return sizeof(double); }
+
+    // Return the number of bytes needed to bring pos to a multiple of
+    // alignment.
+    inline std::size_t padding(std::size_t pos, std::size_t alignment)
+    {
+      return (alignment - pos % alignment) % alignment;
+    }
+
+    // A writer appends to a buffer, or (given no buffer) only counts
+    // the bytes that would be written.
+    class writer
+    {
+    public:
+      explicit writer(char* out) : out_(out), pos_(0), little_(host_is_little_endian()) {}
+
+      std::size_t size() const { return pos_; }
+
+      void bytes(void const* p, std::size_t n)
+      {
+        if (out_ != nullptr && n != 0) std::memcpy(out_ + pos_, p, n);
+        pos_ += n;
+      }
+
+      template <class T>
+      void words(T const* p, std::size_t n)
+      {
+        std::size_t const start = pos_;
+        bytes(p, n * sizeof(T));
+        if (out_ != nullptr && not little_)
+          swap_words(out_ + start, n * sizeof(T) / word_size<T>(), word_size<T>());
+      }
+
+      template <class T> void scalar(T x) { words(&x, 1); }
+      void u8(std::uint8_t x) { bytes(&x, 1); }
+      void u32(std::uint32_t x) { scalar(x); }
+      void u64(std::uint64_t x) { scalar(x); }
+
+      void str(std::string const& s)
+      {
+        u32(static_cast<std::uint32_t>(s.size()));
+        bytes(s.data(), s.size());
+      }
+
+      // Write zero bytes up to a multiple of alignment.
+      void pad(std::size_t alignment = 8)
+      {
+        std::size_t n = padding(pos_, alignment);
+        if (out_ != nullptr) std::memset(out_ + pos_, 0, n);
+        pos_ += n;
+      }
+
+    private:
+      char* out_;
+      std::size_t pos_;
+      bool little_;
+    };
+
+    // A hasher takes the same calls as a writer, and computes the
+    // 128-bit MurmurHash3 (the x64 variant, with seed 0) of the bytes
+    // the writer would write, without storing them. Since those bytes
+    // are the same on all hosts, so is the hash.
+    class hasher
+    {
+    public:
+      hasher() : h1_(0), h2_(0), nbuf_(0), pos_(0), little_(host_is_little_endian()) {}
+
+      std::size_t size() const { return pos_; }
+
+      void bytes(void const* p, std::size_t n)
+      {
+        if (n == 0) return;
+        auto c = static_cast<unsigned char const*>(p);
+        pos_ += n;
+        if (nbuf_ != 0) {
+          std::size_t const k = std::min<std::size_t>(n, block_size - nbuf_);
+          std::memcpy(buf_ + nbuf_, c, k);
+          nbuf_ += k;
+          c += k;
+          n -= k;
+          if (nbuf_ != block_size) return;
+          block(buf_);
+          nbuf_ = 0;
+        }
+        for (; n >= block_size; n -= block_size, c += block_size) block(c);
+        if (n != 0) std::memcpy(buf_, c, n);
+        nbuf_ = n;
+      }
+
+      template <class T>
+      void words(T const* p, std::size_t n)
+      {
+        if (little_) {
+          bytes(p, n * sizeof(T));
+          return;
+        }
+        // Byte-swap a chunk at a time.
+        std::size_t const per_chunk = sizeof(chunk_) / sizeof(T);
+        for (std::size_t start = 0; start < n; start += per_chunk) {
+          std::size_t const m = std::min(per_chunk, n - start);
+          std::memcpy(chunk_, p + start, m * sizeof(T));
+          swap_words(chunk_, m * sizeof(T) / word_size<T>(), word_size<T>());
+          bytes(chunk_, m * sizeof(T));
+        }
+      }
+
+      template <class T> void scalar(T x) { words(&x, 1); }
+      void u8(std::uint8_t x) { bytes(&x, 1); }
+      void u32(std::uint32_t x) { scalar(x); }
+      void u64(std::uint64_t x) { scalar(x); }
+
+      void str(std::string const& s)
+      {
+        u32(static_cast<std::uint32_t>(s.size()));
+        bytes(s.data(), s.size());
+      }
+
+      void pad(std::size_t alignment = 8)
+      {
+        static char const zeros[block_size] = {};
+        for (std::size_t n = padding(pos_, alignment); n != 0; ) {
+          std::size_t const k = std::min<std::size_t>(n, block_size);
+          bytes(zeros, k);
+          n -= k;
+        }
+      }
+
+      // Return the hash of the bytes so far, as its low and high 64 bits.
+      std::array<std::uint64_t, 2> digest() const
+      {
+        std::uint64_t h1 = h1_, h2 = h2_;
+        if (nbuf_ > 8) h2 ^= mix_k2(load(buf_ + 8, nbuf_ - 8));
+        if (nbuf_ > 0) h1 ^= mix_k1(load(buf_, std::min<std::size_t>(nbuf_, 8)));
+        h1 ^= pos_;
+        h2 ^= pos_;
+        h1 += h2;
+        h2 += h1;
+        h1 = fmix(h1);
+        h2 = fmix(h2);
+        h1 += h2;
+        h2 += h1;
+        return {{h1, h2}};
+      }
+
+    private:
+      enum { block_size = 16 };
+      static std::uint64_t const c1 = 0x87c37b91114253d5ULL;
+      static std::uint64_t const c2 = 0x4cf5ad432745937fULL;
+
+      static std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+      // Read n (at most 8) bytes as a little-endian number.
+      static std::uint64_t load(unsigned char const* p, std::size_t n)
+      {
+        std::uint64_t x = 0;
+        for (std::size_t i = 0; i != n; ++i) x |= std::uint64_t(p[i]) << (8 * i);
+        return x;
+      }
+
+      static std::uint64_t mix_k1(std::uint64_t k) { return rotl(k * c1, 31) * c2; }
+      static std::uint64_t mix_k2(std::uint64_t k) { return rotl(k * c2, 33) * c1; }
+
+      static std::uint64_t fmix(std::uint64_t k)
+      {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+      }
+
+      void block(unsigned char const* p)
+      {
+        h1_ ^= mix_k1(load(p, 8));
+        h1_ = rotl(h1_, 27) + h2_;
+        h1_ = h1_ * 5 + 0x52dce729;
+        h2_ ^= mix_k2(load(p + 8, 8));
+        h2_ = rotl(h2_, 31) + h1_;
+        h2_ = h2_ * 5 + 0x38495ab5;
+      }
+
+      std::uint64_t h1_;
+      std::uint64_t h2_;
+      unsigned char buf_[block_size];
+      std::size_t nbuf_;
+      std::uint64_t pos_;
+      bool little_;
+      char chunk_[256];
+    };
+
+    // A reader consumes a buffer; each function returns false if the
+    // buffer is too short.
+    class reader
+    {
+    public:
+      reader(char const* data, std::size_t size) :
+        data_(data), size_(size), pos_(0), little_(host_is_little_endian()) {}
+
+      bool at_end() const { return pos_ == size_; }
+
+      // Return the number of bytes not yet read.
+      std::size_t remaining() const { return size_ - pos_; }
+
+      bool bytes(void* p, std::size_t n)
+      {
+        if (n > size_ - pos_) return false;
+        if (n != 0) std::memcpy(p, data_ + pos_, n);
+        pos_ += n;
+        return true;
+      }
+
+      template <class T>
+      bool words(T* p, std::size_t n)
+      {
+        if (n > (size_ - pos_) / sizeof(T)) return false;
+        if (not bytes(p, n * sizeof(T))) return false;
+        if (not little_)
+          swap_words(reinterpret_cast<char*>(p), n * sizeof(T) / word_size<T>(), word_size<T>());
+        return true;
+      }
+
+      template <class T> bool scalar(T& x) { return words(&x, 1); }
+      bool u8(std::uint8_t& x) { return bytes(&x, 1); }
+      bool u32(std::uint32_t& x) { return scalar(x); }
+      bool u64(std::uint64_t& x) { return scalar(x); }
+
+      bool str(std::string& s)
+      {
+        std::uint32_t n;
+        if (not u32(n) || n > size_ - pos_) return false;
+        s.assign(data_ + pos_, n);
+        pos_ += n;
+        return true;
+      }
+
+      // Skip the padding up to a multiple of alignment.
+      bool pad(std::size_t alignment = 8)
+      {
+        std::size_t const n = padding(pos_, alignment);
+        if (n > size_ - pos_) return false;
+        pos_ += n;
+        return true;
+      }
+
+    private:
+      char const* data_;
+      std::size_t size_;
+      std::size_t pos_;
+      bool little_;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "block_pool.hh"
+
+cosmosis::block_pool::block_pool(std::size_t max_bytes, std::size_t max_sections) :
+  max_bytes_(max_bytes),
+  max_sections_(max_sections),
+  counts_{0, 0, 0}
+{}
+
+cosmosis::Section
+cosmosis::block_pool::make_section()
+{
+  std::shared_ptr<Section::map_type> storage;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sections_.empty())
+      ++counts_.allocations;
+    else
+      {
+        ++counts_.reuses;
+        storage = std::move(sections_.back());
+        sections_.pop_back();
+      }
+  }
+  if (not storage) storage = std::make_shared<Section::map_type>();
+  return Section(std::move(storage));
+}
+
+void
+cosmosis::block_pool::recycle(Section&& s)
+{
+  if (s.shared()) return;
+  std::shared_ptr<Section::map_type> storage = std::move(s.vals_);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& v : *storage) give(v.second);
+  if (sections_.size() == max_sections_) return;
+  // Clearing keeps the map's index, and its first block of entries.
+  storage->clear();
+  sections_.push_back(std::move(storage));
+}
+
+cosmosis::block_pool::counts
+cosmosis::block_pool::get_counts() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return counts_;
+}
+
+void
+cosmosis::block_pool::release()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& l : ints_) l.clear();
+  for (auto& l : doubles_) l.clear();
+  for (auto& l : complexes_) l.clear();
+  sections_.clear();
+  counts_ = counts{0, 0, 0};
+}
+
+// The caller must hold the lock.
+template <class T>
+void
+cosmosis::block_pool::give(std::vector<T>& v)
+{
+  std::size_t const bytes = v.capacity() * sizeof(T);
+  if (bytes == 0 || counts_.bytes_held + bytes > max_bytes_) return;
+  counts_.bytes_held += bytes;
+  buffers<T>()[list_for(v.capacity())].emplace_back(std::move(v));
+}
+
+// The caller must hold the lock.
+void
+cosmosis::block_pool::give(Entry& e)
+{
+  switch (e.type_)
+    {
+    case DBT_INT1D: give(e.vi); break;
+    case DBT_DOUBLE1D: give(e.vd); break;
+    case DBT_COMPLEX1D: give(e.vz); break;
+    case DBT_INTND: give(e.ndi.data_); break;
+    case DBT_DOUBLEND: give(e.ndd.data_); break;
+    case DBT_COMPLEXND: give(e.ndz.data_); break;
+    default: break;
+    }
+}
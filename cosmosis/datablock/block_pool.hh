@@ -0,0 +1,160 @@
+#ifndef COSMOSIS_BLOCK_POOL_HH
+#define COSMOSIS_BLOCK_POOL_HH
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "entry.hh"
+#include "section.hh"
+
+namespace cosmosis
+{
+  // A block_pool keeps the storage of DataBlocks that have been
+  // destroyed or cleared, so that the blocks made after them can reuse
+  // it rather than going back to the heap. It is meant for the
+  // per-sample blocks of a pipeline: each sample builds a block of much
+  // the same shape as the last, so once the first block has been
+  // recycled almost every array and section of the next is served from
+  // the pool.
+  //
+  // The pool holds the buffers of int, double and complex arrays (both
+  // vectors and ndarrays), and the storage of Sections. Storage that is
+  // still shared with a copy of the block (see Section), for example by
+  // a view, is left alone. The pool keeps at most max_bytes of array
+  // buffers, and the storage of at most max_sections Sections; beyond
+  // that, recycled storage is freed. Buffers are kept in lists by size
+  // (each list holding the buffers whose capacity has the same highest
+  // set bit), so that finding one for a request looks through one or
+  // two short lists rather than all of them.
+  //
+  // A DataBlock uses a pool if it was constructed with one; copies of
+  // it share the pool. All the functions below may be called
+  // concurrently from several threads.
+  class block_pool
+  {
+  public:
+    struct counts
+    {
+      // The number of requests for storage that had to allocate, and
+      // the number met from the pool.
+      std::size_t allocations;
+      std::size_t reuses;
+      // The number of bytes of array buffers currently held.
+      std::size_t bytes_held;
+    };
+
+    explicit block_pool(std::size_t max_bytes = std::size_t(1) << 30,
+                        std::size_t max_sections = 1024);
+
+    block_pool(block_pool const&) = delete;
+    block_pool& operator=(block_pool const&) = delete;
+
+    // Return a vector holding a copy of the n values starting at first,
+    // reusing a pooled buffer with room for them if there is one.
+    template <class T>
+    std::vector<T> make_vector(T const* first, std::size_t n);
+
+    // Return an empty Section, reusing pooled storage if there is any.
+    Section make_section();
+
+    // Take the storage of the given Section, and of the arrays it
+    // holds, into the pool, unless it is shared with another Section.
+    // The Section must not be used afterwards, except to destroy it.
+    void recycle(Section&& s);
+
+    counts get_counts() const;
+
+    // Free all the storage held by the pool, and zero the counts.
+    void release();
+
+  private:
+    // The pooled buffers of one element type; list k holds those whose
+    // capacity is in [2^k, 2^(k+1)).
+    template <class T>
+    using buffer_lists = std::array<std::vector<std::vector<T>>, 8 * sizeof(std::size_t)>;
+
+    template <class T>
+    buffer_lists<T>& buffers();
+
+    // Return the list for buffers with the given (nonzero) capacity.
+    static std::size_t list_for(std::size_t capacity);
+
+    template <class T>
+    void give(std::vector<T>& v);
+
+    void give(Entry& e);
+
+    mutable std::mutex mutex_;
+    std::size_t const max_bytes_;
+    std::size_t const max_sections_;
+    counts counts_;
+    buffer_lists<int> ints_;
+    buffer_lists<double> doubles_;
+    buffer_lists<complex_t> complexes_;
+    std::vector<std::shared_ptr<Section::map_type>> sections_;
+  };
+
+  template <>
+  inline block_pool::buffer_lists<int>& block_pool::buffers<int>() { return ints_; }
+
+  template <>
+  inline block_pool::buffer_lists<double>& block_pool::buffers<double>() { return doubles_; }
+
+  template <>
+  inline block_pool::buffer_lists<complex_t>& block_pool::buffers<complex_t>() { return complexes_; }
+
+  inline std::size_t
+  block_pool::list_for(std::size_t capacity)
+  {
+    std::size_t k = 0;
+    while (capacity >>= 1) ++k;
+    return k;
+  }
+}
+
+template <class T>
+std::vector<T>
+cosmosis::block_pool::make_vector(T const* first, std::size_t n)
+{
+  std::vector<T> result;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Take the smallest big enough buffer from the list for n, in which
+    // some may be too small; failing that, any from the first nonempty
+    // list after it, in which all are big enough.
+    auto& lists = buffers<T>();
+    std::size_t k = list_for(n == 0 ? 1 : n);
+    std::vector<std::vector<T>>* pool = nullptr;
+    auto best = lists[k].end();
+    for (auto i = lists[k].begin(); i != lists[k].end(); ++i)
+      if (i->capacity() >= n && (best == lists[k].end() || i->capacity() < best->capacity()))
+        best = i;
+    if (best != lists[k].end())
+      pool = &lists[k];
+    else
+      for (++k; k != lists.size(); ++k)
+        if (not lists[k].empty())
+          {
+            pool = &lists[k];
+            best = pool->end() - 1;
+            break;
+          }
+    if (pool == nullptr)
+      ++counts_.allocations;
+    else
+      {
+        ++counts_.reuses;
+        counts_.bytes_held -= best->capacity() * sizeof(T);
+        result.swap(*best);
+        if (best != pool->end() - 1) best->swap(pool->back());
+        pool->pop_back();
+      }
+  }
+  result.assign(first, first + n);
+  return result;
+}
+
+#endif
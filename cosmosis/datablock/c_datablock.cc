@@ -3,6 +3,8 @@
 #include <complex>   // the C++ header
 #include <string.h>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <functional>
 #include <numeric>
 
@@ -46,14 +48,121 @@ namespace
     return res;
   }
   
-  std::vector<std::complex<double>> from_Complex(double _Complex const* first, std::size_t sz)
+  // A c_datablock_pool is a shared_ptr to a block_pool, shared with
+  // the blocks made from it.
+  typedef std::shared_ptr<cosmosis::block_pool> pool_handle;
+
+  // Make an ndarray holding a copy of the given values, for the given
+  // block; the storage comes from the block's pool, if it has one.
+  template <class T>
+  ndarray<T> make_ndarray(DataBlock* p, T const* val, int ndims, int const* extents)
   {
-    std::vector<std::complex<double>> res(sz);
-    for (std::size_t i = 0; i != sz; ++i)
-    {
-      res[i] = from_Complex(first[i]);
+    vector<size_t> local_extents(extents, extents + ndims);
+    auto values = p->make_vector(val, cosmosis::num_elements(local_extents));
+    return ndarray<T>(std::move(values), std::move(local_extents));
+  }
+
+  // The state behind a c_datablock_view: a pin of the viewed array
+  // (see DataBlock::pin_val), which keeps it alive and unchanged, and
+  // the extents of the array in the form used by the C interface.
+  struct array_view
+  {
+    std::shared_ptr<cosmosis::Entry const> value;
+    vector<int> extents;
+  };
+
+  // The state behind a c_datablock_array. Only the member matching
+  // 'type' is used.
+  struct detached_array
+  {
+    datablock_type_t type;
+    cosmosis::vint_t vi;
+    cosmosis::vdouble_t vd;
+    cosmosis::nd_int_t ndi;
+    cosmosis::nd_double_t ndd;
+  };
+
+  template <class T>
+  void const* array_data(vector<T> const& a, vector<int>& extents)
+  {
+    extents.assign(1, clamp(a.size()));
+    return a.empty() ? nullptr : a.data();
+  }
+
+  template <class T>
+  void const* array_data(ndarray<T> const& a, vector<int>& extents)
+  {
+    extents.clear();
+    for (auto n : a.extents()) extents.push_back(clamp(n));
+    return a.size() == 0 ? nullptr : a.data();
+  }
+
+  template <class T>
+  DATABLOCK_STATUS move_array(DataBlock* p,
+                              const char* section,
+                              const char* name,
+                              T& value,
+                              bool replace)
+  {
+    return replace ? p->replace_val(section, name, std::move(value))
+                   : p->put_val(section, name, std::move(value));
+  }
+
+  DATABLOCK_STATUS move_array(c_datablock* s,
+                              const char* section,
+                              const char* name,
+                              c_datablock_array* array,
+                              bool replace)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (section == nullptr) return DBS_SECTION_NULL;
+    if (name == nullptr) return DBS_NAME_NULL;
+    if (array == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    auto a = static_cast<detached_array*>(array);
+    switch (a->type)
+      {
+      case DBT_INT1D: return move_array(p, section, name, a->vi, replace);
+      case DBT_DOUBLE1D: return move_array(p, section, name, a->vd, replace);
+      case DBT_INTND: return move_array(p, section, name, a->ndi, replace);
+      case DBT_DOUBLEND: return move_array(p, section, name, a->ndd, replace);
+      default: return DBS_LOGIC_ERROR;
+      }
+  }
+
+  // Call f(p, section, name, i) for each of the n values given to one
+  // of the c_datablock_TYPE_many functions, stopping at the first that
+  // fails.
+  template <class F>
+  DATABLOCK_STATUS for_each_value(c_datablock* s,
+                                  int n,
+                                  const char* const* sections,
+                                  const char* const* names,
+                                  void const* vals,
+                                  int* failed,
+                                  F f)
+  {
+    if (failed != nullptr) *failed = -1;
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (n < 0) return DBS_SIZE_NONPOSITIVE;
+    if (n == 0) return DBS_SUCCESS;
+    if (sections == nullptr) return DBS_SECTION_NULL;
+    if (names == nullptr) return DBS_NAME_NULL;
+    if (vals == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    for (int i = 0; i != n; ++i) {
+      DATABLOCK_STATUS status;
+      if (sections[i] == nullptr) status = DBS_SECTION_NULL;
+      else if (names[i] == nullptr) status = DBS_NAME_NULL;
+      else status = f(p, sections[i], names[i], i);
+      if (status != DBS_SUCCESS) {
+        if (failed != nullptr) *failed = i;
+        return status;
+      }
     }
-    return res;
+    return DBS_SUCCESS;
   }
 }
 
@@ -73,6 +182,183 @@ extern "C"
     return new cosmosis::DataBlock(*p);
   }
 
+  DATABLOCK_STATUS c_datablock_reset(c_datablock* s)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    static_cast<DataBlock*>(s)->reset();
+    return DBS_SUCCESS;
+  }
+
+  c_datablock_pool* make_c_datablock_pool(void)
+  {
+    return new pool_handle(std::make_shared<cosmosis::block_pool>());
+  }
+
+  DATABLOCK_STATUS destroy_c_datablock_pool(c_datablock_pool* pool)
+  {
+    if (pool == nullptr) return DBS_VALUE_NULL;
+    delete static_cast<pool_handle*>(pool);
+    return DBS_SUCCESS;
+  }
+
+  c_datablock* make_c_datablock_pooled(c_datablock_pool* pool)
+  {
+    if (pool == nullptr) return nullptr;
+    return new cosmosis::DataBlock(*static_cast<pool_handle*>(pool));
+  }
+
+  DATABLOCK_STATUS c_datablock_pool_counts(c_datablock_pool const* pool,
+                                           long* allocations,
+                                           long* reuses,
+                                           long* bytes_held)
+  {
+    if (pool == nullptr) return DBS_VALUE_NULL;
+    if (allocations == nullptr || reuses == nullptr || bytes_held == nullptr)
+      return DBS_VALUE_NULL;
+    auto counts = (*static_cast<pool_handle const*>(pool))->get_counts();
+    *allocations = counts.allocations;
+    *reuses = counts.reuses;
+    *bytes_held = counts.bytes_held;
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS c_datablock_serialized_size(c_datablock const* s, size_t* size)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (size == nullptr) return DBS_SIZE_NULL;
+    *size = static_cast<DataBlock const*>(s)->serialized_size();
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS c_datablock_serialize(c_datablock const* s, void* buffer, size_t size)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (buffer == nullptr) return DBS_VALUE_NULL;
+    DataBlock const* p = static_cast<DataBlock const*>(s);
+    if (size < p->serialized_size()) return DBS_SIZE_INSUFFICIENT;
+    p->serialize(static_cast<char*>(buffer));
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS c_datablock_deserialize(c_datablock* s, void const* data, size_t size)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (data == nullptr) return DBS_VALUE_NULL;
+    try {
+      return static_cast<DataBlock*>(s)->deserialize(static_cast<char const*>(data), size);
+    }
+    catch (std::bad_alloc const&) {
+      return DBS_MEMORY_ALLOC_FAILURE;
+    }
+  }
+
+  DATABLOCK_STATUS c_datablock_save_snapshot(c_datablock const* s, const char* filename)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (filename == nullptr) return DBS_NAME_NULL;
+    return static_cast<DataBlock const*>(s)->save_snapshot(filename);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_hash(c_datablock const* s, int nsections,
+                   const char* const* sections, uint64_t* hash)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (hash == nullptr) return DBS_VALUE_NULL;
+    if (nsections < 0) return DBS_SIZE_NONPOSITIVE;
+    if (nsections > 0 && sections == nullptr) return DBS_SECTION_NULL;
+    try {
+      vector<string> names;
+      for (int i = 0; i != nsections; ++i) {
+        if (sections[i] == nullptr) return DBS_SECTION_NULL;
+        names.emplace_back(sections[i]);
+      }
+      auto const h = static_cast<DataBlock const*>(s)->hash(names);
+      hash[0] = h[0];
+      hash[1] = h[1];
+    }
+    catch (std::bad_alloc const&) { return DBS_MEMORY_ALLOC_FAILURE; }
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_hash_values(c_datablock const* s, int n,
+                          const char* const* sections, const char* const* names,
+                          uint64_t* hash, int* failed)
+  {
+    if (failed != nullptr) *failed = -1;
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (hash == nullptr) return DBS_VALUE_NULL;
+    if (n < 0) return DBS_SIZE_NONPOSITIVE;
+    if (n > 0 && sections == nullptr) return DBS_SECTION_NULL;
+    if (n > 0 && names == nullptr) return DBS_NAME_NULL;
+    try {
+      vector<std::pair<string, string>> keys;
+      for (int i = 0; i != n; ++i) {
+        DATABLOCK_STATUS status = DBS_SUCCESS;
+        if (sections[i] == nullptr) status = DBS_SECTION_NULL;
+        else if (names[i] == nullptr) status = DBS_NAME_NULL;
+        if (status != DBS_SUCCESS) {
+          if (failed != nullptr) *failed = i;
+          return status;
+        }
+        keys.emplace_back(sections[i], names[i]);
+      }
+      DataBlock::hash_value h;
+      std::size_t bad = 0;
+      auto status = static_cast<DataBlock const*>(s)->hash(keys, h, &bad);
+      if (status != DBS_SUCCESS) {
+        if (failed != nullptr) *failed = static_cast<int>(bad);
+        return status;
+      }
+      hash[0] = h[0];
+      hash[1] = h[1];
+    }
+    catch (std::bad_alloc const&) { return DBS_MEMORY_ALLOC_FAILURE; }
+    return DBS_SUCCESS;
+  }
+
+  uint64_t c_datablock_mark(c_datablock const* s)
+  {
+    if (s == nullptr) return 0;
+    return static_cast<DataBlock const*>(s)->mark();
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_changed_since(c_datablock const* s, uint64_t mark, int maxn,
+                            const char** sections, const char** names, int* n)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (n == nullptr) return DBS_VALUE_NULL;
+    if (maxn < 0) return DBS_SIZE_NONPOSITIVE;
+    if (maxn > 0 && sections == nullptr) return DBS_SECTION_NULL;
+    if (maxn > 0 && names == nullptr) return DBS_NAME_NULL;
+    try {
+      auto const changed = static_cast<DataBlock const*>(s)->changed_since(mark);
+      *n = static_cast<int>(changed.size());
+      for (int i = 0; i != maxn && i != *n; ++i) {
+        sections[i] = changed[i].first.str().c_str();
+        names[i] = changed[i].second.str().c_str();
+      }
+      if (*n > maxn) return DBS_SIZE_INSUFFICIENT;
+    }
+    catch (std::bad_alloc const&) { return DBS_MEMORY_ALLOC_FAILURE; }
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_get_access_counts(c_datablock const* s, uint64_t* counts)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (counts == nullptr) return DBS_VALUE_NULL;
+    auto const& c = static_cast<DataBlock const*>(s)->counts();
+    counts[0] = c.reads;
+    counts[1] = c.read_bytes;
+    counts[2] = c.writes;
+    counts[3] = c.write_bytes;
+    return DBS_SUCCESS;
+  }
+
 
   bool c_datablock_has_section(c_datablock const* s, const char* name)
   {
@@ -444,17 +730,18 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<int> const& r = p->view<vector<int>>(section, name);
-      *val = static_cast<int*>(malloc(r.size() * sizeof(int)));
-      if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
-      std::copy(r.cbegin(), r.cend(), *val);
-      *sz = r.size();
+      return p->view<vector<int>>(section, name, [&](vector<int> const& r) {
+          *val = static_cast<int*>(malloc(r.size() * sizeof(int)));
+          if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
+          std::copy(r.cbegin(), r.cend(), *val);
+          *sz = r.size();
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
   DATABLOCK_STATUS
@@ -472,17 +759,18 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<double> const& r = p->view<vector<double>>(section, name);
-      *val = static_cast<double*>(malloc(r.size() * sizeof(double)));
-      if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
-      std::copy(r.cbegin(), r.cend(), *val);
-      *sz = r.size();
+      return p->view<vector<double>>(section, name, [&](vector<double> const& r) {
+          *val = static_cast<double*>(malloc(r.size() * sizeof(double)));
+          if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
+          std::copy(r.cbegin(), r.cend(), *val);
+          *sz = r.size();
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
   DATABLOCK_STATUS
@@ -500,20 +788,21 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<complex_t> const& r = p->view<vector<complex_t>>(section, name);
-      *val = static_cast<double _Complex*>(malloc(r.size() * sizeof(double _Complex)));
-      if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
-      for (size_t i = 0, n = r.size(); i != n; ++i)
-        {
-          (*val)[i] = * reinterpret_cast<double _Complex const*>(&(r[i]));
-        }
-      *sz = r.size();
+      return p->view<vector<complex_t>>(section, name, [&](vector<complex_t> const& r) {
+          *val = static_cast<double _Complex*>(malloc(r.size() * sizeof(double _Complex)));
+          if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
+          for (size_t i = 0, n = r.size(); i != n; ++i)
+            {
+              (*val)[i] = * reinterpret_cast<double _Complex const*>(&(r[i]));
+            }
+          *sz = r.size();
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
   DATABLOCK_STATUS
@@ -531,21 +820,22 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<string> const& r = p->view<vector<string>>(section, name);
-      *val = static_cast<char**>(malloc(r.size() * sizeof(char*)));
-      *sz = r.size();
-      if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
-      for (int i=0; i<*sz; i++){
-        (*val)[i] = strdup(r[i].c_str());
-      }
+      return p->view<vector<string>>(section, name, [&](vector<string> const& r) {
+          *val = static_cast<char**>(malloc(r.size() * sizeof(char*)));
+          *sz = r.size();
+          if (*val ==nullptr) return DBS_MEMORY_ALLOC_FAILURE;
+          for (int i=0; i<*sz; i++){
+            (*val)[i] = strdup(r[i].c_str());
+          }
 
-      *sz = r.size();
+          *sz = r.size();
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
 
@@ -565,19 +855,20 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<int> const& r = p->view<vector<int>>(section, name);
-      *sz = r.size();
-      if (r.size() > static_cast<size_t>(maxsize)) return DBS_SIZE_INSUFFICIENT;
-      std::copy(r.cbegin(), r.cend(), val);
+      return p->view<vector<int>>(section, name, [&](vector<int> const& r) {
+          *sz = r.size();
+          if (r.size() > static_cast<size_t>(maxsize)) return DBS_SIZE_INSUFFICIENT;
+          std::copy(r.cbegin(), r.cend(), val);
+          // If we are asked to clear out the remainder of the input buffer,
+          // the following line should be used.
+          //    std::fill(val + *sz, val+maxsize, 0);
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    // If we are asked to clear out the remainder of the input buffer,
-    // the following line should be used.
-    //    std::fill(val + *sz, val+maxsize, 0);
-    return DBS_SUCCESS;
   }
 
 
@@ -597,19 +888,20 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<double> const& r = p->view<vector<double>>(section, name);
-      *sz = r.size();
-      if (r.size() > static_cast<size_t>(maxsize)) return DBS_SIZE_INSUFFICIENT;
-      std::copy(r.cbegin(), r.cend(), val);
+      return p->view<vector<double>>(section, name, [&](vector<double> const& r) {
+          *sz = r.size();
+          if (r.size() > static_cast<size_t>(maxsize)) return DBS_SIZE_INSUFFICIENT;
+          std::copy(r.cbegin(), r.cend(), val);
+          // If we are asked to clear out the remainder of the input buffer,
+          // the following line should be used.
+          //    std::fill(val + *sz, val+maxsize, 0);
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    // If we are asked to clear out the remainder of the input buffer,
-    // the following line should be used.
-    //    std::fill(val + *sz, val+maxsize, 0);
-    return DBS_SUCCESS;
   }
 
 
@@ -629,25 +921,24 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try{
-      vector<complex_t> const& r = p->view<vector<complex_t>>(section, name);
-      *sz = r.size();
-      if (r.size() > static_cast<size_t>(maxsize)) return DBS_SIZE_INSUFFICIENT;
-      //std::copy(r.cbegin(), r.cend(), val);
-      for (size_t i = 0, n = r.size(); i != n; ++i)
-        {
-          val[i] = from_complex(r[i]);
-        }
+      return p->view<vector<complex_t>>(section, name, [&](vector<complex_t> const& r) {
+          *sz = r.size();
+          if (r.size() > static_cast<size_t>(maxsize)) return DBS_SIZE_INSUFFICIENT;
+          //std::copy(r.cbegin(), r.cend(), val);
+          for (size_t i = 0, n = r.size(); i != n; ++i)
+            {
+              val[i] = from_complex(r[i]);
+            }
+          // If we are asked to clear out the remainder of the input buffer,
+          // the following line should be used.
+          //    std::fill(val + *sz, val+maxsize, 0);
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-
-
-    // If we are asked to clear out the remainder of the input buffer,
-    // the following line should be used.
-    //    std::fill(val + *sz, val+maxsize, 0);
-    return DBS_SUCCESS;
   }
 
 
@@ -666,17 +957,18 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      vector<string> const& r = p->view<vector<string>>(section, name);
-      *sz = r.size();
-      for (int i=0; i<*sz; i++){
-        val[i] = strdup(r[i].c_str());
-      }
+      return p->view<vector<string>>(section, name, [&](vector<string> const& r) {
+          *sz = r.size();
+          for (int i=0; i<*sz; i++){
+            val[i] = strdup(r[i].c_str());
+          }
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
   DATABLOCK_STATUS
@@ -765,7 +1057,7 @@ extern "C"
     if (sz < 1) return DBS_SIZE_NONPOSITIVE;
 
     auto p = static_cast<DataBlock*>(s);
-    return p->put_val(section, name, vector<int>(val, val+sz));
+    return p->put_val(section, name, p->make_vector(val, sz));
   }
 
   DATABLOCK_STATUS
@@ -782,7 +1074,7 @@ extern "C"
     if (sz < 1) return DBS_SIZE_NONPOSITIVE;
 
     auto p = static_cast<DataBlock*>(s);
-    return p->put_val(section, name, vector<double>(val, val+sz));
+    return p->put_val(section, name, p->make_vector(val, sz));
   }
 
   DATABLOCK_STATUS
@@ -799,8 +1091,9 @@ extern "C"
     if (sz < 1) return DBS_SIZE_NONPOSITIVE;
 
     auto p = static_cast<DataBlock*>(s);
-    std::vector<complex_t> zs = from_Complex(val, sz);
-    return p->put_val(section, name, zs);
+    // double _Complex and complex_t have the same representation.
+    auto zs = p->make_vector(reinterpret_cast<complex_t const*>(val), sz);
+    return p->put_val(section, name, std::move(zs));
   }
 
 
@@ -896,6 +1189,167 @@ extern "C"
     return p->replace_val(section, name, string(val));
   }
 
+  DATABLOCK_STATUS
+  c_datablock_resolve(c_datablock* s,
+                      const char* section,
+                      const char* name,
+                      int* handle)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (section == nullptr) return DBS_SECTION_NULL;
+    if (name == nullptr) return DBS_NAME_NULL;
+    if (handle == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    *handle = p->resolve(section, name);
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_get_int_h(c_datablock* s, int handle, int* val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (val == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->get_val(handle, *val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_get_bool_h(c_datablock* s, int handle, bool* val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (val == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->get_val(handle, *val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_get_double_h(c_datablock* s, int handle, double* val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (val == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->get_val(handle, *val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_put_int_h(c_datablock* s, int handle, int val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->put_val(handle, val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_put_bool_h(c_datablock* s, int handle, bool val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->put_val(handle, val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_put_double_h(c_datablock* s, int handle, double val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->put_val(handle, val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_replace_int_h(c_datablock* s, int handle, int val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->replace_val(handle, val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_replace_bool_h(c_datablock* s, int handle, bool val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->replace_val(handle, val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_replace_double_h(c_datablock* s, int handle, double val)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    return p->replace_val(handle, val);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_get_double_many(c_datablock* s,
+                              int n,
+                              const char* const* sections,
+                              const char* const* names,
+                              double* vals,
+                              int* failed)
+  {
+    return for_each_value(s, n, sections, names, vals, failed,
+                          [vals](DataBlock* p, const char* section, const char* name, int i)
+                          { return p->get_val(section, name, vals[i]); });
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_put_double_many(c_datablock* s,
+                              int n,
+                              const char* const* sections,
+                              const char* const* names,
+                              double const* vals,
+                              int* failed)
+  {
+    return for_each_value(s, n, sections, names, vals, failed,
+                          [vals](DataBlock* p, const char* section, const char* name, int i)
+                          { return p->put_val(section, name, vals[i]); });
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_replace_double_many(c_datablock* s,
+                                  int n,
+                                  const char* const* sections,
+                                  const char* const* names,
+                                  double const* vals,
+                                  int* failed)
+  {
+    return for_each_value(s, n, sections, names, vals, failed,
+                          [vals](DataBlock* p, const char* section, const char* name, int i)
+                          { return p->replace_val(section, name, vals[i]); });
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_get_handle_key(c_datablock const* s,
+                             int handle,
+                             int smax,
+                             char* section,
+                             char* name)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (section == nullptr) return DBS_SECTION_NULL;
+    if (name == nullptr) return DBS_NAME_NULL;
+    if (smax <= 0) return DBS_SIZE_NONPOSITIVE;
+
+    auto p = static_cast<DataBlock const*>(s);
+    std::string section_string, name_string;
+    DATABLOCK_STATUS status = p->handle_key(handle, section_string, name_string);
+    if (status) return status;
+
+    strncpy(section, section_string.c_str(), smax);
+    strncpy(name, name_string.c_str(), smax);
+    return DBS_SUCCESS;
+  }
+
   DATABLOCK_STATUS
   c_datablock_replace_int_array_1d(c_datablock* s,
                                    const char* section,
@@ -910,7 +1364,10 @@ extern "C"
     if (sz  < 1) return DBS_SIZE_NONPOSITIVE;
 
     auto p = static_cast<DataBlock*>(s);
-    return p->replace_val(section, name, vector<int>(val, val+sz));
+    // Reuse the existing array if it has the same size.
+    if (p->overwrite_val<vector<int>>(section, name, val, 1, &sz) == DBS_SUCCESS)
+      return DBS_SUCCESS;
+    return p->replace_val(section, name, p->make_vector(val, sz));
   }
 
   DATABLOCK_STATUS
@@ -927,7 +1384,9 @@ extern "C"
     if (sz  < 1) return DBS_SIZE_NONPOSITIVE;
 
     auto p = static_cast<DataBlock*>(s);
-    return p->replace_val(section, name, vector<double>(val, val+sz));
+    if (p->overwrite_val<vector<double>>(section, name, val, 1, &sz) == DBS_SUCCESS)
+      return DBS_SUCCESS;
+    return p->replace_val(section, name, p->make_vector(val, sz));
   }
 
   DATABLOCK_STATUS
@@ -944,8 +1403,13 @@ extern "C"
     if (sz  < 1) return DBS_SIZE_NONPOSITIVE;
 
     auto p = static_cast<DataBlock*>(s);
-    vector<complex_t> zs = from_Complex(val, sz);
-    return p->replace_val(section, name, zs);
+    // double _Complex and complex_t have the same representation.
+    if (p->overwrite_val<vector<complex_t>>(section, name,
+                                            reinterpret_cast<complex_t const*>(val),
+                                            1, &sz) == DBS_SUCCESS)
+      return DBS_SUCCESS;
+    auto zs = p->make_vector(reinterpret_cast<complex_t const*>(val), sz);
+    return p->replace_val(section, name, std::move(zs));
   }
 
   DATABLOCK_STATUS
@@ -964,8 +1428,8 @@ extern "C"
     if (extents == nullptr) return DBS_EXTENTS_NULL;
 
     auto p = static_cast<DataBlock*>(s);
-    ndarray<int> tmp(val, ndims, extents);
-    return p->put_val(section, name, tmp);
+    auto tmp = make_ndarray(p, val, ndims, extents);
+    return p->put_val(section, name, std::move(tmp));
   }
 
     DATABLOCK_STATUS
@@ -984,8 +1448,10 @@ extern "C"
     if (extents == nullptr) return DBS_EXTENTS_NULL;
 
     auto p = static_cast<DataBlock*>(s);
-    ndarray<int> tmp(val, ndims, extents);
-    return p->replace_val(section, name, tmp);
+    if (p->overwrite_val<ndarray<int>>(section, name, val, ndims, extents) == DBS_SUCCESS)
+      return DBS_SUCCESS;
+    auto tmp = make_ndarray(p, val, ndims, extents);
+    return p->replace_val(section, name, std::move(tmp));
   }
 
 
@@ -1029,18 +1495,19 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      ndarray<int> const& r = p->view<ndarray<int>>(section, name);
-      if (clamp(r.ndims()) != ndims) return DBS_NDIM_MISMATCH;
-      for (size_t i = 0, sz = ndims; i != sz; ++i)
-        if (clamp(r.extents()[i]) != extents[i])
-          return DBS_EXTENTS_MISMATCH;
-      std::copy(r.begin(), r.end(), val);
+      return p->view<ndarray<int>>(section, name, [&](ndarray<int> const& r) {
+          if (clamp(r.ndims()) != ndims) return DBS_NDIM_MISMATCH;
+          for (size_t i = 0, sz = ndims; i != sz; ++i)
+            if (clamp(r.extents()[i]) != extents[i])
+              return DBS_EXTENTS_MISMATCH;
+          std::copy(r.begin(), r.end(), val);
+          return DBS_SUCCESS;
+        });
     }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
   DATABLOCK_STATUS
@@ -1059,8 +1526,8 @@ extern "C"
     if (extents == nullptr) return DBS_EXTENTS_NULL;
 
     auto p = static_cast<DataBlock*>(s);
-    ndarray<double> tmp(val, ndims, extents);
-    return p->put_val(section, name, tmp);
+    auto tmp = make_ndarray(p, val, ndims, extents);
+    return p->put_val(section, name, std::move(tmp));
   }
 
 
@@ -1080,8 +1547,10 @@ extern "C"
     if (extents == nullptr) return DBS_EXTENTS_NULL;
 
     auto p = static_cast<DataBlock*>(s);
-    ndarray<double> tmp(val, ndims, extents);
-    return p->replace_val(section, name, tmp);
+    if (p->overwrite_val<ndarray<double>>(section, name, val, ndims, extents) == DBS_SUCCESS)
+      return DBS_SUCCESS;
+    auto tmp = make_ndarray(p, val, ndims, extents);
+    return p->replace_val(section, name, std::move(tmp));
   }
 
 
@@ -1126,20 +1595,21 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      ndarray<double> const& r = p->view<ndarray<double>>(section, name);
-      if (clamp(r.ndims()) != ndims) return DBS_NDIM_MISMATCH;
-      for (size_t i = 0, sz = ndims; i != sz; ++i){
-        if (clamp(r.extents()[i]) != extents[i]){
-          return DBS_EXTENTS_MISMATCH;
-        }
-      }
-      std::copy(r.begin(), r.end(), val);
-     }
+      return p->view<ndarray<double>>(section, name, [&](ndarray<double> const& r) {
+          if (clamp(r.ndims()) != ndims) return DBS_NDIM_MISMATCH;
+          for (size_t i = 0, sz = ndims; i != sz; ++i){
+            if (clamp(r.extents()[i]) != extents[i]){
+              return DBS_EXTENTS_MISMATCH;
+            }
+          }
+          std::copy(r.begin(), r.end(), val);
+          return DBS_SUCCESS;
+        });
+    }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
-    return DBS_SUCCESS;
   }
 
   DATABLOCK_STATUS
@@ -1158,16 +1628,9 @@ extern "C"
     if (extents == nullptr) return DBS_EXTENTS_NULL;
 
     auto p = static_cast<DataBlock*>(s);
-    // Complex values require translation, so this is handled
-    // differently from int and double...
-    size_t num_elements =
-      std::accumulate(extents, extents+ndims, 1, std::multiplies<int>());
-
-    //vector<complex_t> z(val, val + num_elements);
-    vector<complex_t> z = from_Complex(val, num_elements);
-    vector<size_t> local_extents(extents, extents+ndims);
-    ndarray<complex_t> tmp(z, local_extents);
-    return p->put_val(section, name, tmp);
+    // double _Complex and complex_t have the same representation.
+    auto tmp = make_ndarray(p, reinterpret_cast<complex_t const*>(val), ndims, extents);
+    return p->put_val(section, name, std::move(tmp));
   }
 
   DATABLOCK_STATUS
@@ -1210,23 +1673,156 @@ extern "C"
 
     auto p = static_cast<DataBlock *>(s);
     try {
-      ndarray<complex_t> const& r = p->view<ndarray<complex_t>>(section, name);
-      if (clamp(r.ndims()) != ndims) return DBS_NDIM_MISMATCH;
-      for (size_t i = 0, sz = ndims; i != sz; ++i)
-        if (clamp(r.extents()[i]) != extents[i])
-          return DBS_EXTENTS_MISMATCH;
-      // We rely on the layout of std::complex<double> and double
-      // _Complex matching. Note that &*r.begin() returns the address of
-      // the first location of the stored complex numbers.
-      memcpy(val, &*r.begin(), r.size()*sizeof(complex_t));
-     }
+      return p->view<ndarray<complex_t>>(section, name, [&](ndarray<complex_t> const& r) {
+          if (clamp(r.ndims()) != ndims) return DBS_NDIM_MISMATCH;
+          for (size_t i = 0, sz = ndims; i != sz; ++i)
+            if (clamp(r.extents()[i]) != extents[i])
+              return DBS_EXTENTS_MISMATCH;
+          // We rely on the layout of std::complex<double> and double
+          // _Complex matching. Note that &*r.begin() returns the address of
+          // the first location of the stored complex numbers.
+          memcpy(val, &*r.begin(), r.size()*sizeof(complex_t));
+          return DBS_SUCCESS;
+        });
+    }
     catch (DataBlock::BadDataBlockAccess const&) { return DBS_SECTION_NOT_FOUND; }
     catch (Section::BadSectionAccess const&) { return DBS_NAME_NOT_FOUND; }
     catch (Entry::BadEntry const&) { return DBS_WRONG_VALUE_TYPE; }
     catch (...) { return DBS_LOGIC_ERROR; }
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_view_array(c_datablock* s,
+                         const char* section,
+                         const char* name,
+                         c_datablock_view** view,
+                         datablock_type_t* type,
+                         void const** data,
+                         int* ndims,
+                         int const** extents)
+  {
+    if (s == nullptr) return DBS_DATABLOCK_NULL;
+    if (section == nullptr) return DBS_SECTION_NULL;
+    if (name == nullptr) return DBS_NAME_NULL;
+    if (view == nullptr || type == nullptr || data == nullptr ||
+        ndims == nullptr || extents == nullptr) return DBS_VALUE_NULL;
+
+    auto p = static_cast<DataBlock*>(s);
+    auto const sec = cosmosis::name_id::folded(section);
+    auto const nm = cosmosis::name_id::folded(name);
+    std::unique_ptr<array_view> v(new array_view);
+    DATABLOCK_STATUS status = DBS_SUCCESS;
+    datablock_type_t t = DBT_UNKNOWN;
+    void const* d = nullptr;
+    try {
+      status = p->pin_val(section, name, v->value);
+      if (status == DBS_SUCCESS)
+        {
+          cosmosis::Entry const& e = *v->value;
+          if (e.is<cosmosis::vint_t>()) { t = DBT_INT1D; d = array_data(e.view<cosmosis::vint_t>(), v->extents); }
+          else if (e.is<cosmosis::vdouble_t>()) { t = DBT_DOUBLE1D; d = array_data(e.view<cosmosis::vdouble_t>(), v->extents); }
+          else if (e.is<cosmosis::vcomplex_t>()) { t = DBT_COMPLEX1D; d = array_data(e.view<cosmosis::vcomplex_t>(), v->extents); }
+          else if (e.is<cosmosis::nd_int_t>()) { t = DBT_INTND; d = array_data(e.view<cosmosis::nd_int_t>(), v->extents); }
+          else if (e.is<cosmosis::nd_double_t>()) { t = DBT_DOUBLEND; d = array_data(e.view<cosmosis::nd_double_t>(), v->extents); }
+          else if (e.is<cosmosis::nd_complex_t>()) { t = DBT_COMPLEXND; d = array_data(e.view<cosmosis::nd_complex_t>(), v->extents); }
+          else status = DBS_WRONG_VALUE_TYPE;
+        }
+    }
+    catch (...) { status = DBS_LOGIC_ERROR; }
+
+    if (status != DBS_SUCCESS)
+      {
+        p->log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(void*));
+        return status;
+      }
+    p->log_access(BLOCK_LOG_READ, sec, nm, typeid(void*));
+    *type = t;
+    *data = d;
+    *ndims = static_cast<int>(v->extents.size());
+    *extents = v->extents.data();
+    *view = v.release();
+    return DBS_SUCCESS;
+  }
+
+  DATABLOCK_STATUS
+  destroy_c_datablock_view(c_datablock_view* view)
+  {
+    delete static_cast<array_view*>(view);
+    return DBS_SUCCESS;
+  }
+
+  c_datablock_array*
+  make_c_datablock_array(datablock_type_t type,
+                         int ndims,
+                         int const* extents,
+                         void** data)
+  {
+    if (extents == nullptr || data == nullptr || ndims < 1) return nullptr;
+    bool const is_1d = (type == DBT_INT1D || type == DBT_DOUBLE1D);
+    if (is_1d && ndims != 1) return nullptr;
+    vector<size_t> ext;
+    size_t n = 1;
+    for (int i = 0; i != ndims; ++i)
+      {
+        if (extents[i] < 0) return nullptr;
+        ext.push_back(extents[i]);
+        n *= extents[i];
+      }
+
+    std::unique_ptr<detached_array> a;
+    try {
+      a.reset(new detached_array{type, {}, {}, {{}, {}}, {{}, {}}});
+      switch (type)
+        {
+        case DBT_INT1D:
+          a->vi.resize(n);
+          *data = a->vi.data();
+          break;
+        case DBT_DOUBLE1D:
+          a->vd.resize(n);
+          *data = a->vd.data();
+          break;
+        case DBT_INTND:
+          a->ndi = cosmosis::nd_int_t(vector<int>(n), ext);
+          *data = a->ndi.data();
+          break;
+        case DBT_DOUBLEND:
+          a->ndd = cosmosis::nd_double_t(vector<double>(n), ext);
+          *data = a->ndd.data();
+          break;
+        default:
+          return nullptr;
+        }
+    }
+    catch (...) { return nullptr; }
+    return a.release();
+  }
+
+  DATABLOCK_STATUS
+  destroy_c_datablock_array(c_datablock_array* array)
+  {
+    delete static_cast<detached_array*>(array);
     return DBS_SUCCESS;
   }
 
+  DATABLOCK_STATUS
+  c_datablock_put_array_move(c_datablock* s,
+                             const char* section,
+                             const char* name,
+                             c_datablock_array* array)
+  {
+    return move_array(s, section, name, array, false);
+  }
+
+  DATABLOCK_STATUS
+  c_datablock_replace_array_move(c_datablock* s,
+                                 const char* section,
+                                 const char* name,
+                                 c_datablock_array* array)
+  {
+    return move_array(s, section, name, array, true);
+  }
+
 DATABLOCK_STATUS  c_datablock_put_double_grid(
   c_datablock* s,
   const char * section, 
@@ -1452,12 +2048,60 @@ c_datablock_log_access(c_datablock* s,
 {
 
   if (s == nullptr) return DBS_DATABLOCK_NULL;
+  if (section == nullptr) return DBS_SECTION_NULL;
+  if (name == nullptr) return DBS_NAME_NULL;
+  if (log_type == nullptr) return DBS_VALUE_NULL;
   string t = string(""); // Dummy type since not posible in C
   auto p = static_cast<DataBlock*>(s);
   p->log_access(log_type, section, name, typeid(t));
   return DBS_SUCCESS;
 }
 
+DATABLOCK_STATUS
+c_datablock_set_log_mode(c_datablock* s, datablock_log_mode_t mode)
+{
+  if (s == nullptr) return DBS_DATABLOCK_NULL;
+  if (mode != DBL_OFF && mode != DBL_FAILURES && mode != DBL_FULL)
+    return DBS_WRONG_VALUE_TYPE;
+  auto p = static_cast<DataBlock*>(s);
+  p->set_log_mode(mode);
+  return DBS_SUCCESS;
+}
+
+int
+c_datablock_get_log_mode(c_datablock const* s)
+{
+  if (s == nullptr) return -1;
+  auto p = static_cast<DataBlock const*>(s);
+  return p->log_mode();
+}
+
+DATABLOCK_STATUS
+c_datablock_set_log_capacity(c_datablock* s, int capacity)
+{
+  if (s == nullptr) return DBS_DATABLOCK_NULL;
+  if (capacity <= 0) return DBS_SIZE_NONPOSITIVE;
+  auto p = static_cast<DataBlock*>(s);
+  p->set_log_capacity(capacity);
+  return DBS_SUCCESS;
+}
+
+DATABLOCK_STATUS
+c_datablock_set_concurrent(c_datablock* s, bool on)
+{
+  if (s == nullptr) return DBS_DATABLOCK_NULL;
+  auto p = static_cast<DataBlock*>(s);
+  p->set_concurrent(on);
+  return DBS_SUCCESS;
+}
+
+bool
+c_datablock_is_concurrent(c_datablock const* s)
+{
+  if (s == nullptr) return false;
+  return static_cast<DataBlock const*>(s)->concurrent();
+}
+
 int c_datablock_get_log_count(c_datablock *s)
 {
     if (s == nullptr) return -1;
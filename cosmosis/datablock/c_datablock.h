@@ -3,14 +3,19 @@
 
 #include "datablock_status.h"
 #include "datablock_types.h"
+#include "datablock_logging.h"
 #include "section_names.h"
 
 #ifdef __cplusplus
 #include <complex> 
 #include <cstdbool>
+#include <cstddef>
+#include <cstdint>
 #else
 #include <complex.h> 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #endif
 
 #define OPTION_SECTION "module_options"
@@ -56,6 +61,129 @@ extern "C" {
   c_datablock * 
   clone_c_datablock(c_datablock* s);
 
+  /*
+    c_datablock_reset returns the given c_datablock to the state of a
+    newly-made one, with no sections and an empty access log, but keeps
+    the memory used for its sections and arrays so that the values put
+    next can reuse it; it is meant for reusing one c_datablock for each
+    sample of a pipeline. Handles, and the log mode and capacity, are
+    kept.
+  */
+  DATABLOCK_STATUS
+  c_datablock_reset(c_datablock* s);
+
+  /*
+    A c_datablock_pool keeps the storage of c_datablocks made from it
+    once they are cleared or destroyed, so that later blocks made from
+    the same pool can reuse it rather than allocating afresh. It is
+    intended for the block built for each sample of a pipeline, which
+    has much the same contents each time. The pool holds the buffers of
+    int, double and complex arrays, and the storage of sections, up to
+    1 GB of array buffers.
+
+    make_c_datablock_pooled returns a new c_datablock using the given
+    pool, or NULL if pool is NULL; it is otherwise like
+    make_c_datablock, and must be released by destroy_c_datablock.
+    Clones of it use the same pool. A pool may be destroyed while blocks
+    made from it remain; its storage is freed once the last of them is
+    destroyed. Pools may be shared between threads.
+
+    c_datablock_pool_counts sets *allocations to the number of requests
+    for array or section storage that allocated memory, *reuses to the
+    number that were met from the pool, and *bytes_held to the size of
+    the array buffers held by the pool.
+  */
+  typedef void c_datablock_pool;
+
+  c_datablock_pool*
+  make_c_datablock_pool(void);
+
+  DATABLOCK_STATUS
+  destroy_c_datablock_pool(c_datablock_pool* pool);
+
+  c_datablock*
+  make_c_datablock_pooled(c_datablock_pool* pool);
+
+  DATABLOCK_STATUS
+  c_datablock_pool_counts(c_datablock_pool const* pool,
+                          long* allocations,
+                          long* reuses,
+                          long* bytes_held);
+
+  /*
+    c_datablock_serialize writes the whole contents of the datablock, in
+    a compact binary format that is the same on all hosts, to buffer,
+    which must have room for at least the number of bytes given by
+    c_datablock_serialized_size; it returns DBS_SIZE_INSUFFICIENT if size
+    is too small. c_datablock_deserialize replaces the contents of the
+    datablock with those read from the size bytes at data; handles
+    remain valid. It returns DBS_BAD_FORMAT, leaving the datablock
+    unchanged, if the bytes were not written by c_datablock_serialize.
+    Metadata is included; the access log is not.
+  */
+  DATABLOCK_STATUS
+  c_datablock_serialized_size(c_datablock const* s, size_t* size);
+
+  DATABLOCK_STATUS
+  c_datablock_serialize(c_datablock const* s, void* buffer, size_t size);
+
+  DATABLOCK_STATUS
+  c_datablock_deserialize(c_datablock* s, void const* data, size_t size);
+
+  /*
+    c_datablock_save_snapshot writes the whole contents of the datablock
+    to the named file, replacing it, in a format laid out to be
+    memory-mapped: an index followed by the raw elements of each array,
+    page-aligned. It returns DBS_IO_FAILURE if the file cannot be
+    written.
+  */
+  DATABLOCK_STATUS
+  c_datablock_save_snapshot(c_datablock const* s, const char* filename);
+
+  /*
+    c_datablock_hash sets hash[0] and hash[1] to the low and high 64 bits
+    of a hash of the nsections named sections of the datablock, or of all
+    of it if nsections is 0. c_datablock_hash_values does the same for
+    the n values whose i'th has section sections[i] and name names[i];
+    if one is missing it returns its status, and sets *failed (if
+    failed is not NULL) to its index. The hash covers values of all
+    types, and is the same for equal values on any host.
+  */
+  DATABLOCK_STATUS
+  c_datablock_hash(c_datablock const* s, int nsections,
+                   const char* const* sections, uint64_t* hash);
+
+  DATABLOCK_STATUS
+  c_datablock_hash_values(c_datablock const* s, int n,
+                          const char* const* sections, const char* const* names,
+                          uint64_t* hash, int* failed);
+
+  /*
+    c_datablock_mark returns a mark of the current generation of values
+    (0 if s is NULL). c_datablock_changed_since sets *n to the number of
+    values in the datablock that have been put, replaced or copied since
+    the given mark was taken, and sections[i] and names[i] to the
+    section and name of the i'th of them, for i < maxn. The strings are
+    owned by the library and remain valid for the life of the program.
+    It returns DBS_SIZE_INSUFFICIENT if there are more than maxn such
+    values. Deleted values are not reported.
+  */
+  uint64_t
+  c_datablock_mark(c_datablock const* s);
+
+  DATABLOCK_STATUS
+  c_datablock_changed_since(c_datablock const* s, uint64_t mark, int maxn,
+                            const char** sections, const char** names, int* n);
+
+  /*
+    Set counts[0] to counts[3] to the number of successful reads of
+    values from the datablock, the bytes of data they read, the number
+    of successful writes (puts and replaces) and the bytes they wrote,
+    since it was made or reset. They are counted whatever the log mode.
+  */
+  DATABLOCK_STATUS
+  c_datablock_get_access_counts(c_datablock const* s, uint64_t* counts);
+
   /*
     Return true (1) if the datablock has a section with the given name, and
     false (0) otherwise. If either 's' or 'name' is null, return false.
@@ -153,8 +281,8 @@ extern "C" {
   /*
     Return the name of the i'th section of the datablock. Note that if a
     new section is added, the ordinal position of some or all of the
-    named sections may change; this is because the sections are stored
-    in sorted order for speed of lookup. The caller is not intended to
+    named sections may change; this is because the sections are
+    enumerated in sorted order of their names. The caller is not intended to
     free the returned pointer; the datablock retains ownership of the
     memory buffer containing the string. A NULL pointer is returned if i
     is negative or out-of-range. Numbering of sections starts with 0.
@@ -186,6 +314,49 @@ extern "C" {
 			 const char* section,
 			 const char* name);
 
+  /*
+    Set the amount of logging done of accesses to the datablock; see
+    datablock_log_mode_t in datablock_logging.h. The log is kept in full
+    (DBL_FULL) by default. Changing the mode does not discard entries
+    already in the log. Return DBS_WRONG_VALUE_TYPE if the mode is not
+    one of the enumerators.
+  */
+  DATABLOCK_STATUS
+  c_datablock_set_log_mode(c_datablock* s, datablock_log_mode_t mode);
+
+  /*
+    Return the current log mode of the datablock, or -1 if s is NULL.
+  */
+  int
+  c_datablock_get_log_mode(c_datablock const* s);
+
+  /*
+    Set the maximum number of entries held in the access log of the
+    datablock. When the log is full, each new entry replaces the oldest
+    one. Return DBS_SIZE_NONPOSITIVE if capacity is not positive.
+  */
+  DATABLOCK_STATUS
+  c_datablock_set_log_capacity(c_datablock* s, int capacity);
+
+  /*
+    Turn concurrent mode on (if on is true) or off. In concurrent mode
+    the datablock may be used by several threads at once, for example
+    by the OpenMP threads of a module; operations on different sections
+    do not wait for each other. Each thread keeps its own log, which is
+    collected into the access log when the log is read, or when
+    concurrent mode is turned off. This function, and those that read
+    the log, must not be called while other threads use the datablock.
+  */
+  DATABLOCK_STATUS
+  c_datablock_set_concurrent(c_datablock* s, bool on);
+
+  /*
+    Return true (1) if the datablock is in concurrent mode, and false
+    (0) otherwise, or if s is NULL.
+  */
+  bool
+  c_datablock_is_concurrent(c_datablock const* s);
+
   /*
     Write an enumerator value into 't', corresponding to the type of
     the value stored in the given section, for the given name. Return
@@ -315,6 +486,97 @@ extern "C" {
   DATABLOCK_STATUS
   c_datablock_replace_string(c_datablock* s, const char* section, const char* name, const char* val);
 
+  /*
+    c_datablock_resolve writes into 'handle' a handle for the value
+    with the given name in the given section, for use with the
+    c_datablock_TYPE_h functions below. The value need not exist yet.
+    Resolving the same section and name again yields the same handle.
+
+    Handles let a module that reads or writes the same values on every
+    execution do the name lookups once, typically in its setup
+    function. A handle remains usable for the lifetime of the datablock
+    for which it was resolved, and for any clone of that datablock;
+    deleting a section or clearing the datablock does not invalidate
+    it, and the next use of the handle will find a value stored under
+    the same section and name again.
+
+    Return DBS_SUCCESS on success, and an error status otherwise.
+  */
+  DATABLOCK_STATUS
+  c_datablock_resolve(c_datablock* s, const char* section, const char* name, int* handle);
+
+  /*
+    The c_datablock_get_TYPE_h, c_datablock_put_TYPE_h and
+    c_datablock_replace_TYPE_h functions behave like the corresponding
+    functions taking a section and name, for the value identified by a
+    handle obtained from c_datablock_resolve. They return
+    DBS_HANDLE_INVALID if the handle was not obtained from
+    c_datablock_resolve for this datablock (or the datablock from which
+    it was cloned).
+  */
+  DATABLOCK_STATUS
+  c_datablock_get_int_h(c_datablock* s, int handle, int* val);
+
+  DATABLOCK_STATUS
+  c_datablock_get_bool_h(c_datablock* s, int handle, bool* val);
+
+  DATABLOCK_STATUS
+  c_datablock_get_double_h(c_datablock* s, int handle, double* val);
+
+  DATABLOCK_STATUS
+  c_datablock_put_int_h(c_datablock* s, int handle, int val);
+
+  DATABLOCK_STATUS
+  c_datablock_put_bool_h(c_datablock* s, int handle, bool val);
+
+  DATABLOCK_STATUS
+  c_datablock_put_double_h(c_datablock* s, int handle, double val);
+
+  DATABLOCK_STATUS
+  c_datablock_replace_int_h(c_datablock* s, int handle, int val);
+
+  DATABLOCK_STATUS
+  c_datablock_replace_bool_h(c_datablock* s, int handle, bool val);
+
+  DATABLOCK_STATUS
+  c_datablock_replace_double_h(c_datablock* s, int handle, double val);
+
+  /*
+    The c_datablock_get_double_many, c_datablock_put_double_many and
+    c_datablock_replace_double_many functions get, put or replace n
+    double values in one call: the i'th has section sections[i] and name
+    names[i], and is read into or taken from vals[i]. They are meant for
+    callers for which each call is costly, such as the Python interface,
+    which uses them to set the parameters of each sample and to read
+    back the likelihoods. They stop at the first value that cannot be
+    got, put or replaced, returning its status and setting *failed to
+    its index; the values before it have been processed. On success they
+    set *failed to -1. 'failed' may be NULL.
+  */
+  DATABLOCK_STATUS
+  c_datablock_get_double_many(c_datablock* s, int n,
+                              const char* const* sections, const char* const* names,
+                              double* vals, int* failed);
+
+  DATABLOCK_STATUS
+  c_datablock_put_double_many(c_datablock* s, int n,
+                              const char* const* sections, const char* const* names,
+                              double const* vals, int* failed);
+
+  DATABLOCK_STATUS
+  c_datablock_replace_double_many(c_datablock* s, int n,
+                                  const char* const* sections, const char* const* names,
+                                  double const* vals, int* failed);
+
+  /*
+    Copy into 'section' and 'name' (each a buffer of at least 'smax'
+    characters) the section and name from which the handle was
+    resolved, as strncpy does. Return DBS_HANDLE_INVALID if there is no
+    such handle.
+  */
+  DATABLOCK_STATUS
+  c_datablock_get_handle_key(c_datablock const* s, int handle, int smax, char* section, char* name);
+
   /*
     The c_datablock_get_TYPE_array_1d functions returns DBS_SUCCESS on
     success, and and error status
@@ -438,7 +700,9 @@ extern "C" {
     can be used as a pointer-to-TYPE, one can pass the name of an
     array as 'val'.
 
-    The values in the array are copied into the c_datablock.
+    The values in the array are copied into the c_datablock. If the
+    existing array has the same type and length, its storage is reused,
+    so that no memory is allocated.
   */
   DATABLOCK_STATUS
   c_datablock_replace_int_array_1d(c_datablock* s,
@@ -631,7 +895,8 @@ extern "C" {
 
     The arguments are the same pattern as for c_datablock_put_TYPE_array
     functions, see above for an explanation of the arguments. (The same memory
-    management policy applies).
+    management policy applies). If the existing array has the same type and
+    extents, its storage is reused, so that no memory is allocated.
   */
   DATABLOCK_STATUS
   c_datablock_replace_int_array(c_datablock* s,
@@ -649,6 +914,90 @@ extern "C" {
                                int ndims,
                                int const* extents);
 
+  /*
+    Views give read-only access to the values of an array in a
+    c_datablock, without copying them.
+
+    c_datablock_view_array returns DBS_SUCCESS if the given section has
+    an int, double or complex array (of any number of dimensions) with
+    the given name, and an error status otherwise. On success it sets:
+
+      *view     to a new c_datablock_view, which must be released by a
+                matching call to destroy_c_datablock_view;
+      *type     to the type of the array (DBT_INT1D, DBT_DOUBLE1D,
+                DBT_COMPLEX1D, DBT_INTND, DBT_DOUBLEND or DBT_COMPLEXND);
+      *data     to the first element of the array, which is stored
+                contiguously in row-major order (and may be NULL if the
+                array is empty);
+      *ndims    to the number of dimensions, which is 1 for the 1d types;
+      *extents  to an array of *ndims extents, owned by the view.
+
+    The data and extents remain valid, and unchanged, until the view is
+    destroyed: if the array is later replaced, or the c_datablock is
+    destroyed, the values seen through the view are not affected.
+    Because of this, replacing the viewed array while the view exists
+    makes the c_datablock copy its section; putting or replacing other
+    values does not.
+  */
+  typedef void c_datablock_view;
+
+  DATABLOCK_STATUS
+  c_datablock_view_array(c_datablock* s,
+                         const char* section,
+                         const char* name,
+                         c_datablock_view** view,
+                         datablock_type_t* type,
+                         void const** data,
+                         int* ndims,
+                         int const** extents);
+
+  DATABLOCK_STATUS
+  destroy_c_datablock_view(c_datablock_view* view);
+
+  /*
+    A c_datablock_array is an int or double array made outside of any
+    c_datablock, which can then be moved into a c_datablock without
+    copying its values.
+
+    make_c_datablock_array returns a new array of the given type
+    (DBT_INT1D, DBT_DOUBLE1D, DBT_INTND or DBT_DOUBLEND) and extents,
+    with every element zero, and sets *data to its first element, so
+    that the caller can fill it in; for the 1d types ndims must be 1.
+    It returns NULL if the arguments are invalid. The array must be
+    released by a matching call to destroy_c_datablock_array.
+
+    c_datablock_put_array_move and c_datablock_replace_array_move follow
+    the rules of c_datablock_put_TYPE_array and
+    c_datablock_replace_TYPE_array, but on success take over the
+    storage of the given array rather than copying it. The contents of
+    the array are then unspecified, but it must still be destroyed; the
+    data pointer obtained from make_c_datablock_array must not be used
+    afterwards (use c_datablock_view_array to read the values back). On
+    failure the array is unchanged.
+  */
+  typedef void c_datablock_array;
+
+  c_datablock_array*
+  make_c_datablock_array(datablock_type_t type,
+                         int ndims,
+                         int const* extents,
+                         void** data);
+
+  DATABLOCK_STATUS
+  destroy_c_datablock_array(c_datablock_array* array);
+
+  DATABLOCK_STATUS
+  c_datablock_put_array_move(c_datablock* s,
+                             const char* section,
+                             const char* name,
+                             c_datablock_array* array);
+
+  DATABLOCK_STATUS
+  c_datablock_replace_array_move(c_datablock* s,
+                                 const char* section,
+                                 const char* name,
+                                 c_datablock_array* array);
+
   /*
     TODO: document these functions.
   */
@@ -0,0 +1,212 @@
+#include "concurrency.hh"
+
+using cosmosis::concurrency::block_lock;
+using cosmosis::concurrency::handles_lock;
+using cosmosis::concurrency::holder;
+using cosmosis::concurrency::section_lock;
+using cosmosis::concurrency::state;
+using cosmosis::concurrency::thread_log;
+
+namespace
+{
+  std::atomic<std::uint64_t> last_state_id(0);
+
+  // The state a thread used last, and its log in that state, so that
+  // a thread working on one block finds its log without a lock.
+  struct local_cache
+  {
+    std::uint64_t id;
+    thread_log* log;
+  };
+
+  thread_local local_cache cache = {0, nullptr};
+
+  std::uint64_t take(std::atomic<std::uint64_t>& x)
+  {
+    return x.exchange(0, std::memory_order_relaxed);
+  }
+}
+
+thread_log::thread_log(std::thread::id id, std::size_t capacity) :
+  thread(id), log(capacity), reads(0), read_bytes(0), writes(0), write_bytes(0)
+{}
+
+thread_log::thread_log(thread_log const& other) :
+  thread(other.thread),
+  log(other.log),
+  reads(other.reads.load(std::memory_order_relaxed)),
+  read_bytes(other.read_bytes.load(std::memory_order_relaxed)),
+  writes(other.writes.load(std::memory_order_relaxed)),
+  write_bytes(other.write_bytes.load(std::memory_order_relaxed))
+{}
+
+void
+thread_log::count_read(std::size_t bytes)
+{
+  reads.fetch_add(1, std::memory_order_relaxed);
+  read_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void
+thread_log::count_write(std::size_t bytes)
+{
+  writes.fetch_add(1, std::memory_order_relaxed);
+  write_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void
+thread_log::take_counts(cosmosis::access_counts& c)
+{
+  c.reads += take(reads);
+  c.read_bytes += take(read_bytes);
+  c.writes += take(writes);
+  c.write_bytes += take(write_bytes);
+}
+
+state::state(std::size_t log_capacity) :
+  id_(++last_state_id), log_capacity_(log_capacity)
+{}
+
+state::state(state const& other) :
+  id_(++last_state_id), log_capacity_(other.log_capacity_)
+{
+  std::lock_guard<std::mutex> lock(other.threads_mutex_);
+  for (auto const& t : other.threads_)
+    threads_.emplace_back(new thread_log(*t));
+}
+
+thread_log&
+state::local()
+{
+  if (cache.id != id_) {
+    cache.log = &find_local();
+    cache.id = id_;
+  }
+  return *cache.log;
+}
+
+thread_log&
+state::find_local()
+{
+  std::thread::id const me = std::this_thread::get_id();
+  std::lock_guard<std::mutex> lock(threads_mutex_);
+  for (auto& t : threads_)
+    if (t->thread == me) return *t;
+  threads_.emplace_back(new thread_log(me, log_capacity_));
+  return *threads_.back();
+}
+
+void
+state::collect(access_log& log, access_counts& c)
+{
+  std::lock_guard<std::mutex> lock(threads_mutex_);
+  for (auto& t : threads_) {
+    for (std::size_t i = 0; i != t->log.size(); ++i) log.push(t->log[i]);
+    t->log.clear();
+    t->take_counts(c);
+  }
+}
+
+void
+state::add_counts(access_counts& c) const
+{
+  std::lock_guard<std::mutex> lock(threads_mutex_);
+  for (auto const& t : threads_) {
+    c.reads += t->reads.load(std::memory_order_relaxed);
+    c.read_bytes += t->read_bytes.load(std::memory_order_relaxed);
+    c.writes += t->writes.load(std::memory_order_relaxed);
+    c.write_bytes += t->write_bytes.load(std::memory_order_relaxed);
+  }
+}
+
+void
+state::set_log_capacity(std::size_t capacity)
+{
+  std::lock_guard<std::mutex> lock(threads_mutex_);
+  log_capacity_ = capacity;
+  for (auto& t : threads_) t->log.set_capacity(capacity);
+}
+
+void
+state::clear()
+{
+  std::lock_guard<std::mutex> lock(threads_mutex_);
+  access_counts discarded;
+  for (auto& t : threads_) {
+    t->log.clear();
+    t->take_counts(discarded);
+  }
+}
+
+holder::holder(holder const& other) :
+  state_(other.state_ ? new state(*other.state_) : nullptr)
+{}
+
+holder&
+holder::operator=(holder const& other)
+{
+  if (this != &other)
+    state_.reset(other.state_ ? new state(*other.state_) : nullptr);
+  return *this;
+}
+
+section_lock::section_lock(state* s, name_id section, bool write) :
+  s_(s), stripe_(nullptr), write_(write), exclusive_(false)
+{
+  if (s_ == nullptr) return;
+  s_->sections.lock_shared();
+  stripe_ = &s_->stripe(section);
+  if (write_) stripe_->lock();
+  else stripe_->lock_shared();
+}
+
+section_lock::~section_lock()
+{
+  if (s_ == nullptr) return;
+  if (exclusive_) {
+    s_->sections.unlock();
+    return;
+  }
+  if (write_) stripe_->unlock();
+  else stripe_->unlock_shared();
+  s_->sections.unlock_shared();
+}
+
+void
+section_lock::exclusive()
+{
+  if (s_ == nullptr || exclusive_) return;
+  if (write_) stripe_->unlock();
+  else stripe_->unlock_shared();
+  s_->sections.unlock_shared();
+  s_->sections.lock();
+  exclusive_ = true;
+}
+
+block_lock::block_lock(state* s, bool write) : s_(s), write_(write)
+{
+  if (s_ == nullptr) return;
+  if (write_) s_->sections.lock();
+  else s_->sections.lock_shared();
+}
+
+block_lock::~block_lock()
+{
+  if (s_ == nullptr) return;
+  if (write_) s_->sections.unlock();
+  else s_->sections.unlock_shared();
+}
+
+handles_lock::handles_lock(state* s, bool write) : s_(s), write_(write)
+{
+  if (s_ == nullptr) return;
+  if (write_) s_->handles.lock();
+  else s_->handles.lock_shared();
+}
+
+handles_lock::~handles_lock()
+{
+  if (s_ == nullptr) return;
+  if (write_) s_->handles.unlock();
+  else s_->handles.unlock_shared();
+}
@@ -0,0 +1,181 @@
+#ifndef COSMOSIS_CONCURRENCY_HH
+#define COSMOSIS_CONCURRENCY_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "datablock_logging.h"
+#include "name_table.hh"
+
+// The synchronization used by a DataBlock in concurrent mode (see
+// DataBlock::set_concurrent). It is not part of the interface of the
+// library.
+//
+// Every operation on the values of one section holds the lock on the
+// sections shared, and the lock of the section's stripe shared (to
+// read) or exclusive (to write); sections are spread over the stripes
+// by the hash of their names. Readers never contend with each other,
+// and writers contend only with the users of sections in the same
+// stripe. Operations that add or remove sections, or that use the
+// whole block, hold the lock on the sections exclusive instead, which
+// excludes everything else. The handles have a lock of their own.
+//
+// Each thread that uses the block records its accesses in a log and
+// counts of its own, so that recording them takes no lock; the block
+// collects them into its own log and counts when they are asked for.
+
+namespace cosmosis
+{
+  namespace concurrency
+  {
+    // The log and the access counts of one thread. Only that thread
+    // writes them; the counts may be read at any time.
+    struct thread_log
+    {
+      thread_log(std::thread::id id, std::size_t capacity);
+      thread_log(thread_log const& other);
+      thread_log& operator=(thread_log const&) = delete;
+
+      void count_read(std::size_t bytes);
+      void count_write(std::size_t bytes);
+
+      // Add the counts to c, and zero them.
+      void take_counts(access_counts& c);
+
+      std::thread::id thread;
+      access_log log;
+      std::atomic<std::uint64_t> reads;
+      std::atomic<std::uint64_t> read_bytes;
+      std::atomic<std::uint64_t> writes;
+      std::atomic<std::uint64_t> write_bytes;
+    };
+
+    class state
+    {
+    public:
+      explicit state(std::size_t log_capacity);
+
+      // A copy has its own locks, and copies of the logs and counts of
+      // the threads.
+      state(state const& other);
+      state& operator=(state const&) = delete;
+
+      std::shared_timed_mutex sections;
+      std::shared_timed_mutex handles;
+
+      std::shared_timed_mutex& stripe(name_id section)
+      {
+        return stripes_[hash_key(section) % nstripes];
+      }
+
+      // Return the log of the calling thread, making it on first use.
+      thread_log& local();
+
+      // Append the entries of the log of each thread in turn to log,
+      // and add their counts to c; then empty the logs and zero the
+      // counts. No other thread may be using the block.
+      void collect(access_log& log, access_counts& c);
+
+      // Add the counts of all the threads to c.
+      void add_counts(access_counts& c) const;
+
+      void set_log_capacity(std::size_t capacity);
+
+      // Empty the logs and zero the counts of all the threads.
+      void clear();
+
+    private:
+      static std::size_t const nstripes = 64;
+
+      thread_log& find_local();
+
+      std::shared_timed_mutex stripes_[nstripes];
+      // Identifies this state to the per-thread cache of local();
+      // unlike the address, it is never reused.
+      std::uint64_t const id_;
+      std::size_t log_capacity_;
+      mutable std::mutex threads_mutex_;
+      std::vector<std::unique_ptr<thread_log>> threads_;
+    };
+
+    // holder owns the state of a DataBlock that is in concurrent mode,
+    // and none otherwise. Copying a holder copies the state.
+    class holder
+    {
+    public:
+      holder() = default;
+      holder(holder const& other);
+      holder(holder&&) = default;
+      holder& operator=(holder const& other);
+      holder& operator=(holder&&) = default;
+
+      state* get() const { return state_.get(); }
+      void reset(state* s = nullptr) { state_.reset(s); }
+
+    private:
+      std::unique_ptr<state> state_;
+    };
+
+    // The lock for an operation on the values of one section; it does
+    // nothing if s is null.
+    class section_lock
+    {
+    public:
+      section_lock(state* s, name_id section, bool write);
+      ~section_lock();
+      section_lock(section_lock const&) = delete;
+      section_lock& operator=(section_lock const&) = delete;
+
+      // Exchange the locks held for the lock on the sections held
+      // exclusive, so that a section may be added. Another thread may
+      // change the block in between.
+      void exclusive();
+
+    private:
+      state* s_;
+      std::shared_timed_mutex* stripe_;
+      bool write_;
+      bool exclusive_;
+    };
+
+    // The lock on the sections, held exclusive for an operation on the
+    // whole block or one that adds or removes sections, or shared for
+    // one that only looks at the list of sections; it does nothing if s
+    // is null.
+    class block_lock
+    {
+    public:
+      explicit block_lock(state* s, bool write = true);
+      ~block_lock();
+      block_lock(block_lock const&) = delete;
+      block_lock& operator=(block_lock const&) = delete;
+
+    private:
+      state* s_;
+      bool write_;
+    };
+
+    // The lock on the handles, held shared to use them or exclusive to
+    // add or change them; it does nothing if s is null.
+    class handles_lock
+    {
+    public:
+      handles_lock(state* s, bool write);
+      ~handles_lock();
+      handles_lock(handles_lock const&) = delete;
+      handles_lock& operator=(handles_lock const&) = delete;
+
+    private:
+      state* s_;
+      bool write_;
+    };
+  }
+}
+
+#endif
@@ -16,11 +16,172 @@ import io
 from io import StringIO, BytesIO
 import sys
 
+# The compiled extension module, which gets and sets values directly
+# through the C++ library, if it was built (see datablock/python_block.cc).
+# Each of its functions returns NotImplemented for the values it leaves
+# to the ctypes code below.
+try:
+	from . import _block as _ext
+except ImportError:
+	_ext = None
+else:
+	_ext.set_error_factory(BlockError.exception_for_status)
 
 
 option_section = "module_options"
 metadata_prefix = "cosmosis_metadata:"
 
+# Access log modes; these match datablock_log_mode_t in datablock_logging.h
+LOG_MODES = ["off", "failures", "full"]
+
+# NumPy element types of the array types that can be viewed without copying
+VIEW_DTYPES = {
+	types.DBT_INT1D: np.intc,
+	types.DBT_DOUBLE1D: np.double,
+	types.DBT_COMPLEX1D: np.complex128,
+	types.DBT_INTND: np.intc,
+	types.DBT_DOUBLEND: np.double,
+	types.DBT_COMPELXND: np.complex128,
+}
+
+
+class BlockPool(object):
+	u"""Storage recycled from destroyed or cleared :class:`DataBlock` objects.
+
+	Blocks made with ``DataBlock(pool=pool)`` take the storage for their
+	sections and arrays from the pool where they can, and give it back
+	when they are destroyed or cleared, so that a pipeline building a
+	similar block for every sample stops allocating after the first. A
+	pool may be shared by any number of blocks, and outlives them if
+	needed.
+
+	The pool also keeps up to `max_spare_blocks` of the blocks
+	themselves: when a block made from the pool is garbage collected its
+	C object is reset (see :func:`DataBlock.reset`) and kept, and the
+	next block made from the pool reuses it.
+
+	"""
+	max_spare_blocks = 4
+
+	def __init__(self):
+		self._ptr = lib.make_c_datablock_pool()
+		self._spares = []
+
+	def __del__(self):
+		try:
+			for ptr in self._spares:
+				lib.destroy_c_datablock(ptr)
+			self._spares = []
+			lib.destroy_c_datablock_pool(self._ptr)
+		except:
+			pass
+
+	def _take_block(self):
+		if self._spares:
+			return self._spares.pop()
+		return lib.make_c_datablock_pooled(self._ptr)
+
+	def _give_block(self, ptr):
+		if len(self._spares) < self.max_spare_blocks:
+			lib.c_datablock_reset(ptr)
+			self._spares.append(ptr)
+		else:
+			lib.destroy_c_datablock(ptr)
+
+	def counts(self):
+		u"""Return a dict of the pool's ``allocations`` (requests for storage that had to allocate), ``reuses`` (requests met from the pool) and ``bytes_held``."""
+		allocations = ct.c_long()
+		reuses = ct.c_long()
+		bytes_held = ct.c_long()
+		status = lib.c_datablock_pool_counts(self._ptr, allocations, reuses, bytes_held)
+		if status != 0:
+			raise BlockError.exception_for_status(status, "", "")
+		return {"allocations": allocations.value, "reuses": reuses.value,
+				"bytes_held": bytes_held.value}
+
+
+class _ArrayOwner(object):
+	u"""Owns the C storage behind a NumPy array made by :func:`DataBlock.view` or :func:`DataBlock.new_array`.
+
+	The array keeps a reference to this object (through its base), so the
+	storage is released only once the array, and anything made from it,
+	has been garbage collected.
+
+	"""
+	def __init__(self, view=None, array=None, data=None, shape=None):
+		self.view = view
+		self.array = array
+		self.data = data
+		self.shape = shape
+
+	def __del__(self):
+		try:
+			if self.view is not None:
+				lib.destroy_c_datablock_view(self.view)
+			if self.array is not None:
+				lib.destroy_c_datablock_array(self.array)
+		except:
+			pass
+
+
+def _wrap_c_array(owner, data, shape, dtype):
+	nbytes = int(np.prod(shape)) * np.dtype(dtype).itemsize
+	if nbytes == 0 or not data:
+		return np.zeros(shape, dtype=dtype)
+	buf = (ct.c_char * nbytes).from_address(data)
+	buf._cosmosis_owner = owner
+	return np.frombuffer(buf, dtype=dtype).reshape(shape)
+
+
+def _c_array_owner(value):
+	# Find the _ArrayOwner behind an array made by new_array, if any.
+	base = value
+	while base is not None:
+		owner = getattr(base, "_cosmosis_owner", None)
+		if owner is not None:
+			return owner
+		base = getattr(base, "base", None)
+	return None
+
+class ScalarKeys(object):
+	u"""A fixed list of (section, name) pairs for :meth:`DataBlock.get_many`,
+	:meth:`DataBlock.put_many`, :meth:`DataBlock.replace_many` and
+	:meth:`DataBlock.hash_values`.
+
+	The names are encoded for the C library once, when the ScalarKeys is
+	made, rather than on every call. A plain list of pairs may be passed
+	to those methods instead; the encoded form of recently used lists is
+	cached.
+
+	"""
+	def __init__(self, keys):
+		self.keys = [(section, name) for (section, name) in keys]
+		n = len(self.keys)
+		self._sections = (ct.c_char_p * n)(*[section.encode('ascii') for section, _ in self.keys])
+		self._names = (ct.c_char_p * n)(*[name.encode('ascii') for _, name in self.keys])
+
+	def __len__(self):
+		return len(self.keys)
+
+	def __iter__(self):
+		return iter(self.keys)
+
+
+_scalar_keys_cache = {}
+_scalar_keys_cache_size = 64
+
+def _scalar_keys(keys):
+	if isinstance(keys, ScalarKeys):
+		return keys
+	keys = tuple(tuple(k) for k in keys)
+	result = _scalar_keys_cache.get(keys)
+	if result is None:
+		if len(_scalar_keys_cache) >= _scalar_keys_cache_size:
+			_scalar_keys_cache.clear()
+		result = _scalar_keys_cache[keys] = ScalarKeys(keys)
+	return result
+
+
 class DataBlock(object):
 	u"""A map of (section,name)->value of parameters.
 
@@ -51,7 +212,7 @@ class DataBlock(object):
 	GET=0
 	PUT=1
 	REPLACE=2
-	def __init__(self, ptr=None, own=None):
+	def __init__(self, ptr=None, own=None, pool=None):
 		u"""Construct an empty parameter map, or possibly shadow an existing one.
 
 		In implementation, this Python object is actually a wrapper around
@@ -65,6 +226,9 @@ class DataBlock(object):
 		it will be left to the application to ensure proper destruction at
 		the end of its lifetime.
 
+		If a :class:`BlockPool` is given as `pool` (and `ptr` is not),
+		the new block reuses storage from the pool (see there).
+
 		"""
 
 		# Doc: Need to find out the use-case for this latter option,
@@ -72,11 +236,18 @@ class DataBlock(object):
 		#      should be removed!
 
 		self.owns=own
+		self._pool = None
 		if ptr is None:
-			ptr = lib.make_c_datablock()
+			if pool is None:
+				ptr = lib.make_c_datablock()
+			else:
+				ptr = pool._take_block()
+				self._pool = pool
 			self.owns=True
 		if own is not None:
 			self.owns=own
+		if not self.owns:
+			self._pool = None
 		self._ptr = ptr
 		self._as_parameter_ = ptr
 	#TODO: add destructor.  destroy block if owned
@@ -89,18 +260,37 @@ class DataBlock(object):
 		"""
 		try:
 			if self.owns:
-				lib.destroy_c_datablock(self._ptr)
+				if self._pool is not None:
+					self._pool._give_block(self._ptr)
+				else:
+					lib.destroy_c_datablock(self._ptr)
 		except:
 			pass
 
 				
+	def reset(self):
+		u"""Empty the block, as if it were newly made, keeping its memory for reuse.
+
+		All sections are removed and the access log is emptied, but the
+		memory used for the sections and their arrays is kept, so that
+		putting values of the same shapes again (as for the next sample
+		of a pipeline) does not allocate. Handles and the log mode are
+		kept.
+
+		"""
+		status = lib.c_datablock_reset(self._ptr)
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+
 	def clone(self):
-		u"""Make a brand-new, completely independent object, a deep copy of the existing one.
+		u"""Make a brand-new, completely independent object, a copy of the existing one.
 
 		A new object will be returned from this method which has its own
-		underlying implementation, a deep copy of the parameter map we
-		are holding.  This WILL entail the attempted requisition of
-		enough new memory to hold the complete parameter structure.
+		underlying implementation. The sections of the copy share their
+		values with the original until either block modifies them; a
+		section is duplicated only when it is first changed, so cloning
+		is cheap even for blocks holding large arrays. Changes to either
+		block are never visible in the other.
 
 		"""
 		ptr = lib.clone_c_datablock(self._ptr)
@@ -137,9 +327,11 @@ class DataBlock(object):
 		The object will be a contiguous list—this may entail that a value
 		array with strides be copied to a compressed version—of C type
 		most appropriate to the representation of the Python `numpy_type`.
+		A contiguous array already of that type is used as it is, without
+		copying.
 
 		"""
-		value = np.array(value, dtype=numpy_type)
+		value = np.asarray(value, dtype=numpy_type)
 		#This function is for 1D arrays only
 		assert value.ndim==1
 		#check strides same as itemsize.
@@ -152,7 +344,8 @@ class DataBlock(object):
 			value = value.copy()
 		assert value.itemsize==value.strides[0]
 		#Now return pointer to start of the data
-		array = np.ctypeslib.as_ctypes(value)
+		# (This also works for read-only arrays, such as views.)
+		array = value.ctypes.data_as(ct.POINTER(np.ctypeslib.as_ctypes_type(value.dtype)))
 		array_size = value.size
 		#OK, here's the difficult part.
 		# We have to return the value, as well as the
@@ -383,7 +576,7 @@ class DataBlock(object):
 		ndim = len(shape)
 		extent = (ct.c_int * ndim)()
 		for i in range(ndim): extent[i] = shape[i]
-		value = value.flatten()
+		value = np.ravel(value)
 		p, arr, arr_size = self.python_to_1d_c_array(value, dtype)
 		put_function={
 			(np.intc, self.PUT):lib.c_datablock_put_int_array,
@@ -466,6 +659,110 @@ class DataBlock(object):
 		"""
 		return self._get_array_nd(section, name, int)
 
+	def view(self, section, name):
+		u"""Get a read-only NumPy array sharing memory with an array in the block.
+
+		Unlike :func:`get`, no copy of the values is made, so this is the
+		cheap way to read large arrays of int, float or complex values of
+		any shape. A :class:`BlockError` is raised if there is no such
+		value, or if it is not one of those types.
+
+		The view always shows the values the array had when the view was
+		made: if the value is later replaced, or the block deleted, the
+		view is unaffected. While the view exists, replacing the value
+		makes the block copy its section (putting or replacing other
+		values does not), so views should not be kept longer than needed.
+
+		"""
+		view, data, shape, dtype = self._view_array(section, name)
+		r = _wrap_c_array(_ArrayOwner(view=view), data, shape, dtype)
+		r.flags.writeable = False
+		return r
+
+	def _view_array(self, section, name):
+		view = ct.c_void_p()
+		dtype = lib.c_enum()
+		data = ct.c_void_p()
+		ndim = lib.c_int()
+		extents = lib.c_int_p()
+		status = lib.c_datablock_view_array(self._ptr, section.encode('ascii'), name.encode('ascii'),
+			ct.byref(view), ct.byref(dtype), ct.byref(data), ct.byref(ndim), ct.byref(extents))
+		if status!=0:
+			raise BlockError.exception_for_status(status, section, name)
+		shape = tuple(extents[i] for i in range(ndim.value))
+		return view.value, data.value, shape, VIEW_DTYPES[dtype.value]
+
+	@staticmethod
+	def new_array(shape, dtype=float):
+		u"""Make a zero-filled array that can be moved into a block without copying.
+
+		The result is an ordinary writeable NumPy array, of int or float
+		type, whose memory is allocated by the C++ library. Once it has
+		been filled in it can be stored with :func:`put_move` or
+		:func:`replace_move`, which take over the memory instead of
+		copying it.
+
+		"""
+		shape = tuple(int(n) for n in np.atleast_1d(shape))
+		dtype = {int: np.intc, float: np.double}.get(dtype, dtype)
+		if dtype not in (np.intc, np.double):
+			raise ValueError("new_array supports only int and float arrays")
+		ndim = len(shape)
+		code = {
+			(np.intc, True): types.DBT_INT1D,
+			(np.double, True): types.DBT_DOUBLE1D,
+			(np.intc, False): types.DBT_INTND,
+			(np.double, False): types.DBT_DOUBLEND,
+		}[(dtype, ndim==1)]
+		extent = (ct.c_int * ndim)(*shape)
+		data = ct.c_void_p()
+		array = lib.make_c_datablock_array(code, ndim, extent, ct.byref(data))
+		if not array:
+			raise ValueError("Could not make an array of shape {}".format(shape))
+		owner = _ArrayOwner(array=array, data=data.value, shape=shape)
+		return _wrap_c_array(owner, data.value, shape, dtype)
+
+	def _move_array(self, section, name, value, mode):
+		owner = _c_array_owner(value)
+		if (owner is None or owner.array is None or owner.view is not None
+			or value.shape != owner.shape or value.ctypes.data != owner.data):
+			# Not (the whole of) an array from new_array, or one that
+			# has already been moved into a block: copy it.
+			if mode == self.PUT:
+				return self.put(section, name, value)
+			return self.replace(section, name, value)
+		move_function = {
+			self.PUT: lib.c_datablock_put_array_move,
+			self.REPLACE: lib.c_datablock_replace_array_move,
+		}[mode]
+		status = move_function(self._ptr, section.encode('ascii'), name.encode('ascii'), owner.array)
+		if status!=0:
+			raise BlockError.exception_for_status(status, section, name)
+		# The block now owns the memory; keep it alive for the array's
+		# sake with a view of the stored value.
+		owner.view, data, _, _ = self._view_array(section, name)
+		assert data == owner.data
+		value.flags.writeable = False
+
+	def put_move(self, section, name, value):
+		u"""Store an array made by :func:`new_array`, without copying it.
+
+		The block takes over the memory of `value`, which becomes
+		read-only; from then on it behaves like the result of
+		:func:`view`. Any other array is stored by copying, as with
+		:func:`put`.
+
+		"""
+		self._move_array(section, name, value, self.PUT)
+
+	def replace_move(self, section, name, value):
+		u"""Replace a value with an array made by :func:`new_array`, without copying it.
+
+		See :func:`put_move`.
+
+		"""
+		self._move_array(section, name, value, self.REPLACE)
+
 	#def get_complex_array_2d(self, section, name):
 	#	return self._get_array_2d(section, name, complex)
 
@@ -668,6 +965,10 @@ class DataBlock(object):
 		or :class:`ValueError` will be raised.
 
 		"""
+		if _ext is not None:
+			value = _ext.get(self._ptr, section, name)
+			if value is not NotImplemented:
+				return value
 		type_code_c = lib.c_datatype()
 		status = lib.c_datablock_get_type(self._ptr, section.encode('ascii'), name.encode('ascii'), ct.byref(type_code_c))
 		if status:
@@ -693,8 +994,9 @@ class DataBlock(object):
 		specialization will be raised.
 
 		"""
-		method = self._method_for_value(value,self.PUT)
-		method(section, name, value)
+		if _ext is None or _ext.put(self._ptr, section, name, value) is NotImplemented:
+			method = self._method_for_value(value,self.PUT)
+			method(section, name, value)
 		for (key, val) in list(meta.items()):
 			self.put_metadata(section, name, str(key), str(val))
 
@@ -709,6 +1011,8 @@ class DataBlock(object):
 		specialization will be raised.
 
 		"""
+		if _ext is not None and _ext.replace(self._ptr, section, name, value) is not NotImplemented:
+			return
 		method = self._method_for_value(value,self.REPLACE)
 		method(section, name, value)
 
@@ -780,6 +1084,223 @@ class DataBlock(object):
 		if status!=0:
 			raise BlockError.exception_for_status(status, section, name)
 
+	def resolve(self, section, name):
+		u"""Return a handle for the parameter at (`section`, `name`).
+
+		The handle can be passed to the `get_TYPE_h`, `put_TYPE_h` and
+		`replace_TYPE_h` methods in place of the section and name, which
+		saves looking the parameter up by name each time.  Modules that
+		access the same parameters on every execution can resolve their
+		handles once, in setup.  The parameter need not exist yet.
+
+		A handle remains valid for the lifetime of the block, and for
+		clones of it; deleting a section or clearing the block does not
+		invalidate it.
+
+		"""
+		handle = ct.c_int()
+		status = lib.c_datablock_resolve(self._ptr,section.encode('ascii'),name.encode('ascii'),handle)
+		if status!=0:
+			raise BlockError.exception_for_status(status, section, name)
+		return handle.value
+
+	def handle_key(self, handle):
+		u"""Return the (section, name) pair that `handle` was resolved from."""
+		smax = 128
+		section = ct.create_string_buffer(smax)
+		name = ct.create_string_buffer(smax)
+		status = lib.c_datablock_get_handle_key(self._ptr, handle, smax, section, name)
+		if status!=0:
+			raise BlockError.exception_for_status(status, "<handle {}>".format(handle), "")
+		return section.value.decode('utf-8'), name.value.decode('utf-8')
+
+	def _raise_for_handle(self, status, handle):
+		# An invalid handle has no key, so handle_key raises for us.
+		section, name = self.handle_key(handle)
+		raise BlockError.exception_for_status(status, section, name)
+
+	def get_int_h(self, handle):
+		u"""Retrieve an integer value using a handle from :meth:`resolve`."""
+		r = ct.c_int()
+		status = lib.c_datablock_get_int_h(self._ptr,handle,r)
+		if status!=0:
+			self._raise_for_handle(status, handle)
+		return r.value
+
+	def get_bool_h(self, handle):
+		u"""Retrieve a boolean value using a handle from :meth:`resolve`."""
+		r = ct.c_bool()
+		status = lib.c_datablock_get_bool_h(self._ptr,handle,r)
+		if status!=0:
+			self._raise_for_handle(status, handle)
+		return r.value
+
+	def get_double_h(self, handle):
+		u"""Retrieve a floating-point value using a handle from :meth:`resolve`."""
+		r = ct.c_double()
+		status = lib.c_datablock_get_double_h(self._ptr,handle,r)
+		if status!=0:
+			self._raise_for_handle(status, handle)
+		return r.value
+
+	def put_int_h(self, handle, value):
+		u"""Add an integer parameter using a handle from :meth:`resolve`."""
+		status = lib.c_datablock_put_int_h(self._ptr,handle,int(value))
+		if status!=0:
+			self._raise_for_handle(status, handle)
+
+	def put_bool_h(self, handle, value):
+		u"""Add a boolean parameter using a handle from :meth:`resolve`."""
+		status = lib.c_datablock_put_bool_h(self._ptr,handle,bool(value))
+		if status!=0:
+			self._raise_for_handle(status, handle)
+
+	def put_double_h(self, handle, value):
+		u"""Add a floating-point parameter using a handle from :meth:`resolve`."""
+		status = lib.c_datablock_put_double_h(self._ptr,handle,float(value))
+		if status!=0:
+			self._raise_for_handle(status, handle)
+
+	def replace_int_h(self, handle, value):
+		u"""Change an integer parameter using a handle from :meth:`resolve`."""
+		status = lib.c_datablock_replace_int_h(self._ptr,handle,int(value))
+		if status!=0:
+			self._raise_for_handle(status, handle)
+
+	def replace_bool_h(self, handle, value):
+		u"""Change a boolean parameter using a handle from :meth:`resolve`."""
+		status = lib.c_datablock_replace_bool_h(self._ptr,handle,bool(value))
+		if status!=0:
+			self._raise_for_handle(status, handle)
+
+	def replace_double_h(self, handle, value):
+		u"""Change a floating-point parameter using a handle from :meth:`resolve`."""
+		status = lib.c_datablock_replace_double_h(self._ptr,handle,float(value))
+		if status!=0:
+			self._raise_for_handle(status, handle)
+
+	def _many(self, function, keys, values):
+		failed = ct.c_int()
+		status = function(self._ptr, len(keys), keys._sections, keys._names,
+			values.ctypes.data_as(ct.POINTER(ct.c_double)), ct.byref(failed))
+		if status!=0:
+			section, name = keys.keys[failed.value] if failed.value>=0 else ("", "")
+			raise BlockError.exception_for_status(status, section, name)
+
+	def _many_values(self, keys, values):
+		values = np.ascontiguousarray(values, dtype=np.double)
+		if values.shape != (len(keys),):
+			raise ValueError("put_many and replace_many need one value for each of the {} keys, not {}".format(len(keys), values.shape))
+		return values
+
+	def get_many(self, keys):
+		u"""Return an array of the floating-point parameters with the given (section, name) pairs.
+
+		`keys` is a list of pairs, or a :class:`ScalarKeys`. This is
+		equivalent to calling :meth:`get_double` for each pair, but crosses
+		into the C library only once, so it is much faster for many
+		values. An error is raised for the first parameter that cannot be
+		read.
+
+		"""
+		keys = _scalar_keys(keys)
+		values = np.empty(len(keys))
+		self._many(lib.c_datablock_get_double_many, keys, values)
+		return values
+
+	def put_many(self, keys, values):
+		u"""Add floating-point parameters with the given (section, name) pairs and values.
+
+		As :meth:`get_many`, this is equivalent to calling
+		:meth:`put_double` for each pair, in one call into the C library.
+		If one of the parameters cannot be put (for example, because it
+		already exists) an error is raised, and the parameters before it
+		have been added.
+
+		"""
+		keys = _scalar_keys(keys)
+		self._many(lib.c_datablock_put_double_many, keys, self._many_values(keys, values))
+
+	def replace_many(self, keys, values):
+		u"""Change floating-point parameters with the given (section, name) pairs; see :meth:`put_many`."""
+		keys = _scalar_keys(keys)
+		self._many(lib.c_datablock_replace_double_many, keys, self._many_values(keys, values))
+
+	def hash(self, sections=None):
+		u"""Return a 128-bit hash of the given sections, or of the whole block, as an int.
+
+		The hash depends only on the contents of the sections, including
+		arrays and metadata, and not on the order in which they were
+		made, so it is the same for equal contents in another block, or
+		another process or run. A section that is not in the block is
+		hashed as if it were empty.
+
+		"""
+		sections = [] if sections is None else [s.encode('ascii') for s in sections]
+		h = (ct.c_uint64 * 2)()
+		status = lib.c_datablock_hash(self._ptr, len(sections), (ct.c_char_p * len(sections))(*sections), h)
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+		return h[0] | (h[1] << 64)
+
+	def hash_values(self, keys):
+		u"""Return a 128-bit hash of the values with the given (section, name) pairs, as an int.
+
+		`keys` is a list of pairs, or a :class:`ScalarKeys`. The values
+		may be of any type, including arrays; as with :meth:`hash`, the
+		result depends only on the values and their names. An error is
+		raised if one of them is not in the block.
+
+		"""
+		keys = _scalar_keys(keys)
+		h = (ct.c_uint64 * 2)()
+		failed = ct.c_int()
+		status = lib.c_datablock_hash_values(self._ptr, len(keys), keys._sections, keys._names, h, ct.byref(failed))
+		if status!=0:
+			section, name = keys.keys[failed.value] if failed.value>=0 else ("", "")
+			raise BlockError.exception_for_status(status, section, name)
+		return h[0] | (h[1] << 64)
+
+	def mark(self):
+		u"""Return a mark of the current state of the values, for :meth:`changed_since`."""
+		return lib.c_datablock_mark(self._ptr)
+
+	def changed_since(self, mark):
+		u"""Return the (section, name) pairs of the values put or replaced since `mark` was taken.
+
+		`mark` is a value returned by :meth:`mark`, of this or any other
+		block.  Values copied from another section count as put;
+		deleted values are not reported.
+
+		"""
+		n = ct.c_int()
+		status = lib.c_datablock_changed_since(self._ptr, mark, 0, None, None, ct.byref(n))
+		while status == errors.DBS_SIZE_INSUFFICIENT:
+			maxn = n.value
+			sections = (lib.c_str * maxn)()
+			names = (lib.c_str * maxn)()
+			status = lib.c_datablock_changed_since(self._ptr, mark, maxn, sections, names, ct.byref(n))
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+		if n.value == 0:
+			return []
+		return [(s.decode(), v.decode()) for s, v in zip(sections[:n.value], names[:n.value])]
+
+	def access_counts(self):
+		u"""Return the counts of reads and writes of values since the block was made or reset.
+
+		The result is a dict with the number of successful reads and
+		writes (puts and replaces), and the bytes of data they read and
+		wrote, under "reads", "read_bytes", "writes" and "write_bytes".
+		They are kept whatever the log mode.
+
+		"""
+		counts = (ct.c_uint64 * 4)()
+		status = lib.c_datablock_get_access_counts(self._ptr, counts)
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+		return dict(zip(["reads", "read_bytes", "writes", "write_bytes"], counts))
+
 	def replace_int_array_1d(self, section, name, value):
 		u"""Replace the value of a parameter with a simple integer array.
 
@@ -865,7 +1386,11 @@ class DataBlock(object):
 			(section,name) = section_name
 		except ValueError:
 			raise ValueError("You must specify both a section and a name to get or set a block item: b['section','name']")
-		if self.has_value(section, name):
+		if _ext is not None and _ext.set(self._ptr, section, name, value) is not NotImplemented:
+			return
+		# Unlike has_value, get_type does not log the check.
+		type_code_c = lib.c_datatype()
+		if lib.c_datablock_get_type(self._ptr, section.encode('ascii'), name.encode('ascii'), ct.byref(type_code_c)) == 0:
 			self.replace(section, name, value)
 		else:
 			self.put(section, name, value)
@@ -906,6 +1431,10 @@ class DataBlock(object):
 		elements of each being the `section` and name of each parameter.
 
 		"""
+		if _ext is not None:
+			keys = _ext.keys(self._ptr, section)
+			if keys is not NotImplemented:
+				return keys
 		if section is None:
 			sections = self.sections()
 		else:
@@ -942,6 +1471,57 @@ class DataBlock(object):
 		meta = key[s+1:]
 		return name, meta
 
+	def save(self, filename, format="snapshot", clobber=False):
+		u"""Save the entire contents of the block, in the given format.
+
+		With format "snapshot" (the default) this is
+		:func:`save_snapshot`, with ".snap" appended to `filename`;
+		with "tgz" it is :func:`save_to_file` and with "directory"
+		:func:`save_to_directory`.
+
+		"""
+		if format == "snapshot":
+			self.save_snapshot(filename + ".snap", clobber=clobber)
+		elif format == "tgz":
+			self.save_to_file(filename, clobber=clobber)
+		elif format == "directory":
+			self.save_to_directory(filename, clobber=clobber)
+		else:
+			raise ValueError("Unknown format for saving a block: '{}'; "
+				"use snapshot, tgz or directory".format(format))
+
+	def save_snapshot(self, filename, clobber=False):
+		u"""Save the entire contents of the block to a single binary file.
+
+		The file holds an index and then the raw contents of each array,
+		so that it can be opened cheaply, without parsing, by
+		:class:`cosmosis.datablock.cosmosis_py.snapshot.Snapshot`, or read
+		back into a block by :func:`from_snapshot`. It is much faster to
+		write than the text of :func:`save_to_file`. The directory holding
+		the file is created if necessary.
+
+		"""
+		base_dirname = os.path.dirname(filename)
+		if base_dirname:
+			try:
+				mkdir(base_dirname)
+			except OSError:
+				pass
+
+		if os.path.exists(filename) and not clobber:
+			raise ValueError("File %s already exists and not clobbering"%filename)
+
+		status = lib.c_datablock_save_snapshot(self._ptr, os.fsencode(filename))
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", filename)
+
+	@classmethod
+	def from_snapshot(cls, filename):
+		u"""Make a new block holding the contents of a file written by :func:`save_snapshot`."""
+		from .snapshot import Snapshot
+		with Snapshot(filename) as snapshot:
+			return snapshot.to_block()
+
 	def save_to_file(self, dirname, clobber=False):
 		u"""Effectively :func:`save_to_directory` with the result tarʼd and compressed to a single file.
 
@@ -1108,6 +1688,54 @@ class DataBlock(object):
 		if status!=0:
 			raise BlockError.exception_for_status(status, "", "")
 
+	def set_log_mode(self, mode):
+		u"""Choose which accesses to this block are recorded in its log.
+
+		The `mode` is one of "full" (the default), which records every
+		access; "failures", which records only failed reads, writes and
+		replaces; or "off", which records nothing.  Changing the mode
+		does not remove entries already in the log.
+
+		"""
+		if mode not in LOG_MODES:
+			raise ValueError("Log mode should be one of {}, not {}".format(", ".join(LOG_MODES), mode))
+		status = lib.c_datablock_set_log_mode(self._ptr, LOG_MODES.index(mode))
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+
+	def get_log_mode(self):
+		u"""Return the log mode of this block, as a string; see :meth:`set_log_mode`."""
+		return LOG_MODES[lib.c_datablock_get_log_mode(self._ptr)]
+
+	def set_concurrent(self, on=True):
+		u"""Turn concurrent mode on or off.
+
+		In concurrent mode the block may be used by several threads at
+		once, for example by the OpenMP threads of a C or Fortran module,
+		or by modules run in parallel.  Operations on different sections
+		do not wait for each other.  Each thread keeps its own log, which
+		is collected into the log of the block when it is read, or when
+		concurrent mode is turned off.
+
+		"""
+		status = lib.c_datablock_set_concurrent(self._ptr, bool(on))
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+
+	def is_concurrent(self):
+		u"""Return True if the block is in concurrent mode; see :meth:`set_concurrent`."""
+		return bool(lib.c_datablock_is_concurrent(self._ptr))
+
+	def set_log_capacity(self, capacity):
+		u"""Set the maximum number of entries held in the log.
+
+		Once the log is full each new entry replaces the oldest one.
+
+		"""
+		status = lib.c_datablock_set_log_capacity(self._ptr, capacity)
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+
 	def get_log_count(self):
 		u"""Return the number of entries in the log."""
 		return lib.c_datablock_get_log_count(self._ptr)
@@ -1385,12 +2013,63 @@ class DataBlock(object):
 		sio.seek(0)
 		return sio.read()
 
+	def to_bytes(self):
+		u"""Return the whole contents of the block in a compact binary form.
+
+		The result, which includes metadata but not the access log, can
+		be turned back into a block with DataBlock.from_bytes, on any
+		machine. It is much faster to make and to read than the YAML of
+		to_string, and arrays are stored exactly, so this is what is used
+		when blocks are pickled.
+
+		"""
+		size = self.serialized_size()
+		buf = ct.create_string_buffer(size)
+		status = lib.c_datablock_serialize(self._ptr, buf, size)
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+		return buf.raw
+
+	def serialized_size(self):
+		u"""Return the size in bytes of the result of to_bytes, without making it.
+
+		This is a good measure of the memory used by the values in the block.
+
+		"""
+		size = ct.c_size_t()
+		status = lib.c_datablock_serialized_size(self._ptr, ct.byref(size))
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+		return size.value
+
+	def load_bytes(self, data):
+		u"""Replace the contents of the block with those saved by to_bytes.
+
+		Handles remain valid. If data is not the result of to_bytes the
+		block is unchanged and an error is raised.
+
+		"""
+		status = lib.c_datablock_deserialize(self._ptr, data, len(data))
+		if status!=0:
+			raise BlockError.exception_for_status(status, "", "")
+
+	@classmethod
+	def from_bytes(cls, data):
+		u"""Make a new block from the result of to_bytes."""
+		block = cls()
+		block.load_bytes(data)
+		return block
+
 	def __reduce__(self):
-		return (datablock_from_string, (self.to_string(),))
+		return (datablock_from_bytes, (self.to_bytes(),))
 
 
 # This is not needed under python 3, where, the __reduce__ method
 # above can return the class method, but it is under python 2.
+def datablock_from_bytes(data):
+	return DataBlock.from_bytes(data)
+
+# Blocks pickled by earlier versions were stored as YAML.
 def datablock_from_string(s):
 	return DataBlock.from_string(s)
 
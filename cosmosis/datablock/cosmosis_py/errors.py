@@ -21,7 +21,10 @@ enum_names = [
 "DBS_NDIM_MISMATCH",
 "DBS_EXTENTS_NULL",
 "DBS_EXTENTS_MISMATCH",
-"DBS_LOGIC_ERROR"
+"DBS_LOGIC_ERROR",
+"DBS_HANDLE_INVALID",
+"DBS_BAD_FORMAT",
+"DBS_IO_FAILURE"
 ]
 
 
@@ -62,6 +65,9 @@ ERROR_MESSAGES.update({
     DBS_EXTENTS_NULL: "{status} Null value passed for array extents (section was {section}, name was {name})",
     DBS_EXTENTS_MISMATCH: "{status} Supplied array extents do not match the extents of the stored array (section was {section}, name was {name})",
     DBS_LOGIC_ERROR: "{status}: Internal cosmosis logical error.  Please contact cosmosis team (section was {section}, name was {name})",
+    DBS_HANDLE_INVALID: "{status}: Handle passed into function was not obtained from resolve on this block (section was {section}, name was {name})",
+    DBS_BAD_FORMAT: "{status}: Data passed to deserialize was not a serialized DataBlock, or was truncated or corrupted",
+    DBS_IO_FAILURE: "{status}: A file could not be written",
 })
 
 ERROR_CLASSES = {}
@@ -65,6 +65,29 @@ load_array_function_types(locals(), ct.c_int, 'int')
 load_array_function_types(locals(), ct.c_double, 'double')
 #load_array_function_types(locals(), ct.c_complex, 'complex')
 
+def load_handle_function_types(namespace, c_type, c_name):
+	load_library_function(namespace, "c_datablock_put_%s_h"%c_name, [c_block, c_int, c_type], c_status)
+	load_library_function(namespace, "c_datablock_replace_%s_h"%c_name, [c_block, c_int, c_type], c_status)
+	load_library_function(namespace, "c_datablock_get_%s_h"%c_name, [c_block, c_int, ct.POINTER(c_type)], c_status)
+
+load_handle_function_types(locals(), ct.c_int, 'int')
+load_handle_function_types(locals(), ct.c_bool, 'bool')
+load_handle_function_types(locals(), ct.c_double, 'double')
+
+load_library_function(
+	locals(),
+	"c_datablock_resolve",
+	[c_block, c_str, c_str, c_int_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_get_handle_key",
+	[c_block, ct.c_int, ct.c_int, c_str, c_str],
+	c_status
+	)
+
 load_library_function(
 	locals(), 
 	"make_c_datablock",
@@ -86,6 +109,112 @@ load_library_function(
 	c_block
 )
 
+load_library_function(
+	locals(),
+	"c_datablock_reset",
+	[c_block],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"make_c_datablock_pool",
+	[],
+	ct.c_void_p
+	)
+
+load_library_function(
+	locals(),
+	"destroy_c_datablock_pool",
+	[ct.c_void_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"make_c_datablock_pooled",
+	[ct.c_void_p],
+	c_block
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_pool_counts",
+	[ct.c_void_p, ct.POINTER(ct.c_long), ct.POINTER(ct.c_long), ct.POINTER(ct.c_long)],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_serialized_size",
+	[c_block, ct.POINTER(ct.c_size_t)],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_serialize",
+	[c_block, ct.c_void_p, ct.c_size_t],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_deserialize",
+	[c_block, ct.c_char_p, ct.c_size_t],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_save_snapshot",
+	[c_block, c_str],
+	c_status
+	)
+
+for op in ["get", "put", "replace"]:
+	load_library_function(
+		locals(),
+		"c_datablock_%s_double_many"%op,
+		[c_block, c_int, ct.POINTER(c_str), ct.POINTER(c_str), ct.POINTER(ct.c_double), c_int_p],
+		c_status
+		)
+
+load_library_function(
+	locals(),
+	"c_datablock_hash",
+	[c_block, c_int, ct.POINTER(c_str), ct.POINTER(ct.c_uint64)],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_hash_values",
+	[c_block, c_int, ct.POINTER(c_str), ct.POINTER(c_str), ct.POINTER(ct.c_uint64), c_int_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_mark",
+	[c_block],
+	ct.c_uint64
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_changed_since",
+	[c_block, ct.c_uint64, c_int, ct.POINTER(c_str), ct.POINTER(c_str), c_int_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_get_access_counts",
+	[c_block, ct.POINTER(ct.c_uint64)],
+	c_status
+	)
+
 
 
 load_library_function(
@@ -204,6 +333,41 @@ load_library_function(
 	c_status
 	)
 
+load_library_function(
+	locals(),
+	"c_datablock_set_log_mode",
+	[c_block, c_enum],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_get_log_mode",
+	[c_block],
+	ct.c_int
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_set_concurrent",
+	[c_block, ct.c_bool],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_is_concurrent",
+	[c_block],
+	ct.c_bool
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_set_log_capacity",
+	[c_block, ct.c_int],
+	c_status
+	)
+
 
 
 
@@ -259,6 +423,49 @@ load_library_function(
 	ct.c_int
 	)
 
+load_library_function(
+	locals(),
+	"c_datablock_view_array",
+	[c_block, c_str, c_str, ct.POINTER(ct.c_void_p), ct.POINTER(c_enum),
+		ct.POINTER(ct.c_void_p), c_int_p, ct.POINTER(c_int_p)],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"destroy_c_datablock_view",
+	[ct.c_void_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"make_c_datablock_array",
+	[c_enum, ct.c_int, c_int_p, ct.POINTER(ct.c_void_p)],
+	ct.c_void_p
+	)
+
+load_library_function(
+	locals(),
+	"destroy_c_datablock_array",
+	[ct.c_void_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_put_array_move",
+	[c_block, c_str, c_str, ct.c_void_p],
+	c_status
+	)
+
+load_library_function(
+	locals(),
+	"c_datablock_replace_array_move",
+	[c_block, c_str, c_str, ct.c_void_p],
+	c_status
+	)
+
 load_library_function(
 	locals(),
 	"c_datablock_put_str_array_1d",
@@ -0,0 +1,164 @@
+u"""Reading of DataBlock snapshot files.
+
+A snapshot, written by :meth:`DataBlock.save_snapshot`, holds the whole
+contents of a block in one file.  A :class:`Snapshot` maps the file
+into memory and reads only its short index; arrays are returned as
+read-only numpy views of the mapped file, so that nothing is read from
+disk until it is used.  This makes it cheap to open the snapshots of
+many samples (for example those saved by the grid sampler) and look at
+a few values of each.
+
+The layout of the file is described in datablock/snapshot.cc.
+
+"""
+import mmap
+import struct
+import numpy as np
+from . import dbt_types as types
+
+__all__ = ["Snapshot"]
+
+MAGIC = b"CSNP"
+VERSION = 1
+HEADER = struct.Struct("<4sIIIQQ")
+
+_dtypes = {
+	types.DBT_INT1D: np.dtype("<i4"),
+	types.DBT_DOUBLE1D: np.dtype("<f8"),
+	types.DBT_COMPLEX1D: np.dtype("<c16"),
+	types.DBT_INTND: np.dtype("<i4"),
+	types.DBT_DOUBLEND: np.dtype("<f8"),
+	types.DBT_COMPELXND: np.dtype("<c16"),
+}
+
+_scalars = {
+	types.DBT_INT: struct.Struct("<i"),
+	types.DBT_DOUBLE: struct.Struct("<d"),
+	types.DBT_BOOL: struct.Struct("<?"),
+}
+
+
+class Snapshot(object):
+	u"""A read-only view of a DataBlock snapshot file.
+
+	Values are looked up as in a DataBlock, by ``snapshot[section, name]``
+	(case-insensitively).  Arrays are read-only views of the mapped file,
+	which stays mapped while any of them is in use.  A Snapshot may be
+	used as a context manager, which closes it.
+
+	"""
+	def __init__(self, filename):
+		self.filename = filename
+		with open(filename, "rb") as f:
+			self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+		try:
+			self._index = self._read_index()
+		except:
+			self._map.close()
+			raise
+
+	def _read_index(self):
+		m = self._map
+		if len(m) < HEADER.size:
+			raise ValueError("{} is not a DataBlock snapshot".format(self.filename))
+		magic, version, _, count, index_size, file_size = HEADER.unpack_from(m, 0)
+		if magic != MAGIC or version != VERSION or file_size != len(m):
+			raise ValueError("{} is not a DataBlock snapshot, or is truncated".format(self.filename))
+		index = {}
+		pos = HEADER.size
+		for _ in range(count):
+			section, pos = _read_string(m, pos)
+			name, pos = _read_string(m, pos)
+			dtype, ndims = struct.unpack_from("<BI", m, pos)
+			pos += 5
+			shape = struct.unpack_from("<{}Q".format(ndims), m, pos)
+			pos += 8 * ndims
+			offset, nbytes = struct.unpack_from("<QQ", m, pos)
+			pos += 16
+			index[section, name] = (dtype, shape, offset, nbytes)
+		return index
+
+	def close(self):
+		u"""Unmap the file, unless arrays from it are still in use."""
+		try:
+			self._map.close()
+		except BufferError:
+			# Arrays still refer to the map; it is unmapped once they
+			# have all gone.
+			pass
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *args):
+		self.close()
+
+	def keys(self, section=None):
+		u"""Return the (section, name) pairs of the values, optionally those of one section only."""
+		if section is None:
+			return list(self._index.keys())
+		section = section.lower()
+		return [k for k in self._index if k[0] == section]
+
+	def sections(self):
+		u"""Return the names of the sections, in the order they were made."""
+		return list(dict.fromkeys(k[0] for k in self._index))
+
+	def __contains__(self, key):
+		section, name = key
+		return (section.lower(), name.lower()) in self._index
+
+	def __len__(self):
+		return len(self._index)
+
+	def __getitem__(self, key):
+		section, name = key
+		try:
+			dtype, shape, offset, nbytes = self._index[section.lower(), name.lower()]
+		except KeyError:
+			raise KeyError("No value {} in section {} of {}".format(name, section, self.filename))
+		m = self._map
+		if dtype in _dtypes:
+			t = _dtypes[dtype]
+			return np.frombuffer(m, dtype=t, count=nbytes // t.itemsize, offset=offset).reshape(shape)
+		if dtype in _scalars:
+			return _scalars[dtype].unpack_from(m, offset)[0]
+		if dtype == types.DBT_COMPLEX:
+			real, imag = struct.unpack_from("<dd", m, offset)
+			return complex(real, imag)
+		if dtype == types.DBT_STRING:
+			return m[offset:offset + nbytes].decode()
+		if dtype == types.DBT_STRING1D:
+			strings = []
+			pos = offset
+			for _ in range(shape[0]):
+				s, pos = _read_string(m, pos)
+				strings.append(s)
+			return np.array(strings, dtype=str)
+		raise ValueError("Unknown type {} for {} in section {} of {}".format(dtype, name, section, self.filename))
+
+	def to_block(self):
+		u"""Return a new DataBlock holding copies of all the values."""
+		from .block import DataBlock
+		block = DataBlock()
+		for section, name in self._index:
+			value = self[section, name]
+			if isinstance(value, np.ndarray):
+				value = value.copy()
+			block[section, name] = value
+		return block
+
+	def export(self, dirname, format="tgz", clobber=False):
+		u"""Save the contents in the text formats of DataBlock.
+
+		With format "tgz" this is :meth:`DataBlock.save_to_file`, and with
+		format "directory" :meth:`DataBlock.save_to_directory`.
+
+		"""
+		self.to_block().save(dirname, format=format, clobber=clobber)
+
+
+def _read_string(m, pos):
+	n, = struct.unpack_from("<I", m, pos)
+	pos += 4
+	return m[pos:pos + n].decode(), pos + n
@@ -1,89 +1,128 @@
 #include "datablock.hh"
 #include "clamp.hh"
+#include <cstring>
 #include <iostream>
+#include <typeindex>
 #include "cxxabi.h"
 using namespace std;
+using cosmosis::concurrency::block_lock;
+using cosmosis::concurrency::handles_lock;
+using cosmosis::concurrency::section_lock;
 
-bool cosmosis::DataBlock::has_val(string section,
-                                              string name) const
+bool cosmosis::DataBlock::has_val(string const& section,
+                                  string const& name) const
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  section_lock lock(sync(), sec, false);
+  log_access(BLOCK_LOG_CHECK, sec, nm, typeid(void));
+  auto isec = sections_.find(sec);
   if (isec == sections_.end()) return false;
-  return isec->second.has_val(name) ? true : false;
+  return isec->second.has_val(nm) ? true : false;
 }
 
-int cosmosis::DataBlock::get_size(string section,
-                                  string name) const
+int cosmosis::DataBlock::get_size(string const& section,
+                                  string const& name) const
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section);
+  section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
   if (isec == sections_.end()) return -1;
-  return isec->second.get_size(name);
+  return isec->second.get_size(name_id::folded(name));
 }
 
-DATABLOCK_STATUS cosmosis::DataBlock::get_type(string section,
-                                              string name, datablock_type_t &t) const
+DATABLOCK_STATUS cosmosis::DataBlock::get_type(string const& section,
+                                              string const& name, datablock_type_t &t) const
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section);
+  section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
   if (isec == sections_.end()) return DBS_SECTION_NOT_FOUND;
-  return isec->second.get_type(name,t);
+  return isec->second.get_type(name_id::folded(name),t);
 }
 
 
-bool cosmosis::DataBlock::has_section(string name) const
+bool cosmosis::DataBlock::has_section(string const& name) const
 {
-  downcase(name);
-  return sections_.find(name) != sections_.end();
+  name_id const sec = name_id::folded(name);
+  block_lock lock(sync(), false);
+  log_access(BLOCK_LOG_CHECK, sec, "", typeid(void));
+  return sections_.find(sec) != sections_.end();
 }
 
-int cosmosis::DataBlock::num_values(string section) const
+int cosmosis::DataBlock::num_values(string const& section) const
 {
-  downcase(section);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section);
+  section_lock lock(sync(), sec, false);
+  log_access(BLOCK_LOG_CHECK, sec, "", typeid(void));
+  auto isec = sections_.find(sec);
   if (isec == sections_.end()) return -1;
   return clamp(isec->second.number_values());
 }
 
 std::size_t cosmosis::DataBlock::num_sections() const
 {
+  block_lock lock(sync(), false);
+  log_access(BLOCK_LOG_CHECK, "", "", typeid(void));
   return sections_.size();
 }
 
 std::string const& cosmosis::DataBlock::section_name(std::size_t i) const
 {
-  if (i >= num_sections()) throw BadDataBlockAccess();
-  auto isec = sections_.begin();
-  std::advance(isec, i);
-  return isec->first;
-
+  block_lock lock(sync(), false);
+  if (i >= sections_.size()) throw BadDataBlockAccess();
+  return sections_.nth(i).first.str();
 }
 
 
 std::string const& cosmosis::DataBlock::value_name(int i, int j) const
 {
-  std::string section = section_name(i);
-  return value_name(section,j);
+  return value_name(section_name(i),j);
 }
 
 
-std::string const& cosmosis::DataBlock::value_name(std::string section, int j) const
+std::string const& cosmosis::DataBlock::value_name(std::string const& section, int j) const
 {
-  downcase(section);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section);
+  section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
   if (isec == sections_.end()) throw BadDataBlockAccess();
   return isec->second.value_name(j);
 }
 
 
+DATABLOCK_STATUS
+cosmosis::DataBlock::pin_val(std::string const& section,
+                             std::string const& name,
+                             std::shared_ptr<Entry const>& value)
+{
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  // Pinning records the pin in the Section, so the lock is exclusive.
+  section_lock lock(sync(), sec, true);
+  auto isec = sections_.find(sec);
+  if (isec == sections_.end()) return DBS_SECTION_NOT_FOUND;
+  value = isec->second.pin(nm);
+  return value ? DBS_SUCCESS : DBS_NAME_NOT_FOUND;
+}
+
+cosmosis::Section
+cosmosis::DataBlock::get_section(std::string const& section) const
+{
+  name_id const sec = name_id::folded(section);
+  section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
+  if (isec == sections_.end()) throw BadDataBlockAccess();
+  return isec->second;
+}
+
+
 void cosmosis::DataBlock::print_log()
 {
-  for (auto L=access_log_.begin(); L!=access_log_.end(); ++L){
-    auto l = *L;
-    auto access_type = std::get<0>(l);
-    auto section = std::get<1>(l);
-    auto name = std::get<2>(l);
+  collect_log();
+  for (std::size_t i = 0; i != access_log_.size(); ++i){
+    auto const& l = access_log_[i];
+    auto const& access_type = l.log_type.str();
+    auto const& section = l.section.str();
+    auto const& name = l.name.str();
     bool new_module = access_type == std::string(BLOCK_LOG_START_MODULE);
     if (new_module) std::cout << std::endl << std::endl;
       std::cout << access_type << "    " << section << "    " << name << std::endl;
@@ -93,48 +132,196 @@ void cosmosis::DataBlock::print_log()
 }
 
 DATABLOCK_STATUS 
-cosmosis::DataBlock::copy_section(std::string source, std::string dest)
-{
-  downcase(source); downcase(dest);
-  if (!has_section(source)) return DBS_SECTION_NOT_FOUND;
-  if (has_section(dest)) return DBS_NAME_ALREADY_EXISTS;  //slight abuse
-  auto& source_section = sections_[source];
-  auto& dest_section = source_section;
-  sections_[dest] = dest_section;
-  log_access(BLOCK_LOG_COPY, source, dest, typeid(source));
+cosmosis::DataBlock::copy_section(std::string const& source, std::string const& dest)
+{
+  name_id const src = name_id::folded(source), dst = name_id::folded(dest);
+  block_lock lock(sync());
+  auto isrc = sections_.find(src);
+  if (isrc == sections_.end()) return DBS_SECTION_NOT_FOUND;
+  if (sections_.find(dst) != sections_.end()) return DBS_NAME_ALREADY_EXISTS;  //slight abuse
+  // References to elements of sections_ survive the insertion.
+  auto& source_section = isrc->second;
+  Section& copy = sections_[dst];
+  copy = source_section;
+  copy.touch();
+  log_access(BLOCK_LOG_COPY, src, dst, typeid(source));
   return DBS_SUCCESS;
 }
 
+std::uint64_t
+cosmosis::DataBlock::mark() const
+{
+  return Entry::current_generation();
+}
+
+std::vector<std::pair<cosmosis::name_id, cosmosis::name_id>>
+cosmosis::DataBlock::changed_since(std::uint64_t mark) const
+{
+  std::vector<std::pair<name_id, name_id>> result;
+  std::vector<name_id> names;
+  block_lock lock(sync());
+  for (auto const& sec : sections_)
+    {
+      names.clear();
+      sec.second.changed_since(mark, names);
+      for (name_id n : names) result.emplace_back(sec.first, n);
+    }
+  return result;
+}
+
+
+cosmosis::DataBlock::DataBlock(std::shared_ptr<block_pool> pool) :
+  pool_(std::move(pool))
+{}
+
+cosmosis::DataBlock::~DataBlock()
+{
+  remove_sections();
+}
 
 void cosmosis::DataBlock::clear()
 {
+  block_lock lock(sync());
   std::string t = std::string("");
   log_access(BLOCK_LOG_CLEAR, "", "", typeid(t));
-  sections_.clear();
+  remove_sections();
+  invalidate_handles();
+}
+
+void cosmosis::DataBlock::reset()
+{
+  block_lock lock(sync());
+  if (not pool_) pool_ = std::make_shared<block_pool>();
+  remove_sections();
+  invalidate_handles();
+  access_log_.clear();
+  counts_ = access_counts();
+  if (auto s = sync()) s->clear();
+}
+
+void cosmosis::DataBlock::set_concurrent(bool on)
+{
+  if (on == concurrent()) return;
+  if (on)
+    concurrent_.reset(new concurrency::state(access_log_.capacity()));
+  else
+    {
+      collect_log();
+      concurrent_.reset();
+    }
+  invalidate_handles();
+}
+
+bool cosmosis::DataBlock::concurrent() const
+{
+  return sync() != nullptr;
+}
+
+cosmosis::DataBlock::access_counts
+cosmosis::DataBlock::counts() const
+{
+  access_counts result = counts_;
+  if (auto s = sync()) s->add_counts(result);
+  return result;
+}
+
+void cosmosis::DataBlock::collect_log()
+{
+  if (auto s = sync()) s->collect(access_log_, counts_);
 }
 
 DATABLOCK_STATUS 
-cosmosis::DataBlock::delete_section(std::string section)
+cosmosis::DataBlock::delete_section(std::string const& section)
 {
-  downcase(section);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section);
+  block_lock lock(sync());
+  auto isec = sections_.find(sec);
   if (isec == sections_.end()) return DBS_SECTION_NOT_FOUND;
+  if (pool_) pool_->recycle(std::move(isec->second));
   sections_.erase(isec);
+  invalidate_handles();
   std::string t = std::string("");
-  log_access(BLOCK_LOG_DELETE, section, "", typeid(t));
+  log_access(BLOCK_LOG_DELETE, sec, "", typeid(t));
 
   return DBS_SUCCESS;
 }
 
-void cosmosis::DataBlock::log_access(const std::string& log_type, 
-  const std::string& section, const std::string &name, const std::type_info& type)
+namespace
+{
+  // The kinds of access that are recorded, interned once. Callers pass
+  // the BLOCK_LOG_* pointers themselves, so they can be recognized
+  // without looking the string up.
+  struct log_type_ids
+  {
+    const char* type;
+    cosmosis::name_id id;
+  };
+
+  log_type_ids const* known_log_types(std::size_t& n)
+  {
+    static log_type_ids const ids[] = {
+      {BLOCK_LOG_READ, BLOCK_LOG_READ},
+      {BLOCK_LOG_WRITE, BLOCK_LOG_WRITE},
+      {BLOCK_LOG_READ_FAIL, BLOCK_LOG_READ_FAIL},
+      {BLOCK_LOG_WRITE_FAIL, BLOCK_LOG_WRITE_FAIL},
+      {BLOCK_LOG_READ_DEFAULT, BLOCK_LOG_READ_DEFAULT},
+      {BLOCK_LOG_REPLACE, BLOCK_LOG_REPLACE},
+      {BLOCK_LOG_REPLACE_FAIL, BLOCK_LOG_REPLACE_FAIL},
+      {BLOCK_LOG_CLEAR, BLOCK_LOG_CLEAR},
+      {BLOCK_LOG_DELETE, BLOCK_LOG_DELETE},
+      {BLOCK_LOG_START_MODULE, BLOCK_LOG_START_MODULE},
+      {BLOCK_LOG_COPY, BLOCK_LOG_COPY},
+      {BLOCK_LOG_CHECK, BLOCK_LOG_CHECK}
+    };
+    n = sizeof(ids) / sizeof(ids[0]);
+    return ids;
+  }
+
+  cosmosis::name_id log_type_id(const char* log_type)
+  {
+    std::size_t n;
+    auto ids = known_log_types(n);
+    for (std::size_t i = 0; i != n; ++i)
+      if (ids[i].type == log_type) return ids[i].id;
+    return cosmosis::name_id(log_type);
+  }
+
+  bool is_failure(const char* log_type)
+  {
+    return std::strcmp(log_type, BLOCK_LOG_READ_FAIL) == 0 ||
+           std::strcmp(log_type, BLOCK_LOG_WRITE_FAIL) == 0 ||
+           std::strcmp(log_type, BLOCK_LOG_REPLACE_FAIL) == 0;
+  }
+}
+
+void cosmosis::DataBlock::record_access(const char* log_type,
+  name_id section, name_id name, const std::type_info& type) const
 {
-  auto entry = log_entry(log_type, section, name, type);
-  access_log_.push_back(entry);
+  if (log_mode_ == DBL_FAILURES && !is_failure(log_type)) return;
+  log_entry const e{log_type_id(log_type), section, name, &type};
+  if (auto s = sync()) s->local().log.push(e);
+  else access_log_.push(e);
+}
+
+void cosmosis::DataBlock::set_log_mode(datablock_log_mode_t mode)
+{
+  log_mode_ = mode;
+}
+
+datablock_log_mode_t cosmosis::DataBlock::log_mode() const
+{
+  return log_mode_;
+}
+
+void cosmosis::DataBlock::set_log_capacity(std::size_t capacity)
+{
+  access_log_.set_capacity(capacity);
+  if (auto s = sync()) s->set_log_capacity(capacity);
 }
 
 int cosmosis::DataBlock::get_log_count()
 {
+  collect_log();
   return access_log_.size();
 }
 
@@ -147,13 +334,14 @@ cosmosis::DataBlock::get_log_entry(int i,
   std::string& type)
 {
   if (i<0) return DBS_SIZE_INSUFFICIENT;
+  collect_log();
   unsigned int j = (unsigned int) i;
   if (j>=access_log_.size()) return DBS_SIZE_INSUFFICIENT;
-  const log_entry entry = access_log_[j];
-  log_type = std::get<0>(entry);
-  section = std::get<1>(entry);
-  name = std::get<2>(entry);
-  std::type_index info(std::get<3>(entry));
+  auto const& entry = access_log_[j];
+  log_type = entry.log_type.str();
+  section = entry.section.str();
+  name = entry.name.str();
+  std::type_index info(*entry.type);
   char type_name[128];
   int status;
   size_t len = 128;
@@ -170,11 +358,12 @@ cosmosis::DataBlock::get_log_entry(int i,
 
 void cosmosis::DataBlock::report_failures(std::ostream &output)
 {
-   for (auto L=access_log_.begin(); L!=access_log_.end(); ++L){
-      auto l = *L;
-      auto access_type = std::get<0>(l);
-      auto section = std::get<1>(l);
-      auto name = std::get<2>(l);
+   collect_log();
+   for (std::size_t i = 0; i != access_log_.size(); ++i){
+      auto const& l = access_log_[i];
+      auto const& access_type = l.log_type.str();
+      auto const& section = l.section.str();
+      auto const& name = l.name.str();
       if(access_type==BLOCK_LOG_READ_FAIL){
         output << "Failed to read " << name << " from " << section << std::endl;
       }
@@ -189,14 +378,11 @@ void cosmosis::DataBlock::report_failures(std::ostream &output)
 
 
 DATABLOCK_STATUS
-cosmosis::DataBlock::put_metadata(std::string section,
-                             std::string name,
-                             std::string key,
-                             std::string value)
+cosmosis::DataBlock::put_metadata(std::string const& section,
+                             std::string const& name,
+                             std::string const& key,
+                             std::string const& value)
 {
-    downcase(section); 
-    downcase(name);
-
     // The thing which we are putting the metadata for must exist
     if (!has_val(section, name)) return DBS_NAME_NOT_FOUND; 
 
@@ -206,14 +392,11 @@ cosmosis::DataBlock::put_metadata(std::string section,
 }
 
 DATABLOCK_STATUS
-cosmosis::DataBlock::replace_metadata(std::string section,
-                             std::string name,
-                             std::string key,
-                             std::string value)
+cosmosis::DataBlock::replace_metadata(std::string const& section,
+                             std::string const& name,
+                             std::string const& key,
+                             std::string const& value)
 {
-    downcase(section); 
-    downcase(name);
-
     // The thing which we are putting the metadata for must exist
     if (!has_val(section, name)) return DBS_NAME_NOT_FOUND; 
 
@@ -223,14 +406,11 @@ cosmosis::DataBlock::replace_metadata(std::string section,
 }
 
 DATABLOCK_STATUS
-cosmosis::DataBlock::get_metadata(std::string section,
-                             std::string name,
-                             std::string key,
+cosmosis::DataBlock::get_metadata(std::string const& section,
+                             std::string const& name,
+                             std::string const& key,
                              std::string &value)
 {
-    downcase(section); 
-    downcase(name);
-
     // The thing which we are putting the metadata for must exist
     if (!has_val(section, name)) return DBS_NAME_NOT_FOUND; 
 
@@ -238,3 +418,133 @@ cosmosis::DataBlock::get_metadata(std::string section,
     return get_val(section, metadata_key, value);
 
 }
+
+int
+cosmosis::DataBlock::resolve(std::string const& section, std::string const& name)
+{
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  handles_lock lock(sync(), true);
+  // Handles are resolved rarely (typically once per module, in setup),
+  // so a linear search is adequate here.
+  for (std::size_t i = 0; i != handles_.size(); ++i)
+    if (handles_[i].section == sec && handles_[i].name == nm)
+      return static_cast<int>(i);
+  handles_.emplace_back(sec, nm);
+  return static_cast<int>(handles_.size() - 1);
+}
+
+DATABLOCK_STATUS
+cosmosis::DataBlock::handle_key(int handle,
+                                std::string& section,
+                                std::string& name) const
+{
+  handle_slot const* names = handle_names(handle);
+  if (names == nullptr) return DBS_HANDLE_INVALID;
+  section = names->section.str();
+  name = names->name.str();
+  return DBS_SUCCESS;
+}
+
+cosmosis::DataBlock::handle_slot const*
+cosmosis::DataBlock::handle_names(int handle) const
+{
+  handles_lock lock(sync(), false);
+  if (handle < 0 || static_cast<std::size_t>(handle) >= handles_.size())
+    return nullptr;
+  return &handles_[handle];
+}
+
+cosmosis::DataBlock::handle_slot::handle_slot(name_id s, name_id n)
+  : section(s), name(n), owner(nullptr), version(0), entry(nullptr)
+{}
+
+cosmosis::DataBlock::handle_slot::handle_slot(handle_slot const& other)
+  : section(other.section), name(other.name),
+    owner(nullptr), version(0), entry(nullptr)
+{}
+
+cosmosis::DataBlock::handle_slot&
+cosmosis::DataBlock::handle_slot::operator=(handle_slot const& other)
+{
+  section = other.section;
+  name = other.name;
+  owner = nullptr;
+  version = 0;
+  entry = nullptr;
+  return *this;
+}
+
+cosmosis::DataBlock::handle_slot*
+cosmosis::DataBlock::find_slot(int handle)
+{
+  if (handle < 0 || static_cast<std::size_t>(handle) >= handles_.size())
+    return nullptr;
+  return &handles_[handle];
+}
+
+cosmosis::Entry const*
+cosmosis::DataBlock::find_entry(handle_slot& slot, DATABLOCK_STATUS& status)
+{
+  if (slot.entry != nullptr && slot.owner->version() == slot.version)
+    return slot.entry;
+  auto isec = sections_.find(slot.section);
+  if (isec == sections_.end())
+    {
+      status = DBS_SECTION_NOT_FOUND;
+      return nullptr;
+    }
+  cache_entry(slot, isec->second);
+  if (slot.entry == nullptr) status = DBS_NAME_NOT_FOUND;
+  return slot.entry;
+}
+
+cosmosis::Entry*
+cosmosis::DataBlock::find_writable_entry(handle_slot& slot, DATABLOCK_STATUS& status)
+{
+  Entry const* e = find_entry(slot, status);
+  if (e == nullptr) return nullptr;
+  if (slot.owner->shared())
+    {
+      // This duplicates the values, unless they are shared only with
+      // pins of other values.
+      Entry* w = slot.owner->find_entry(slot.name);
+      cache_entry(slot, *slot.owner);
+      return w;
+    }
+  // The Section's storage now belongs to this DataBlock alone, and the
+  // Section itself is not const, so the Entry may be modified.
+  return const_cast<Entry*>(e);
+}
+
+void
+cosmosis::DataBlock::cache_entry(handle_slot& slot, Section& sec)
+{
+  Section const& s = sec;
+  slot.owner = &sec;
+  slot.version = s.version();
+  slot.entry = s.find_entry(slot.name);
+}
+
+void
+cosmosis::DataBlock::invalidate_handles()
+{
+  handles_lock lock(sync(), true);
+  for (auto& slot : handles_) slot.entry = nullptr;
+}
+
+cosmosis::Section&
+cosmosis::DataBlock::section_for_write(name_id section)
+{
+  if (not pool_) return sections_[section];
+  auto isec = sections_.find(section);
+  if (isec != sections_.end()) return isec->second;
+  return sections_.emplace(section, pool_->make_section()).first->second;
+}
+
+void
+cosmosis::DataBlock::remove_sections()
+{
+  if (pool_)
+    for (auto& s : sections_) pool_->recycle(std::move(s.second));
+  sections_.clear();
+}
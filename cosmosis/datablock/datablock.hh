@@ -34,13 +34,21 @@
 //
 //----------------------------------------------------------------------
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <map>
 #include <cctype>
+#include <deque>
 #include <ostream>
+#include <utility>
+#include <vector>
 
 #include "datablock_status.h"
 #include "section.hh"
+#include "block_pool.hh"
+#include "concurrency.hh"
+#include "hashed_map.hh"
 #include "datablock_logging.h"
 
 #define OPTION_SECTION "module_options"
@@ -51,24 +59,70 @@ namespace cosmosis
   inline
   void downcase(std::string& s) { for (auto& x : s) { x = std::tolower(x); } }
 
+  // value_bytes gives the number of bytes of data in a value, as
+  // counted by DataBlock::counts.
+  template <class T>
+  std::size_t value_bytes(T const&) { return sizeof(T); }
+
+  inline
+  std::size_t value_bytes(char const* s) { return std::char_traits<char>::length(s); }
+
+  inline
+  std::size_t value_bytes(std::string const& s) { return s.size(); }
+
+  template <class T>
+  std::size_t value_bytes(std::vector<T> const& v) { return v.size() * sizeof(T); }
+
+  inline
+  std::size_t value_bytes(std::vector<std::string> const& v)
+  {
+    std::size_t n = 0;
+    for (auto const& s : v) n += s.size();
+    return n;
+  }
+
+  template <class T>
+  std::size_t value_bytes(ndarray<T> const& a) { return a.size() * sizeof(T); }
+
   class DataBlock
   {
   public:
     struct BadDataBlockAccess : cosmosis::Exception { }; // used for exceptions.
 
-    // All memory management functions are compiler generated.
+    // Copies share their sections' values with the original (see
+    // Section); moving a DataBlock leaves the source empty but usable.
+    DataBlock() = default;
+    DataBlock(DataBlock const&) = default;
+    DataBlock(DataBlock&&) = default;
+    DataBlock& operator=(DataBlock const&) = default;
+    DataBlock& operator=(DataBlock&&) = default;
+
+    // Create a DataBlock that takes the storage for its sections and
+    // arrays from the given pool where it can, and returns it to the
+    // pool when it is cleared or destroyed (see block_pool). Copies of
+    // the DataBlock use the same pool.
+    explicit DataBlock(std::shared_ptr<block_pool> pool);
+
+    ~DataBlock();
+
+    // Return a vector holding a copy of the n values starting at first,
+    // to be put into this DataBlock. If the DataBlock uses a pool, the
+    // vector's storage is taken from the pool when possible.
+    template <class T>
+    std::vector<T> make_vector(T const* first, std::size_t n);
 
     // Return true if the datablock has a value in the given
-    // section with the given name, and false otherwise.
-    bool has_val(std::string section,
-                 std::string name) const;
+    // section with the given name, and false otherwise. The check is
+    // logged as BLOCK_LOG_CHECK.
+    bool has_val(std::string const& section,
+                 std::string const& name) const;
 
     // Return -1 if no parameter of the given name in the given section
     // is found, or if the parameter is not an array. Return -2 if the
     // length of the array is larger than MAXINT. Otherwise, return the
     // length of the array.
-    int get_size(std::string section,
-                 std::string name) const;
+    int get_size(std::string const& section,
+                 std::string const& name) const;
 
     // Return the extents of the array of the given name in the given
     // section. If the found item is actually an array carrying the
@@ -76,59 +130,64 @@ namespace cosmosis
     // extents. If no object is found, or if the object is not an array,
     // return an error status, and do no modify extents.
     template <class T>
-    DATABLOCK_STATUS get_array_shape(std::string section,
-                                     std::string name,
+    DATABLOCK_STATUS get_array_shape(std::string const& section,
+                                     std::string const& name,
                                      std::vector<std::size_t>& extents);
 
     // Get the type, if any, of the named object. The types are
     // identified by the enumeration type datablock_type_t. Returns
     // DBS_SUCCESS if found.
-    DATABLOCK_STATUS get_type(std::string section,
-                              std::string name,
+    DATABLOCK_STATUS get_type(std::string const& section,
+                              std::string const& name,
                               datablock_type_t& t) const;
 
     // get functions return the status, and set the value of their
     // output argument only upon success.
     template <class T>
-    DATABLOCK_STATUS get_val(std::string section,
-                             std::string name,
+    DATABLOCK_STATUS get_val(std::string const& section,
+                             std::string const& name,
                              T& val);
 
     template <class T>
-    DATABLOCK_STATUS get_val(std::string section,
-                             std::string name,
+    DATABLOCK_STATUS get_val(std::string const& section,
+                             std::string const& name,
                              T const& def,
                              T& val);
 
     // put and replace functions return the status of the or
     // replace. They modify the state of the object only on success.
     // put requires that there is not already a value with the given
-    // name in the given section.
+    // name in the given section. The value is copied into the
+    // DataBlock, or moved if it is an rvalue.
     template <class T>
-    DATABLOCK_STATUS put_val(std::string section,
-                             std::string name,
-                             T const& val);
+    DATABLOCK_STATUS put_val(std::string const& section,
+                             std::string const& name,
+                             T&& val);
 
     // replace requires that there is already a value with the given
     // name and of the same type in the given section.
     template <class T>
-    DATABLOCK_STATUS replace_val(std::string section,
-                                 std::string name,
-                                 T const& val);
+    DATABLOCK_STATUS replace_val(std::string const& section,
+                                 std::string const& name,
+                                 T&& val);
 
     // Return true if the DataBlock has a section with the given name.
-    bool has_section(std::string name) const;
-    DATABLOCK_STATUS copy_section(std::string source, std::string dest);
+    // As for has_val and num_values (which lists a section) and
+    // num_sections (which lists the block), the check is logged as
+    // BLOCK_LOG_CHECK, with an empty name for the whole section (and an
+    // empty section for the whole block).
+    bool has_section(std::string const& name) const;
+    DATABLOCK_STATUS copy_section(std::string const& source, std::string const& dest);
 
     DATABLOCK_STATUS
-    delete_section(std::string section);
+    delete_section(std::string const& section);
 
     // Return the number of sections in this DataBlock.
     std::size_t num_sections() const;
 
     // Get the number of values in a named section.
     // Returns -1 if there is no section with the given name.
-    int num_values(std::string section) const;
+    int num_values(std::string const& section) const;
 
     // Return the name of the i'th section. Throws BadDataBlockAccess if
     // the index is out-of-range.
@@ -136,167 +195,619 @@ namespace cosmosis
 
     // Return the name of the value in the given section and position
     // in that section.  Specify section either by number or name
-    std::string const& value_name(std::string section, int j) const;
+    std::string const& value_name(std::string const& section, int j) const;
     std::string const& value_name(int i, int j) const;
 
     // Remove all the sections.
     void clear();
 
-
+    // Return the DataBlock to the state of a new one, with no sections
+    // and an empty access log, for reuse with the next sample. The
+    // storage of its sections and of the arrays they hold is kept for
+    // the values put next, which in a pipeline usually have the same
+    // shapes as before (see block_pool; a DataBlock made without a pool
+    // is given one of its own). Handles, the log mode and the log
+    // capacity are kept.
+    void reset();
+
+    // Binary serialization. serialize writes serialized_size() bytes,
+    // describing every section and value of the block (including
+    // metadata, but not the access log or handles), to out; the vector
+    // overload appends them. The format, which is the same on all
+    // hosts, is described in serialize.cc. deserialize replaces the
+    // contents of the block with those described by the given bytes;
+    // handles remain valid, and refer to the new values. If the bytes
+    // are not in the expected format it returns DBS_BAD_FORMAT, and
+    // leaves the block unchanged.
+    std::size_t serialized_size() const;
+    void serialize(char* out) const;
+    void serialize(std::vector<char>& out) const;
+    DATABLOCK_STATUS deserialize(char const* data, std::size_t size);
+
+    // Write the whole contents of the block to the named file as a
+    // snapshot, a format that can be memory-mapped and read without
+    // parsing (see snapshot.cc). The file is replaced atomically; if it
+    // cannot be written, return DBS_IO_FAILURE.
+    DATABLOCK_STATUS save_snapshot(std::string const& filename) const;
+
+    // A 128-bit hash of values in the block, as its low and high 64
+    // bits. It depends only on the names, types and contents of the
+    // values, so it is the same for equal values in any block, on any
+    // host (see serialize.cc); values of any type, including arrays and
+    // metadata, are included. The first form hashes the named sections
+    // (a missing one as if it were empty), or the whole block if none
+    // are named. The second hashes the values with the given sections
+    // and names; if one is missing it returns DBS_SECTION_NOT_FOUND or
+    // DBS_NAME_NOT_FOUND, and sets *failed (if given) to its index.
+    // Neither is recorded in the access log.
+    typedef std::array<std::uint64_t, 2> hash_value;
+    hash_value hash(std::vector<std::string> const& sections = {}) const;
+    DATABLOCK_STATUS hash(std::vector<std::pair<std::string, std::string>> const& keys,
+                          hash_value& result,
+                          std::size_t* failed = nullptr) const;
+
+    // Return a mark of the current generation of values (see
+    // Entry::generation). changed_since returns the section and value
+    // names of the values in the block that have been put, replaced or
+    // copied (by copy_section) since the mark was taken, section by
+    // section in the order they were made. Values that were deleted,
+    // along with their sections, are not reported. Marks can be
+    // compared across blocks, so a mark taken from one block may be
+    // given to another (for instance a copy of it). Neither function is
+    // recorded in the access log.
+    std::uint64_t mark() const;
+    std::vector<std::pair<name_id, name_id>> changed_since(std::uint64_t mark) const;
 
     DATABLOCK_STATUS
-    put_metadata(std::string section,
-                                 std::string name,
-                                 std::string key,
-                                 std::string value);
+    put_metadata(std::string const& section,
+                                 std::string const& name,
+                                 std::string const& key,
+                                 std::string const& value);
 
     DATABLOCK_STATUS
-    get_metadata(std::string section,
-                                 std::string name,
-                                 std::string key,
+    get_metadata(std::string const& section,
+                                 std::string const& name,
+                                 std::string const& key,
                                  std::string &value);
 
     DATABLOCK_STATUS
-    replace_metadata(std::string section,
-                                 std::string name,
-                                 std::string key,
-                                 std::string value);
+    replace_metadata(std::string const& section,
+                                 std::string const& name,
+                                 std::string const& key,
+                                 std::string const& value);
 
     // The view functions provide readonly access to the data in
     // DataBlock without copying the data. The reference returned by a
     // call to view is invalidated if any replace function is called for
-    // the same section and name. Throws BadDataBlockAccess if the
+    // the same section and name, or if any value in the section is put
+    // or replaced while the section is shared with a copy of the
+    // DataBlock (see Section). Throws BadDataBlockAccess if the
     // section can't be found, BadSection access if the name can't be
     // found, or BadEntry if the contained value is of the wrong type.
     template <class T>
-    T const& view(std::string section, std::string name);
+    T const& view(std::string const& section, std::string const& name);
+
+    // As view, but call f with the reference to the value while the
+    // section is still locked, and return what f returns. Unlike the
+    // reference returned by view, the reference f is given is valid in
+    // concurrent mode even when other threads write to the section, so
+    // f may copy the value out. f must not use the DataBlock.
+    template <class T, class F>
+    auto view(std::string const& section, std::string const& name, F&& f)
+      -> decltype(f(std::declval<T const&>()));
+
+    // If the value with the given section and name is an array of
+    // type A (a vector or ndarray of int, double or complex) with the
+    // given extents, overwrite its elements in place with the values
+    // starting at 'first', so that no memory is allocated, and return
+    // DBS_SUCCESS. Otherwise the value is left unchanged and an error
+    // is returned: DBS_EXTENTS_MISMATCH if only the shape differs.
+    // Failures are not logged, since the caller will usually fall back
+    // to replace_val.
+    template <class A>
+    DATABLOCK_STATUS overwrite_val(std::string const& section,
+                                   std::string const& name,
+                                   typename A::value_type const* first,
+                                   int ndims,
+                                   int const* extents);
+
+    // Return a copy of the given section. The copy shares its values
+    // with this DataBlock (see Section), so making it is cheap, and
+    // while it exists the values it holds remain valid and unchanged
+    // whatever is done to the DataBlock. Throws BadDataBlockAccess if
+    // there is no such section.
+    Section get_section(std::string const& section) const;
+
+    // Set 'value' to a pointer to the given value that keeps it valid
+    // and unchanged while any copy of the pointer exists, whatever is
+    // done to the DataBlock (see Section::pin). Unlike a copy of the
+    // section, it does not cause the section's values to be duplicated
+    // when other values are put or replaced. Return
+    // DBS_SECTION_NOT_FOUND or DBS_NAME_NOT_FOUND if there is no such
+    // value.
+    DATABLOCK_STATUS pin_val(std::string const& section,
+                             std::string const& name,
+                             std::shared_ptr<Entry const>& value);
+
+    // Handles provide repeated access to one (section, name) pair
+    // without repeating the case-folding and lookups done on every call
+    // to the functions above; a module would typically resolve its
+    // handles once, in setup, and use them in each execute. resolve
+    // returns a non-negative handle, and returns the same handle if
+    // the same pair is resolved again. The value need not exist yet.
+    //
+    // A handle remains usable for the lifetime of the DataBlock, and in
+    // copies made of it. The location of the value is cached on first
+    // use; delete_section and clear discard the cached locations, so
+    // that the next use of each handle looks the value up again.
+    //
+    // The handle functions behave, and log accesses, like the
+    // corresponding functions taking a section and name. They return
+    // DBS_HANDLE_INVALID if the handle was not obtained from resolve.
+    int resolve(std::string const& section, std::string const& name);
+
+    template <class T>
+    DATABLOCK_STATUS get_val(int handle, T& val);
+
+    template <class T>
+    DATABLOCK_STATUS put_val(int handle, T&& val);
+
+    template <class T>
+    DATABLOCK_STATUS replace_val(int handle, T&& val);
+
+    // Set section and name to the (downcased) pair from which the
+    // handle was resolved.
+    DATABLOCK_STATUS handle_key(int handle,
+                                std::string& section,
+                                std::string& name) const;
+
+    // The access log records reads, writes and other operations on the
+    // DataBlock, according to the log mode: DBL_FULL (the default)
+    // records every access, DBL_FAILURES only failed reads, writes and
+    // replaces, and DBL_OFF nothing at all. The log keeps the most
+    // recent entries, up to its capacity; older entries are discarded.
+    void set_log_mode(datablock_log_mode_t mode);
+    datablock_log_mode_t log_mode() const;
+    void set_log_capacity(std::size_t capacity);
+
+    // The counts of successful reads and writes (puts, replaces and
+    // overwrites) of values, and of the bytes of data they read and
+    // wrote (see value_bytes), since the block was made or last reset.
+    // They are kept whatever the log mode, and are copied with the
+    // block.
+    typedef cosmosis::access_counts access_counts;
+    access_counts counts() const;
+
+    // In concurrent mode a DataBlock may be used by several threads at
+    // once, for instance by the OpenMP threads of a module, or by
+    // modules run in parallel. Operations on different sections then
+    // proceed in parallel, and reads of the same section too; writes
+    // to a section wait for the other users of that section (see
+    // concurrency.hh). Each thread records its accesses in a log of its
+    // own, which is collected into the access log when the log is
+    // read; the entries of each thread stay in order, but those of
+    // different threads are grouped by thread. Out of concurrent mode,
+    // the default, there is no locking at all.
+    //
+    // Even in concurrent mode, a reference returned by view is only
+    // valid while no other thread writes to the same section (to copy a
+    // value out, pass view a function to do it under the lock); and
+    // set_concurrent, set_log_mode, the functions that read the access
+    // log, and copying, moving or destroying the block, must not be
+    // called while other threads are using it. Turning concurrent mode
+    // off collects the logs of the threads.
+    void set_concurrent(bool on);
+    bool concurrent() const;
 
     void print_log();
     void report_failures(std::ostream& output);
-    void log_access(const std::string& log_type, const std::string& section, const std::string& name, const std::type_info& type);
+    void log_access(const char* log_type, name_id section, name_id name, const std::type_info& type) const;
     int get_log_count();
     DATABLOCK_STATUS
     get_log_entry(int i, std::string& log_type, std::string& section, std::string &name, std::string & type);
   private:
-    std::map<std::string, Section> sections_;
-    std::vector<log_entry> access_log_;
+    // A handle_slot records the key a handle was resolved from, and
+    // caches the location of the corresponding Entry, together with the
+    // Section holding it and the version of that Section's storage at
+    // the time the Entry was found; the cache is used only while the
+    // Section still uses the same storage. (The version, unlike the
+    // address of the storage, is never reused, so freed storage whose
+    // address comes back from the heap is not mistaken for the cached
+    // one.) Copying a slot discards the cache,
+    // so that a copy of a DataBlock never refers to the entries of the
+    // original.
+    struct handle_slot
+    {
+      handle_slot(name_id s, name_id n);
+      handle_slot(handle_slot const& other);
+      handle_slot(handle_slot&& other) = default;
+      handle_slot& operator=(handle_slot const& other);
+      handle_slot& operator=(handle_slot&& other) = default;
+
+      name_id section;
+      name_id name;
+      Section* owner;
+      std::uint64_t version;
+      Entry const* entry;
+    };
+
+    // Return the slot for the given handle, or nullptr if there is none.
+    handle_slot* find_slot(int handle);
+
+    // Return the Entry for the given slot, looking it up if it is not
+    // cached. If there is no such Entry, return nullptr and set status.
+    Entry const* find_entry(handle_slot& slot, DATABLOCK_STATUS& status);
+
+    // As find_entry, but first give the Section holding the Entry its
+    // own copy of its values if they are shared, so that the Entry may
+    // be modified.
+    Entry* find_writable_entry(handle_slot& slot, DATABLOCK_STATUS& status);
+
+    // Cache, in the given slot, the location of its Entry in sec.
+    void cache_entry(handle_slot& slot, Section& sec);
+
+    void invalidate_handles();
+
+    // Return the section with the given name, creating it (from the
+    // pool, if there is one) if there is no such section.
+    Section& section_for_write(name_id section);
+
+    // Remove all sections, returning their storage to the pool if
+    // there is one.
+    void remove_sections();
+
+    // Write the serialized block with the given writer (see serialize.cc).
+    template <class Writer> void write(Writer& w) const;
+
+    // Add an entry to the access log, if the log mode calls for it.
+    void record_access(const char* log_type, name_id section, name_id name, const std::type_info& type) const;
+
+    // In concurrent mode, move the logs and counts of the threads into
+    // access_log_ and counts_.
+    void collect_log();
+
+    // Return the synchronization state, or nullptr if the block is not
+    // in concurrent mode.
+    concurrency::state* sync() const { return concurrent_.get(); }
+
+    // Return the slot of the given handle, or nullptr if there is none,
+    // taking the lock on the handles to find it. Slots are never moved
+    // or removed, and their names never change, so the names may still
+    // be read once the lock is released.
+    handle_slot const* handle_names(int handle) const;
+
+    // The implementations of get_val, put_val and replace_val, given
+    // the folded names of the section and value.
+    template <class T>
+    DATABLOCK_STATUS get_named_val(name_id sec, name_id nm, T& val);
+    template <class T>
+    DATABLOCK_STATUS put_named_val(name_id sec, name_id nm, T&& val);
+    template <class T>
+    DATABLOCK_STATUS replace_named_val(name_id sec, name_id nm, T&& val);
+
+    hashed_map<Section, name_id> sections_;
+    // Checking whether a value or section exists is logged too, so the
+    // log is changed by const functions.
+    mutable access_log access_log_;
+    datablock_log_mode_t log_mode_ = DBL_FULL;
+    access_counts counts_;
+
+    void count_read(std::size_t bytes);
+    void count_write(std::size_t bytes);
+    // A deque, so that slots stay in place as handles are added.
+    std::deque<handle_slot> handles_;
+    std::shared_ptr<block_pool> pool_;
+    concurrency::holder concurrent_;
   };
 }
 
 // Implementation details below.
 
+inline
+void
+cosmosis::DataBlock::log_access(const char* log_type,
+                                name_id section,
+                                name_id name,
+                                const std::type_info& type) const
+{
+  if (log_mode_ != DBL_OFF) record_access(log_type, section, name, type);
+}
+
+inline
+void
+cosmosis::DataBlock::count_read(std::size_t bytes)
+{
+  if (auto s = sync()) { s->local().count_read(bytes); return; }
+  ++counts_.reads;
+  counts_.read_bytes += bytes;
+}
+
+inline
+void
+cosmosis::DataBlock::count_write(std::size_t bytes)
+{
+  if (auto s = sync()) { s->local().count_write(bytes); return; }
+  ++counts_.writes;
+  counts_.write_bytes += bytes;
+}
+
+template <class T>
+std::vector<T>
+cosmosis::DataBlock::make_vector(T const* first, std::size_t n)
+{
+  if (pool_) return pool_->make_vector(first, n);
+  return std::vector<T>(first, first + n);
+}
+
 template <class T>
 DATABLOCK_STATUS
-cosmosis::DataBlock::get_array_shape(std::string section,
-                                     std::string name,
+cosmosis::DataBlock::get_array_shape(std::string const& section,
+                                     std::string const& name,
                                      std::vector<std::size_t>& extents)
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  concurrency::section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
   if (isec == sections_.end())
     {
-      log_access(BLOCK_LOG_READ_FAIL, section, name, typeid(T));
+      log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(T));
       return DBS_SECTION_NOT_FOUND;
     }
-  DATABLOCK_STATUS status = isec->second.get_array_shape<T>(name, extents);
-  if (status == DBS_SUCCESS) { log_access(BLOCK_LOG_READ, section, name, typeid(T)); }
-  else { log_access(BLOCK_LOG_READ_FAIL, section, name, typeid(T)); }
+  DATABLOCK_STATUS status = isec->second.get_array_shape<T>(nm, extents);
+  if (status == DBS_SUCCESS) { log_access(BLOCK_LOG_READ, sec, nm, typeid(T)); }
+  else { log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(T)); }
   return status;
 }
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::DataBlock::get_val(std::string section,
-                             std::string name,
+cosmosis::DataBlock::get_val(std::string const& section,
+                             std::string const& name,
                              T& val)
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
+  return get_named_val(name_id::folded(section), name_id::folded(name), val);
+}
+
+template <class T>
+DATABLOCK_STATUS
+cosmosis::DataBlock::get_named_val(name_id sec, name_id nm, T& val)
+{
+  concurrency::section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
   if (isec == sections_.end())
     {
-      log_access(BLOCK_LOG_READ_FAIL, section, name, typeid(val));
+      log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(val));
       return DBS_SECTION_NOT_FOUND;
     }
-  DATABLOCK_STATUS status = isec->second.get_val(name, val);
-  if (status == DBS_SUCCESS) { log_access(BLOCK_LOG_READ, section, name, typeid(val)); }
-  else { log_access(BLOCK_LOG_READ_FAIL, section, name, typeid(val)); }
+  DATABLOCK_STATUS status = isec->second.get_val(nm, val);
+  if (status == DBS_SUCCESS)
+    {
+      count_read(value_bytes(val));
+      log_access(BLOCK_LOG_READ, sec, nm, typeid(val));
+    }
+  else { log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(val)); }
   return status;
 }
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::DataBlock::get_val(std::string section,
-                             std::string name,
+cosmosis::DataBlock::get_val(std::string const& section,
+                             std::string const& name,
                              T const& def,
                              T& val)
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
-  if (isec == sections_.end())
-    {
-      val = def;
-      log_access(BLOCK_LOG_READ_DEFAULT, section, name, typeid(val));
-      put_val(section, name, val);
-      return DBS_SUCCESS;
-    }
-  DATABLOCK_STATUS status = isec->second.get_val(name, def, val);
-  if (status == DBS_SUCCESS) { log_access(BLOCK_LOG_READ, section, name, typeid(val)); }
-  else if (status == DBS_USED_DEFAULT)
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  DATABLOCK_STATUS status = DBS_USED_DEFAULT;
+  {
+    concurrency::section_lock lock(sync(), sec, false);
+    auto isec = sections_.find(sec);
+    if (isec == sections_.end()) val = def;
+    else status = isec->second.get_val(nm, def, val);
+    if (status == DBS_SUCCESS)
+      {
+        count_read(value_bytes(val));
+        log_access(BLOCK_LOG_READ, sec, nm, typeid(val));
+      }
+    else if (status == DBS_USED_DEFAULT)
+      { log_access(BLOCK_LOG_READ_DEFAULT, sec, nm, typeid(val)); }
+    else { log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(val)); }
+  }
+  // The default is put once the lock has been released, since put_val
+  // takes it again.
+  if (status == DBS_USED_DEFAULT)
     {
-      log_access(BLOCK_LOG_READ_DEFAULT, section, name, typeid(val));
       status = DBS_SUCCESS;
-      put_val(section, name, val);      
+      put_val(section, name, val);
     }
-  else { log_access(BLOCK_LOG_READ_FAIL, section, name, typeid(val)); }
   return status;
 }
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::DataBlock::put_val(std::string section,
-                             std::string name,
-                             T const& val)
+cosmosis::DataBlock::put_val(std::string const& section,
+                             std::string const& name,
+                             T&& val)
 {
-  downcase(section); downcase(name);
-  auto& sec = sections_[section]; // create one if needed
-  DATABLOCK_STATUS status = sec.put_val(name, val);
+  return put_named_val(name_id::folded(section), name_id::folded(name), std::forward<T>(val));
+}
+
+template <class T>
+DATABLOCK_STATUS
+cosmosis::DataBlock::put_named_val(name_id sec, name_id nm, T&& val)
+{
+  concurrency::section_lock lock(sync(), sec, true);
+  if (sync() != nullptr && sections_.find(sec) == sections_.end()) lock.exclusive();
+  auto& s = section_for_write(sec);
+  std::size_t const bytes = value_bytes(val);
+  DATABLOCK_STATUS status = s.put_val(nm, std::forward<T>(val));
   if (status == DBS_SUCCESS)
-    { log_access(BLOCK_LOG_WRITE, section, name, typeid(val)); }
+    {
+      count_write(bytes);
+      log_access(BLOCK_LOG_WRITE, sec, nm, typeid(val));
+    }
   else
-    { log_access(BLOCK_LOG_WRITE_FAIL, section, name, typeid(val)); }
+    { log_access(BLOCK_LOG_WRITE_FAIL, sec, nm, typeid(val)); }
   return status;
 }
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::DataBlock::replace_val(std::string section,
-                                 std::string name,
-                                 T const& val)
+cosmosis::DataBlock::replace_val(std::string const& section,
+                                 std::string const& name,
+                                 T&& val)
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
+  return replace_named_val(name_id::folded(section), name_id::folded(name), std::forward<T>(val));
+}
+
+template <class T>
+DATABLOCK_STATUS
+cosmosis::DataBlock::replace_named_val(name_id sec, name_id nm, T&& val)
+{
+  concurrency::section_lock lock(sync(), sec, true);
+  auto isec = sections_.find(sec);
   if (isec == sections_.end())
     {
-      log_access(BLOCK_LOG_REPLACE_FAIL, section, name, typeid(val));
+      log_access(BLOCK_LOG_REPLACE_FAIL, sec, nm, typeid(val));
       return DBS_SECTION_NOT_FOUND;
     }
-  DATABLOCK_STATUS status = isec->second.replace_val(name, val);
+  std::size_t const bytes = value_bytes(val);
+  DATABLOCK_STATUS status = isec->second.replace_val(nm, std::forward<T>(val));
   if (status == DBS_SUCCESS)
-    { log_access(BLOCK_LOG_REPLACE, section, name, typeid(val)); }
+    {
+      count_write(bytes);
+      log_access(BLOCK_LOG_REPLACE, sec, nm, typeid(val));
+    }
   else
-    { log_access(BLOCK_LOG_REPLACE_FAIL, section, name, typeid(val)); }
+    { log_access(BLOCK_LOG_REPLACE_FAIL, sec, nm, typeid(val)); }
+  return status;
+}
+
+template <class A>
+DATABLOCK_STATUS
+cosmosis::DataBlock::overwrite_val(std::string const& section,
+                                   std::string const& name,
+                                   typename A::value_type const* first,
+                                   int ndims,
+                                   int const* extents)
+{
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  concurrency::section_lock lock(sync(), sec, true);
+  auto isec = sections_.find(sec);
+  if (isec == sections_.end()) return DBS_SECTION_NOT_FOUND;
+  DATABLOCK_STATUS status =
+    isec->second.overwrite_val<A>(nm, first, ndims, extents);
+  if (status == DBS_SUCCESS)
+    {
+      count_write(value_bytes(isec->second.view<A>(nm)));
+      log_access(BLOCK_LOG_REPLACE, sec, nm, typeid(A));
+    }
   return status;
 }
 
 template <class T>
 T const&
-cosmosis::DataBlock::view(std::string section, std::string name)
+cosmosis::DataBlock::view(std::string const& section, std::string const& name)
+{
+  return view<T>(section, name, [](T const& result) -> T const& { return result; });
+}
+
+template <class T, class F>
+auto
+cosmosis::DataBlock::view(std::string const& section, std::string const& name, F&& f)
+  -> decltype(f(std::declval<T const&>()))
+{
+  name_id const sec = name_id::folded(section), nm = name_id::folded(name);
+  concurrency::section_lock lock(sync(), sec, false);
+  auto isec = sections_.find(sec);
+  if (isec == sections_.end()) {log_access(BLOCK_LOG_READ_FAIL, sec, nm, typeid(void*)); throw BadDataBlockAccess(); }
+  T const& result = isec->second.view<T>(nm);
+  count_read(value_bytes(result));
+  log_access(BLOCK_LOG_READ, sec, nm, typeid(void*));
+  return f(result);
+}
+
+template <class T>
+DATABLOCK_STATUS
+cosmosis::DataBlock::get_val(int handle, T& val)
+{
+  // In concurrent mode the locations cached in the handles are not
+  // used, and the value is looked up by the names in the handle.
+  if (sync() != nullptr)
+    {
+      handle_slot const* names = handle_names(handle);
+      return names ? get_named_val(names->section, names->name, val) : DBS_HANDLE_INVALID;
+    }
+  handle_slot* slot = find_slot(handle);
+  if (slot == nullptr) return DBS_HANDLE_INVALID;
+  DATABLOCK_STATUS status = DBS_SUCCESS;
+  Entry const* e = find_entry(*slot, status);
+  if (e != nullptr && not e->is<T>()) status = DBS_WRONG_VALUE_TYPE;
+  if (status == DBS_SUCCESS)
+    {
+      val = e->val<T>();
+      count_read(value_bytes(val));
+      log_access(BLOCK_LOG_READ, slot->section, slot->name, typeid(val));
+    }
+  else { log_access(BLOCK_LOG_READ_FAIL, slot->section, slot->name, typeid(val)); }
+  return status;
+}
+
+template <class T>
+DATABLOCK_STATUS
+cosmosis::DataBlock::put_val(int handle, T&& val)
 {
-  downcase(section); downcase(name);
-  auto isec = sections_.find(section);
-  if (isec == sections_.end()) {log_access(BLOCK_LOG_READ_FAIL, section, name, typeid(void*)); throw BadDataBlockAccess(); }
-  log_access(BLOCK_LOG_READ, section, name, typeid(void*)); 
-  return isec->second.view<T>(name);
+  if (sync() != nullptr)
+    {
+      handle_slot const* names = handle_names(handle);
+      return names ? put_named_val(names->section, names->name, std::forward<T>(val)) : DBS_HANDLE_INVALID;
+    }
+  handle_slot* slot = find_slot(handle);
+  if (slot == nullptr) return DBS_HANDLE_INVALID;
+  DATABLOCK_STATUS status = DBS_NAME_ALREADY_EXISTS;
+  if (slot->entry == nullptr)
+    {
+      auto& sec = section_for_write(slot->section);
+      std::size_t const bytes = value_bytes(val);
+      status = sec.put_val(slot->name, std::forward<T>(val));
+      if (status == DBS_SUCCESS)
+        {
+          cache_entry(*slot, sec);
+          count_write(bytes);
+        }
+    }
+  if (status == DBS_SUCCESS)
+    { log_access(BLOCK_LOG_WRITE, slot->section, slot->name, typeid(val)); }
+  else
+    { log_access(BLOCK_LOG_WRITE_FAIL, slot->section, slot->name, typeid(val)); }
+  return status;
+}
+
+template <class T>
+DATABLOCK_STATUS
+cosmosis::DataBlock::replace_val(int handle, T&& val)
+{
+  if (sync() != nullptr)
+    {
+      handle_slot const* names = handle_names(handle);
+      return names ? replace_named_val(names->section, names->name, std::forward<T>(val)) : DBS_HANDLE_INVALID;
+    }
+  handle_slot* slot = find_slot(handle);
+  if (slot == nullptr) return DBS_HANDLE_INVALID;
+  DATABLOCK_STATUS status = DBS_SUCCESS;
+  Entry const* e = find_entry(*slot, status);
+  if (e != nullptr && not e->is<typename std::decay<T>::type>())
+    status = DBS_WRONG_VALUE_TYPE;
+  if (status == DBS_SUCCESS)
+    {
+      Entry* w = find_writable_entry(*slot, status);
+      count_write(value_bytes(val));
+      w->set_val(std::forward<T>(val));
+      w->touch();
+      log_access(BLOCK_LOG_REPLACE, slot->section, slot->name, typeid(val));
+    }
+  else
+    { log_access(BLOCK_LOG_REPLACE_FAIL, slot->section, slot->name, typeid(val)); }
+  return status;
 }
 
 
@@ -13,5 +13,63 @@ const char * BLOCK_LOG_CLEAR = "CLEAR";
 const char * BLOCK_LOG_DELETE = "DELETE";
 const char * BLOCK_LOG_START_MODULE = "MODULE-START";
 const char * BLOCK_LOG_COPY = "COPY";
+const char * BLOCK_LOG_CHECK = "CHECK";
 
-}
\ No newline at end of file
+}
+
+const std::size_t cosmosis::access_log::default_capacity;
+
+cosmosis::access_log::access_log(std::size_t capacity)
+  : entries_(), capacity_(capacity == 0 ? 1 : capacity), oldest_(0)
+{}
+
+void
+cosmosis::access_log::push(log_entry const& e)
+{
+  if (entries_.size() < capacity_)
+    {
+      entries_.push_back(e);
+      return;
+    }
+  entries_[oldest_] = e;
+  oldest_ = (oldest_ + 1) % capacity_;
+}
+
+std::size_t
+cosmosis::access_log::size() const
+{
+  return entries_.size();
+}
+
+std::size_t
+cosmosis::access_log::capacity() const
+{
+  return capacity_;
+}
+
+void
+cosmosis::access_log::set_capacity(std::size_t capacity)
+{
+  if (capacity == 0) capacity = 1;
+  std::size_t const n = entries_.size();
+  std::size_t const keep = (capacity < n) ? capacity : n;
+  std::vector<log_entry> kept;
+  kept.reserve(keep);
+  for (std::size_t i = n - keep; i != n; ++i) kept.push_back((*this)[i]);
+  entries_.swap(kept);
+  capacity_ = capacity;
+  oldest_ = 0;
+}
+
+void
+cosmosis::access_log::clear()
+{
+  entries_.clear();
+  oldest_ = 0;
+}
+
+cosmosis::log_entry const&
+cosmosis::access_log::operator[](std::size_t i) const
+{
+  return entries_[(oldest_ + i) % entries_.size()];
+}
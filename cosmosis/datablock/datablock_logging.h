@@ -1,3 +1,6 @@
+#ifndef COSMOSIS_DATABLOCK_LOGGING_H
+#define COSMOSIS_DATABLOCK_LOGGING_H
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -12,6 +15,21 @@ extern const char* BLOCK_LOG_CLEAR;
 extern const char* BLOCK_LOG_DELETE;
 extern const char* BLOCK_LOG_START_MODULE;
 extern const char* BLOCK_LOG_COPY;
+extern const char* BLOCK_LOG_CHECK;
+
+/*
+  datablock_log_mode_t enumerates the amount of logging a datablock
+  does of the accesses made to it. DBL_FULL, the default, records every
+  access, including checks of whether a value or section exists
+  (BLOCK_LOG_CHECK); DBL_FAILURES records only failed reads, writes and
+  replaces; DBL_OFF records nothing.
+*/
+typedef enum
+{
+  DBL_OFF,
+  DBL_FAILURES,
+  DBL_FULL,
+} datablock_log_mode_t;
 
 #ifdef __cplusplus
 }
@@ -20,14 +38,73 @@ extern const char* BLOCK_LOG_COPY;
 
 
 #ifdef __cplusplus
-#include <string>
-#include <typeindex>
+#include <cstddef>
+#include <cstdint>
 #include <typeinfo>
+#include <vector>
+#include "name_table.hh"
 namespace cosmosis
 {
-  typedef std::tuple<std::string, std::string, std::string, std::type_index> log_entry;
-}
-#endif
+  // A log_entry records one access to a DataBlock: the kind of access
+  // (normally one of the BLOCK_LOG_* strings), the section and name
+  // accessed, and the type of value involved. The strings are held as
+  // ids in the name table, so recording an access copies no strings.
+  struct log_entry
+  {
+    name_id log_type;
+    name_id section;
+    name_id name;
+    std::type_info const* type;
+  };
+
+  // The counts of successful reads and writes (puts, replaces and
+  // overwrites) of the values of a DataBlock, and of the bytes of data
+  // they read and wrote (see DataBlock::counts).
+  struct access_counts
+  {
+    std::uint64_t reads = 0;
+    std::uint64_t read_bytes = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t write_bytes = 0;
+  };
+
+  // access_log is a ring buffer holding the most recent log entries,
+  // up to a fixed capacity. Storage is allocated as entries are added,
+  // until the capacity is reached; after that each new entry replaces
+  // the oldest one.
+  class access_log
+  {
+  public:
+    static const std::size_t default_capacity = 65536;
+
+    explicit access_log(std::size_t capacity = default_capacity);
 
+    void push(log_entry const& e);
 
+    // Return the number of entries held, which is never more than the
+    // capacity.
+    std::size_t size() const;
+    std::size_t capacity() const;
 
+    // Change the capacity, keeping the most recent entries if the
+    // new capacity is smaller than the number of entries held.
+    void set_capacity(std::size_t capacity);
+
+    // Remove all the entries, keeping the memory that holds them.
+    void clear();
+
+    // Return the i'th entry held, counting from the oldest. The caller
+    // must ensure i < size().
+    log_entry const& operator[](std::size_t i) const;
+
+  private:
+    std::vector<log_entry> entries_;
+    std::size_t capacity_;
+    // Once entries_ is full, the position of the oldest entry, which
+    // the next entry will replace.
+    std::size_t oldest_;
+  };
+}
+#endif
+
+#endif
@@ -36,6 +36,9 @@ typedef enum
   DBS_EXTENTS_NULL,
   DBS_EXTENTS_MISMATCH,
   DBS_LOGIC_ERROR,
+  DBS_HANDLE_INVALID,
+  DBS_BAD_FORMAT,
+  DBS_IO_FAILURE,
   /*
     DBS_USED_DEFAULT should never be returned by a user-facing function.
   */
@@ -82,6 +85,12 @@ inline const char * datablock_status_str(DATABLOCK_STATUS dbs) {
       return "DBS_EXTENTS_MISMATCH";
     case DBS_LOGIC_ERROR:
       return "DBS_LOGIC_ERROR";
+    case DBS_HANDLE_INVALID:
+      return "DBS_HANDLE_INVALID";
+    case DBS_BAD_FORMAT:
+      return "DBS_BAD_FORMAT";
+    case DBS_IO_FAILURE:
+      return "DBS_IO_FAILURE";
     case DBS_USED_DEFAULT:
       return "DBS_USED_DEFAULT";
   }
@@ -1,5 +1,7 @@
 #include "entry.hh"
 #include "clamp.hh"
+#include <atomic>
+#include <exception>
 #include <limits>
 #include <cstdio>
 
@@ -10,6 +12,7 @@ using std::vector;
 // avoid warnings about the use of unitialized memory.
 cosmosis::Entry::Entry(Entry const& e) :
   type_(e.type_),
+  generation_(e.generation_),
   i(0)
 {
   if      (type_ == enum_for_type<int>()) i = e.i;
@@ -45,9 +48,71 @@ cosmosis::Entry::operator=(cosmosis::Entry const& e)
   else if (type_ == enum_for_type<nd_double_t>()) emplace(&ndd, e.ndd);
   else if (type_ == enum_for_type<nd_complex_t>()) emplace(&ndz, e.ndz);
   else throw BadEntry();  
+  generation_ = e.generation_;
   return *this;
 }
 
+cosmosis::Entry::Entry(Entry&& e) noexcept :
+  type_(e.type_),
+  generation_(e.generation_),
+  i(0)
+{
+  if      (type_ == enum_for_type<int>()) i = e.i;
+  else if (type_ == enum_for_type<bool>()) b = e.b;
+  else if (type_ == enum_for_type<double>()) d = e.d;
+  else if (type_ == enum_for_type<string>()) emplace(&s, std::move(e.s));
+  else if (type_ == enum_for_type<complex_t>()) z = e.z;
+  else if (type_ == enum_for_type<vint_t>()) emplace(&vi, std::move(e.vi));
+  else if (type_ == enum_for_type<vdouble_t>()) emplace(&vd, std::move(e.vd));
+  else if (type_ == enum_for_type<vstring_t>()) emplace(&vs, std::move(e.vs));
+  else if (type_ == enum_for_type<vcomplex_t>()) emplace(&vz, std::move(e.vz));
+  else if (type_ == enum_for_type<nd_int_t>()) emplace(&ndi, std::move(e.ndi));
+  else if (type_ == enum_for_type<nd_double_t>()) emplace(&ndd, std::move(e.ndd));
+  else if (type_ == enum_for_type<nd_complex_t>()) emplace(&ndz, std::move(e.ndz));
+  // An Entry always carries one of the types above; a move may not
+  // throw, so anything else is fatal.
+  else std::terminate();
+}
+
+cosmosis::Entry&
+cosmosis::Entry::operator=(cosmosis::Entry&& e) noexcept
+{
+  if (this == &e) return *this;
+  if      (e.type_ == enum_for_type<int>()) set_val(e.i);
+  else if (e.type_ == enum_for_type<bool>()) set_val(e.b);
+  else if (e.type_ == enum_for_type<double>()) set_val(e.d);
+  else if (e.type_ == enum_for_type<string>()) set_val(std::move(e.s));
+  else if (e.type_ == enum_for_type<complex_t>()) set_val(e.z);
+  else if (e.type_ == enum_for_type<vint_t>()) set_val(std::move(e.vi));
+  else if (e.type_ == enum_for_type<vdouble_t>()) set_val(std::move(e.vd));
+  else if (e.type_ == enum_for_type<vstring_t>()) set_val(std::move(e.vs));
+  else if (e.type_ == enum_for_type<vcomplex_t>()) set_val(std::move(e.vz));
+  else if (e.type_ == enum_for_type<nd_int_t>()) set_val(std::move(e.ndi));
+  else if (e.type_ == enum_for_type<nd_double_t>()) set_val(std::move(e.ndd));
+  else if (e.type_ == enum_for_type<nd_complex_t>()) set_val(std::move(e.ndz));
+  // As in the move constructor.
+  else std::terminate();
+  generation_ = e.generation_;
+  return *this;
+}
+
+namespace
+{
+  std::atomic<std::uint64_t> last_generation(0);
+}
+
+std::uint64_t
+cosmosis::Entry::next_generation()
+{
+  return last_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+std::uint64_t
+cosmosis::Entry::current_generation()
+{
+  return last_generation.load(std::memory_order_relaxed);
+}
+
 cosmosis::Entry::~Entry()
 {
   _destroy_if_managed();
@@ -112,7 +177,7 @@ int cosmosis::Entry::size() const
 void cosmosis::Entry::set_val(int v) { _set(v, i); }
 void cosmosis::Entry::set_val(bool v) { _set(v, b); }
 void cosmosis::Entry::set_val(double v) { _set(v, d); }
-void cosmosis::Entry::set_val(const char * v) { _vset(string(v), s); }
+void cosmosis::Entry::set_val(const char * v) { _vmove(string(v), s); }
 void cosmosis::Entry::set_val(string const& v) { _vset(v, s); }
 void cosmosis::Entry::set_val(cosmosis::complex_t v) { _set(v, z); }
 void cosmosis::Entry::set_val(vector<int> const& v) { _vset(v, vi); }
@@ -123,3 +188,13 @@ void cosmosis::Entry::set_val(vector<complex_t> const& v) { _vset(v, vz); }
 void cosmosis::Entry::set_val(nd_int_t const& v) { _vset(v, ndi); }
 void cosmosis::Entry::set_val(nd_double_t const& v) { _vset(v, ndd); }
 void cosmosis::Entry::set_val(nd_complex_t const& v) { _vset(v, ndz); }
+
+void cosmosis::Entry::set_val(string&& v) { _vmove(std::move(v), s); }
+void cosmosis::Entry::set_val(vector<int>&& v) { _vmove(std::move(v), vi); }
+void cosmosis::Entry::set_val(vector<double>&& v) { _vmove(std::move(v), vd); }
+void cosmosis::Entry::set_val(vector<string>&& v) { _vmove(std::move(v), vs); }
+void cosmosis::Entry::set_val(vector<complex_t>&& v) { _vmove(std::move(v), vz); }
+
+void cosmosis::Entry::set_val(nd_int_t&& v) { _vmove(std::move(v), ndi); }
+void cosmosis::Entry::set_val(nd_double_t&& v) { _vmove(std::move(v), ndd); }
+void cosmosis::Entry::set_val(nd_complex_t&& v) { _vmove(std::move(v), ndz); }
@@ -1,8 +1,11 @@
 #ifndef COSMOSIS_ENTRY_HH
 #define COSMOSIS_ENTRY_HH
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <complex>
+#include <utility>
 #include <vector>
 
 #include "ndarray.hh"
@@ -41,9 +44,7 @@
 //
 // TODO:
 //
-//   1. Evaluate whether move c'tor and move assignment should be
-//   supported.
-//   2. Extend to support 2-dimensional arrays.
+//   1. Extend to support 2-dimensional arrays.
 //
 
 namespace cosmosis
@@ -78,9 +79,27 @@ namespace cosmosis
     explicit Entry(nd_double_t const& a);
     explicit Entry(nd_complex_t const& a);
 
+    // The array constructors and set_val functions taking an rvalue
+    // reference take over the storage of the given array, rather than
+    // copying it.
+    explicit Entry(vint_t&& a);
+    explicit Entry(vdouble_t&& a);
+    explicit Entry(vstring_t&& a);
+    explicit Entry(vcomplex_t&& a);
+    explicit Entry(nd_int_t&& a);
+    explicit Entry(nd_double_t&& a);
+    explicit Entry(nd_complex_t&& a);
+
     Entry(Entry const& other);
     Entry& operator=(Entry const& other);
 
+    // Moving an Entry moves the value it carries; the moved-from Entry
+    // carries a value of the same type, in a valid but unspecified
+    // state. Moves do not throw, so that containers of Entries move
+    // rather than copy them as they grow.
+    Entry(Entry&& other) noexcept;
+    Entry& operator=(Entry&& other) noexcept;
+
     ~Entry();
 
     // Two Entries are equal if they carry the same type, and the same value.
@@ -117,11 +136,46 @@ namespace cosmosis
     void set_val(nd_int_t const& v);
     void set_val(nd_double_t const& v);
     void set_val(nd_complex_t const& v);
+    void set_val(std::string&& v);
+    void set_val(vint_t&& v);
+    void set_val(vdouble_t&& v);
+    void set_val(vstring_t&& v);
+    void set_val(vcomplex_t&& v);
+    void set_val(nd_int_t&& v);
+    void set_val(nd_double_t&& v);
+    void set_val(nd_complex_t&& v);
+
+    // If the Entry carries an array of type A (one of the vector or
+    // ndarray types, other than vstring_t) with the given extents,
+    // overwrite its elements with the values starting at 'first',
+    // without allocating memory, and return true. Otherwise leave the
+    // Entry unchanged and return false.
+    template <class A>
+    bool overwrite(typename A::value_type const* first,
+                   int ndims,
+                   int const* extents);
+
+    // Every Entry records the generation at which its value was last
+    // set. Generations come from a single counter, shared by all
+    // Entries (and thread-safe), which touch() advances; so a value
+    // has been set since current_generation() returned g exactly when
+    // its generation() is greater than g. Copying or moving an Entry
+    // keeps its generation; set_val and overwrite do not change it,
+    // Section and DataBlock call touch() for the values they write.
+    std::uint64_t generation() const { return generation_; }
+    void touch() { generation_ = next_generation(); }
+    static std::uint64_t current_generation();
+    static std::uint64_t next_generation();
 
   private:
+    // block_pool takes the buffers of arrays it recycles.
+    friend class block_pool;
+
     // The type of the value currenty active.
     datablock_type_t type_;
 
+    std::uint64_t generation_ = 0;
+
     // The anonymous union contains the value. We have a named union
     // member for each type we can hold.
     union
@@ -159,11 +213,37 @@ namespace cosmosis
     // Set the carried value to be of type T, with value val. Use this
     // function to set types with nontrival destructors.
     template <class T> void _vset(T const& val, T& member);
+
+    // As _vset, but moving from val rather than copying it.
+    template <class T> void _vmove(T&& val, T& member);
+
+    // Return the carried array of type A; the caller must ensure that
+    // the Entry carries an A.
+    template <class A> A& _array();
   }; // class Entry
 
+  // has_extents returns true if the given array has the given extents.
+  template <class T>
+  bool has_extents(std::vector<T> const& a, int ndims, int const* extents)
+  {
+    return ndims == 1 && extents[0] >= 0 &&
+      a.size() == static_cast<std::size_t>(extents[0]);
+  }
+
+  template <class T>
+  bool has_extents(ndarray<T> const& a, int ndims, int const* extents)
+  {
+    if (ndims < 0 || a.ndims() != static_cast<std::size_t>(ndims)) return false;
+    for (int i = 0; i != ndims; ++i)
+      if (extents[i] < 0 || a.extents()[i] != static_cast<std::size_t>(extents[i]))
+        return false;
+    return true;
+  }
+
   // emplace is used to do placement new of type T, with value val, at
-  // location addr.
+  // location addr. The second form moves from val.
   template <class T> void emplace(T* addr, T const& val);
+  template <class T> void emplace(T* addr, T&& val);
 } // namespace cosmosis
 
 
@@ -195,7 +275,7 @@ cosmosis::Entry::Entry(const char * v) :
 
 inline
 cosmosis::Entry::Entry(std::string v) :
-  type_(DBT_STRING), s(v)
+  type_(DBT_STRING), s(std::move(v))
 {}
 
 inline
@@ -238,6 +318,54 @@ cosmosis::Entry::Entry(nd_complex_t const& v) :
   type_(DBT_COMPLEXND), ndz(v)
 {}
 
+inline
+cosmosis::Entry::Entry(vint_t&& v) :
+  type_(DBT_INT1D), vi(std::move(v))
+{}
+
+inline
+cosmosis::Entry::Entry(vdouble_t&& v) :
+  type_(DBT_DOUBLE1D), vd(std::move(v))
+{}
+
+inline
+cosmosis::Entry::Entry(vstring_t&& v) :
+  type_(DBT_STRING1D), vs(std::move(v))
+{}
+
+inline
+cosmosis::Entry::Entry(vcomplex_t&& v) :
+  type_(DBT_COMPLEX1D), vz(std::move(v))
+{}
+
+inline
+cosmosis::Entry::Entry(nd_int_t&& v) :
+  type_(DBT_INTND), ndi(std::move(v))
+{}
+
+inline
+cosmosis::Entry::Entry(nd_double_t&& v) :
+  type_(DBT_DOUBLEND), ndd(std::move(v))
+{}
+
+inline
+cosmosis::Entry::Entry(nd_complex_t&& v) :
+  type_(DBT_COMPLEXND), ndz(std::move(v))
+{}
+
+template <class A>
+bool
+cosmosis::Entry::overwrite(typename A::value_type const* first,
+                           int ndims,
+                           int const* extents)
+{
+  if (not is<A>()) return false;
+  A& a = _array<A>();
+  if (not has_extents(a, ndims, extents)) return false;
+  std::copy(first, first + a.size(), a.data());
+  return true;
+}
+
 template <class T>
 T const& cosmosis::Entry::_val(T* v) const
 {
@@ -266,6 +394,19 @@ void cosmosis::Entry::_vset(T const& val, T& member)
     }
 }
 
+template <class T>
+void cosmosis::Entry::_vmove(T&& val, T& member)
+{
+  if (type_ == enum_for_type<T>())
+    member = std::move(val);
+  else
+    {
+      _destroy_if_managed();
+      type_ = enum_for_type<T>();
+      emplace(&member, std::move(val));
+    }
+}
+
 
 namespace cosmosis
 {
@@ -301,6 +442,7 @@ namespace cosmosis
 
 
   template <class T> void emplace(T* addr, T const& val) { new(addr) T(val); }
+  template <class T> void emplace(T* addr, T&& val) { new(addr) T(std::move(val)); }
   template <class T> bool Entry::is() const { return (type_ == enum_for_type<T>()); }
 
   template <> inline bool Entry::val<bool>() const { return _val(&b); }
@@ -316,6 +458,13 @@ namespace cosmosis
   template <> inline nd_double_t Entry::val<nd_double_t>() const { return _val(&ndd); }
   template <> inline nd_complex_t Entry::val<nd_complex_t>() const { return _val(&ndz); }
 
+  template <> inline vint_t& Entry::_array<vint_t>() { return vi; }
+  template <> inline vdouble_t& Entry::_array<vdouble_t>() { return vd; }
+  template <> inline vcomplex_t& Entry::_array<vcomplex_t>() { return vz; }
+  template <> inline nd_int_t& Entry::_array<nd_int_t>() { return ndi; }
+  template <> inline nd_double_t& Entry::_array<nd_double_t>() { return ndd; }
+  template <> inline nd_complex_t& Entry::_array<nd_complex_t>() { return ndz; }
+
   template <> inline bool const& Entry::view<bool>() const { return _val(&b); }
   template <> inline int const& Entry::view<int>() const { return _val(&i); }
   template <> inline double const& Entry::view<double>() const { return _val(&d); }
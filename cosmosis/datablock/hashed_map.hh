@@ -0,0 +1,368 @@
+#ifndef COSMOSIS_HASHED_MAP_HH
+#define COSMOSIS_HASHED_MAP_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace cosmosis {
+
+  // hash_name returns the 32-bit FNV-1a hash of the given name. It is
+  // the hash used by hashed_map for string keys.
+  inline std::uint32_t
+  hash_name(char const* s, std::size_t n)
+  {
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i != n; ++i) {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  inline std::uint32_t
+  hash_name(std::string const& s)
+  {
+    return hash_name(s.data(), s.size());
+  }
+
+  // hash_key and key_less give the hash and the ordering of keys used
+  // by hashed_map<V, K>. Other key types provide their own overloads,
+  // in their own namespace.
+  inline std::uint32_t
+  hash_key(std::string const& s)
+  {
+    return hash_name(s);
+  }
+
+  inline bool
+  key_less(std::string const& a, std::string const& b)
+  {
+    return a < b;
+  }
+
+  // hashed_map<V, K> is the associative container used by DataBlock
+  // (for sections) and Section (for entries), with K = name_id. Values
+  // are kept in a dense sequence in insertion order, and located
+  // through an open-addressing (linear probing) index of 32-bit hashes
+  // and positions, so that a lookup touches one small contiguous table
+  // and, in the common case, does a single key comparison.
+  //
+  // The interface mimics the subset of std::map that DataBlock and
+  // Section use. Iteration with begin()/end() visits elements in
+  // insertion order; nth(i) gives the i'th element in sorted key order,
+  // which is the order that has always been used to enumerate sections
+  // and values through the C, Fortran and Python interfaces. The sorted
+  // order is kept up to date by emplace() and erase(), so that the
+  // const member functions never modify the map, and may be used from
+  // several threads at once (as they are on storage shared by copies
+  // of a Section).
+  //
+  // References to elements remain valid when new elements are inserted.
+  // erase() invalidates references to the erased element and to the
+  // most recently inserted element (which is moved into the hole).
+  template <typename V, typename K = std::string>
+  class hashed_map {
+  public:
+    using key_type = K;
+    using value_type = std::pair<K, V>;
+    using iterator = typename std::deque<value_type>::iterator;
+    using const_iterator = typename std::deque<value_type>::const_iterator;
+
+    hashed_map();
+    hashed_map(hashed_map const&) = default;
+    hashed_map& operator=(hashed_map const&) = default;
+
+    // A moved-from hashed_map remains usable; its contents are
+    // unspecified. The move constructor gives the moved-from map a new
+    // empty index; should that small allocation fail, the program
+    // terminates.
+    hashed_map(hashed_map&& other) noexcept;
+    hashed_map& operator=(hashed_map&& other) noexcept;
+
+    void swap(hashed_map& other) noexcept;
+
+    std::size_t size() const;
+    bool empty() const;
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Return an iterator to the element with the given key, or end() if
+    // there is no such element.
+    iterator find(K const& key);
+    const_iterator find(K const& key) const;
+
+    // Insert a default-constructed value for key if there is no element
+    // with that key already; return a reference to the value.
+    V& operator[](K const& key);
+
+    // Insert (key, value) if there is no element with that key already.
+    // The bool is true if the insertion took place.
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(K const& key, Args&&... args);
+
+    void erase(iterator pos);
+    void clear();
+
+    // Return the i'th element in sorted key order. The caller must
+    // ensure i < size().
+    value_type const& nth(std::size_t i) const;
+
+  private:
+    // A bucket with pos == 0 is empty; otherwise the element lives at
+    // elements_[pos-1].
+    struct bucket {
+      std::uint32_t hash;
+      std::uint32_t pos;
+    };
+
+    std::deque<value_type> elements_;
+    std::vector<bucket> buckets_;
+    // The positions of the elements, in sorted key order.
+    std::vector<std::uint32_t> order_;
+
+    std::size_t mask() const;
+    std::size_t probe(K const& key, std::uint32_t h) const;
+    std::vector<std::uint32_t>::iterator find_order(K const& key);
+    void insert_bucket(std::uint32_t h, std::uint32_t pos);
+    void rehash(std::size_t nbuckets);
+  };
+}
+
+template <typename V, typename K>
+cosmosis::hashed_map<V, K>::hashed_map()
+  : elements_(), buckets_(16, bucket{0, 0}), order_()
+{}
+
+template <typename V, typename K>
+cosmosis::hashed_map<V, K>::hashed_map(hashed_map&& other) noexcept
+  : hashed_map()
+{
+  swap(other);
+}
+
+template <typename V, typename K>
+cosmosis::hashed_map<V, K>&
+cosmosis::hashed_map<V, K>::operator=(hashed_map&& other) noexcept
+{
+  swap(other);
+  return *this;
+}
+
+template <typename V, typename K>
+void
+cosmosis::hashed_map<V, K>::swap(hashed_map& other) noexcept
+{
+  elements_.swap(other.elements_);
+  buckets_.swap(other.buckets_);
+  order_.swap(other.order_);
+}
+
+template <typename V, typename K>
+std::size_t
+cosmosis::hashed_map<V, K>::size() const
+{
+  return elements_.size();
+}
+
+template <typename V, typename K>
+bool
+cosmosis::hashed_map<V, K>::empty() const
+{
+  return elements_.empty();
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::iterator
+cosmosis::hashed_map<V, K>::begin()
+{
+  return elements_.begin();
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::iterator
+cosmosis::hashed_map<V, K>::end()
+{
+  return elements_.end();
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::const_iterator
+cosmosis::hashed_map<V, K>::begin() const
+{
+  return elements_.begin();
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::const_iterator
+cosmosis::hashed_map<V, K>::end() const
+{
+  return elements_.end();
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::iterator
+cosmosis::hashed_map<V, K>::find(K const& key)
+{
+  auto const& b = buckets_[probe(key, hash_key(key))];
+  if (b.pos == 0) return elements_.end();
+  return elements_.begin() + (b.pos - 1);
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::const_iterator
+cosmosis::hashed_map<V, K>::find(K const& key) const
+{
+  auto const& b = buckets_[probe(key, hash_key(key))];
+  if (b.pos == 0) return elements_.end();
+  return elements_.begin() + (b.pos - 1);
+}
+
+template <typename V, typename K>
+V&
+cosmosis::hashed_map<V, K>::operator[](K const& key)
+{
+  return emplace(key).first->second;
+}
+
+template <typename V, typename K>
+template <typename... Args>
+std::pair<typename cosmosis::hashed_map<V, K>::iterator, bool>
+cosmosis::hashed_map<V, K>::emplace(K const& key, Args&&... args)
+{
+  std::uint32_t const h = hash_key(key);
+  std::size_t i = probe(key, h);
+  if (buckets_[i].pos != 0)
+    return {elements_.begin() + (buckets_[i].pos - 1), false};
+
+  elements_.emplace_back(std::piecewise_construct,
+                         std::forward_as_tuple(key),
+                         std::forward_as_tuple(std::forward<Args>(args)...));
+  auto const pos = static_cast<std::uint32_t>(elements_.size());
+  order_.insert(find_order(key), pos - 1);
+  // Keep the load factor at or below one half.
+  if (2 * elements_.size() > buckets_.size())
+    rehash(2 * buckets_.size());
+  else
+    buckets_[i] = bucket{h, pos};
+  return {elements_.end() - 1, true};
+}
+
+template <typename V, typename K>
+void
+cosmosis::hashed_map<V, K>::erase(iterator it)
+{
+  std::size_t const victim = static_cast<std::size_t>(it - elements_.begin());
+  std::size_t i = probe(it->first, hash_key(it->first));
+
+  // Backward-shift deletion: pull later members of the probe chain into
+  // the hole so that no tombstones are needed.
+  std::size_t const m = mask();
+  std::size_t j = i;
+  for (;;) {
+    j = (j + 1) & m;
+    if (buckets_[j].pos == 0) break;
+    std::size_t const home = buckets_[j].hash & m;
+    bool const movable = (i <= j) ? (home <= i || home > j)
+                                  : (home <= i && home > j);
+    if (movable) {
+      buckets_[i] = buckets_[j];
+      i = j;
+    }
+  }
+  buckets_[i] = bucket{0, 0};
+  order_.erase(find_order(it->first));
+
+  // Move the last element into the vacated position.
+  std::size_t const last = elements_.size() - 1;
+  if (victim != last) {
+    auto& moved = elements_[last];
+    std::size_t k = probe(moved.first, hash_key(moved.first));
+    buckets_[k].pos = static_cast<std::uint32_t>(victim + 1);
+    *find_order(moved.first) = static_cast<std::uint32_t>(victim);
+    elements_[victim] = std::move(moved);
+  }
+  elements_.pop_back();
+}
+
+template <typename V, typename K>
+void
+cosmosis::hashed_map<V, K>::clear()
+{
+  elements_.clear();
+  std::fill(buckets_.begin(), buckets_.end(), bucket{0, 0});
+  order_.clear();
+}
+
+template <typename V, typename K>
+typename cosmosis::hashed_map<V, K>::value_type const&
+cosmosis::hashed_map<V, K>::nth(std::size_t i) const
+{
+  return elements_[order_[i]];
+}
+
+// Private member functions.
+
+template <typename V, typename K>
+std::size_t
+cosmosis::hashed_map<V, K>::mask() const
+{
+  return buckets_.size() - 1;
+}
+
+// Return the index of the bucket holding key, or of the empty bucket at
+// which the search for key stopped.
+template <typename V, typename K>
+std::size_t
+cosmosis::hashed_map<V, K>::probe(K const& key, std::uint32_t h) const
+{
+  std::size_t const m = mask();
+  std::size_t i = h & m;
+  while (buckets_[i].pos != 0) {
+    if (buckets_[i].hash == h && elements_[buckets_[i].pos - 1].first == key)
+      return i;
+    i = (i + 1) & m;
+  }
+  return i;
+}
+
+// Return the position in order_ of the element with the given key, or
+// of the first with a greater key if there is none.
+template <typename V, typename K>
+std::vector<std::uint32_t>::iterator
+cosmosis::hashed_map<V, K>::find_order(K const& key)
+{
+  return std::lower_bound(order_.begin(), order_.end(), key,
+                          [this](std::uint32_t e, K const& k) {
+                            return key_less(elements_[e].first, k);
+                          });
+}
+
+template <typename V, typename K>
+void
+cosmosis::hashed_map<V, K>::insert_bucket(std::uint32_t h, std::uint32_t pos)
+{
+  std::size_t const m = mask();
+  std::size_t i = h & m;
+  while (buckets_[i].pos != 0) i = (i + 1) & m;
+  buckets_[i] = bucket{h, pos};
+}
+
+template <typename V, typename K>
+void
+cosmosis::hashed_map<V, K>::rehash(std::size_t nbuckets)
+{
+  buckets_.assign(nbuckets, bucket{0, 0});
+  for (std::size_t k = 0; k != elements_.size(); ++k)
+    insert_bucket(hash_key(elements_[k].first),
+                  static_cast<std::uint32_t>(k + 1));
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include "name_table.hh"
+#include "hashed_map.hh"
+
+#include <cctype>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+
+namespace
+{
+  std::uint32_t const not_yet_folded = std::numeric_limits<std::uint32_t>::max();
+
+  // Each distinct spelling has its own id, and records the id of its
+  // lower-case form once that has been needed.
+  struct spelling
+  {
+    std::uint32_t exact;
+    std::uint32_t folded;
+  };
+
+  struct name_table
+  {
+    std::shared_timed_mutex mutex;
+    // The keys of spellings are never erased, so pointers to them
+    // remain valid as the table grows; names[i] is the spelling with
+    // id i.
+    cosmosis::hashed_map<spelling> spellings;
+    std::deque<std::string const*> names;
+  };
+
+  name_table& table()
+  {
+    static name_table t;
+    return t;
+  }
+
+  // The caller must hold an exclusive lock on t.
+  spelling& add(name_table& t, std::string const& name)
+  {
+    auto const next = static_cast<std::uint32_t>(t.names.size());
+    auto r = t.spellings.emplace(name, spelling{next, not_yet_folded});
+    if (r.second) t.names.push_back(&r.first->first);
+    return r.first->second;
+  }
+
+  std::uint32_t intern(std::string const& name, bool fold)
+  {
+    auto& t = table();
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(t.mutex);
+      auto i = t.spellings.find(name);
+      if (i != t.spellings.end())
+        {
+          std::uint32_t id = fold ? i->second.folded : i->second.exact;
+          if (id != not_yet_folded) return id;
+        }
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(t.mutex);
+    spelling& s = add(t, name);
+    if (not fold) return s.exact;
+    if (s.folded == not_yet_folded)
+      {
+        std::string lower(name);
+        for (auto& x : lower) x = std::tolower(x);
+        // References to elements of spellings survive insertion.
+        spelling& l = add(t, lower);
+        l.folded = l.exact;
+        s.folded = l.exact;
+      }
+    return s.folded;
+  }
+}
+
+cosmosis::name_id::name_id(std::string const& name)
+  : value_(intern(name, false))
+{}
+
+cosmosis::name_id::name_id(char const* name)
+  : value_(intern(name, false))
+{}
+
+cosmosis::name_id
+cosmosis::name_id::folded(std::string const& name)
+{
+  return name_id(intern(name, true));
+}
+
+std::string const&
+cosmosis::name_id::str() const
+{
+  auto& t = table();
+  std::shared_lock<std::shared_timed_mutex> lock(t.mutex);
+  return *t.names[value_];
+}
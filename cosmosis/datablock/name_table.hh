@@ -0,0 +1,65 @@
+#ifndef COSMOSIS_NAME_TABLE_HH
+#define COSMOSIS_NAME_TABLE_HH
+
+#include <cstdint>
+#include <string>
+
+namespace cosmosis
+{
+  // The name table is a process-wide set of interned strings. Each
+  // distinct string added to the table is given a small integer id; a
+  // name_id holds that id, and can be copied, compared and hashed in
+  // place of the string. Names are never removed from the table, so a
+  // name_id (and the reference returned by str()) remains valid for
+  // the life of the process.
+  //
+  // DataBlock and Section use name_ids for section and value names,
+  // so that each name is stored once no matter how many blocks (or
+  // copies of blocks) use it. DataBlock names are case-insensitive:
+  // name_id::folded gives the id of the lower-case form of a name, and
+  // the lower-casing is done only the first time a given spelling is
+  // seen.
+  //
+  // All the functions below may be called concurrently from several
+  // threads.
+  class name_id
+  {
+  public:
+    // Intern the given name exactly as spelled. These constructors are
+    // deliberately implicit, so that a string can be used wherever a
+    // name_id is expected.
+    name_id(std::string const& name);
+    name_id(char const* name);
+
+    // Return the id of the lower-case form of the given name.
+    static name_id folded(std::string const& name);
+
+    // Return the interned name.
+    std::string const& str() const;
+
+    std::uint32_t value() const { return value_; }
+
+    friend bool operator==(name_id a, name_id b) { return a.value_ == b.value_; }
+    friend bool operator!=(name_id a, name_id b) { return a.value_ != b.value_; }
+
+  private:
+    explicit name_id(std::uint32_t value) : value_(value) {}
+
+    std::uint32_t value_;
+  };
+
+  // hash_key and key_less let name_id be used as the key of a
+  // hashed_map. Names are ordered by their strings, not their ids.
+  inline std::uint32_t hash_key(name_id n)
+  {
+    std::uint32_t h = n.value() * 2654435761u;
+    return h ^ (h >> 16);
+  }
+
+  inline bool key_less(name_id a, name_id b)
+  {
+    return a.str() < b.str();
+  }
+}
+
+#endif
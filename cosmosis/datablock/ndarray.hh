@@ -1,9 +1,12 @@
 #ifndef COSMOSIS_NDARRAY_HH
 #define COSMOSIS_NDARRAY_HH
 
+#include <algorithm>
+#include <array>
 #include <exception>
 #include <functional>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 
 #include "exceptions.hh"
@@ -22,6 +25,20 @@ namespace cosmosis {
     }
   };
 
+  // NDArrayRangeException is thrown by the checked accessor of
+  // ndarray_view<T, N> when an index is not less than the corresponding
+  // extent.
+  class NDArrayRangeException : public cosmosis::Exception {
+  public:
+    virtual const char*
+    what() const throw()
+    {
+      return "NDArray index out of range";
+    }
+  };
+
+  template <typename T, std::size_t N> class ndarray_view;
+
   // Calculate the number of elements in an array with the given set of extents.
   inline std::size_t
   num_elements(std::vector<std::size_t> const& extents)
@@ -39,6 +56,7 @@ namespace cosmosis {
   template <typename T>
   class ndarray {
   public:
+    using value_type = T;
     using iterator = typename std::vector<T>::iterator;
     using const_iterator = typename std::vector<T>::const_iterator;
 
@@ -68,6 +86,11 @@ namespace cosmosis {
 
     std::vector<std::size_t> const& extents() const;
 
+    // Return a pointer to the first element; elements are stored
+    // contiguously, in row-major order.
+    T* data();
+    T const* data() const;
+
     // size() returns the number of elements in the array, which is the product
     // of all the extents.
     std::size_t size() const;
@@ -87,13 +110,99 @@ namespace cosmosis {
     template <typename... Args>
     T operator()(Args... indices) const;
 
+    // Return a view of the array with its rank fixed at N, which is
+    // much faster to index (see ndarray_view). Throws
+    // NDArrayIndexException if the array does not have N dimensions.
+    // The view refers to the elements of this array, and is
+    // invalidated by anything that invalidates its iterators.
+    template <std::size_t N>
+    ndarray_view<T, N> view();
+
+    template <std::size_t N>
+    ndarray_view<T const, N> view() const;
+
   private:
+    // block_pool takes the buffers of arrays it recycles.
+    friend class block_pool;
+
     std::vector<std::size_t> extents_;
     std::vector<T> data_;
 
     template <typename... Args>
-    size_t get_index(Args... indices);
+    size_t get_index(Args... indices) const;
   };
+
+  // ndarray_view<T, N> gives access to the elements of an array of
+  // rank N, stored contiguously in row-major order, that it does not
+  // own; T is const-qualified for a read-only view. With the rank
+  // known at compile time, and the strides computed once when the view
+  // is made, indexing needs no loop over the extents and no check of
+  // the number of indices, so it is suited to inner loops, such as
+  // interpolation in tables held in a DataBlock:
+  //
+  //   auto pk = block.view<nd_double_t>("matter_power_lin", "p_k").view<2>();
+  //   double x = pk(iz, ik);
+  //   for (double p : pk.row(iz)) { ... }
+  //
+  // Copying a view is cheap, and does not copy the elements.
+  template <typename T, std::size_t N>
+  class ndarray_view {
+  public:
+    static_assert(N > 0, "an ndarray_view must have at least one dimension");
+
+    using value_type = typename std::remove_const<T>::type;
+    using iterator = T*;
+
+    // Make a view of the elements starting at data, with the given
+    // extents.
+    ndarray_view(T* data, std::array<std::size_t, N> const& extents);
+
+    static constexpr std::size_t rank() { return N; }
+    std::size_t extent(std::size_t i) const { return extents_[i]; }
+    std::array<std::size_t, N> const& extents() const { return extents_; }
+    std::size_t size() const { return size_; }
+    T* data() const { return data_; }
+
+    iterator begin() const { return data_; }
+    iterator end() const { return data_ + size_; }
+
+    // Unchecked element access: the caller must pass N indices, each
+    // less than the corresponding extent.
+    template <typename... Args>
+    T& operator()(Args... indices) const;
+
+    // Checked element access: throws NDArrayRangeException if an index
+    // is out of range.
+    template <typename... Args>
+    T& at(Args... indices) const;
+
+    // Return a view of the contiguous row of elements selected by the
+    // first N-1 indices, e.g. row(i) of a 2-D view holds the elements
+    // (i, 0), (i, 1), ... The indices are not checked.
+    template <typename... Args>
+    ndarray_view<T, 1> row(Args... indices) const;
+
+  private:
+    template <typename... Args>
+    static std::array<std::size_t, sizeof...(Args)> to_array(Args... indices);
+
+    T* data_;
+    std::array<std::size_t, N> extents_;
+    std::array<std::size_t, N> strides_;
+    std::size_t size_;
+  };
+
+  // Return the offset of the element with the given indices from the
+  // start of a row-major array with the given strides.
+  template <std::size_t N>
+  constexpr std::size_t
+  offset_of(std::array<std::size_t, N> const& strides,
+            std::array<std::size_t, N> const& indices)
+  {
+    std::size_t result = 0;
+    for (std::size_t i = 0; i != N; ++i) result += strides[i] * indices[i];
+    return result;
+  }
 }
 
 template <typename T>
@@ -171,6 +280,20 @@ cosmosis::ndarray<T>::extents() const
   return extents_;
 }
 
+template <typename T>
+T*
+cosmosis::ndarray<T>::data()
+{
+  return data_.data();
+}
+
+template <typename T>
+T const*
+cosmosis::ndarray<T>::data() const
+{
+  return data_.data();
+}
+
 template <typename T>
 std::size_t
 cosmosis::ndarray<T>::size() const
@@ -194,14 +317,35 @@ cosmosis::ndarray<T>::operator()(Args... indices) const
   return data_[get_index(indices...)];
 }
 
+template <typename T>
+template <std::size_t N>
+cosmosis::ndarray_view<T, N>
+cosmosis::ndarray<T>::view()
+{
+  if (ndims() != N) throw NDArrayIndexException();
+  std::array<std::size_t, N> extents{};
+  std::copy(extents_.begin(), extents_.end(), extents.begin());
+  return ndarray_view<T, N>(data_.data(), extents);
+}
+
+template <typename T>
+template <std::size_t N>
+cosmosis::ndarray_view<T const, N>
+cosmosis::ndarray<T>::view() const
+{
+  if (ndims() != N) throw NDArrayIndexException();
+  std::array<std::size_t, N> extents{};
+  std::copy(extents_.begin(), extents_.end(), extents.begin());
+  return ndarray_view<T const, N>(data_.data(), extents);
+}
+
 // Private member functions.
 
-// TODO: Look at generated assembly code to see if replacing the for loop with
-// compile-time recursion makes any difference.
+// ndarray_view<T, N> is much faster to index; see ndarray_bench.
 template <typename T>
 template <typename... Args>
 std::size_t
-cosmosis::ndarray<T>::get_index(Args... indices)
+cosmosis::ndarray<T>::get_index(Args... indices) const
 {
   constexpr size_t NDIMS = sizeof...(indices);
   if (NDIMS != ndims())
@@ -217,4 +361,57 @@ cosmosis::ndarray<T>::get_index(Args... indices)
   return index1D;
 }
 
+template <typename T, std::size_t N>
+cosmosis::ndarray_view<T, N>::ndarray_view(T* data,
+                                           std::array<std::size_t, N> const& extents)
+  : data_(data), extents_(extents), strides_(), size_(1)
+{
+  for (std::size_t i = N; i-- != 0;) {
+    strides_[i] = size_;
+    size_ *= extents_[i];
+  }
+}
+
+template <typename T, std::size_t N>
+template <typename... Args>
+std::array<std::size_t, sizeof...(Args)>
+cosmosis::ndarray_view<T, N>::to_array(Args... indices)
+{
+  return {{static_cast<std::size_t>(indices)...}};
+}
+
+template <typename T, std::size_t N>
+template <typename... Args>
+T&
+cosmosis::ndarray_view<T, N>::operator()(Args... indices) const
+{
+  static_assert(sizeof...(Args) == N, "wrong number of indices to ndarray_view");
+  return data_[offset_of<N>(strides_, to_array(indices...))];
+}
+
+template <typename T, std::size_t N>
+template <typename... Args>
+T&
+cosmosis::ndarray_view<T, N>::at(Args... indices) const
+{
+  static_assert(sizeof...(Args) == N, "wrong number of indices to ndarray_view");
+  auto const idx = to_array(indices...);
+  for (std::size_t i = 0; i != N; ++i)
+    if (idx[i] >= extents_[i]) throw NDArrayRangeException();
+  return data_[offset_of<N>(strides_, idx)];
+}
+
+template <typename T, std::size_t N>
+template <typename... Args>
+cosmosis::ndarray_view<T, 1>
+cosmosis::ndarray_view<T, N>::row(Args... indices) const
+{
+  static_assert(sizeof...(Args) == N - 1, "row takes one index fewer than the rank");
+  std::array<std::size_t, N> idx{};
+  auto const leading = to_array(indices...);
+  std::copy(leading.begin(), leading.end(), idx.begin());
+  return ndarray_view<T, 1>(data_ + offset_of<N>(strides_, idx),
+                            std::array<std::size_t, 1>{{extents_[N - 1]}});
+}
+
 #endif
@@ -0,0 +1,436 @@
+// The CPython extension module cosmosis_py._block, which gets, puts
+// and replaces values of a DataBlock, and lists its keys, by calling
+// the C++ interface directly. It is used by the DataBlock class of
+// cosmosis_py/block.py, which would otherwise go through ctypes and
+// the C interface: the checking and conversion of arguments that
+// ctypes does on each call, and the several C calls needed for one
+// Python access, cost far more than the access itself.
+//
+// Each function takes the address of the DataBlock (the _ptr of the
+// Python object) as its first argument. Values of the types the
+// ctypes code handles in the common way are dealt with here; for
+// anything else (string and complex arrays, unusual numpy types,
+// non-ASCII names) a function returns NotImplemented, and block.py
+// falls back to ctypes. Failures raise the exception made by the
+// factory given to set_error_factory from the DATABLOCK_STATUS, the
+// section and the name, as the ctypes code does.
+//
+// The module is linked against libcosmosis.so, and must use the same
+// copy of it as ctypes does; it finds it in the directory above its
+// own.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include "datablock.hh"
+#include "section.hh"
+#include "entry.hh"
+#include "ndarray.hh"
+
+#include <algorithm>
+#include <climits>
+#include <complex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+using cosmosis::DataBlock;
+using cosmosis::Section;
+using cosmosis::Entry;
+using cosmosis::complex_t;
+using cosmosis::ndarray;
+using std::string;
+using std::vector;
+
+namespace
+{
+  PyObject* error_factory = nullptr;
+
+  // The arguments common to all the functions: the block, and the
+  // section and name both as Python and as C++ strings.
+  struct key
+  {
+    DataBlock* block;
+    PyObject* section_obj;
+    PyObject* name_obj;
+    string section;
+    string name;
+  };
+
+  bool is_ascii(PyObject* s)
+  {
+    return PyUnicode_CheckExact(s) && PyUnicode_IS_ASCII(s);
+  }
+
+  // Fill in k from the first three arguments. Return false, with a
+  // Python error set if the block is not an address, or else with none
+  // if the names are left to the ctypes code.
+  bool parse_key(PyObject* const* args, key& k)
+  {
+    k.block = static_cast<DataBlock*>(PyLong_AsVoidPtr(args[0]));
+    if (k.block == nullptr) {
+      if (not PyErr_Occurred())
+        PyErr_SetString(PyExc_ValueError, "null DataBlock");
+      return false;
+    }
+    k.section_obj = args[1];
+    k.name_obj = args[2];
+    if (not is_ascii(k.section_obj) || not is_ascii(k.name_obj)) return false;
+    k.section = PyUnicode_AsUTF8(k.section_obj);
+    k.name = PyUnicode_AsUTF8(k.name_obj);
+    return true;
+  }
+
+  PyObject* not_implemented()
+  {
+    Py_RETURN_NOTIMPLEMENTED;
+  }
+
+  PyObject* raise_status(DATABLOCK_STATUS status, key const& k)
+  {
+    if (error_factory == nullptr) {
+      PyErr_Format(PyExc_RuntimeError, "DataBlock error %d for %S in section %S",
+                   static_cast<int>(status), k.name_obj, k.section_obj);
+      return nullptr;
+    }
+    PyObject* e = PyObject_CallFunction(error_factory, "iOO", static_cast<int>(status),
+                                        k.section_obj, k.name_obj);
+    if (e == nullptr) return nullptr;
+    PyErr_SetObject(reinterpret_cast<PyObject*>(Py_TYPE(e)), e);
+    Py_DECREF(e);
+    return nullptr;
+  }
+
+  // Call f, translating C++ exceptions into the Python errors the C
+  // interface would give.
+  template <class F>
+  PyObject* guarded(key const& k, F f)
+  {
+    try { return f(); }
+    catch (DataBlock::BadDataBlockAccess const&) { return raise_status(DBS_SECTION_NOT_FOUND, k); }
+    catch (Section::BadSectionAccess const&) { return raise_status(DBS_NAME_NOT_FOUND, k); }
+    catch (Entry::BadEntry const&) { return raise_status(DBS_WRONG_VALUE_TYPE, k); }
+    catch (std::bad_alloc const&) { return PyErr_NoMemory(); }
+    catch (...) { return raise_status(DBS_LOGIC_ERROR, k); }
+  }
+
+  PyObject* to_python(int x) { return PyLong_FromLong(x); }
+  PyObject* to_python(bool x) { return PyBool_FromLong(x); }
+  PyObject* to_python(double x) { return PyFloat_FromDouble(x); }
+  PyObject* to_python(complex_t const& x) { return PyComplex_FromDoubles(x.real(), x.imag()); }
+  PyObject* to_python(string const& x) { return PyUnicode_DecodeUTF8(x.data(), x.size(), nullptr); }
+
+  template <class T> struct npy_type;
+  template <> struct npy_type<int> { static int const value = NPY_INT; };
+  template <> struct npy_type<double> { static int const value = NPY_DOUBLE; };
+
+  template <class T>
+  PyObject* get_scalar(key const& k)
+  {
+    T val;
+    DATABLOCK_STATUS status = k.block->get_val(k.section, k.name, val);
+    if (status != DBS_SUCCESS) return raise_status(status, k);
+    return to_python(val);
+  }
+
+  // Return a new numpy array holding a copy of the values.
+  template <class T>
+  PyObject* new_array(T const* data, std::size_t n, vector<npy_intp>& dims)
+  {
+    PyObject* a = PyArray_SimpleNew(static_cast<int>(dims.size()), dims.data(), npy_type<T>::value);
+    if (a != nullptr)
+      std::copy(data, data + n, static_cast<T*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(a))));
+    return a;
+  }
+
+  // The arrays are copied while the section is locked, so that other
+  // threads may write to it meanwhile. Making a numpy array runs no
+  // Python code, so the GIL is kept until the lock is released.
+  template <class T>
+  PyObject* get_vector(key const& k)
+  {
+    return k.block->view<vector<T>>(k.section, k.name, [](vector<T> const& v) {
+        vector<npy_intp> dims{static_cast<npy_intp>(v.size())};
+        return new_array(v.data(), v.size(), dims);
+      });
+  }
+
+  template <class T>
+  PyObject* get_ndarray(key const& k)
+  {
+    return k.block->view<ndarray<T>>(k.section, k.name, [](ndarray<T> const& a) {
+        vector<npy_intp> dims(a.extents().begin(), a.extents().end());
+        return new_array(a.data(), a.size(), dims);
+      });
+  }
+
+  enum class mode { put, replace };
+
+  template <class T>
+  DATABLOCK_STATUS store(key const& k, mode m, T&& val)
+  {
+    if (m == mode::put) return k.block->put_val(k.section, k.name, std::forward<T>(val));
+    return k.block->replace_val(k.section, k.name, std::forward<T>(val));
+  }
+
+  // Store the elements of the C-contiguous array a, as the C interface
+  // does: a 1-dimensional array as a vector and any other as an
+  // ndarray, overwriting the elements of an existing array of the same
+  // shape in place when replacing.
+  template <class T>
+  DATABLOCK_STATUS store_array(key const& k, mode m, PyArrayObject* a)
+  {
+    T const* data = static_cast<T const*>(PyArray_DATA(a));
+    int const ndims = PyArray_NDIM(a);
+    vector<int> extents(PyArray_DIMS(a), PyArray_DIMS(a) + ndims);
+    std::size_t const n = PyArray_SIZE(a);
+    DataBlock* p = k.block;
+    if (ndims == 1) {
+      if (m == mode::replace &&
+          p->overwrite_val<vector<T>>(k.section, k.name, data, ndims, extents.data()) == DBS_SUCCESS)
+        return DBS_SUCCESS;
+      return store(k, m, p->make_vector(data, n));
+    }
+    if (m == mode::replace &&
+        p->overwrite_val<ndarray<T>>(k.section, k.name, data, ndims, extents.data()) == DBS_SUCCESS)
+      return DBS_SUCCESS;
+    vector<std::size_t> local_extents(extents.begin(), extents.end());
+    return store(k, m, ndarray<T>(p->make_vector(data, n), std::move(local_extents)));
+  }
+
+  // Return value as a C-contiguous array of int or double, if it is an
+  // array, list or tuple that the ctypes code would store as one, and
+  // otherwise nullptr (with no Python error set).
+  PyArrayObject* as_array(PyObject* value)
+  {
+    if (not PyArray_Check(value) && not PyList_Check(value) && not PyTuple_Check(value))
+      return nullptr;
+    PyObject* obj = PyArray_FROM_O(value);
+    if (obj == nullptr) {
+      PyErr_Clear();
+      return nullptr;
+    }
+    PyArrayObject* a = reinterpret_cast<PyArrayObject*>(obj);
+    char const kind = PyArray_DESCR(a)->kind;
+    bool ok = (kind == 'i' || kind == 'f') && PyArray_NDIM(a) > 0 && PyArray_SIZE(a) > 0;
+    for (int i = 0; ok && i != PyArray_NDIM(a); ++i) ok = PyArray_DIMS(a)[i] <= INT_MAX;
+    if (not ok) {
+      Py_DECREF(obj);
+      return nullptr;
+    }
+    PyObject* res = PyArray_FROM_OTF(obj, kind == 'i' ? NPY_INT : NPY_DOUBLE,
+                                     NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    Py_DECREF(obj);
+    if (res == nullptr) PyErr_Clear();
+    return reinterpret_cast<PyArrayObject*>(res);
+  }
+
+  // Return the value of an exact int, or of a numpy int32 or int64, in
+  // x. Return false if value is not one of those, or (since ctypes
+  // truncates those) does not fit in an int.
+  bool as_int(PyObject* value, int& x)
+  {
+    if (not PyLong_CheckExact(value) && not PyArray_IsScalar(value, Int32) &&
+        not PyArray_IsScalar(value, Int64))
+      return false;
+    PyObject* i = PyNumber_Index(value);
+    if (i == nullptr) {
+      PyErr_Clear();
+      return false;
+    }
+    int overflow;
+    long const v = PyLong_AsLongAndOverflow(i, &overflow);
+    Py_DECREF(i);
+    if (overflow != 0 || v < INT_MIN || v > INT_MAX) return false;
+    x = static_cast<int>(v);
+    return true;
+  }
+
+  PyObject* store_value(key const& k, mode m, PyObject* value)
+  {
+    return guarded(k, [&]() -> PyObject* {
+        DATABLOCK_STATUS status;
+        int i;
+        if (PyBool_Check(value))
+          status = store(k, m, value == Py_True);
+        else if (as_int(value, i))
+          status = store(k, m, i);
+        else if (PyFloat_CheckExact(value) || PyArray_IsScalar(value, Double) ||
+                 PyArray_IsScalar(value, Float))
+          {
+            double const x = PyFloat_AsDouble(value);
+            if (x == -1.0 && PyErr_Occurred()) return nullptr;
+            status = store(k, m, x);
+          }
+        else if (PyComplex_CheckExact(value))
+          status = store(k, m, complex_t(PyComplex_RealAsDouble(value), PyComplex_ImagAsDouble(value)));
+        else if (is_ascii(value))
+          status = store(k, m, string(PyUnicode_AsUTF8(value)));
+        else {
+          PyArrayObject* a = as_array(value);
+          if (a == nullptr) return not_implemented();
+          if (PyArray_TYPE(a) == NPY_INT)
+            status = store_array<int>(k, m, a);
+          else
+            status = store_array<double>(k, m, a);
+          Py_DECREF(a);
+        }
+        if (status != DBS_SUCCESS) return raise_status(status, k);
+        Py_RETURN_NONE;
+      });
+  }
+
+  bool check_nargs(char const* function, Py_ssize_t nargs, Py_ssize_t min, Py_ssize_t max)
+  {
+    if (nargs >= min && nargs <= max) return true;
+    PyErr_Format(PyExc_TypeError, "%s takes %zd to %zd arguments (%zd given)",
+                 function, min, max, nargs);
+    return false;
+  }
+
+  PyObject* block_get(PyObject*, PyObject* const* args, Py_ssize_t nargs)
+  {
+    if (not check_nargs("get", nargs, 3, 3)) return nullptr;
+    key k;
+    if (not parse_key(args, k)) return PyErr_Occurred() ? nullptr : not_implemented();
+    return guarded(k, [&]() -> PyObject* {
+        datablock_type_t t;
+        DATABLOCK_STATUS status = k.block->get_type(k.section, k.name, t);
+        if (status != DBS_SUCCESS) return raise_status(status, k);
+        switch (t)
+          {
+          case DBT_INT: return get_scalar<int>(k);
+          case DBT_BOOL: return get_scalar<bool>(k);
+          case DBT_DOUBLE: return get_scalar<double>(k);
+          case DBT_COMPLEX: return get_scalar<complex_t>(k);
+          case DBT_STRING: return get_scalar<string>(k);
+          case DBT_INT1D: return get_vector<int>(k);
+          case DBT_DOUBLE1D: return get_vector<double>(k);
+          case DBT_INTND: return get_ndarray<int>(k);
+          case DBT_DOUBLEND: return get_ndarray<double>(k);
+          default: return not_implemented();
+          }
+      });
+  }
+
+  PyObject* block_store(char const* function, mode m, PyObject* const* args, Py_ssize_t nargs)
+  {
+    if (not check_nargs(function, nargs, 4, 4)) return nullptr;
+    key k;
+    if (not parse_key(args, k)) return PyErr_Occurred() ? nullptr : not_implemented();
+    return store_value(k, m, args[3]);
+  }
+
+  PyObject* block_put(PyObject*, PyObject* const* args, Py_ssize_t nargs)
+  {
+    return block_store("put", mode::put, args, nargs);
+  }
+
+  PyObject* block_replace(PyObject*, PyObject* const* args, Py_ssize_t nargs)
+  {
+    return block_store("replace", mode::replace, args, nargs);
+  }
+
+  PyObject* block_set(PyObject*, PyObject* const* args, Py_ssize_t nargs)
+  {
+    if (not check_nargs("set", nargs, 4, 4)) return nullptr;
+    key k;
+    if (not parse_key(args, k)) return PyErr_Occurred() ? nullptr : not_implemented();
+    // get_type, unlike has_val, does not log the check; the put or
+    // replace that follows is logged.
+    datablock_type_t t;
+    mode const m = k.block->get_type(k.section, k.name, t) == DBS_SUCCESS ? mode::replace : mode::put;
+    return store_value(k, m, args[3]);
+  }
+
+  // Append the keys of the named section to the list, with the given
+  // Python object as the section of each.
+  bool append_keys(PyObject* list, DataBlock const* p, string const& section, PyObject* section_obj)
+  {
+    int const n = p->num_values(section);
+    for (int j = 0; j < n; ++j) {
+      string const& name = p->value_name(section, j);
+      PyObject* name_obj = PyUnicode_DecodeUTF8(name.data(), name.size(), nullptr);
+      if (name_obj == nullptr) return false;
+      PyObject* pair = PyTuple_Pack(2, section_obj, name_obj);
+      Py_DECREF(name_obj);
+      if (pair == nullptr) return false;
+      int const rc = PyList_Append(list, pair);
+      Py_DECREF(pair);
+      if (rc != 0) return false;
+    }
+    return true;
+  }
+
+  PyObject* block_keys(PyObject*, PyObject* const* args, Py_ssize_t nargs)
+  {
+    if (not check_nargs("keys", nargs, 1, 2)) return nullptr;
+    DataBlock const* p = static_cast<DataBlock const*>(PyLong_AsVoidPtr(args[0]));
+    if (p == nullptr) {
+      if (not PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "null DataBlock");
+      return nullptr;
+    }
+    PyObject* section_obj = nargs == 2 ? args[1] : Py_None;
+    if (section_obj != Py_None && not is_ascii(section_obj)) return not_implemented();
+    PyObject* list = PyList_New(0);
+    if (list == nullptr) return nullptr;
+    bool ok = true;
+    try {
+      if (section_obj != Py_None)
+        ok = append_keys(list, p, PyUnicode_AsUTF8(section_obj), section_obj);
+      else
+        for (std::size_t i = 0, n = p->num_sections(); ok && i != n; ++i) {
+          string const& section = p->section_name(i);
+          PyObject* s = PyUnicode_DecodeUTF8(section.data(), section.size(), nullptr);
+          ok = s != nullptr && append_keys(list, p, section, s);
+          Py_XDECREF(s);
+        }
+    }
+    catch (std::bad_alloc const&) { ok = false; PyErr_NoMemory(); }
+    catch (...) { ok = false; PyErr_SetString(PyExc_RuntimeError, "Cosmosis internal error listing DataBlock keys"); }
+    if (not ok) {
+      Py_DECREF(list);
+      return nullptr;
+    }
+    return list;
+  }
+
+  PyObject* set_error_factory(PyObject*, PyObject* factory)
+  {
+    Py_INCREF(factory);
+    Py_XSETREF(error_factory, factory);
+    Py_RETURN_NONE;
+  }
+
+  PyMethodDef methods[] = {
+    {"get", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(block_get)), METH_FASTCALL,
+     "get(ptr, section, name): return the value, as DataBlock.get does."},
+    {"put", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(block_put)), METH_FASTCALL,
+     "put(ptr, section, name, value): add a value, as DataBlock.put does."},
+    {"replace", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(block_replace)), METH_FASTCALL,
+     "replace(ptr, section, name, value): replace a value, as DataBlock.replace does."},
+    {"set", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(block_set)), METH_FASTCALL,
+     "set(ptr, section, name, value): replace a value if there is one, or else add it."},
+    {"keys", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(block_keys)), METH_FASTCALL,
+     "keys(ptr, section=None): return the (section, name) pairs, as DataBlock.keys does."},
+    {"set_error_factory", set_error_factory, METH_O,
+     "Set the function called with (status, section, name) to make the exception for a failure."},
+    {nullptr, nullptr, 0, nullptr}
+  };
+
+  PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "_block",
+    "Direct access to DataBlock values, used by cosmosis_py.block.",
+    -1, methods, nullptr, nullptr, nullptr, nullptr
+  };
+}
+
+PyMODINIT_FUNC
+PyInit__block()
+{
+  import_array();
+  return PyModule_Create(&module);
+}
@@ -1,43 +1,80 @@
 #include "section.hh"
 
+#include <algorithm>
+#include <atomic>
+
 using std::string;
 
+namespace
+{
+  std::atomic<std::uint64_t> last_version{0};
+}
+
+std::uint64_t
+cosmosis::Section::next_version()
+{
+  return last_version.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+cosmosis::Section::Section() :
+  vals_(std::make_shared<map_type>()),
+  version_(next_version())
+{}
+
+cosmosis::Section::Section(std::shared_ptr<map_type> storage) :
+  vals_(std::move(storage)),
+  version_(next_version())
+{}
+
 bool
-cosmosis::Section::has_val(string const& name) const
+cosmosis::Section::has_val(name_id name) const
 {
-  return vals_.find(name) != vals_.end();
+  return vals_->find(name) != vals_->end();
 }
 
 std::size_t
 cosmosis::Section::number_values() const
 {
-  return vals_.size();
+  return vals_->size();
 }
 
 int
-cosmosis::Section::get_size(string const& name) const
+cosmosis::Section::get_size(name_id name) const
 {
-  auto ival = vals_.find(name);
-  if (ival == vals_.end()) return -1;
+  auto ival = vals_->find(name);
+  if (ival == vals_->end()) return -1;
   return ival->second.size();
 }
 
 std::string const& cosmosis::Section::value_name(std::size_t i) const
 {
   if (i >= number_values()) throw BadSectionAccess();
-  auto isec = vals_.begin();
-  std::advance(isec, i);
-  return isec->first;
+  return vals_->nth(i).first.str();
+}
+
+cosmosis::Entry*
+cosmosis::Section::find_entry(name_id name)
+{
+  unshare_for_write(&name);
+  auto ival = vals_->find(name);
+  return (ival == vals_->end()) ? nullptr : &ival->second;
+}
+
+cosmosis::Entry const*
+cosmosis::Section::find_entry(name_id name) const
+{
+  auto ival = vals_->find(name);
+  return (ival == vals_->end()) ? nullptr : &ival->second;
 }
 
 DATABLOCK_STATUS 
-cosmosis::Section::get_type(std::string const&name, datablock_type_t &t) const
+cosmosis::Section::get_type(name_id name, datablock_type_t &t) const
 {
-  auto ival = vals_.find(name);
+  auto ival = vals_->find(name);
   // If not found, use unkown
   t = DBT_UNKNOWN;
   // Find the right entry
-  if (ival == vals_.end()) return DBS_NAME_NOT_FOUND;
+  if (ival == vals_->end()) return DBS_NAME_NOT_FOUND;
 
   if      (ival->second.is<int>())          t = DBT_INT;
   else if (ival->second.is<bool>())         t = DBT_BOOL;
@@ -54,3 +91,78 @@ cosmosis::Section::get_type(std::string const&name, datablock_type_t &t) const
   else return DBS_LOGIC_ERROR;
   return DBS_SUCCESS;
 }
+
+bool
+cosmosis::Section::shared() const
+{
+  return vals_.use_count() > 1;
+}
+
+void
+cosmosis::Section::unshare()
+{
+  if (shared())
+    {
+      vals_ = std::make_shared<map_type>(*vals_);
+      pins_.reset();
+      version_ = next_version();
+    }
+}
+
+void
+cosmosis::Section::unshare_for_write(name_id const* name)
+{
+  long const users = vals_.use_count();
+  if (users == 1) return;
+  if (pins_)
+    {
+      // A pin adds its name after taking its share of the storage, and
+      // removes it before giving it back, so the count of others below
+      // is never too low.
+      std::lock_guard<std::mutex> lock(pins_->mutex);
+      auto const& names = pins_->names;
+      if ((name == nullptr || std::find(names.begin(), names.end(), *name) == names.end()) &&
+          users - static_cast<long>(names.size()) == 1)
+        return;
+    }
+  unshare();
+}
+
+std::shared_ptr<cosmosis::Entry const>
+cosmosis::Section::pin(name_id name)
+{
+  auto ival = vals_->find(name);
+  if (ival == vals_->end()) return nullptr;
+  if (not pins_) pins_ = std::make_shared<pin_list>();
+  std::shared_ptr<map_type> storage = vals_;
+  std::shared_ptr<pin_list> pins = pins_;
+  {
+    std::lock_guard<std::mutex> lock(pins->mutex);
+    pins->names.push_back(name);
+  }
+  return std::shared_ptr<Entry const>(&ival->second,
+    [storage, pins, name](Entry const*)
+    {
+      std::lock_guard<std::mutex> lock(pins->mutex);
+      pins->names.erase(std::find(pins->names.begin(), pins->names.end(), name));
+    });
+}
+
+void const*
+cosmosis::Section::storage() const
+{
+  return vals_.get();
+}
+
+void
+cosmosis::Section::changed_since(std::uint64_t g, std::vector<name_id>& names) const
+{
+  for (auto const& v : *vals_)
+    if (generation_ > g || v.second.generation() > g) names.push_back(v.first);
+}
+
+void
+cosmosis::Section::touch()
+{
+  generation_ = Entry::next_generation();
+}
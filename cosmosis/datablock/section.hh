@@ -1,12 +1,19 @@
 #ifndef COSMOSIS_SECTION_HH
 #define COSMOSIS_SECTION_HH
 
+#include <cstdint>
 #include <initializer_list>
-#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 #include "exceptions.hh"
 #include "entry.hh"
+#include "hashed_map.hh"
+#include "name_table.hh"
 #include "datablock_status.h"
 #include "datablock_types.h"
 
@@ -16,6 +23,17 @@ namespace cosmosis
   // provides 'get', 'put', and 'replace' ability for each type of
   // quantity.
   //
+  // Values are identified by name_id; a string may be passed wherever
+  // a name_id is expected, and is used exactly as spelled. (Case
+  // folding is done by DataBlock.)
+  //
+  // Copying a Section is cheap: the copy shares the stored values with
+  // the original, and the values are duplicated only when one of the
+  // Sections sharing them is modified (copy-on-write). A single value
+  // can be kept instead with pin(), which shares the storage too, but
+  // causes it to be duplicated only when the pinned value itself is
+  // modified.
+  //
   // Original author: Marc Paterno (paterno@fnal.gov)
 
   class Section
@@ -23,14 +41,35 @@ namespace cosmosis
   public:
     struct BadSectionAccess : cosmosis::Exception { }; // used for exceptions
 
+    Section();
+
+    // Copies share their values. Moving a Section copies it, since the
+    // source must remain usable and copying is cheap.
+    Section(Section const&) = default;
+    Section& operator=(Section const&) = default;
+
+    // The value given to put_val or replace_val is copied into the
+    // Section, or moved if it is an rvalue.
     template <class T>
-    DATABLOCK_STATUS put_val(std::string const& name, T const& value);
+    DATABLOCK_STATUS put_val(name_id name, T&& value);
 
     template <class T>
-    DATABLOCK_STATUS replace_val(std::string const& name, T const& value);
+    DATABLOCK_STATUS replace_val(name_id name, T&& value);
+
+    // If the value with the given name is an array of type A with the
+    // given extents, overwrite its elements in place with the values
+    // starting at 'first' (see Entry::overwrite) and return
+    // DBS_SUCCESS. Otherwise return DBS_NAME_NOT_FOUND,
+    // DBS_WRONG_VALUE_TYPE or DBS_EXTENTS_MISMATCH, and leave the value
+    // unchanged.
+    template <class A>
+    DATABLOCK_STATUS overwrite_val(name_id name,
+                                   typename A::value_type const* first,
+                                   int ndims,
+                                   int const* extents);
 
     // return true if we have a value of the right type for the given name.
-    template <class T> bool has_value(std::string const& name) const;
+    template <class T> bool has_value(name_id name) const;
 
     //Return the number of items stored in this section
     std::size_t number_values() const;
@@ -39,17 +78,17 @@ namespace cosmosis
     // or if the parameter is not an array type. Return -2 if the array
     // length is longer than MAXINT. Otherwise, return the length of the
     // array.
-    int get_size(std::string const& name) const;
+    int get_size(name_id name) const;
     
     DATABLOCK_STATUS 
-    get_type(std::string const&name, datablock_type_t &t) const;
+    get_type(name_id name, datablock_type_t &t) const;
 
     // Return DBS_SUCCESS if the value with the given name is of the
     // given type, and and error if there is no such name or the value
     // is not of the given type. If returning DBS_SUCCESS, the value of
     // v is set; otherwise the value is not defined.
     template <class T>
-    DATABLOCK_STATUS get_val(std::string const& name, T& v) const;
+    DATABLOCK_STATUS get_val(name_id name, T& v) const;
 
     // Return DBS_SUCCESS if the value with the given name is of the
     // given type, or if there is no value with the given name. Return
@@ -58,10 +97,10 @@ namespace cosmosis
     // default; otherwise, set v to be the value associated with the
     // name.
     template <class T>
-    DATABLOCK_STATUS get_val(std::string const& name, T const& def, T& v) const;
+    DATABLOCK_STATUS get_val(name_id name, T const& def, T& v) const;
 
     // Return true if we have a value of any type with the given name.
-    bool has_val(std::string const& name) const;
+    bool has_val(name_id name) const;
 
     // Return DBS_SUCCESS if the value with the given name is of the
     // given type, and is an array, and an error if there is no such
@@ -69,7 +108,7 @@ namespace cosmosis
     // returning DBS_SUCESS, set 'extents' to carry the extent of each
     // dimension of the array.
     template <class T>
-    DATABLOCK_STATUS get_array_shape(std::string const& name,
+    DATABLOCK_STATUS get_array_shape(name_id name,
                                      std::vector<std::size_t>& extents) const;
 
     //Return the name of the key at position i
@@ -78,24 +117,96 @@ namespace cosmosis
     // The view functions provide readonly access to the data in the
     // Section without copying the data. The reference returned by a
     // call to view is invalidated if any replace function is called for
-    // the same name. Throws BadSectionAccess if the name can't be
+    // the same name, or if any value is put or replaced while the
+    // Section shares its values with another. Throws BadSectionAccess if the name can't be
     // found, and BadEntry if the contained value is the wrong type.
     template <class T>
-    T const& view(std::string const& name) const;
+    T const& view(name_id name) const;
+
+    // Return a pointer to the Entry with the given name, or nullptr if
+    // there is no such Entry. The pointer remains valid until the
+    // Section is destroyed or assigned to, or its values are
+    // duplicated by unshare(); adding values does not invalidate it.
+    // The non-const version calls unshare() first.
+    Entry* find_entry(name_id name);
+    Entry const* find_entry(name_id name) const;
+
+    // Return a pointer to the value with the given name, or nullptr if
+    // there is none, which keeps the value alive and unchanged for as
+    // long as any copy of the pointer exists, whatever becomes of the
+    // Section. Values may still be put into the Section, and other
+    // values replaced, without duplicating the stored values.
+    std::shared_ptr<Entry const> pin(name_id name);
+
+    // Return true if the stored values are shared with another Section,
+    // or a pin.
+    bool shared() const;
+
+    // Give this Section its own copy of the stored values, if they are
+    // shared. This is done automatically by every modifying function.
+    void unshare();
+
+    // Return an address identifying the storage currently holding the
+    // values; it changes when unshare() duplicates them.
+    void const* storage() const;
+
+    // Return a number identifying the storage currently holding the
+    // values. Unlike the address returned by storage(), it is never
+    // reused: each new storage, whether made by unshare(), taken from a
+    // pool or newly allocated, gets a number not used before. Copies
+    // sharing their storage have the same version.
+    std::uint64_t version() const { return version_; }
+
+    // Append to 'names' the names of the values set after generation g
+    // (see Entry::generation), in the order they were put. If the
+    // Section itself has been touched since then, that is all of them.
+    void changed_since(std::uint64_t g, std::vector<name_id>& names) const;
+
+    // Mark every value as set now, as when the Section is copied to a
+    // new name.
+    void touch();
 
   private:
-    std::map<std::string, Entry> vals_;
+    // block_pool recycles the storage of Sections.
+    friend class block_pool;
+
+    typedef hashed_map<Entry, name_id> map_type;
+
+    // Create a Section using the given storage, which must be empty.
+    explicit Section(std::shared_ptr<map_type> storage);
+
+    // The names of the pinned values of one storage, one for each pin.
+    struct pin_list
+    {
+      std::mutex mutex;
+      std::vector<name_id> names;
+    };
+
+    // Return a version number not returned before.
+    static std::uint64_t next_version();
+
+    // Call unshare(), unless the only others using the stored values
+    // are pins of values other than the one named, which is about to
+    // be modified. A null name stands for a value about to be added.
+    void unshare_for_write(name_id const* name);
+
+    std::shared_ptr<map_type> vals_;
+    // The pins made through this Section (or the Sections it was copied
+    // from) of the stored values; null if there have been none.
+    std::shared_ptr<pin_list> pins_;
+    std::uint64_t version_;
+    std::uint64_t generation_ = 0;
   };
 }
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::Section::put_val(std::string const& name, T const& v)
+cosmosis::Section::put_val(name_id name, T&& v)
 {
-  auto i = vals_.find(name);
-  if (i == vals_.end() )
+  if (vals_->find(name) == vals_->end())
     {
-      vals_.emplace(name, Entry(v));
+      unshare_for_write(nullptr);
+      vals_->emplace(name, std::forward<T>(v)).first->second.touch();
       return DBS_SUCCESS;
     }
   return DBS_NAME_ALREADY_EXISTS;
@@ -103,29 +214,48 @@ cosmosis::Section::put_val(std::string const& name, T const& v)
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::Section::replace_val(std::string const& name, T const& v)
+cosmosis::Section::replace_val(name_id name, T&& v)
 {
-  auto i = vals_.find(name);
-  if (i == vals_.end()) return DBS_NAME_NOT_FOUND;
-  if (not i->second.is<T>()) return DBS_WRONG_VALUE_TYPE;
-  i->second.set_val(v);
+  Entry const* e = static_cast<Section const*>(this)->find_entry(name);
+  if (e == nullptr) return DBS_NAME_NOT_FOUND;
+  if (not e->is<typename std::decay<T>::type>()) return DBS_WRONG_VALUE_TYPE;
+  Entry* w = find_entry(name);
+  w->set_val(std::forward<T>(v));
+  w->touch();
+  return DBS_SUCCESS;
+}
+
+template <class A>
+DATABLOCK_STATUS
+cosmosis::Section::overwrite_val(name_id name,
+                                 typename A::value_type const* first,
+                                 int ndims,
+                                 int const* extents)
+{
+  Entry const* e = static_cast<Section const*>(this)->find_entry(name);
+  if (e == nullptr) return DBS_NAME_NOT_FOUND;
+  if (not e->is<A>()) return DBS_WRONG_VALUE_TYPE;
+  if (not has_extents(e->view<A>(), ndims, extents)) return DBS_EXTENTS_MISMATCH;
+  Entry* w = find_entry(name);
+  w->overwrite<A>(first, ndims, extents);
+  w->touch();
   return DBS_SUCCESS;
 }
 
 template <class T>
 bool
-cosmosis::Section::has_value(std::string const& name) const
+cosmosis::Section::has_value(name_id name) const
 {
-  auto i = vals_.find(name);
-  return (i != vals_.end()) && i->second.is<T>();
+  auto i = vals_->find(name);
+  return (i != vals_->end()) && i->second.is<T>();
 }
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::Section::get_val(std::string const& name, T& v) const
+cosmosis::Section::get_val(name_id name, T& v) const
 {
-  auto i = vals_.find(name);
-  if (i == vals_.end()) return DBS_NAME_NOT_FOUND;
+  auto i = vals_->find(name);
+  if (i == vals_->end()) return DBS_NAME_NOT_FOUND;
   if (not i->second.is<T>()) return DBS_WRONG_VALUE_TYPE;
   v = i->second.val<T>();
   return DBS_SUCCESS;
@@ -133,10 +263,10 @@ cosmosis::Section::get_val(std::string const& name, T& v) const
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::Section::get_val(std::string const& name, T const& def, T& v) const
+cosmosis::Section::get_val(name_id name, T const& def, T& v) const
 {
-  auto i = vals_.find(name);
-  if (i == vals_.end())
+  auto i = vals_->find(name);
+  if (i == vals_->end())
     {
       v = def;
       return DBS_USED_DEFAULT;
@@ -148,11 +278,11 @@ cosmosis::Section::get_val(std::string const& name, T const& def, T& v) const
 
 template <class T>
 DATABLOCK_STATUS
-cosmosis::Section::get_array_shape(std::string const& name,
+cosmosis::Section::get_array_shape(name_id name,
                                    std::vector<std::size_t>& extents) const
 {
-  auto i = vals_.find(name);
-  if (i == vals_.end()) return DBS_NAME_NOT_FOUND;
+  auto i = vals_->find(name);
+  if (i == vals_->end()) return DBS_NAME_NOT_FOUND;
   typedef ndarray<T> array_t;
   if (not i->second.is<array_t>()) return DBS_WRONG_VALUE_TYPE;
   auto const& r = view<array_t>(name);
@@ -162,10 +292,10 @@ cosmosis::Section::get_array_shape(std::string const& name,
 
 template <class T>
 T const&
-cosmosis::Section::view(std::string const& name) const
+cosmosis::Section::view(name_id name) const
 {
-  auto i = vals_.find(name);
-  if (i == vals_.end()) throw BadSectionAccess();
+  auto i = vals_->find(name);
+  if (i == vals_->end()) throw BadSectionAccess();
   return i->second.view<T>();
 }
 
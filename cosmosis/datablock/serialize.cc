@@ -0,0 +1,346 @@
+// Binary serialization of DataBlock.
+//
+// The format is little-endian throughout, and versioned:
+//
+//   header:   the 4 bytes "CSDB", u32 version (= 1), u32 number of sections
+//   section:  string name, u32 number of values, then each value
+//   value:    string name, u8 type tag (the datablock_type_t), payload
+//   string:   u32 length, then the bytes (not NUL-terminated)
+//
+// The payload of each type is:
+//
+//   DBT_INT       i32
+//   DBT_BOOL      u8
+//   DBT_DOUBLE    f64
+//   DBT_COMPLEX   f64 real part, f64 imaginary part
+//   DBT_STRING    string
+//   DBT_STRING1D  u64 length, then that many strings
+//   DBT_INT1D, DBT_DOUBLE1D, DBT_COMPLEX1D
+//                 u64 length, padding, raw elements
+//   DBT_INTND, DBT_DOUBLEND, DBT_COMPLEXND
+//                 u32 ndims, u64 extent of each dimension, padding, raw
+//                 elements in row-major order
+//
+// Padding (zero bytes) aligns the raw elements of arrays to a multiple
+// of 8 bytes from the start of the data, so that they may be used in
+// place from a suitably aligned buffer. Sections are written in the
+// order they were created, and the values of each section in sorted
+// order, so a block and its copies serialize to equal bytes; blocks
+// with the same values whose sections were made in a different order
+// do not (compare them with DataBlock::hash). Metadata is stored
+// in ordinary string values, and so is included; the access log, log
+// mode and handles are not.
+//
+// DataBlock::hash hashes the same encoding of the values it covers,
+// streamed through a binary_io::hasher rather than written out, so
+// that arrays are hashed in place. Each section is hashed as its name,
+// u32 number of values and the values (as above), taking the sections
+// in the order asked for, or else sorted by name, so that the hash
+// does not depend on the order in which the sections were made. Each
+// value picked out by its section and name is hashed as the name of
+// its section, then the value.
+
+#include "datablock.hh"
+#include "binary_io.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+using cosmosis::DataBlock;
+using cosmosis::Section;
+using cosmosis::binary_io::hasher;
+using cosmosis::binary_io::reader;
+using cosmosis::binary_io::writer;
+using cosmosis::concurrency::block_lock;
+using cosmosis::complex_t;
+using cosmosis::name_id;
+using cosmosis::ndarray;
+using std::size_t;
+using std::string;
+using std::uint8_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+namespace
+{
+  char const magic[4] = {'C', 'S', 'D', 'B'};
+  uint32_t const format_version = 1;
+
+  template <class Writer, class T>
+  void write_vector(Writer& w, vector<T> const& v)
+  {
+    w.u64(v.size());
+    w.pad();
+    w.words(v.data(), v.size());
+  }
+
+  template <class Writer, class T>
+  void write_ndarray(Writer& w, ndarray<T> const& a)
+  {
+    w.u32(static_cast<uint32_t>(a.ndims()));
+    for (size_t e : a.extents()) w.u64(e);
+    w.pad();
+    w.words(a.data(), a.size());
+  }
+
+  template <class Writer>
+  void write_value(Writer& w, Section const& s, name_id name)
+  {
+    datablock_type_t t;
+    s.get_type(name, t);
+    w.str(name.str());
+    w.u8(static_cast<uint8_t>(t));
+    switch (t)
+      {
+      case DBT_INT: w.template scalar<int32_t>(s.view<int>(name)); break;
+      case DBT_BOOL: w.u8(s.view<bool>(name) ? 1 : 0); break;
+      case DBT_DOUBLE: w.scalar(s.view<double>(name)); break;
+      case DBT_COMPLEX: w.scalar(s.view<complex_t>(name)); break;
+      case DBT_STRING: w.str(s.view<string>(name)); break;
+      case DBT_STRING1D:
+        {
+          auto const& v = s.view<vector<string>>(name);
+          w.u64(v.size());
+          for (auto const& x : v) w.str(x);
+          break;
+        }
+      case DBT_INT1D: write_vector(w, s.view<vector<int>>(name)); break;
+      case DBT_DOUBLE1D: write_vector(w, s.view<vector<double>>(name)); break;
+      case DBT_COMPLEX1D: write_vector(w, s.view<vector<complex_t>>(name)); break;
+      case DBT_INTND: write_ndarray(w, s.view<ndarray<int>>(name)); break;
+      case DBT_DOUBLEND: write_ndarray(w, s.view<ndarray<double>>(name)); break;
+      case DBT_COMPLEXND: write_ndarray(w, s.view<ndarray<complex_t>>(name)); break;
+      default: break;
+      }
+  }
+
+  void hash_section(hasher& h, string const& name, Section const* s)
+  {
+    h.str(name);
+    h.u32(s == nullptr ? 0 : static_cast<uint32_t>(s->number_values()));
+    if (s == nullptr) return;
+    for (std::size_t i = 0; i != s->number_values(); ++i)
+      write_value(h, *s, s->value_name(i));
+  }
+
+  template <class T>
+  bool read_vector(reader& r, vector<T>& v)
+  {
+    uint64_t n;
+    if (not r.u64(n) || not r.pad() || n > r.remaining() / sizeof(T)) return false;
+    v.resize(n);
+    return r.words(v.data(), n);
+  }
+
+  template <class T>
+  bool read_ndarray(reader& r, Section& s, name_id name)
+  {
+    uint32_t ndims;
+    if (not r.u32(ndims) || ndims == 0 || ndims > r.remaining() / sizeof(uint64_t))
+      return false;
+    vector<size_t> extents(ndims);
+    uint64_t n = 1;
+    for (auto& e : extents) {
+      uint64_t x;
+      if (not r.u64(x)) return false;
+      // Reject extents whose product would overflow, or be more than
+      // the remaining bytes could hold.
+      if (x != 0 && n > (r.remaining() / sizeof(T)) / x) return false;
+      e = x;
+      n *= x;
+    }
+    vector<T> values;
+    if (not r.pad() || n > r.remaining() / sizeof(T)) return false;
+    values.resize(n);
+    if (not r.words(values.data(), n)) return false;
+    return s.put_val(name, ndarray<T>(std::move(values), std::move(extents))) == DBS_SUCCESS;
+  }
+
+  template <class T>
+  bool put_scalar(reader& r, Section& s, name_id name)
+  {
+    T x;
+    return r.scalar(x) && s.put_val(name, x) == DBS_SUCCESS;
+  }
+
+  template <class T>
+  bool put_vector(reader& r, Section& s, name_id name)
+  {
+    vector<T> v;
+    return read_vector(r, v) && s.put_val(name, std::move(v)) == DBS_SUCCESS;
+  }
+
+  bool read_value(reader& r, Section& s)
+  {
+    string name;
+    uint8_t tag;
+    if (not r.str(name) || not r.u8(tag)) return false;
+    name_id const nm = name_id::folded(name);
+    switch (static_cast<datablock_type_t>(tag))
+      {
+      case DBT_INT:
+        {
+          int32_t x;
+          return r.scalar(x) && s.put_val(nm, static_cast<int>(x)) == DBS_SUCCESS;
+        }
+      case DBT_BOOL:
+        {
+          uint8_t x;
+          return r.u8(x) && s.put_val(nm, x != 0) == DBS_SUCCESS;
+        }
+      case DBT_DOUBLE: return put_scalar<double>(r, s, nm);
+      case DBT_COMPLEX: return put_scalar<complex_t>(r, s, nm);
+      case DBT_STRING:
+        {
+          string x;
+          return r.str(x) && s.put_val(nm, std::move(x)) == DBS_SUCCESS;
+        }
+      case DBT_STRING1D:
+        {
+          uint64_t n;
+          // Each string takes at least four bytes.
+          if (not r.u64(n) || n > r.remaining() / 4) return false;
+          vector<string> v(n);
+          for (auto& x : v)
+            if (not r.str(x)) return false;
+          return s.put_val(nm, std::move(v)) == DBS_SUCCESS;
+        }
+      case DBT_INT1D: return put_vector<int>(r, s, nm);
+      case DBT_DOUBLE1D: return put_vector<double>(r, s, nm);
+      case DBT_COMPLEX1D: return put_vector<complex_t>(r, s, nm);
+      case DBT_INTND: return read_ndarray<int>(r, s, nm);
+      case DBT_DOUBLEND: return read_ndarray<double>(r, s, nm);
+      case DBT_COMPLEXND: return read_ndarray<complex_t>(r, s, nm);
+      default: return false;
+      }
+  }
+}
+
+static_assert(sizeof(int) == 4, "DataBlock serialization assumes a 32-bit int");
+
+std::size_t
+cosmosis::DataBlock::serialized_size() const
+{
+  // The whole-block operations below take the lock on the sections
+  // exclusive (see concurrency.hh).
+  block_lock lock(sync());
+  writer w(nullptr);
+  write(w);
+  return w.size();
+}
+
+void
+cosmosis::DataBlock::serialize(char* out) const
+{
+  block_lock lock(sync());
+  writer w(out);
+  write(w);
+}
+
+void
+cosmosis::DataBlock::serialize(std::vector<char>& out) const
+{
+  block_lock lock(sync());
+  writer counter(nullptr);
+  write(counter);
+  std::size_t const start = out.size();
+  out.resize(start + counter.size());
+  writer w(out.data() + start);
+  write(w);
+}
+
+template <class Writer>
+void
+cosmosis::DataBlock::write(Writer& w) const
+{
+  w.bytes(magic, sizeof(magic));
+  w.u32(format_version);
+  w.u32(static_cast<uint32_t>(sections_.size()));
+  for (auto const& sec : sections_) {
+    Section const& s = sec.second;
+    w.str(sec.first.str());
+    w.u32(static_cast<uint32_t>(s.number_values()));
+    for (std::size_t i = 0; i != s.number_values(); ++i)
+      write_value(w, s, s.value_name(i));
+  }
+}
+
+DATABLOCK_STATUS
+cosmosis::DataBlock::deserialize(char const* data, std::size_t size)
+{
+  reader r(data, size);
+  char m[sizeof(magic)];
+  uint32_t version, nsections;
+  if (not r.bytes(m, sizeof(m)) || std::memcmp(m, magic, sizeof(m)) != 0 ||
+      not r.u32(version) || version != format_version ||
+      not r.u32(nsections))
+    return DBS_BAD_FORMAT;
+
+  hashed_map<Section, name_id> sections;
+  for (uint32_t i = 0; i != nsections; ++i) {
+    string name;
+    uint32_t nvalues;
+    if (not r.str(name) || not r.u32(nvalues)) return DBS_BAD_FORMAT;
+    auto ins = sections.emplace(name_id::folded(name));
+    if (not ins.second) return DBS_BAD_FORMAT;
+    for (uint32_t j = 0; j != nvalues; ++j)
+      if (not read_value(r, ins.first->second)) return DBS_BAD_FORMAT;
+  }
+  if (not r.at_end()) return DBS_BAD_FORMAT;
+
+  block_lock lock(sync());
+  remove_sections();
+  sections_ = std::move(sections);
+  invalidate_handles();
+  return DBS_SUCCESS;
+}
+
+cosmosis::DataBlock::hash_value
+cosmosis::DataBlock::hash(std::vector<std::string> const& sections) const
+{
+  block_lock lock(sync());
+  hasher h;
+  if (sections.empty()) {
+    vector<std::pair<string const*, Section const*>> all;
+    for (auto const& sec : sections_) all.emplace_back(&sec.first.str(), &sec.second);
+    std::sort(all.begin(), all.end(),
+              [](std::pair<string const*, Section const*> const& a,
+                 std::pair<string const*, Section const*> const& b)
+              { return *a.first < *b.first; });
+    for (auto const& sec : all) hash_section(h, *sec.first, sec.second);
+  }
+  else
+    for (auto const& name : sections) {
+      name_id const sec = name_id::folded(name);
+      auto isec = sections_.find(sec);
+      hash_section(h, sec.str(), isec == sections_.end() ? nullptr : &isec->second);
+    }
+  return h.digest();
+}
+
+DATABLOCK_STATUS
+cosmosis::DataBlock::hash(std::vector<std::pair<std::string, std::string>> const& keys,
+                          hash_value& result,
+                          std::size_t* failed) const
+{
+  block_lock lock(sync());
+  hasher h;
+  for (std::size_t i = 0; i != keys.size(); ++i) {
+    name_id const sec = name_id::folded(keys[i].first);
+    name_id const nm = name_id::folded(keys[i].second);
+    auto isec = sections_.find(sec);
+    DATABLOCK_STATUS status = DBS_SECTION_NOT_FOUND;
+    if (isec != sections_.end() && isec->second.has_val(nm)) {
+      h.str(sec.str());
+      write_value(h, isec->second, nm);
+      continue;
+    }
+    if (isec != sections_.end()) status = DBS_NAME_NOT_FOUND;
+    if (failed != nullptr) *failed = i;
+    return status;
+  }
+  result = h.digest();
+  return DBS_SUCCESS;
+}
@@ -0,0 +1,262 @@
+// Snapshot files of DataBlock.
+//
+// A snapshot holds the whole contents of a block in a single file laid
+// out so that it can be memory-mapped and used without parsing: a
+// short index says where each value is, and the elements of each
+// numeric array are stored raw, starting on a page boundary. It is
+// meant for saving the block of every sample of a sampler, so that
+// postprocessing can open many of them cheaply, reading only the
+// arrays it uses. (See DataBlock.save_snapshot and the Snapshot class
+// in cosmosis_py/snapshot.py.)
+//
+// The file is little-endian throughout, and versioned:
+//
+//   header:   the 4 bytes "CSNP", u32 version (= 1), u32 page size
+//             (= 4096), u32 number of values, u64 size of the index,
+//             u64 size of the file; 32 bytes in all
+//   index:    for each value, section by section in the order they
+//             were made, and by name within each: string section
+//             name, string value name, u8 type tag (the
+//             datablock_type_t), u32 ndims (0 for scalars), u64 extent
+//             of each dimension, u64 offset of its payload from the
+//             start of the file, u64 size of its payload in bytes
+//   payloads: those of scalars and strings first, each 8-byte aligned;
+//             then those of arrays, each page-aligned
+//   string:   u32 length, then the bytes (not NUL-terminated)
+//
+// The payload of each type is:
+//
+//   DBT_INT       i32
+//   DBT_BOOL      u8
+//   DBT_DOUBLE    f64
+//   DBT_COMPLEX   f64 real part, f64 imaginary part
+//   DBT_STRING    the bytes of the string
+//   DBT_STRING1D  the strings
+//   DBT_INT1D, DBT_DOUBLE1D, DBT_COMPLEX1D, DBT_INTND, DBT_DOUBLEND,
+//   DBT_COMPLEXND
+//                 the raw elements, in row-major order
+//
+// Metadata is stored in ordinary string values, and so is included.
+
+#include "datablock.hh"
+#include "binary_io.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using cosmosis::Section;
+using cosmosis::binary_io::padding;
+using cosmosis::binary_io::writer;
+using cosmosis::concurrency::block_lock;
+using cosmosis::complex_t;
+using cosmosis::ndarray;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+namespace
+{
+  char const magic[4] = {'C', 'S', 'N', 'P'};
+  uint32_t const format_version = 1;
+  size_t const page_size = 4096;
+  size_t const header_size = 32;
+
+  struct snapshot_entry
+  {
+    string const* section;
+    string const* name;
+    datablock_type_t type;
+    vector<uint64_t> extents;
+    // The raw elements of a numeric array, and the size of the words
+    // they are made of; or else the encoded payload.
+    char const* data;
+    size_t word_size;
+    vector<char> payload;
+    uint64_t offset;
+    uint64_t nbytes;
+  };
+
+  // Set the payload of e to what f writes to a writer.
+  template <class F>
+  void encode(snapshot_entry& e, F f)
+  {
+    writer counter(nullptr);
+    f(counter);
+    e.payload.resize(counter.size());
+    writer w(e.payload.data());
+    f(w);
+    e.nbytes = e.payload.size();
+  }
+
+  template <class T>
+  void set_array(snapshot_entry& e, T const* data, size_t n)
+  {
+    e.data = reinterpret_cast<char const*>(data);
+    e.word_size = cosmosis::binary_io::word_size<T>();
+    e.nbytes = n * sizeof(T);
+  }
+
+  template <class T>
+  void set_vector(snapshot_entry& e, vector<T> const& v)
+  {
+    e.extents.push_back(v.size());
+    set_array(e, v.data(), v.size());
+  }
+
+  template <class T>
+  void set_ndarray(snapshot_entry& e, ndarray<T> const& a)
+  {
+    for (size_t x : a.extents()) e.extents.push_back(x);
+    set_array(e, a.data(), a.size());
+  }
+
+  snapshot_entry make_entry(string const& section, Section const& s, string const& name)
+  {
+    snapshot_entry e{&section, &name, DBT_UNKNOWN, {}, nullptr, 0, {}, 0, 0};
+    s.get_type(name, e.type);
+    switch (e.type)
+      {
+      case DBT_INT:
+        encode(e, [&](writer& w) { w.scalar<std::int32_t>(s.view<int>(name)); });
+        break;
+      case DBT_BOOL:
+        encode(e, [&](writer& w) { w.u8(s.view<bool>(name) ? 1 : 0); });
+        break;
+      case DBT_DOUBLE:
+        encode(e, [&](writer& w) { w.scalar(s.view<double>(name)); });
+        break;
+      case DBT_COMPLEX:
+        encode(e, [&](writer& w) { w.scalar(s.view<complex_t>(name)); });
+        break;
+      case DBT_STRING:
+        {
+          string const& x = s.view<string>(name);
+          encode(e, [&](writer& w) { w.bytes(x.data(), x.size()); });
+          break;
+        }
+      case DBT_STRING1D:
+        {
+          auto const& v = s.view<vector<string>>(name);
+          e.extents.push_back(v.size());
+          encode(e, [&](writer& w) { for (auto const& x : v) w.str(x); });
+          break;
+        }
+      case DBT_INT1D: set_vector(e, s.view<vector<int>>(name)); break;
+      case DBT_DOUBLE1D: set_vector(e, s.view<vector<double>>(name)); break;
+      case DBT_COMPLEX1D: set_vector(e, s.view<vector<complex_t>>(name)); break;
+      case DBT_INTND: set_ndarray(e, s.view<ndarray<int>>(name)); break;
+      case DBT_DOUBLEND: set_ndarray(e, s.view<ndarray<double>>(name)); break;
+      case DBT_COMPLEXND: set_ndarray(e, s.view<ndarray<complex_t>>(name)); break;
+      default: break;
+      }
+    return e;
+  }
+
+  void write_index(writer& w, vector<snapshot_entry> const& entries)
+  {
+    for (auto const& e : entries) {
+      w.str(*e.section);
+      w.str(*e.name);
+      w.u8(static_cast<std::uint8_t>(e.type));
+      w.u32(static_cast<uint32_t>(e.extents.size()));
+      for (uint64_t x : e.extents) w.u64(x);
+      w.u64(e.offset);
+      w.u64(e.nbytes);
+    }
+  }
+
+  bool write_zeros(std::FILE* f, size_t n)
+  {
+    static char const zeros[page_size] = {};
+    for (; n > page_size; n -= page_size)
+      if (std::fwrite(zeros, 1, page_size, f) != page_size) return false;
+    return std::fwrite(zeros, 1, n, f) == n;
+  }
+
+  // Write the raw elements of an array, byte-swapping them (a chunk at
+  // a time) on big-endian hosts.
+  bool write_array(std::FILE* f, snapshot_entry const& e)
+  {
+    if (cosmosis::binary_io::host_is_little_endian())
+      return std::fwrite(e.data, 1, e.nbytes, f) == e.nbytes;
+    vector<char> chunk;
+    for (size_t start = 0; start < e.nbytes; start += page_size) {
+      size_t const n = std::min<size_t>(page_size, e.nbytes - start);
+      chunk.assign(e.data + start, e.data + start + n);
+      cosmosis::binary_io::swap_words(chunk.data(), n / e.word_size, e.word_size);
+      if (std::fwrite(chunk.data(), 1, n, f) != n) return false;
+    }
+    return true;
+  }
+}
+
+DATABLOCK_STATUS
+cosmosis::DataBlock::save_snapshot(std::string const& filename) const
+{
+  block_lock lock(sync());
+  vector<snapshot_entry> entries;
+  for (auto const& sec : sections_)
+    for (size_t i = 0; i != sec.second.number_values(); ++i)
+      entries.push_back(make_entry(sec.first.str(), sec.second, sec.second.value_name(i)));
+
+  // Lay out the file: the index (whose size does not depend on the
+  // offsets it records), then the small payloads, then the arrays.
+  writer counter(nullptr);
+  write_index(counter, entries);
+  uint64_t const index_size = counter.size();
+  uint64_t pos = header_size + index_size;
+  for (auto& e : entries)
+    if (e.data == nullptr) {
+      pos += padding(pos, 8);
+      e.offset = pos;
+      pos += e.nbytes;
+    }
+  uint64_t const head_size = pos;
+  for (auto& e : entries)
+    if (e.data != nullptr) {
+      pos += padding(pos, page_size);
+      e.offset = pos;
+      pos += e.nbytes;
+    }
+  uint64_t const file_size = pos;
+
+  vector<char> head(head_size);
+  writer w(head.data());
+  w.bytes(magic, sizeof(magic));
+  w.u32(format_version);
+  w.u32(static_cast<uint32_t>(page_size));
+  w.u32(static_cast<uint32_t>(entries.size()));
+  w.u64(index_size);
+  w.u64(file_size);
+  write_index(w, entries);
+  for (auto const& e : entries)
+    if (e.data == nullptr) {
+      w.pad(8);
+      w.bytes(e.payload.data(), e.payload.size());
+    }
+
+  // Write to a temporary file and rename it, so that readers never see
+  // a partial snapshot.
+  string const tmp = filename + ".tmp";
+  std::FILE* f = std::fopen(tmp.c_str(), "wb");
+  if (f == nullptr) return DBS_IO_FAILURE;
+  bool ok = std::fwrite(head.data(), 1, head.size(), f) == head.size();
+  pos = head_size;
+  for (auto const& e : entries) {
+    if (not ok) break;
+    if (e.data == nullptr) continue;
+    ok = write_zeros(f, e.offset - pos) && write_array(f, e);
+    pos = e.offset + e.nbytes;
+  }
+  ok = (std::fclose(f) == 0) && ok;
+  if (ok) ok = std::rename(tmp.c_str(), filename.c_str()) == 0;
+  if (not ok) {
+    std::remove(tmp.c_str());
+    return DBS_IO_FAILURE;
+  }
+  return DBS_SUCCESS;
+}
@@ -319,6 +319,26 @@ def run_cosmosis(ini, pool=None, pipeline=None, values=None, priors=None, overri
     #Get that sampler from the system.
     sampler_classes = [Sampler.registry[sample_method] for sample_method in sample_methods]
 
+    if isinstance(pool, mpi_pool.MPIPool):
+        # How the MPI pool hands out the tasks of each map; see MPIPool.
+        schedule = ini.get(RUNTIME_INI_SECTION, "mpi_schedule", fallback=pool.schedule)
+        if schedule not in ("static", "dynamic"):
+            raise ValueError("The mpi_schedule option in [runtime] should be static or dynamic, not {}".format(schedule))
+        pool.schedule = schedule
+        pool.chunk_time = ini.getfloat(RUNTIME_INI_SECTION, "mpi_chunk_time", fallback=pool.chunk_time)
+        # Whether the master only hands out tasks, doing none itself.
+        pool.dispatch_only = ini.getboolean(RUNTIME_INI_SECTION, "mpi_dispatch_only", fallback=pool.dispatch_only)
+        # The hybrid mode: each rank runs its pipeline on this many
+        # samples at once, in threads (the pipeline reads the same
+        # [runtime] threads option, and may turn it down).
+        pool.set_threads(getattr(pipeline, "threads", 1))
+    elif getattr(pipeline, "threads", 1) > 1 and is_root:
+        print("NOTE: The threads option in [runtime] is only used when running under MPI; I will ignore it.")
+
+    # Write output from a background thread, so that the sampler
+    # (and the workers waiting on it) do not wait on file I/O.
+    background_output = ini.getboolean(RUNTIME_INI_SECTION, "background_output", fallback=False)
+
     if pool:
         if not any(issubclass(sampler_class,ParallelSampler) for sampler_class in sampler_classes):
             if len(sampler_classes)>1:
@@ -377,6 +397,8 @@ def run_cosmosis(ini, pool=None, pipeline=None, values=None, priors=None, overri
             print("* Running sampler {}/{}: {}".format(sampler_number+1,number_samplers, sampler_name))
             if pool and smp:
                 print(f"* Using multiprocessing (SMP) with {pool.size} processes.")
+            elif pool and pool.threads > 1:
+                print(f"* Using MPI with {pool.size} processes, each with {pool.threads} threads.")
             elif pool:
                 print(f"* Using MPI with {pool.size} processes.")
             else:
@@ -409,6 +431,8 @@ def run_cosmosis(ini, pool=None, pipeline=None, values=None, priors=None, overri
 
         if output:
             write_header_output(output, ini, values, pipeline)
+            if background_output:
+                output.start_background_writer()
 
         sys.stdout.flush()
         sys.stderr.flush()
@@ -437,6 +461,16 @@ def run_cosmosis(ini, pool=None, pipeline=None, values=None, priors=None, overri
         if output:
             output.close()
 
+    if is_root and isinstance(pool, mpi_pool.MPIPool) and pool.map_time:
+        logs.overview(pool.utilization_report())
+
+    if pipeline.profiler:
+        if (pool is not None) and (not smp):
+            profile_name = pipeline.profile_output + f'.{pool.rank}'
+        else:
+            profile_name = pipeline.profile_output
+        pipeline.profiler.write(profile_name)
+
     if cleanup_pipeline:
         pipeline.cleanup()
 
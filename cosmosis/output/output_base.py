@@ -1,6 +1,8 @@
 import abc
 import numpy as np
 import fcntl
+import queue
+import threading
 
 output_registry = {}
 
@@ -42,6 +44,9 @@ class OutputBase(metaclass=OutputMetaclass):
         self.closed=False
         self.begun_sampling = False
         self.resumed = False
+        self._queue = None
+        self._writer = None
+        self._writer_error = None
 
     @property
     def columns(self):
@@ -77,12 +82,67 @@ class OutputBase(metaclass=OutputMetaclass):
     def column_names(self):
         return [c[0] for c in self._columns]
 
+    def start_background_writer(self, max_queued=10000):
+        """
+        From now on, hand everything written to this output
+        to a background thread, which does the actual writing
+        in the same order.  This lets a sampler get on with
+        dispatching work instead of waiting on file I/O.
+
+        Up to max_queued items can be waiting at once, after
+        which writes block until the thread catches up.
+        Errors in the thread are raised by the next call that
+        writes, or by sync or close.
+        """
+        if self._writer is not None:
+            return
+        self._queue = queue.Queue(max_queued)
+        self._writer = threading.Thread(target=self._background_writer, daemon=True)
+        self._writer.start()
+
+    def _background_writer(self):
+        while True:
+            item = self._queue.get()
+            if item is None:
+                self._queue.task_done()
+                break
+            method, args = item
+            if self._writer_error is None:
+                try:
+                    method(*args)
+                except Exception as error:
+                    self._writer_error = error
+            self._queue.task_done()
+
+    def _check_writer(self):
+        if self._writer_error is not None:
+            error = self._writer_error
+            self._writer_error = None
+            raise error
+
+    def _do(self, method, *args):
+        # Call method now, or queue it for the background writer
+        if self._writer is None:
+            method(*args)
+        else:
+            self._check_writer()
+            self._queue.put((method, args))
+
+    def sync(self):
+        """
+        Wait until the background writer, if there is one,
+        has written everything sent to it so far.
+        """
+        if self._writer is not None:
+            self._queue.join()
+            self._check_writer()
+
     def comment(self, comment):
         """
         Save a comment.  Ordering will be preserved
         if you save multiple ones.
         """
-        self._write_comment(comment.strip('\n'))
+        self._do(self._write_comment, comment.strip('\n'))
 
     def parameters(self, *param_groups):
         """ 
@@ -116,10 +176,10 @@ class OutputBase(metaclass=OutputMetaclass):
 
         #If this is our first sample then 
         if not self.begun_sampling:
-            self._begun_sampling(params)
+            self._do(self._begun_sampling, params)
             self.begun_sampling=True
         #Pass to the subclasses to write output
-        self._write_parameters(params)
+        self._do(self._write_parameters, params)
 
     def reset_to_chain_start(self):
         """
@@ -131,9 +191,10 @@ class OutputBase(metaclass=OutputMetaclass):
 
     def flush(self):
         """
-        For supported output classes, flush all pending output
+        For supported output classes, flush all pending output.
+        With a background writer this does not wait for it.
         """
-        self._flush()
+        self._do(self._flush)
 
     def metadata(self, key, value, comment=""):
         """
@@ -143,7 +204,7 @@ class OutputBase(metaclass=OutputMetaclass):
         """
         if self.closed:
             raise RuntimeError("Tried to write metadata info to closed output")
-        self._write_metadata(key, value, comment)
+        self._do(self._write_metadata, key, value, comment)
 
     def final(self, key, value, comment=""):
         """
@@ -153,7 +214,7 @@ class OutputBase(metaclass=OutputMetaclass):
         """
         if self.closed:
             raise RuntimeError("Tried to write final info to closed output")
-        self._write_final(key, value, comment)
+        self._do(self._write_final, key, value, comment)
 
     def name_for_sampler_resume_info(self):
         """
@@ -177,8 +238,15 @@ class OutputBase(metaclass=OutputMetaclass):
         fcntl.lockf(f, fcntl.LOCK_UN|fcntl.LOCK_NB)
 
     def close(self):
-        self._close()
-        self.closed=True
+        if self._writer is not None:
+            self._queue.put(None)
+            self._writer.join()
+            self._writer = None
+        try:
+            self._check_writer()
+        finally:
+            self._close()
+            self.closed=True
 
     def blinding_header(self):
         if self.resumed:
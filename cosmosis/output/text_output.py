@@ -122,6 +122,8 @@ In the last case you can set lock=F in the [output] section to disable this feat
         self._file.flush()
 
     def reset_to_chain_start(self):
+        # Let any background writer finish first
+        self.sync()
         # On the first iteration the start mark is not set until we call
         # output the first time.
         if self._start_mark is None:
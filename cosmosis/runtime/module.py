@@ -91,6 +91,12 @@ class Module(object):
         self.execute_function = execute_function
         self.cleanup_function = cleanup_function
 
+        # The inputs and outputs the module declares, if any (see
+        # parse_inputs).
+        self.inputs = None
+        self.outputs = None
+        self.thread_safe = False
+
         # identify module filename
         filename = file_path
         if not os.path.isabs(filename):
@@ -154,10 +160,10 @@ class Module(object):
         defaults = {k for s,k in config.keys('_cosmosis_default_section')}
 
         # get all the accesses since the last new-module command
-        # The "file" argument doesn't get read during setup because
-        # it was used earlier, but should not be in this list.
-        # so we explicity include it.
-        accesses_by_last_module = {"file"}
+        # The "file", "inputs" and "outputs" arguments don't get read during setup
+        # because they were used earlier, but should not be in this list.
+        # so we explicity include them.
+        accesses_by_last_module = {"file", "inputs", "outputs"}
         for (log_type, section, name, dtype) in logs:
             # if this is the start of a new module then clear the list
             # because we only want the last one.
@@ -166,7 +172,7 @@ class Module(object):
             # or something like that.  But this is all super fast and only
             # happens once at the start of the pipeline.
             if log_type == "MODULE-START":
-                accesses_by_last_module = {"file"}
+                accesses_by_last_module = {"file", "inputs", "outputs"}
             # keep only logs that are READs and for the current section
             elif (log_type == "READ-OK") and (section == option_section):
                 accesses_by_last_module.add(name)
@@ -373,9 +379,41 @@ class Module(object):
         m = cls(module_name, filename,
                 setup_function, exec_function, cleanup_function,
                 root_directory)
+        m.inputs = cls.parse_inputs(options.get(module_name, "inputs", fallback=None))
+        m.outputs = cls.parse_inputs(options.get(module_name, "outputs", fallback=None))
+        # Whether several threads may run the module at once, on
+        # different blocks, in the hybrid MPI and threads mode.
+        m.thread_safe = options.getboolean(module_name, "thread_safe", fallback=False)
 
         return m
 
+    @staticmethod
+    def parse_inputs(text):
+        u"""Parse the `inputs` option of a module.
+
+        The option lists, separated by spaces, everything in the block
+        that the module reads: values as ‘section/name’ and whole sections
+        as ‘section’.  It is used by the `skip_unchanged` option of the
+        pipeline, which reruns a module only when one of these changes.
+        The `outputs` option lists what the module writes in the same
+        way; both are used, along with the access log, to find which
+        modules the `parallel_modules` option may run at the same time.
+        Return None if `text` is None, and otherwise a pair of the list of
+        (section, name) values and the list of sections.
+
+        """
+        if text is None:
+            return None
+        values = []
+        sections = []
+        for item in text.split():
+            section, _, name = item.lower().partition("/")
+            if name:
+                values.append((section, name))
+            else:
+                sections.append(section)
+        return values, sections
+
 
 
     @staticmethod
@@ -414,6 +452,9 @@ class FunctionModule(Module):
         """
         self.name = name
         self.filename='missing'
+        self.inputs = None
+        self.outputs = None
+        self.thread_safe = False
 
         self.setup_function = setup_function
         self.execute_function = execute_function
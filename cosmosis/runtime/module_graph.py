@@ -0,0 +1,143 @@
+u"""The dependencies between the modules of a pipeline.
+
+A :class:`ModuleGraph` records which modules of a pipeline must run
+before which others.  It is built from the access log of a block that
+has been run through the whole pipeline: a module depends on an earlier
+one if either writes a value that the other reads or writes.  Reads
+include failed reads, since a module that looks for a value before it
+is made must still look before it is made, and checks of whether a
+value or section exists (logged as CHECK), since the answer depends on
+the modules that ran before.  Listing the values of a section, or the
+sections of the block, counts as reading all of them.  Values a module
+declares in its `inputs` and `outputs` options are added to what it was
+seen to read and write.
+
+Running the modules in any order that respects these dependencies gives
+the same block as running them in sequence, which is what the
+`parallel_modules` option of the [pipeline] section does (see
+:meth:`Pipeline.run_parallel`).  Only the accesses seen in the log are
+known, so a module that reads different values from sample to sample
+should declare those values or sections in its `inputs` option.
+
+"""
+
+__all__ = ["ModuleGraph"]
+
+# A key is (section, name), or (section, None) for a whole section;
+# EVERYTHING stands for the whole block.
+EVERYTHING = (None, None)
+
+READS = {"READ-OK", "READ-FAIL", "READ-DEFAULT"}
+WRITES = {"WRITE-OK", "WRITE-FAIL", "REPLACE-OK", "REPLACE-FAIL"}
+
+
+def overlap(a, b):
+    u"""Return True if the key sets `a` and `b` may refer to the same value."""
+    if not a or not b:
+        return False
+    if EVERYTHING in a or EVERYTHING in b:
+        return True
+    if a & b:
+        return True
+    # Whole sections overlap anything in them.
+    sections_a = {s for s, n in a if n is None}
+    sections_b = {s for s, n in b if n is None}
+    return (any(s in sections_b for s, _ in a) or
+            any(s in sections_a for s, _ in b))
+
+
+class ModuleGraph(object):
+    u"""The order in which the modules of a pipeline must run.
+
+    `reads` and `writes` give, for each module in pipeline order, the set
+    of keys it reads and writes.  `dependencies[j]` is then the set of
+    the indices of the modules that must finish before module j starts,
+    and `dependents[i]` the modules that wait for module i.
+
+    """
+    def __init__(self, reads, writes):
+        self.reads = reads
+        self.writes = writes
+        n = len(reads)
+        self.dependencies = [set() for _ in range(n)]
+        self.dependents = [set() for _ in range(n)]
+        for j in range(n):
+            for i in range(j):
+                if (overlap(writes[i], reads[j]) or overlap(writes[i], writes[j]) or
+                        overlap(reads[i], writes[j])):
+                    self.dependencies[j].add(i)
+                    self.dependents[i].add(j)
+
+    @classmethod
+    def from_block(cls, block, modules):
+        u"""Build the graph from the log of `block`, which has just been run through all the `modules`.
+
+        Return None if the log does not record every module, for example
+        because it has overflowed.
+
+        """
+        n = len(modules)
+        reads = [set() for _ in range(n)]
+        writes = [set() for _ in range(n)]
+        current = -1
+        for i in range(block.get_log_count()):
+            log_type, section, name, _ = block.get_log_entry(i)
+            if log_type == "MODULE-START":
+                current += 1
+                if current == n:
+                    break
+                if section != modules[current].name:
+                    return None
+            elif current < 0:
+                continue
+            elif log_type in READS:
+                reads[current].add((section, name))
+            elif log_type in WRITES:
+                writes[current].add((section, name))
+            elif log_type == "CHECK":
+                # Checks of a whole section have no name, and of the
+                # whole block no section.
+                reads[current].add((section, name or None) if section else EVERYTHING)
+            elif log_type == "COPY":
+                # Copies log the source section and the new one.
+                reads[current].add((section, None))
+                writes[current].add((name, None))
+            elif log_type == "DELETE":
+                writes[current].add((section, None))
+            elif log_type == "CLEAR":
+                writes[current].add(EVERYTHING)
+        if current + 1 < n:
+            return None
+
+        for i, module in enumerate(modules):
+            for declared, keys in ((getattr(module, "inputs", None), reads[i]),
+                                   (getattr(module, "outputs", None), writes[i])):
+                if declared is not None:
+                    values, sections = declared
+                    keys.update(values)
+                    keys.update((s, None) for s in sections)
+        return cls(reads, writes)
+
+    def width(self):
+        u"""Return the largest number of modules that are ever ready to run at once."""
+        remaining = [len(d) for d in self.dependencies]
+        ready = [i for i, r in enumerate(remaining) if r == 0]
+        widest = 0
+        while ready:
+            widest = max(widest, len(ready))
+            next_ready = []
+            for i in ready:
+                for j in self.dependents[i]:
+                    remaining[j] -= 1
+                    if remaining[j] == 0:
+                        next_ready.append(j)
+            ready = next_ready
+        return widest
+
+    def describe(self, modules):
+        u"""Return a description of the dependencies, one line for each module."""
+        lines = []
+        for module, deps in zip(modules, self.dependencies):
+            after = ", ".join(modules[i].name for i in sorted(deps)) or "(nothing)"
+            lines.append("{} runs after {}".format(module.name, after))
+        return "\n".join(lines)
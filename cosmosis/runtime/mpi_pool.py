@@ -1,3 +1,10 @@
+import collections
+import concurrent.futures
+import itertools
+import time
+from ..utils import in_order
+
+
 class _close_pool_message(object):
     def __repr__(self):
         return "<Close pool message>"
@@ -9,13 +16,56 @@ class _function_wrapper(object):
         self.callback = callback
 
 
+class _chunk(object):
+    # A run of consecutive tasks of a dynamically scheduled map, starting
+    # with task number `start`.
+    def __init__(self, start, tasks):
+        self.start = start
+        self.tasks = tasks
+
+
 def _error_function(task):
     raise RuntimeError("Pool was sent tasks before being told what "
                        "function to apply.")
 
 
 class MPIPool(object):
-    def __init__(self, debug=False, comm=None):
+    u"""A pool of MPI processes, of which the master hands out tasks to the others.
+
+    By default (`schedule="static"`) :meth:`map` gives each process an
+    equal share of the tasks at once.  With `schedule="dynamic"` the
+    workers are instead sent small chunks of tasks, and a new chunk each
+    time they return one, so that workers with quick tasks take on more
+    of them and none sits idle while others finish.  The size of the
+    chunks is chosen so that each takes about `chunk_time` seconds,
+    from the mean time of the tasks done so far, but shrinks towards the
+    end of each map so that the last chunks finish together.  Each
+    worker is sent `prefetch` chunks ahead, so that it can start the
+    next as soon as it returns one.  The master works on single tasks
+    in between handing out chunks.
+
+    :meth:`imap` and :meth:`imap_unordered` hand out tasks in the same
+    way as the dynamic schedule, but yield results as they come back, so
+    that the caller can deal with them while the workers go on with
+    their next chunks.
+
+    With `dispatch_only=True` the master does no tasks itself, and only
+    hands them out and collects the results, so that workers never wait
+    for it to finish a likelihood of its own before they get more work.
+
+    With `threads` greater than one each rank runs that many tasks at a
+    time, on a pool of threads sharing its pipeline: the hybrid mode, in
+    which one rank per node holds a single copy of the data the modules
+    load, and its threads share out the tasks sent to the node.  Chunks
+    then hold at least one task per thread.
+
+    In any mode the pool records, for each rank, the number of tasks
+    it did and the time it spent on them; :meth:`utilization` reports
+    them as a fraction of the time spent in :meth:`map`.
+
+    """
+    def __init__(self, debug=False, comm=None, schedule="static", chunk_time=0.1, prefetch=2,
+                 dispatch_only=False, threads=1):
         try:
             from mpi4py import MPI
             self.MPI = MPI
@@ -28,12 +78,62 @@ class MPIPool(object):
         self.size = self.comm.Get_size()
         self.debug = debug
 
+        if schedule not in ("static", "dynamic"):
+            raise ValueError("MPI schedule should be 'static' or 'dynamic', not {}".format(schedule))
+        self.schedule = schedule
+        self.chunk_time = chunk_time
+        self.prefetch = prefetch
+        self.dispatch_only = dispatch_only
+        self.threads = 1
+        self.executor = None
+        self.set_threads(threads)
+        # The mean time taken by a task so far, used to size chunks.
+        self.task_time = None
+
         self.function = _error_function
         self.callback = None
+        # The number of chunks sent out whose results are not yet read,
+        # and, for each rank, the requests of the non-blocking sends of
+        # its chunks, oldest first.  A rank does its chunks in turn, so
+        # once its result for one is read the send of that chunk is done.
+        self.outstanding = 0
+        self.sends = [collections.deque() for _ in range(self.size)]
+
+        # Per-rank counts of tasks, chunks and busy seconds, and the
+        # total time spent in map, kept by the master.
+        self.tasks_done = [0] * self.size
+        self.chunks_done = [0] * self.size
+        self.busy_time = [0.0] * self.size
+        self.map_time = 0.0
 
     def is_master(self):
         return self.rank == 0
 
+    def set_threads(self, threads):
+        u"""Run `threads` tasks at a time in this rank."""
+        if self.executor is not None:
+            self.executor.shutdown()
+            self.executor = None
+        self.threads = max(1, threads)
+        if self.threads > 1:
+            self.executor = concurrent.futures.ThreadPoolExecutor(
+                max_workers=self.threads, thread_name_prefix="cosmosis-pool")
+
+    def _apply_all(self, tasks):
+        # Return the results of the tasks, and the time they took.
+        start = time.perf_counter()
+        # The threads of this rank share out the tasks between them.
+        apply = self.executor.map if self.executor is not None and len(tasks) > 1 else map
+        if self.callback:
+            def compose(x):
+                result = self.function(x)
+                self.callback(x, result)
+                return result
+            results = list(apply(compose, tasks))
+        else:
+            results = list(apply(self.function, tasks))
+        return results, time.perf_counter() - start
+
     def wait(self):
         if self.is_master():
             raise RuntimeError("Master node told to await jobs")
@@ -50,15 +150,33 @@ class MPIPool(object):
                 self.callback = task.callback
                 continue
 
-            if self.callback:
-                def compose(x):
-                    result = self.function(x)
-                    self.callback(x, result)
-                    return result
-                results = list(map(compose, task))
-            else:
-                results = list(map(self.function, task))
-            self.comm.send(results, dest=0, tag=status.tag)
+            if isinstance(task, _chunk):
+                results, elapsed = self._apply_all(task.tasks)
+                self.comm.send((task.start, results, elapsed), dest=0, tag=status.tag)
+                continue
+
+            results, elapsed = self._apply_all(task)
+            self.comm.send((results, elapsed), dest=0, tag=status.tag)
+
+    def _send_function(self, function, callback):
+        if function is not self.function or callback is not self.callback:
+            self.function = function
+            self.callback = callback
+            F = _function_wrapper(function, callback)
+            for i in range(1, self.size):
+                self.comm.send(F, dest=i)
+
+    def _drain(self):
+        # Throw away the results of chunks from an abandoned iteration.
+        status = self.MPI.Status()
+        while self.outstanding:
+            self.comm.recv(source=self.MPI.ANY_SOURCE, status=status)
+            self._chunk_done(status.source)
+
+    def _chunk_done(self, rank):
+        # The result of the oldest chunk sent to rank has been read.
+        self.sends[rank].popleft().wait()
+        self.outstanding -= 1
 
     def map(self, function, tasks, callback=None):
         # Should be called by the master only
@@ -67,41 +185,191 @@ class MPIPool(object):
             return
 
         tasks= list(tasks)
-        # send function if necessary
-        if function is not self.function or callback is not self.callback:
-            self.function = function
-            self.callback = callback
-            F = _function_wrapper(function, callback)
-            requests = [self.comm.send(F, dest=i)
-                        for i in range(1, self.size)]
-            #self.MPI.Request.waitall(requests)
+        self._drain()
+        self._send_function(function, callback)
+
+        start = time.perf_counter()
+        if self.schedule == "dynamic" and self.size > 1:
+            results = [None] * len(tasks)
+            for first, chunk_results in self._imap_chunks(tasks, len(tasks), None):
+                results[first:first + len(chunk_results)] = chunk_results
+        else:
+            results = self._map_static(tasks)
+        self.map_time += time.perf_counter() - start
+        return results
+
+    def imap_unordered(self, function, tasks, max_in_flight=None, callback=None):
+        u"""Apply `function` to each of `tasks`, yielding (i, result) pairs as they finish, where i is the position of the task.
+
+        `tasks` may be any iterable, and is only read as tasks are handed
+        out.  Each worker is sent up to `prefetch` chunks ahead, and at
+        most `max_in_flight` tasks, if given, are out at a time.  Only one
+        such iteration should be in progress at a time; the results of one
+        that is abandoned are thrown away before the next starts.
+
+        """
+        if not self.is_master():
+            self.wait()
+            return
+        self._drain()
+        self._send_function(function, callback)
+        n = len(tasks) if hasattr(tasks, "__len__") else None
+        start = time.perf_counter()
+        try:
+            for first, chunk_results in self._imap_chunks(tasks, n, max_in_flight):
+                for i, result in enumerate(chunk_results, first):
+                    yield i, result
+        finally:
+            self.map_time += time.perf_counter() - start
+
+    def imap(self, function, tasks, max_in_flight=None, callback=None):
+        u"""Like :meth:`imap_unordered`, but yield just the results, in the order of the tasks."""
+        return in_order(self.imap_unordered(function, tasks, max_in_flight, callback))
+
+    def _record(self, rank, ntasks, elapsed):
+        self.tasks_done[rank] += ntasks
+        self.chunks_done[rank] += 1
+        self.busy_time[rank] += elapsed
+        if ntasks:
+            # A running mean that follows drifts in the cost of tasks,
+            # for example as a sampler moves around parameter space.
+            t = elapsed / ntasks
+            self.task_time = t if self.task_time is None else 0.8 * self.task_time + 0.2 * t
+
+    def master_works(self):
+        u"""Return True if the master does some of the tasks itself."""
+        return not self.dispatch_only or self.size == 1
+
+    def _map_static(self, tasks):
+        # The ranks that share the tasks, and where each one's
+        # share starts.
+        first = 0 if self.master_works() else 1
+        nshare = self.size - first
 
         # distribute tasks to workers
         requests = []
         for i in range(1, self.size):
-            req = self.comm.send(tasks[i::self.size], dest=i)
+            req = self.comm.send(tasks[i-first::nshare], dest=i)
             requests.append(req)
 
         # process local work
         results = [None]*len(tasks)
-
-        if self.callback:
-            def compose(x):
-                result = self.function(x)
-                self.callback(x, result)
-                return result
-            results[::self.size] = list(map(compose, tasks[::self.size]))
-        else:
-            results[::self.size] = list(map(self.function, tasks[::self.size]))
+        if first == 0:
+            results[::nshare], elapsed = self._apply_all(tasks[::nshare])
+            self._record(0, len(results[::nshare]), elapsed)
 
         # recover results from workers (in any order)
         status = self.MPI.Status()
         for i in range(self.size-1):
-            result = self.comm.recv(source=self.MPI.ANY_SOURCE,
-                                    status=status)
-            results[status.source::self.size] = result
+            result, elapsed = self.comm.recv(source=self.MPI.ANY_SOURCE,
+                                             status=status)
+            results[status.source-first::nshare] = result
+            self._record(status.source, len(result), elapsed)
         return results
 
+    def chunk_size(self, remaining):
+        u"""Return the number of tasks to send in the next chunk, when `remaining` (or an unknown number, if None) are not yet sent."""
+        if self.task_time is None:
+            n = 1
+        else:
+            n = int(self.chunk_time / max(self.task_time, 1e-9))
+        if remaining is None:
+            return max(self.threads, n)
+        # Guided scheduling: never more than a share of what is left,
+        # so that the chunks get smaller as the map nears its end.
+        share = -(-remaining // (2 * self.size))
+        # But enough to keep every thread of a rank busy.
+        return max(1, min(n, share), min(self.threads, remaining))
+
+    def _imap_chunks(self, tasks, n, max_in_flight):
+        # Yield (start, results) for runs of consecutive tasks from the
+        # iterable tasks, of which there are n (None if not known), as
+        # they are done.  The workers are topped up with chunks before
+        # each yield, so that they carry on while the caller works.
+        tasks = iter(tasks)
+        sent = 0
+        in_flight = 0
+        exhausted = False
+        pending = [0] * self.size
+        ranks = list(range(1, self.size))
+
+        def take(k):
+            nonlocal sent, exhausted
+            chunk = list(itertools.islice(tasks, k))
+            start = sent
+            sent += len(chunk)
+            if len(chunk) < k or sent == n:
+                exhausted = True
+            return start, chunk
+
+        def top_up(ranks):
+            # Send chunks a round at a time, so that every rank has one
+            # before any has two.
+            nonlocal in_flight
+            for level in range(self.prefetch):
+                for rank in ranks:
+                    if pending[rank] > level:
+                        continue
+                    if exhausted:
+                        return
+                    k = self.chunk_size(None if n is None else n - sent)
+                    if max_in_flight is not None:
+                        if in_flight >= max_in_flight:
+                            return
+                        k = min(k, max_in_flight - in_flight)
+                    start, chunk = take(k)
+                    if not chunk:
+                        return
+                    # Non-blocking, so that a large chunk does not hold up the
+                    # master until the worker has finished its previous one.
+                    self.sends[rank].append(self.comm.isend(_chunk(start, chunk), dest=rank))
+                    pending[rank] += 1
+                    in_flight += len(chunk)
+                    self.outstanding += 1
+
+        top_up(ranks)
+        master_works = self.master_works()
+        status = self.MPI.Status()
+        while True:
+            if master_works and not exhausted and not self.comm.Iprobe(source=self.MPI.ANY_SOURCE, status=status):
+                # No worker is waiting, so do one task (per thread) here.
+                start, chunk = take(self.threads)
+                if chunk:
+                    chunk_results, elapsed = self._apply_all(chunk)
+                    self._record(0, len(chunk), elapsed)
+                    yield start, chunk_results
+                continue
+            if not in_flight:
+                break
+            start, chunk_results, elapsed = self.comm.recv(source=self.MPI.ANY_SOURCE, status=status)
+            rank = status.source
+            pending[rank] -= 1
+            in_flight -= len(chunk_results)
+            self._chunk_done(rank)
+            self._record(rank, len(chunk_results), elapsed)
+            top_up([rank] + ranks)
+            yield start, chunk_results
+
+    def utilization(self):
+        u"""Return, for each rank, a dict of the tasks and chunks it did, the seconds it spent on them, and that time as a fraction of the time spent in map."""
+        return [{"rank": rank,
+                 "tasks": self.tasks_done[rank],
+                 "chunks": self.chunks_done[rank],
+                 "busy": self.busy_time[rank],
+                 "utilization": self.busy_time[rank] / self.map_time if self.map_time else 0.0}
+                for rank in range(self.size)]
+
+    def utilization_report(self):
+        u"""Return a table of :meth:`utilization`, as text."""
+        schedule = self.schedule + (", dispatch only" if self.dispatch_only else "")
+        if self.threads > 1:
+            schedule += ", {} threads per rank".format(self.threads)
+        lines = ["MPI pool ({} schedule): {:.1f}s in map".format(schedule, self.map_time),
+                 "{:>6} {:>10} {:>8} {:>10} {:>12}".format("rank", "tasks", "chunks", "busy (s)", "utilization")]
+        for u in self.utilization():
+            lines.append("{rank:>6} {tasks:>10} {chunks:>8} {busy:>10.1f} {utilization:>11.1%}".format(**u))
+        return "\n".join(lines)
+
     def gather(self, data, root=0):
         return self.comm.gather(data, root)
 
@@ -116,8 +384,9 @@ class MPIPool(object):
 
     def close(self):
         if self.is_master():
-            for i in range(1, self.size):
-                self.comm.isend(_close_pool_message(), dest=i)
+            self._drain()
+            self.MPI.Request.waitall([self.comm.isend(_close_pool_message(), dest=i)
+                                      for i in range(1, self.size)])
 
     def __enter__(self):
         return self
@@ -8,6 +8,8 @@ import sys
 import numpy as np
 import time
 import collections
+import concurrent.futures
+import threading
 import warnings
 import traceback
 from . import config
@@ -15,7 +17,10 @@ from . import parameter
 from . import prior
 from . import module
 from . import logs
+from . import profiling
+from .module_graph import ModuleGraph
 from ..datablock.cosmosis_py import block, section_names
+from ..datablock.cosmosis_py.block import BlockError, ScalarKeys
 try:
     import faulthandler
     faulthandler.enable()
@@ -45,6 +50,8 @@ class PipelineResults(object):
 
 PIPELINE_INI_SECTION = "pipeline"
 NO_LIKELIHOOD_NAMES = "no_likelihood_names_sentinel"
+# The largest capacity a block's access log can be given.
+MAX_LOG_CAPACITY = 2**31 - 1
 
 class MissingLikelihoodError(Exception):
 
@@ -71,22 +78,50 @@ class MissingLikelihoodError(Exception):
         self.pipeline_data = data
 
 
-class LimitedSizeDict(collections.OrderedDict):
-    "From http://stackoverflow.com/questions/2437617/limiting-the-size-of-a-python-dictionary"
-    def __init__(self, *args, **kwds):
-        self.size_limit = kwds.pop("size_limit", None)
-        collections.OrderedDict.__init__(self, *args, **kwds)
-        self._check_size_limit()
-
-    def __setitem__(self, key, value):
-        collections.OrderedDict.__setitem__(self, key, value)
-        self._check_size_limit()
-
-    def _check_size_limit(self):
+class ByteLimitedCache(collections.OrderedDict):
+    """A least-recently-used cache of blocks, limited by the total size
+    (DataBlock.serialized_size) of the blocks it holds rather than by
+    their number. A block larger than the whole limit is not stored.
+    """
+    def __init__(self, size_limit=None):
+        collections.OrderedDict.__init__(self)
+        self.size_limit = size_limit
+        self.sizes = {}
+        self.total_size = 0
+
+    def get(self, key, default=None):
+        if key not in self:
+            return default
+        self.move_to_end(key)
+        return collections.OrderedDict.__getitem__(self, key)
+
+    def __setitem__(self, key, block):
+        size = block.serialized_size()
+        if key in self:
+            del self[key]
+        if self.size_limit is not None and size > self.size_limit:
+            return
+        collections.OrderedDict.__setitem__(self, key, block)
+        self.sizes[key] = size
+        self.total_size += size
         if self.size_limit is not None:
-            while len(self) > self.size_limit:
+            while self.total_size > self.size_limit:
                 self.popitem(last=False)
 
+    def __delitem__(self, key):
+        collections.OrderedDict.__delitem__(self, key)
+        self.total_size -= self.sizes.pop(key)
+
+    def popitem(self, last=True):
+        key, block = collections.OrderedDict.popitem(self, last=last)
+        self.total_size -= self.sizes.pop(key)
+        return key, block
+
+    def clear(self):
+        collections.OrderedDict.clear(self)
+        self.sizes.clear()
+        self.total_size = 0
+
 
 class SlowSubspaceCache(object):
     """
@@ -94,66 +129,72 @@ class SlowSubspaceCache(object):
     are fast and which are slow, and then caches the results of new sets
     of slow parameters so that if only fast parameters have changed the 
     pipeline can be much faster.
+
+    The state of the block is saved after every module that is followed
+    by one using new parameters (a checkpoint), keyed on the values of
+    all the parameters used up to that point. A run restarts from the
+    deepest checkpoint whose parameters are unchanged, so a change in a
+    parameter used late in the pipeline reruns only the modules from
+    there on, wherever the fast/slow split is. The checkpoints are kept
+    in a cache limited to a total of cache_size_limit bytes.
     """
-    def __init__(self, first_fast_module=None, cache_size_limit=3,):
-        self.current_hash = np.nan
+    def __init__(self, first_fast_module=None, cache_size_limit=None):
         self.analyzed = False
-        self.cache = LimitedSizeDict(size_limit=cache_size_limit)
+        self.cache = ByteLimitedCache(size_limit=cache_size_limit)
         self.first_fast_module = first_fast_module
+        self.current_keys = {}
+        self.first_module = 0
 
     def clear_cache(self):
         self.cache.clear()
-        self.current_hash = np.nan
+        self.current_keys = {}
 
-    def hash_slow_parameters(self, block):
+    def hash_parameters(self, block, keys):
         """This is not a general block hash! 
-        It just looks at the slow parameters.
+        It just looks at the given parameters, which may be of any type,
+        including vectors.
         """
-        pairs = block.keys()
-        pairs.sort()
-        values = []
-        for section,name in pairs:
-            if (section,name) not in self.slow_params:
-                continue
-            value = block[section, name]
-            if not np.isscalar(value):
-                #non-scalar in the block - this must
-                #reflect some feature not coded yet
-                warnings.warn("Vector parameter(s) in the input means that fast-slow split will not work - this can be fixed - please open an issue if it affects you.  Or set fast_slow=F")
-                return np.nan # 
-            values.append(value)
-        values = tuple(values)
-        return hash(values)
+        try:
+            return block.hash_values(keys)
+        except BlockError:
+            # Some parameters are not in this block; hash the ones
+            # that are.
+            return block.hash_values([p for p in keys if p in block])
 
     def start_pipeline(self, initial_block):
         # We may be in the process of analyzing the pipeline
         # the first time.
         if not self.analyzed:
             return 0
-        #
-        new_hash = self.hash_slow_parameters(initial_block)
-        cached = self.cache.get(new_hash)
-        if cached is None:
-            self.current_hash = new_hash
-            first_module = 0
-        else:            
+        # The key of each checkpoint covers all the parameters used
+        # before it.
+        hashes = tuple(self.hash_parameters(initial_block, keys) for keys in self.checkpoint_keys)
+        self.current_keys = {c: (c, hashes[:i+1]) for i, c in enumerate(self.checkpoints)}
+        self.first_module = 0
+        for c in reversed(self.checkpoints):
+            cached = self.cache.get(self.current_keys[c])
+            if cached is None:
+                continue
             # Now we need to use the old cached results in the new block.
             # We put everything from the old block into the new block,
-            # EXCEPT for the fast parameters themselves.
+            # EXCEPT for the parameters first used from here on.
+            later_params = self.later_params[c]
             for section,name in cached.keys():
-                if (section,name) not in self.fast_params:
+                if (section,name) not in later_params:
                     initial_block[section,name] = cached[section,name]
-            first_module = self.split_index
-        return first_module
+            self.first_module = c
+            break
+        return self.first_module
 
     def next_module_results(self, module_index, block):
         if not self.analyzed:
             return
-
-        if module_index != self.split_index-1:
+        # Save a checkpoint after the module if the next one starts a
+        # new level, unless we have just restarted from it.
+        key = self.current_keys.get(module_index+1)
+        if key is None or module_index+1 <= self.first_module:
             return
-
-        self.cache[self.current_hash] = block.clone()
+        self.cache[key] = block.clone()
 
     def analyze_pipeline(self, pipeline, all_params=False, grid=False):
         """
@@ -186,13 +227,26 @@ class SlowSubspaceCache(object):
         original_timing = pipeline.timing
         pipeline.timing = True
         #Also get the datablock since it contains a log
-        #of all the parameter accesses
-        _, _, block = pipeline.posterior(start, return_data=True)
-        pipeline.timing = original_timing
+        #of all the parameter accesses, which we need in full
+        #The log must hold the whole run, since the first use of each
+        #parameter is near its start, so it is given the largest capacity
+        #it can have (its storage only grows as needed).
+        original_access_log = pipeline.access_log
+        original_log_capacity = pipeline.log_capacity
+        pipeline.access_log = "full"
+        pipeline.log_capacity = MAX_LOG_CAPACITY
+        try:
+            _, _, block = pipeline.posterior(start, return_data=True)
+        finally:
+            pipeline.timing = original_timing
+            pipeline.access_log = original_access_log
+            pipeline.log_capacity = original_log_capacity
         timings = pipeline.timings
 
         if timings is None:
             raise ValueError("Pipeline did not complete, so cannot do fast/slow")
+        if block.get_log_count() >= MAX_LOG_CAPACITY:
+            raise ValueError("The access log overflowed, so cannot do fast/slow")
 
         #Now we have the datablock, which has the log in it, and the timing.
         #The only information that can be of relevance is the fraction
@@ -254,6 +308,19 @@ class SlowSubspaceCache(object):
         self.fast_modules = len(pipeline.modules) - self.slow_modules
         self.slow_params = sum(list(first_use.values())[:self.split_index], [])
         self.fast_params = sum(list(first_use.values())[self.split_index:], [])
+        # Checkpoints are kept before every module that uses new
+        # parameters (and before the first fast module).
+        n = len(pipeline.modules)
+        self.checkpoints = sorted({i for i in range(1, n) if first_use_count[i] > 0} |
+                                  ({self.split_index} if 0 < self.split_index < n else set()))
+        groups = list(first_use.values())
+        self.checkpoint_keys = []
+        self.later_params = {}
+        start = 0
+        for c in self.checkpoints:
+            self.checkpoint_keys.append(ScalarKeys(sorted(sum(groups[start:c], []))))
+            self.later_params[c] = set(sum(groups[c:], []))
+            start = c
 
         if self.worth_splitting:
             print("")
@@ -360,9 +427,27 @@ class Pipeline(object):
         self.root_directory = self.options.get("runtime", "root", fallback=os.getcwd())
         self.run_count = 0
         self.run_count_ok = 0
+        # Guards the counts, and other state shared by runs, when
+        # several threads run the pipeline at once.
+        self.run_lock = threading.Lock()
 
         self.debug = self.options.getboolean(PIPELINE_INI_SECTION, "debug", fallback=False)
         self.timing = self.options.getboolean(PIPELINE_INI_SECTION, "timing", fallback=False)
+        # How much of the access to each block is logged: full, failures, or off.
+        self.access_log = self.options.get(PIPELINE_INI_SECTION, "access_log", fallback="full")
+        if self.access_log not in block.LOG_MODES:
+            raise ValueError("The access_log option in [pipeline] should be one of {}, not {}".format(
+                ", ".join(block.LOG_MODES), self.access_log))
+        # The number of entries the log of each block holds, if not the
+        # default (see DataBlock.set_log_capacity).
+        self.log_capacity = None
+        # Whether the block for each sample reuses the blocks from
+        # earlier samples, once they are no longer referenced, and their
+        # storage, rather than allocating afresh.
+        if self.options.getboolean(PIPELINE_INI_SECTION, "block_pool", fallback=False):
+            self.block_pool = block.BlockPool()
+        else:
+            self.block_pool = None
         shortcut = self.options.get(PIPELINE_INI_SECTION, "shortcut", fallback="")
         if shortcut=="":
             shortcut=None
@@ -373,6 +458,47 @@ class Pipeline(object):
             self.do_fast_slow = False
         self.slow_subspace_cache = None #until set in method
         self.first_fast_module = self.options.get(PIPELINE_INI_SECTION, "first_fast_module", fallback="")
+        # The memory, in MB, used by the blocks saved for the fast/slow split.
+        self.fast_slow_cache_mb = self.options.getfloat(PIPELINE_INI_SECTION, "fast_slow_cache_mb", fallback=500.0)
+
+        # Whether to skip running modules that declare their inputs
+        # when none of those has changed since their last run, and
+        # instead restore the values they wrote then.
+        self.skip_unchanged = self.options.getboolean(PIPELINE_INI_SECTION, "skip_unchanged", fallback=False)
+        self.unchanged_outputs = {}
+
+        # The number of threads on which modules that do not depend on
+        # each other are run at once; 1 runs every module in sequence.
+        # The dependencies are found from the access log of the first
+        # complete run (see module_graph.py).
+        self.parallel_modules = self.options.getint(PIPELINE_INI_SECTION, "parallel_modules", fallback=1)
+        if self.parallel_modules > 1 and (self.do_fast_slow or shortcut or self.skip_unchanged):
+            sys.stderr.write("Warning: the parallel_modules option cannot be used with fast_slow, shortcut or skip_unchanged; running modules in sequence\n")
+            self.parallel_modules = 1
+        self.module_graph = None
+        self.module_executor = None
+
+        # The number of threads in each process that may run the whole
+        # pipeline at once, each on its own sample, in the hybrid MPI and
+        # threads mode (the [runtime] threads option; see MPIPool).  The
+        # threads share the modules and the data they loaded in setup,
+        # so a module not marked `thread_safe` is only ever run by one
+        # thread at a time.
+        self.threads = self.options.getint("runtime", "threads", fallback=1)
+        if self.threads > 1 and (self.do_fast_slow or shortcut or self.skip_unchanged or self.block_pool):
+            sys.stderr.write("Warning: the threads option cannot be used with fast_slow, shortcut, skip_unchanged or block_pool; using one thread\n")
+            self.threads = 1
+
+        # The base name of the files to which a profile of the modules
+        # is written at the end of the run (see profiling.py), if any.
+        # The profiler measures each module by what changes in the block
+        # and the process while it runs, which cannot be told apart when
+        # several modules run at once.
+        self.profile_output = self.options.get(PIPELINE_INI_SECTION, "profile", fallback="")
+        if self.profile_output and (self.parallel_modules > 1 or self.threads > 1):
+            sys.stderr.write("Warning: the profile option cannot be used with parallel_modules or threads; not profiling\n")
+            self.profile_output = ""
+        self.profiler = profiling.ModuleProfiler() if self.profile_output else None
 
         # initialize modules
         self.modules = []
@@ -411,6 +537,12 @@ class Pipeline(object):
             self.shortcut_module=0
             self.shortcut_data=None
 
+        self.module_locks = {}
+        if self.threads > 1:
+            for i, m in enumerate(self.modules):
+                if not getattr(m, "thread_safe", False):
+                    self.module_locks[i] = threading.Lock()
+
 
 
     def find_module_file(self, path):
@@ -477,7 +609,8 @@ class Pipeline(object):
             else:
                 first_fast_index = None
 
-            self.slow_subspace_cache = SlowSubspaceCache(first_fast_module=first_fast_index)
+            self.slow_subspace_cache = SlowSubspaceCache(first_fast_module=first_fast_index,
+                cache_size_limit=int(self.fast_slow_cache_mb * 1e6))
             self.slow_subspace_cache.analyze_pipeline(self, all_params=all_params, grid=grid)
 
             if not self.slow_subspace_cache.worth_splitting:
@@ -511,6 +644,9 @@ class Pipeline(object):
 
     def cleanup(self):
         u"""Call every `module`ʼs `cleanup` method."""
+        if self.module_executor is not None:
+            self.module_executor.shutdown()
+            self.module_executor = None
         for module in self.modules:
             module.cleanup()
 
@@ -583,6 +719,11 @@ class Pipeline(object):
     def run(self, data_package):
         u"""Run every module, in sequence, on DataBlock `data_package`.
 
+        If the `parallel_modules` option is set, modules that do not
+        depend on each other are instead run at the same time, once the
+        first run has shown what they read and write (see
+        :meth:`run_parallel`).
+
         Apart from that the function goes to a lot of effort to provide
         run-time diagnostic information to the user.
 
@@ -596,8 +737,8 @@ class Pipeline(object):
         as the initial parameter vector.
 
         """
-        self.run_count += 1
-        modules = self.modules
+        with self.run_lock:
+            self.run_count += 1
         if self.timing:
             self.timings = None
 
@@ -621,67 +762,215 @@ class Pipeline(object):
         if self.timing:
             start_time = time.time()
 
-        for module_number, module in enumerate(modules):
-            if module_number<first_module:
-                continue
-            logs.noisy(f"Running module {module}")
-            data_package.log_access("MODULE-START", module.name, "")
-            if self.timing:
-                t1 = time.time()
+        # The first complete run, with the whole log kept, shows which
+        # modules may run in parallel in the runs after it.
+        learn_graph = self.parallel_modules > 1 and self.module_graph is None and first_module == 0
+        if learn_graph:
+            log_mode = data_package.get_log_mode()
+            data_package.set_log_mode("full")
 
-            status = module.execute(data_package)
+        if self.module_graph is not None and first_module == 0:
+            status = self.run_parallel(data_package, timings)
+        else:
+            status = self.run_sequential(data_package, first_module, timings)
+
+        if learn_graph:
+            if not status:
+                self.learn_module_graph(data_package)
+            data_package.set_log_mode(log_mode)
+
+        if status:
+            if logs.is_enabled_for(logs.logging.DEBUG):
+                data_package.print_log()
+                logs.noisy("Because you set debug verbosity I printed a log of "
+                               "all access to data printed above. "
+                               "Look for the word 'FAIL' \n"
+                               "Though the error message could also be "
+                               "somewhere above that.\n")
+
+            logs.warning(f"Error running pipeline ({status}). Returning zero likelihood. Error may be above.")
+            if not logs.is_enabled_for(logs.logging.DEBUG):
+                logs.warning("Set log level to 'debug' for more info.")
+            return None
 
-            if status is None:
-                raise ValueError(("A module you ran, '{}', did not return a proper status value.\n"+
-                    "It should return an integer, 0 if everything worked.\n"+
-                    "Sorry to be picky but this kind of thing is important.").format(module))
+        if self.timing:
+            end_time = time.time()
+            sys.stdout.write("Total pipeline time: {:.3} seconds\n".format(end_time-start_time))
+            self.timings = timings
 
-            logs.noisy("Done %.20s status = %d \n" % (module,status))
+        logs.noisy("Pipeline ran okay.")
+        with self.run_lock:
+            self.run_count_ok += 1
 
-            if self.timing:
-                t2 = time.time()
-                timings.append(t2-t1)
-                sys.stdout.write("%s took: %.3f seconds\n"% (module,t2-t1))
+        data_package.log_access("MODULE-START", "Results", "")
+        # return something
+        self.has_run = True
+        return True
+
+    def run_sequential(self, data_package, first_module, timings):
+        u"""Run the modules from `first_module` onwards, in sequence, on `data_package`.
+
+        Return the status of the first module to fail, or 0 if all
+        succeed.  The time taken by each module is appended to `timings`.
 
+        """
+        for module_number, module in enumerate(self.modules):
+            if module_number<first_module:
+                continue
+            status, duration = self.execute_module(module_number, module, data_package)
+            timings.append(duration)
             if status:
-                if logs.is_enabled_for(logs.logging.DEBUG):
-                    data_package.print_log()
-                    logs.noisy("Because you set debug verbosity I printed a log of "
-                                   "all access to data printed above. "
-                                   "Look for the word 'FAIL' \n"
-                                   "Though the error message could also be "
-                                   "somewhere above that.\n")
-
-                logs.warning(f"Error running pipeline ({status}). Returning zero likelihood. Error may be above.")
-                if not logs.is_enabled_for(logs.logging.DEBUG):
-                    logs.warning("Set log level to 'debug' for more info.")
-                return None
+                return status
 
-            # If we are using a fast/slow split (and we are not already running on a cached subset)
-            # Then see if it wants to cache these results
-            if self.slow_subspace_cache and first_module==0:
+            # If we are using a fast/slow split then see if it wants to
+            # cache these results
+            if self.slow_subspace_cache:
                 self.slow_subspace_cache.next_module_results(module_number, data_package)
 
             # Alternatively we will do the shortcut thing
             elif self.shortcut_module and (not self.has_run) and module_number==self.shortcut_module-1:
                 print("Saving shortcut data")
                 self.shortcut_data = data_package.clone()
+        return 0
+
+    def run_parallel(self, data_package, timings):
+        u"""Run the modules on `data_package`, each as soon as those it depends on have finished.
+
+        Modules are run on a pool of `parallel_modules` threads, with the
+        block in concurrent mode; those that release the GIL (C, C++ and
+        Fortran modules, and much of numpy) then run at the same time.
+        The dependencies of :attr:`module_graph` make the resulting block
+        the same as that of :meth:`run_sequential`, whatever the order
+        in which the modules finish.  That is true of failures too: once
+        a module fails, only the modules before it in the pipeline are
+        started, and the status returned is that of the first module, in
+        pipeline order, to fail.
 
+        """
+        graph = self.module_graph
+        n = len(self.modules)
+        remaining = [len(d) for d in graph.dependencies]
+        ready = [i for i in range(n) if remaining[i] == 0]
+        statuses = [None] * n
+        durations = [None] * n
+        first_failure = n
+        running = {}
+        data_package.set_concurrent(True)
+        try:
+            while ready or running:
+                for i in ready:
+                    if i < first_failure:
+                        future = self.module_executor.submit(
+                            self.execute_module, i, self.modules[i], data_package)
+                        running[future] = i
+                ready = []
+                if not running:
+                    break
+                done, _ = concurrent.futures.wait(running, return_when=concurrent.futures.FIRST_COMPLETED)
+                for future in done:
+                    i = running.pop(future)
+                    statuses[i], durations[i] = future.result()
+                    if statuses[i]:
+                        first_failure = min(first_failure, i)
+                        continue
+                    for j in graph.dependents[i]:
+                        remaining[j] -= 1
+                        if remaining[j] == 0:
+                            ready.append(j)
+                ready.sort()
+        finally:
+            # No module may still be using the block when it leaves
+            # concurrent mode, even if another raised an exception.
+            concurrent.futures.wait(running)
+            data_package.set_concurrent(False)
+
+        timings.extend(d for d in durations[:first_failure + 1] if d is not None)
+        return statuses[first_failure] if first_failure < n else 0
+
+    def learn_module_graph(self, data_package):
+        u"""Find the dependencies between modules from the log of `data_package`, just run through them all."""
+        with self.run_lock:
+            # Another thread may have got there first.
+            if self.module_graph is None and self.parallel_modules > 1:
+                self._learn_module_graph(data_package)
+
+    def _learn_module_graph(self, data_package):
+        graph = ModuleGraph.from_block(data_package, self.modules)
+        if graph is None:
+            logs.warning("The access log did not record every module, so modules will be run in sequence")
+            self.parallel_modules = 1
+            return
+        logs.noisy("Module dependencies:\n" + graph.describe(self.modules))
+        if graph.width() < 2:
+            logs.overview("No modules in the pipeline are independent of each other, so they will be run in sequence")
+            self.parallel_modules = 1
+            return
+        self.module_graph = graph
+        self.module_executor = concurrent.futures.ThreadPoolExecutor(
+            max_workers=self.parallel_modules, thread_name_prefix="cosmosis-module")
+
+    def execute_module(self, module_number, module, data_package):
+        u"""Run one module on `data_package`, and return its status and the time it took."""
+        logs.noisy(f"Running module {module}")
+        data_package.log_access("MODULE-START", module.name, "")
+        t1 = time.time()
+
+        input_hash = self.hash_module_inputs(module, data_package) if self.skip_unchanged else None
+        cached = self.unchanged_outputs.get(module_number) if input_hash is not None else None
+        if cached is not None and cached[0] == input_hash:
+            logs.noisy(f"Inputs to {module} unchanged; reusing its outputs")
+            for key, value in cached[1].items():
+                data_package[key] = value
+            status = 0
+        else:
+            mark = data_package.mark()
+            if self.profiler:
+                state = self.profiler.start(data_package)
+            lock = self.module_locks.get(module_number)
+            if lock is None:
+                status = module.execute(data_package)
+            else:
+                with lock:
+                    status = module.execute(data_package)
+            if self.profiler:
+                self.profiler.stop(module, data_package, state, status)
+            if input_hash is not None and status == 0:
+                outputs = {key: data_package[key] for key in data_package.changed_since(mark)}
+                self.unchanged_outputs[module_number] = (input_hash, outputs)
+
+        if status is None:
+            raise ValueError(("A module you ran, '{}', did not return a proper status value.\n"+
+                "It should return an integer, 0 if everything worked.\n"+
+                "Sorry to be picky but this kind of thing is important.").format(module))
+
+        logs.noisy("Done %.20s status = %d \n" % (module,status))
+
+        t2 = time.time()
         if self.timing:
-            end_time = time.time()
-            sys.stdout.write("Total pipeline time: {:.3} seconds\n".format(end_time-start_time))
-            self.timings = timings
+            sys.stdout.write("%s took: %.3f seconds\n"% (module,t2-t1))
+        return status, t2-t1
 
-        logs.noisy("Pipeline ran okay.")
-        self.run_count_ok += 1
+    def hash_module_inputs(self, module, data_package):
+        u"""Return a hash of the inputs that `module` declares, or None.
 
-        data_package.log_access("MODULE-START", "Results", "")
-        # return something
-        self.has_run = True
-        return True
+        None is returned if the module declares no inputs, or if one of
+        them is missing from `data_package`, in which case it is always
+        run.
+
+        """
+        if module.inputs is None:
+            return None
+        values, sections = module.inputs
+        try:
+            return (data_package.hash_values(values),
+                    data_package.hash(sections) if sections else None)
+        except BlockError:
+            return None
 
     def clear_cache(self):
-        self.slow_subspace_cache.clear_cache()
+        if self.slow_subspace_cache:
+            self.slow_subspace_cache.clear_cache()
+        self.unchanged_outputs.clear()
 
 
 
@@ -1072,20 +1361,28 @@ class LikelihoodPipeline(Pipeline):
             if self.is_out_of_range(p):
                 return None
 
-        data = block.DataBlock()
+        data = block.DataBlock(pool=self.block_pool)
+        data.set_log_mode(self.access_log)
+        if self.log_capacity is not None:
+            data.set_log_capacity(self.log_capacity)
 
         if all_params:
-            for param, x in zip(self.parameters, p):
-                data[param.section, param.name] = x
+            values = list(zip(self.parameters, p))
         else:
-            # add varied parameters
-            for param, x in zip(self.varied_params, p):
+            # varied parameters, then fixed ones
+            values = list(zip(self.varied_params, p))
+            values += [(param, param.start) for param in self.fixed_params]
+
+        # Put the floating-point values in a single call into the C
+        # library.  Others, like integer fixed parameters, keep their
+        # types, so they are put one at a time.
+        doubles = [(param, x) for param, x in values if isinstance(x, float)]
+        data.put_many([(param.section, param.name) for param, _ in doubles],
+                      [x for _, x in doubles])
+        for param, x in values:
+            if not isinstance(x, float):
                 data[param.section, param.name] = x
 
-            # add fixed parameters
-            for param in self.fixed_params:
-                data[param.section, param.name] = param.start
-
         return data
 
 
@@ -1279,16 +1576,15 @@ class LikelihoodPipeline(Pipeline):
 
         section_name = section_names.likelihoods
 
-        # loop through named likelihoods and sum their values
-        likelihoods = []
-        for likelihood_name in self.likelihood_names:
-            try:
-                L = data.get_double(section_name,likelihood_name+"_like")
-                likelihoods.append(L)
-                logs.noisy(f"Likelihood {likelihood_name} = {L}")
-            # Complain if not found
-            except block.BlockError:
-                raise MissingLikelihoodError(likelihood_name, data)
+        # read all the named likelihoods at once, and sum their values
+        keys = [(section_name, likelihood_name+"_like") for likelihood_name in self.likelihood_names]
+        try:
+            likelihoods = data.get_many(keys)
+        # Complain if one is not found
+        except block.BlockError as error:
+            raise MissingLikelihoodError(error.name[:-len("_like")], data)
+        for likelihood_name, L in zip(self.likelihood_names, likelihoods):
+            logs.noisy(f"Likelihood {likelihood_name} = {L}")
 
         # Total likelihood
         like = sum(likelihoods)
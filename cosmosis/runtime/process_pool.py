@@ -1,23 +1,280 @@
 import multiprocessing
+import multiprocessing.connection
 import os
+import pickle
+import struct
+import traceback
+import numpy as np
+from ..utils import in_order
+
+# The kinds of reply a worker sends for a task.
+_SHARED = 0
+_PICKLED = 1
+_ERROR = 2
+
+
+class _Unpackable(Exception):
+    pass
+
+
+class _RemoteTraceback(Exception):
+    def __init__(self, tb):
+        self.tb = tb
+
+    def __str__(self):
+        return "\n\nIn the pool worker:\n" + self.tb
+
+
+def _pack(obj, buf, offset):
+    # Write the numbers in obj to the uint8 array buf, starting at offset,
+    # and return a description of the structure of obj and the offset
+    # after it.  Raise _Unpackable if obj is not made of numbers, None,
+    # numeric arrays, tuples and lists, or if it does not fit.
+    if obj is None:
+        return "n", offset
+    if isinstance(obj, bool) or isinstance(obj, np.bool_):
+        raise _Unpackable()
+    if isinstance(obj, (float, np.floating)):
+        if offset + 8 > len(buf):
+            raise _Unpackable()
+        struct.pack_into("d", buf, offset, obj)
+        return "f", offset + 8
+    if isinstance(obj, (int, np.integer)):
+        if offset + 8 > len(buf):
+            raise _Unpackable()
+        try:
+            struct.pack_into("q", buf, offset, obj)
+        except struct.error:
+            raise _Unpackable()
+        return "i", offset + 8
+    if isinstance(obj, np.ndarray):
+        if obj.dtype.kind not in "biufc":
+            raise _Unpackable()
+        end = offset + obj.nbytes
+        if end > len(buf):
+            raise _Unpackable()
+        buf[offset:end] = np.ascontiguousarray(obj).reshape(-1).view(np.uint8)
+        # Keep the next value aligned.
+        return ("a", obj.dtype.str, obj.shape), (end + 7) & ~7
+    if isinstance(obj, (tuple, list)):
+        specs = []
+        for item in obj:
+            spec, offset = _pack(item, buf, offset)
+            specs.append(spec)
+        return ("t" if isinstance(obj, tuple) else "l", specs), offset
+    raise _Unpackable()
+
+
+def _unpack(spec, buf, offset):
+    # The inverse of _pack, copying arrays out of buf.
+    if spec == "n":
+        return None, offset
+    if spec == "f":
+        return struct.unpack_from("d", buf, offset)[0], offset + 8
+    if spec == "i":
+        return struct.unpack_from("q", buf, offset)[0], offset + 8
+    kind = spec[0]
+    if kind == "a":
+        dtype = np.dtype(spec[1])
+        shape = spec[2]
+        end = offset + dtype.itemsize * int(np.prod(shape, dtype=np.int64))
+        value = buf[offset:end].view(dtype).reshape(shape).copy()
+        return value, (end + 7) & ~7
+    items = []
+    for item_spec in spec[1]:
+        item, offset = _unpack(item_spec, buf, offset)
+        items.append(item)
+    return (tuple(items) if kind == "t" else items), offset
+
+
+def _worker(function, tasks, results, lock, ring, slot_size):
+    buf = np.frombuffer(ring, dtype=np.uint8)
+    while True:
+        message = tasks.get()
+        if message is None:
+            break
+        index, slot, task = message
+        try:
+            result = function(task)
+        except Exception as error:
+            tb = traceback.format_exc()
+            try:
+                pickle.dumps(error)
+            except Exception:
+                error = RuntimeError(str(error))
+            reply = (index, slot, _ERROR, (error, tb))
+        else:
+            slot_buf = buf[slot * slot_size:(slot + 1) * slot_size]
+            try:
+                spec, _ = _pack(result, slot_buf, 0)
+                reply = (index, slot, _SHARED, spec)
+            except _Unpackable:
+                reply = (index, slot, _PICKLED, result)
+        with lock:
+            try:
+                results.send(reply)
+            except Exception as error:
+                results.send((index, slot, _ERROR, (RuntimeError(str(error)), traceback.format_exc())))
 
 
 class Pool(object):
-    def __init__(self, processes):
+    u"""A pool of forked processes on this machine, used by the --smp option.
+
+    The workers are forked the first time a function is mapped, so that
+    each inherits the loaded pipeline and any state the sampler set up
+    beforehand, and are kept for later maps with the same function, in
+    which only the tasks are sent to them.  Mapping a
+    different function, or calling :meth:`close` (as is done at the end of
+    each sampler), stops them; they are forked again when next needed.
+
+    Results made of numbers, None, numeric arrays, tuples and lists (like
+    the posterior, prior and derived parameters that samplers return) are
+    passed back through a ring of `slots_per_process * processes` shared
+    memory slots of `slot_size` bytes each, rather than being pickled;
+    other results, or ones that do not fit in a slot, are pickled.  At
+    most one task per slot is handed out at a time, and workers take the
+    next task as soon as they finish one.  :meth:`imap` and
+    :meth:`imap_unordered` yield results as they come, so that the
+    caller can deal with them while the workers go on with the rest.
+
+    """
+    def __init__(self, processes, slot_size=65536, slots_per_process=2):
         self.size = processes
         self.rank = 0
         self.master_pid = os.getpid()
+        self.slot_size = slot_size
+        self.nslot = slots_per_process * processes
+        self.context = multiprocessing.get_context("fork")
+        self.ring = None
+        self.function = None
+        self.workers = []
+        # The number of tasks handed out whose results are not yet read.
+        self.outstanding = 0
+
+        # The number of results passed back each way.
+        self.shared_results = 0
+        self.pickled_results = 0
 
     def is_master(self):
         return self.master_pid == os.getpid()
 
+    def start(self, function):
+        u"""Fork the workers, which will apply `function` to the tasks they are sent."""
+        self.stop()
+        if self.ring is None:
+            self.ring = self.context.RawArray("b", self.nslot * self.slot_size)
+            self.buffer = np.frombuffer(self.ring, dtype=np.uint8)
+        self.function = function
+        self.tasks = self.context.SimpleQueue()
+        self.results, writer = self.context.Pipe(duplex=False)
+        lock = self.context.Lock()
+        self.workers = [
+            self.context.Process(target=_worker, daemon=True,
+                                 args=(function, self.tasks, writer, lock, self.ring, self.slot_size))
+            for _ in range(self.size)
+        ]
+        for worker in self.workers:
+            worker.start()
+        writer.close()
+
+    def stop(self, terminate=False):
+        u"""Stop the workers, if they are running."""
+        if not self.workers:
+            return
+        if not terminate:
+            for _ in self.workers:
+                self.tasks.put(None)
+        for worker in self.workers:
+            if terminate:
+                worker.terminate()
+            worker.join(None if not terminate else 5)
+        self.workers = []
+        self.function = None
+        self.outstanding = 0
+        self.tasks.close()
+        self.results.close()
+
+    def _receive(self):
+        sentinels = [worker.sentinel for worker in self.workers]
+        while True:
+            ready = multiprocessing.connection.wait([self.results] + sentinels)
+            if self.results in ready:
+                return self.results.recv()
+            codes = [worker.exitcode for worker in self.workers if worker.exitcode is not None]
+            if codes:
+                self.stop(terminate=True)
+                raise RuntimeError("A process pool worker exited unexpectedly "
+                                   "(exit code {})".format(codes[0]))
+
+    def imap_unordered(self, function, tasks, max_in_flight=None):
+        u"""Apply `function` to each of `tasks`, yielding (i, result) pairs as they finish, where i is the position of the task.
+
+        `tasks` may be any iterable, and is only read as tasks are handed
+        out.  At most `max_in_flight` tasks (and never more than there are
+        result slots) are out at a time; workers carry on with them while
+        the caller deals with the results already yielded.  Only one such
+        iteration should be in progress at a time; the tasks of one that is
+        abandoned are finished and thrown away before the next starts.
+
+        """
+        self._drain()
+        if not self.workers or function != self.function:
+            self.start(function)
+
+        limit = self.nslot if max_in_flight is None else max(1, min(max_in_flight, self.nslot))
+        free = list(range(limit))
+        tasks = iter(tasks)
+        sent = 0
+        exhausted = False
+        while True:
+            while free and not exhausted:
+                try:
+                    task = next(tasks)
+                except StopIteration:
+                    exhausted = True
+                    break
+                self.tasks.put((sent, free.pop(), task))
+                self.outstanding += 1
+                sent += 1
+            if len(free) == limit:
+                return
+            index, slot, kind, payload = self._receive()
+            self.outstanding -= 1
+            if kind == _ERROR:
+                # Other tasks are still running, so start afresh next time.
+                self.stop(terminate=True)
+                error, tb = payload
+                raise error from _RemoteTraceback(tb)
+            if kind == _SHARED:
+                start = slot * self.slot_size
+                result, _ = _unpack(payload, self.buffer[start:start + self.slot_size], 0)
+                self.shared_results += 1
+            else:
+                result = payload
+                self.pickled_results += 1
+            free.append(slot)
+            yield index, result
+
+    def imap(self, function, tasks, max_in_flight=None):
+        u"""Like :meth:`imap_unordered`, but yield just the results, in the order of the tasks."""
+        return in_order(self.imap_unordered(function, tasks, max_in_flight))
+
     def map(self, function, args):
-        with multiprocessing.Pool(self.size) as pool:
-            results = pool.map(function, args)
+        args = list(args)
+        results = [None] * len(args)
+        for index, result in self.imap_unordered(function, args):
+            results[index] = result
         return results
 
+    def _drain(self):
+        # Throw away the results of tasks from an abandoned iteration.
+        while self.outstanding:
+            self._receive()
+            self.outstanding -= 1
+
     def close(self):
-        pass
+        if self.is_master():
+            self.stop()
 
     def bcast(self, data):
         return self.data
@@ -30,4 +287,4 @@ class Pool(object):
         return self
 
     def __exit__(self, *args):
-        pass        
\ No newline at end of file
+        self.close()
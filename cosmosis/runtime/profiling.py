@@ -0,0 +1,130 @@
+u"""Profiling of the modules in a pipeline.
+
+A :class:`ModuleProfiler` records, for every execution of every module,
+the wall-clock and CPU time it took, the reads and writes it made to
+the block (counted by the DataBlock itself, whatever its log mode), the
+growth in the peak resident memory of the process, and the net number
+of memory blocks allocated by Python.  The totals for each module can be
+written as a JSON report, and the individual executions as a trace in
+the Chrome trace-event format, which can be loaded into chrome://tracing
+or https://ui.perfetto.dev.
+
+It is switched on with the `profile` option in the [pipeline] section,
+which gives the base name of the files to write: `{profile}.json` and
+`{profile}.trace.json` (with the MPI rank appended to the base name
+when running under MPI).  Since the block counts and the process-wide
+measures cannot be divided between modules running at once, it is
+switched off when the `parallel_modules` or [runtime] `threads` options
+are set.
+
+"""
+import json
+import os
+import sys
+import threading
+import time
+
+try:
+    import resource
+except ImportError:
+    resource = None
+
+__all__ = ["ModuleProfiler"]
+
+COUNTS = ["reads", "read_bytes", "writes", "write_bytes"]
+
+
+def peak_rss():
+    u"""Return the peak resident memory of the process so far, in bytes, or 0 if unknown."""
+    if resource is None:
+        return 0
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # Linux reports kilobytes, macOS bytes.
+    return rss if sys.platform == "darwin" else rss * 1024
+
+
+class ModuleProfiler(object):
+    u"""Collects the cost of each module executed by a pipeline.
+
+    Call :meth:`start` just before a module is run on a block and
+    :meth:`stop` just after.  At most `max_events` executions are kept
+    for the trace; the totals include all of them.
+
+    """
+    def __init__(self, max_events=100000):
+        self.max_events = max_events
+        self.totals = {}
+        self.events = []
+        self.dropped_events = 0
+        self.origin = time.perf_counter()
+        self.pid = os.getpid()
+
+    def start(self, block):
+        u"""Return the state to pass to :meth:`stop` after the module has run on `block`."""
+        return (time.perf_counter(), time.process_time(), block.access_counts(),
+                peak_rss(), sys.getallocatedblocks())
+
+    def stop(self, module, block, state, status=0):
+        u"""Record the execution of `module`, begun when :meth:`start` returned `state`."""
+        wall0, cpu0, counts0, rss0, alloc0 = state
+        wall1 = time.perf_counter()
+        record = {
+            "wall": wall1 - wall0,
+            "cpu": time.process_time() - cpu0,
+            "peak_rss_growth": peak_rss() - rss0,
+            "allocated_blocks": sys.getallocatedblocks() - alloc0,
+        }
+        counts1 = block.access_counts()
+        for key in COUNTS:
+            record[key] = counts1[key] - counts0[key]
+
+        name = getattr(module, "name", str(module))
+        totals = self.totals.get(name)
+        if totals is None:
+            totals = self.totals[name] = dict.fromkeys(
+                ["calls", "failures", "wall", "cpu", "max_wall", "peak_rss_growth",
+                 "allocated_blocks"] + COUNTS, 0)
+        totals["calls"] += 1
+        if status:
+            totals["failures"] += 1
+        totals["max_wall"] = max(totals["max_wall"], record["wall"])
+        for key, value in record.items():
+            totals[key] += value
+
+        if len(self.events) < self.max_events:
+            args = dict(record, status=status)
+            self.events.append({
+                "name": name,
+                "cat": "module",
+                "ph": "X",
+                "ts": 1e6 * (wall0 - self.origin),
+                "dur": 1e6 * record["wall"],
+                "pid": self.pid,
+                "tid": threading.get_ident(),
+                "args": args,
+            })
+        else:
+            self.dropped_events += 1
+
+    def report(self):
+        u"""Return the totals for each module, in the order they were first run, as a dict."""
+        modules = []
+        for name, totals in self.totals.items():
+            entry = dict(name=name, **totals)
+            entry["mean_wall"] = totals["wall"] / totals["calls"]
+            modules.append(entry)
+        wall = sum(m["wall"] for m in modules)
+        for m in modules:
+            m["wall_fraction"] = m["wall"] / wall if wall else 0.0
+        return {"pid": self.pid, "modules": modules, "dropped_events": self.dropped_events}
+
+    def trace(self):
+        u"""Return the executions as a Chrome trace-event document."""
+        return {"traceEvents": self.events, "displayTimeUnit": "ms"}
+
+    def write(self, basename):
+        u"""Write the report to `{basename}.json` and the trace to `{basename}.trace.json`."""
+        with open(basename + ".json", "w") as f:
+            json.dump(self.report(), f, indent=2)
+        with open(basename + ".trace.json", "w") as f:
+            json.dump(self.trace(), f)
@@ -11,7 +11,7 @@ def task(p):
             logs.error("Failed to run parameters: {} so not saving".format(p))
         else:
             filename = "{}_{}".format(sampler.save_name, i)
-            r.block.save_to_file(filename, clobber=True)
+            r.block.save(filename, format=sampler.save_format, clobber=True)
 
     return (r.prior, r.post, r.extra)
 
@@ -29,6 +29,7 @@ class AprioriSampler(ParallelSampler):
 
         self.converged = False
         self.save_name = self.read_ini("save", str, "")
+        self.save_format = self.read_ini_choices("save_format", str, ["snapshot", "tgz", "directory"], "snapshot")
         self.nsample = self.read_ini("nsample", int, 1)
         self.n = 0
 
@@ -9,7 +9,7 @@ def task(p):
     results = grid_sampler.pipeline.run_results(p)
     #If requested, save the data to file
     if grid_sampler.save_name and results.block is not None:
-        results.block.save_to_file(grid_sampler.save_name+"_%d"%i, clobber=True)
+        results.block.save(grid_sampler.save_name+"_%d"%i, format=grid_sampler.save_format, clobber=True)
     return (results.post, results.prior, results.extra)
 
 LARGE_JOB_SIZE = 1000000
@@ -28,6 +28,7 @@ class GridSampler(ParallelSampler):
         self.converged = False
         self.nsample = self.read_ini("nsample_dimension", int, 1)
         self.save_name = self.read_ini("save", str, "")
+        self.save_format = self.read_ini_choices("save_format", str, ["snapshot", "tgz", "directory"], "snapshot")
         self.nstep = self.read_ini("nstep", int, -1)
         self.allow_large = self.read_ini("allow_large", bool, False)
         self.sample_points = None
@@ -75,10 +76,17 @@ class GridSampler(ParallelSampler):
         # an iterator that generates the sequence of grid points
         # which is an outer product of the linearly spaced sample
         # points in each dimension.
-        self.sample_points = itertools.product(*[np.linspace(*param.limits,
+        sample_points = itertools.product(*[np.linspace(*param.limits,
                                                        num=self.nsample)
                                             for param in param_order])
 
+        # The pool works through the whole grid as one stream of jobs,
+        # each with an index number in case we are saving the output
+        # results from each one.  We keep a second copy of the points
+        # to save alongside the results as they come in.
+        self.sample_points, job_points = itertools.tee(sample_points)
+        self.results = self.imap(task, enumerate(job_points))
+
 
 
     def execute(self):
@@ -86,27 +94,16 @@ class GridSampler(ParallelSampler):
         if self.sample_points is None:
             self.setup_sampling()
 
-        #Chunk of tasks to do this run through, of size nstep.
-        #This advances the self.sample_points forward so it knows
-        #that these samples have been done
-        samples = list(itertools.islice(self.sample_points, self.nstep))
+        #Chunk of results to save this run through, of size nstep.
+        #The pool carries on with the later jobs in the meantime.
+        results = list(itertools.islice(self.results, self.nstep))
+        samples = list(itertools.islice(self.sample_points, len(results)))
 
         #If there are no samples left then we are done.
-        if not samples:
+        if not results:
             self.converged=True
             return
 
-        #Each job has an index number in case we are saving
-        #the output results from each one
-        sample_index = np.arange(len(samples)) + self.ndone
-        jobs = list(zip(sample_index, samples))
-
-        #Actually compute the likelihood results
-        if self.pool:
-            results = self.pool.map(task, jobs)
-        else:
-            results = list(map(task, jobs))
-
         #Update the count
         self.ndone += len(results)
 
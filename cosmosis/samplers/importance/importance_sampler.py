@@ -109,20 +109,18 @@ class ImportanceSampler(ParallelSampler):
         self.samples = np.transpose(reordered_cols)
 
         self.current_index = 0
+        # The pool works through all the samples as one stream of tasks
+        self.results = self.imap(task, self.samples)
 
     def execute(self):
         self.output.comment("Importance sampling from %s"%self.input_filename)
 
-        #Pick out a chunk of samples to run on
+        #Pick out a chunk of samples to save the results for.
+        #The pool carries on with the later samples in the meantime.
         start = self.current_index
         end = start+self.nstep
         samples_chunk = self.samples[start:end]
-
-        #Run the pipeline on each of the samples
-        if self.pool:
-            results = self.pool.map(task, samples_chunk)
-        else:
-            results = list(map(task, samples_chunk))
+        results = itertools.islice(self.results, len(samples_chunk))
 
         #Collect together and output the results
         for i,(sample, (new_like, extra)) in enumerate(zip(samples_chunk, results)):
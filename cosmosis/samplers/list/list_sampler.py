@@ -9,7 +9,7 @@ def task(p):
     results = list_sampler.pipeline.run_results(p, all_params=True)
     #If requested, save the data to file
     if list_sampler.save_name and results.block is not None:
-        results.block.save_to_file(list_sampler.save_name+"_%d"%i, clobber=True)
+        results.block.save(list_sampler.save_name+"_%d"%i, format=list_sampler.save_format, clobber=True)
     return results.post, (results.prior, results.extra)
 
 
@@ -26,6 +26,7 @@ class ListSampler(ParallelSampler):
         self.converged = False
         self.filename = self.read_ini("filename", str)
         self.save_name = self.read_ini("save", str, "")
+        self.save_format = self.read_ini_choices("save_format", str, ["snapshot", "tgz", "directory"], "snapshot")
         self.burn = self.read_ini("burn", int, 0)
         self.thin = self.read_ini("thin", int, 1)
         limits = self.read_ini("limits", bool, False)
@@ -93,17 +94,10 @@ class ListSampler(ParallelSampler):
         sample_index = list(range(len(sample_vectors)))
         jobs = list(zip(sample_index, sample_vectors))
 
-        #Run all the parameters
-        #This only outputs them all at the end
-        #which is a bit problematic, though you 
-        #can't use MPI and retain the output ordering.
-        #Have a few options depending on whether
-        #you care about this we should think about
-        #(also true for grid sampler).
-        if self.pool:
-            results = self.pool.map(task, jobs)
-        else:
-            results = list(map(task, jobs))
+        #Run all the parameters, saving the results
+        #in order as they come in while the pool
+        #carries on with the rest.
+        results = self.imap(task, jobs)
 
         #Save the results of the sampling
         #We now need to abuse the output code a little.
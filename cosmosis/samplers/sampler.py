@@ -229,6 +229,16 @@ class ParallelSampler(Sampler):
     def is_master(self):
         return self.pool is None or self.pool.is_master()
 
+    def imap(self, function, tasks):
+        u"""Apply `function` to each of `tasks`, in the pool if there is one, yielding the results in order as they come.
+
+        Unlike `pool.map`, the pool carries on with later tasks while the
+        sampler deals with the results already yielded.
+        """
+        if self.pool:
+            return self.pool.imap(function, tasks)
+        return map(function, tasks)
+
 
 # These are marked as deprecated in emcee, so I moved them here.
 # I think I wrote the first one.  And I've rewritten the second
@@ -9,7 +9,7 @@ def task(p):
     results = star_sampler.pipeline.run_results(p)
     #If requested, save the data to file
     if star_sampler.save_name and results.block is not None:
-        results.block.save_to_file(star_sampler.save_name+"_%d"%i, clobber=True)
+        results.block.save(star_sampler.save_name+"_%d"%i, format=star_sampler.save_format, clobber=True)
     return (results.post, results.prior, results.extra)
 
 LARGE_JOB_SIZE = 1000000
@@ -28,6 +28,7 @@ class StarSampler(ParallelSampler):
         self.converged = False
         self.nsample = self.read_ini("nsample_dimension", int, 3)
         self.save_name = self.read_ini("save", str, "")
+        self.save_format = self.read_ini_choices("save_format", str, ["snapshot", "tgz", "directory"], "snapshot")
         self.nstep = self.read_ini("nstep", int, -1)
         self.allow_large = self.read_ini("allow_large", bool, False)
         self.sample_points = None
@@ -0,0 +1,63 @@
+"""
+Benchmark of the per-access cost of getting and setting DataBlock
+values from Python, as every Python module in a pipeline does: through
+the compiled extension module (cosmosis_py._block, used when it has
+been built) against the ctypes bindings it replaces.
+
+Run with: python -m cosmosis.test.bench_block_access
+"""
+import timeit
+import numpy as np
+import cosmosis.datablock.cosmosis_py.block as block_module
+from cosmosis.datablock.cosmosis_py import DataBlock
+
+
+def make_block():
+    block = DataBlock()
+    block["cosmological_parameters", "omega_m"] = 0.3
+    block["cosmological_parameters", "n_modes"] = 5
+    block["distances", "z"] = np.linspace(0.0, 3.0, 100)
+    block["matter_power_lin", "p_k"] = np.ones((100, 200))
+    return block
+
+
+def cases(block):
+    z = np.linspace(0.0, 3.0, 100)
+    p_k = np.ones((100, 200))
+    return [
+        ("get double", lambda: block["cosmological_parameters", "omega_m"]),
+        ("get int", lambda: block["cosmological_parameters", "n_modes"]),
+        ("set double", lambda: block.__setitem__(("cosmological_parameters", "omega_m"), 0.3)),
+        ("replace double", lambda: block.replace("cosmological_parameters", "omega_m", 0.3)),
+        ("get array (100)", lambda: block["distances", "z"]),
+        ("set array (100)", lambda: block.__setitem__(("distances", "z"), z)),
+        ("get array (100x200)", lambda: block["matter_power_lin", "p_k"]),
+        ("set array (100x200)", lambda: block.__setitem__(("matter_power_lin", "p_k"), p_k)),
+        ("keys", lambda: block.keys()),
+    ]
+
+
+def time_per_call(f, number=20000):
+    return min(timeit.repeat(f, number=number, repeat=5)) / number
+
+
+def main():
+    ext = block_module._ext
+    if ext is None:
+        print("The extension module was not built; only ctypes is available")
+    block = make_block()
+    print("{:22s} {:>12s} {:>12s} {:>8s}".format("", "ctypes", "extension", "speedup"))
+    for label, f in cases(block):
+        block_module._ext = None
+        t_ctypes = time_per_call(f)
+        block_module._ext = ext
+        if ext is None:
+            print("{:22s} {:9.2f} us".format(label, 1e6 * t_ctypes))
+            continue
+        t_ext = time_per_call(f)
+        print("{:22s} {:9.2f} us {:9.2f} us {:7.1f}x".format(
+            label, 1e6 * t_ctypes, 1e6 * t_ext, t_ctypes / t_ext))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,49 @@
+"""
+Benchmark of the overhead of each map of the --smp process pool, with
+tasks that take no time and return what a sampler's do: the posterior,
+the prior and a vector of derived parameters.  Compares the persistent
+pool, which keeps its workers and passes results back through shared
+memory, to a multiprocessing.Pool made for each map, as was used before.
+
+Run with: python -m cosmosis.test.bench_process_pool [processes]
+"""
+import multiprocessing
+import sys
+import time
+import numpy as np
+from cosmosis.runtime.process_pool import Pool
+
+
+def task(p):
+    return (-0.5 * np.dot(p, p), 0.0, p * 2.0)
+
+
+def time_per_batch(map_function, batch, repeat):
+    map_function(task, batch)
+    start = time.perf_counter()
+    for _ in range(repeat):
+        map_function(task, batch)
+    return (time.perf_counter() - start) / repeat
+
+
+def main():
+    processes = int(sys.argv[1]) if len(sys.argv) > 1 else 64
+    ndim = 20
+
+    def fresh_pool_map(function, args):
+        with multiprocessing.Pool(processes) as pool:
+            return pool.map(function, args)
+
+    print("{} processes, {} parameters".format(processes, ndim))
+    print("{:>8s} {:>16s} {:>16s} {:>8s}".format("batch", "new pool", "persistent", "speedup"))
+    with Pool(processes) as pool:
+        for batch_size in [processes, 4 * processes, 16 * processes]:
+            batch = [np.random.randn(ndim) for _ in range(batch_size)]
+            t_fresh = time_per_batch(fresh_pool_map, batch, 3)
+            t_persistent = time_per_batch(pool.map, batch, 20)
+            print("{:8d} {:13.2f} ms {:13.2f} ms {:7.1f}x".format(
+                batch_size, 1e3 * t_fresh, 1e3 * t_persistent, t_fresh / t_persistent))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+"""
+Benchmark of pickling a DataBlock, as the MPI and multiprocessing pools
+do whenever a block crosses a process boundary: the binary format of
+DataBlock.to_bytes (now used by pickle) against the YAML of to_string.
+
+The block holds the parameters and the arrays a Boltzmann code would
+put, including a P(k,z) grid of 500 x 1000 values.
+
+Run with: python -m cosmosis.test.bench_serialize
+"""
+import pickle
+import time
+import numpy as np
+from cosmosis.datablock.cosmosis_py import DataBlock
+
+
+def make_block(nz=500, nk=1000):
+    block = DataBlock()
+    rng = np.random.default_rng(1)
+    for i in range(10):
+        for j in range(10):
+            block["params_{}".format(i), "p_{}".format(j)] = rng.uniform()
+    block["matter_power_lin", "k_h"] = np.logspace(-4, 1, nk)
+    block["matter_power_lin", "z"] = np.linspace(0.0, 3.0, nz)
+    block["matter_power_lin", "p_k"] = rng.uniform(size=(nz, nk))
+    for name in ["z", "a", "d_a", "d_m", "d_l", "h", "mu"]:
+        block["distances", name] = rng.uniform(size=5000)
+    block.put_metadata("distances", "d_a", "unit", "Mpc")
+    return block
+
+
+def check_round_trip(block, copy):
+    for section, name in block.keys():
+        a, b = block[section, name], copy[section, name]
+        if isinstance(a, np.ndarray):
+            # YAML keeps only the printed precision of each value
+            assert np.allclose(a, b, rtol=1e-15, atol=0), (section, name)
+        else:
+            assert a == b, (section, name)
+
+
+def timed(f, repeats):
+    best = None
+    for _ in range(repeats):
+        t0 = time.perf_counter()
+        result = f()
+        t = time.perf_counter() - t0
+        best = t if best is None else min(best, t)
+    return best, result
+
+
+def main():
+    block = make_block()
+    nbytes = sum(block[k].nbytes for k in block.keys()
+                 if isinstance(block[k], np.ndarray))
+    print("Array data: {:.1f} MB".format(nbytes / 1e6))
+
+    t_dump, text = timed(block.to_string, 1)
+    t_load, copy = timed(lambda: DataBlock.from_string(text), 1)
+    check_round_trip(block, copy)
+    print("YAML   dump {:8.1f} ms  load {:8.1f} ms  size {:6.1f} MB".format(
+        1e3 * t_dump, 1e3 * t_load, len(text) / 1e6))
+
+    t_dump, data = timed(lambda: pickle.dumps(block), 10)
+    t_load, copy = timed(lambda: pickle.loads(data), 10)
+    check_round_trip(block, copy)
+    assert copy.to_bytes() == block.to_bytes()
+    print("binary dump {:8.1f} ms  load {:8.1f} ms  size {:6.1f} MB".format(
+        1e3 * t_dump, 1e3 * t_load, len(data) / 1e6))
+    print("binary throughput: {:.0f} MB/s".format(nbytes / 1e6 / (t_dump + t_load)))
+
+
+if __name__ == "__main__":
+    main()
@@ -320,6 +320,300 @@ void test_ndim(){
 
 }
 
+void test_handles(){
+  printf("In test_handles\n");
+  c_datablock* s = make_c_datablock();
+  int hx = -1, hb = -1, hn = -1;
+  assert(c_datablock_resolve(s, "A", "x", &hx)==DBS_SUCCESS);
+  assert(c_datablock_resolve(s, "A", "b", &hb)==DBS_SUCCESS);
+  assert(c_datablock_resolve(s, "a", "N", &hn)==DBS_SUCCESS);
+  assert(hx >= 0 && hb >= 0 && hn >= 0 && hx != hb && hb != hn);
+  assert(c_datablock_resolve(NULL, "A", "x", &hx)==DBS_DATABLOCK_NULL);
+  assert(c_datablock_resolve(s, "A", "x", NULL)==DBS_VALUE_NULL);
+
+  double x = 0.0;
+  bool b = false;
+  int n = 0;
+  assert(c_datablock_get_double_h(s, hx, &x)==DBS_SECTION_NOT_FOUND);
+  assert(c_datablock_put_double_h(s, hx, 1.5)==DBS_SUCCESS);
+  assert(c_datablock_put_bool_h(s, hb, true)==DBS_SUCCESS);
+  assert(c_datablock_put_int_h(s, hn, 4)==DBS_SUCCESS);
+  assert(c_datablock_put_int_h(s, hn, 5)==DBS_NAME_ALREADY_EXISTS);
+  assert(c_datablock_get_double(s, "a", "x", &x)==DBS_SUCCESS);
+  assert(x == 1.5);
+  assert(c_datablock_replace_double_h(s, hx, 2.5)==DBS_SUCCESS);
+  assert(c_datablock_replace_bool_h(s, hb, false)==DBS_SUCCESS);
+  assert(c_datablock_replace_int_h(s, hn, 6)==DBS_SUCCESS);
+  assert(c_datablock_get_double_h(s, hx, &x)==DBS_SUCCESS);
+  assert(c_datablock_get_bool_h(s, hb, &b)==DBS_SUCCESS);
+  assert(c_datablock_get_int_h(s, hn, &n)==DBS_SUCCESS);
+  assert(x == 2.5 && b == false && n == 6);
+  assert(c_datablock_get_int_h(s, hx, &n)==DBS_WRONG_VALUE_TYPE);
+  assert(c_datablock_get_double_h(s, hx, NULL)==DBS_VALUE_NULL);
+  assert(c_datablock_get_double_h(s, 1000, &x)==DBS_HANDLE_INVALID);
+
+  char section[16], name[16];
+  assert(c_datablock_get_handle_key(s, hn, 16, section, name)==DBS_SUCCESS);
+  assert(strcmp(section, "a")==0 && strcmp(name, "n")==0);
+  assert(c_datablock_get_handle_key(s, -1, 16, section, name)==DBS_HANDLE_INVALID);
+
+  /* Handles are valid in clones, and after the section is deleted. */
+  c_datablock* r = clone_c_datablock(s);
+  assert(c_datablock_delete_section(s, "A")==DBS_SUCCESS);
+  assert(c_datablock_get_double_h(s, hx, &x)==DBS_SECTION_NOT_FOUND);
+  assert(c_datablock_put_double(s, "A", "x", 3.5)==DBS_SUCCESS);
+  assert(c_datablock_get_double_h(s, hx, &x)==DBS_SUCCESS);
+  assert(x == 3.5);
+  assert(c_datablock_get_double_h(r, hx, &x)==DBS_SUCCESS);
+  assert(x == 2.5);
+
+  destroy_c_datablock(r);
+  destroy_c_datablock(s);
+}
+
+void test_views(){
+  printf("In test_views\n");
+  c_datablock* s = make_c_datablock();
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  int ext[] = {2, 3};
+  assert(c_datablock_put_double_array(s, "A", "grid", arr, 2, ext)==DBS_SUCCESS);
+  assert(c_datablock_put_int(s, "A", "n", 1)==DBS_SUCCESS);
+
+  c_datablock_view* view = NULL;
+  datablock_type_t type = DBT_UNKNOWN;
+  void const* data = NULL;
+  int ndims = 0;
+  int const* extents = NULL;
+  assert(c_datablock_view_array(s, "a", "GRID", &view, &type, &data, &ndims, &extents)==DBS_SUCCESS);
+  assert(type == DBT_DOUBLEND && ndims == 2 && extents[0] == 2 && extents[1] == 3);
+  double const* d = (double const*)data;
+  assert(d[0] == 1.0 && d[5] == 6.0);
+
+  /* The view is unaffected by changes to the block, or its destruction. */
+  double arr2[] = {-1.0, -2.0, -3.0, -4.0, -5.0, -6.0};
+  assert(c_datablock_replace_double_array(s, "A", "grid", arr2, 2, ext)==DBS_SUCCESS);
+  double x[6];
+  assert(c_datablock_get_double_array(s, "A", "grid", x, 2, ext)==DBS_SUCCESS);
+  assert(x[0] == -1.0);
+  destroy_c_datablock(s);
+  assert(d[0] == 1.0 && d[5] == 6.0);
+  assert(destroy_c_datablock_view(view)==DBS_SUCCESS);
+
+  s = make_c_datablock();
+  assert(c_datablock_put_int(s, "A", "n", 1)==DBS_SUCCESS);
+  assert(c_datablock_view_array(s, "A", "n", &view, &type, &data, &ndims, &extents)==DBS_WRONG_VALUE_TYPE);
+  assert(c_datablock_view_array(s, "B", "n", &view, &type, &data, &ndims, &extents)==DBS_SECTION_NOT_FOUND);
+  assert(c_datablock_view_array(s, "A", "m", &view, &type, &data, &ndims, &extents)==DBS_NAME_NOT_FOUND);
+  assert(c_datablock_view_array(s, "A", "n", NULL, &type, &data, &ndims, &extents)==DBS_VALUE_NULL);
+
+  /* Arrays made outside the block are moved in without copying. */
+  int n = 4;
+  void* buffer = NULL;
+  c_datablock_array* a = make_c_datablock_array(DBT_DOUBLE1D, 1, &n, &buffer);
+  assert(a != NULL && buffer != NULL);
+  for (int i = 0; i != n; ++i) ((double*)buffer)[i] = i + 0.5;
+  assert(c_datablock_put_array_move(s, "A", "n", a)==DBS_NAME_ALREADY_EXISTS);
+  assert(c_datablock_put_array_move(s, "A", "v", a)==DBS_SUCCESS);
+  assert(destroy_c_datablock_array(a)==DBS_SUCCESS);
+  assert(c_datablock_view_array(s, "A", "v", &view, &type, &data, &ndims, &extents)==DBS_SUCCESS);
+  assert(data == buffer && type == DBT_DOUBLE1D && ndims == 1 && extents[0] == 4);
+  assert(destroy_c_datablock_view(view)==DBS_SUCCESS);
+  double* v = NULL;
+  int length = 0;
+  assert(c_datablock_get_double_array_1d(s, "A", "v", &v, &length)==DBS_SUCCESS);
+  assert(length == 4 && v[3] == 3.5);
+  free(v);
+
+  int ext3[] = {2, 2, 2};
+  a = make_c_datablock_array(DBT_INTND, 3, ext3, &buffer);
+  assert(a != NULL);
+  ((int*)buffer)[7] = 8;
+  assert(c_datablock_replace_array_move(s, "A", "w", a)==DBS_NAME_NOT_FOUND);
+  assert(c_datablock_put_array_move(s, "A", "w", a)==DBS_SUCCESS);
+  destroy_c_datablock_array(a);
+  int w[8];
+  assert(c_datablock_get_int_array(s, "A", "w", w, 3, ext3)==DBS_SUCCESS);
+  assert(w[7] == 8 && w[0] == 0);
+
+  assert(make_c_datablock_array(DBT_DOUBLE1D, 2, ext, &buffer) == NULL);
+  assert(make_c_datablock_array(DBT_STRING1D, 1, &n, &buffer) == NULL);
+  destroy_c_datablock(s);
+}
+
+void test_pool(){
+  printf("In test_pool\n");
+  c_datablock_pool* pool = make_c_datablock_pool();
+  assert(pool != NULL);
+  assert(make_c_datablock_pooled(NULL) == NULL);
+  long allocations = -1, reuses = -1, bytes = -1;
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  int ext[] = {2, 3};
+
+  /* The second block reuses all the storage of the first. */
+  for (int sample = 0; sample != 2; ++sample) {
+    c_datablock* s = make_c_datablock_pooled(pool);
+    assert(c_datablock_put_double_array_1d(s, "A", "x", arr, 6)==DBS_SUCCESS);
+    assert(c_datablock_put_double_array(s, "B", "grid", arr, 2, ext)==DBS_SUCCESS);
+    assert(c_datablock_put_int(s, "B", "n", sample)==DBS_SUCCESS);
+    double x[6];
+    assert(c_datablock_get_double_array(s, "B", "grid", x, 2, ext)==DBS_SUCCESS);
+    assert(x[5] == 6.0);
+    assert(c_datablock_pool_counts(pool, &allocations, &reuses, &bytes)==DBS_SUCCESS);
+    if (sample == 0) assert(allocations == 4 && reuses == 0 && bytes == 0);
+    else assert(allocations == 4 && reuses == 4 && bytes == 0);
+    assert(destroy_c_datablock(s)==DBS_SUCCESS);
+  }
+  assert(c_datablock_pool_counts(pool, &allocations, &reuses, &bytes)==DBS_SUCCESS);
+  assert(bytes == 12 * sizeof(double));
+
+  /* Storage still shared with a clone is not recycled. */
+  c_datablock* s = make_c_datablock_pooled(pool);
+  assert(c_datablock_put_double_array_1d(s, "A", "x", arr, 6)==DBS_SUCCESS);
+  c_datablock* c = clone_c_datablock(s);
+  assert(destroy_c_datablock(s)==DBS_SUCCESS);
+  double* v = NULL;
+  int length = 0;
+  assert(c_datablock_get_double_array_1d(c, "A", "x", &v, &length)==DBS_SUCCESS);
+  assert(length == 6 && v[5] == 6.0);
+  free(v);
+
+  /* Blocks may outlive their pool. */
+  assert(destroy_c_datablock_pool(pool)==DBS_SUCCESS);
+  assert(c_datablock_put_int(c, "B", "n", 1)==DBS_SUCCESS);
+  assert(destroy_c_datablock(c)==DBS_SUCCESS);
+  assert(c_datablock_pool_counts(NULL, &allocations, &reuses, &bytes)==DBS_VALUE_NULL);
+}
+
+void test_serialize(){
+  printf("In test_serialize\n");
+  c_datablock* s = make_c_datablock();
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  int ext[] = {2, 3};
+  assert(c_datablock_put_int(s, "A", "n", 7)==DBS_SUCCESS);
+  assert(c_datablock_put_string(s, "A", "s", "text")==DBS_SUCCESS);
+  assert(c_datablock_put_double_array(s, "B", "grid", arr, 2, ext)==DBS_SUCCESS);
+
+  size_t size = 0;
+  assert(c_datablock_serialized_size(s, &size)==DBS_SUCCESS);
+  assert(size > 6 * sizeof(double));
+  char* buffer = malloc(size);
+  assert(c_datablock_serialize(s, buffer, size - 1)==DBS_SIZE_INSUFFICIENT);
+  assert(c_datablock_serialize(s, buffer, size)==DBS_SUCCESS);
+
+  c_datablock* t = make_c_datablock();
+  assert(c_datablock_deserialize(t, buffer, size - 1)==DBS_BAD_FORMAT);
+  assert(c_datablock_num_sections(t) == 0);
+  assert(c_datablock_deserialize(t, buffer, size)==DBS_SUCCESS);
+  int n = 0;
+  char* str = NULL;
+  double x[6];
+  assert(c_datablock_get_int(t, "A", "n", &n)==DBS_SUCCESS && n == 7);
+  assert(c_datablock_get_string(t, "A", "s", &str)==DBS_SUCCESS);
+  assert(strcmp(str, "text") == 0);
+  free(str);
+  assert(c_datablock_get_double_array(t, "B", "grid", x, 2, ext)==DBS_SUCCESS);
+  assert(memcmp(x, arr, sizeof(arr)) == 0);
+
+  assert(c_datablock_serialized_size(NULL, &size)==DBS_DATABLOCK_NULL);
+  assert(c_datablock_serialize(s, NULL, size)==DBS_VALUE_NULL);
+  assert(c_datablock_deserialize(t, NULL, size)==DBS_VALUE_NULL);
+  free(buffer);
+  destroy_c_datablock(t);
+  destroy_c_datablock(s);
+}
+
+void test_many(){
+  printf("In test_many\n");
+  c_datablock* s = make_c_datablock();
+  const char* sections[] = {"A", "A", "B"};
+  const char* names[] = {"x", "y", "z"};
+  double vals[] = {1.5, 2.5, 3.5};
+  double got[3] = {0.0, 0.0, 0.0};
+  int failed = 7;
+  assert(c_datablock_put_double_many(s, 3, sections, names, vals, &failed)==DBS_SUCCESS);
+  assert(failed == -1);
+  assert(c_datablock_get_double_many(s, 3, sections, names, got, &failed)==DBS_SUCCESS);
+  assert(got[0] == 1.5 && got[1] == 2.5 && got[2] == 3.5);
+
+  /* Processing stops at the first failure. */
+  assert(c_datablock_put_double_many(s, 3, sections, names, vals, &failed)==DBS_NAME_ALREADY_EXISTS);
+  assert(failed == 0);
+  const char* more[] = {"x", "y", "w"};
+  vals[0] = -1.0;
+  assert(c_datablock_replace_double_many(s, 3, sections, more, vals, &failed)==DBS_NAME_NOT_FOUND);
+  assert(failed == 2);
+  assert(c_datablock_get_double(s, "A", "x", &got[0])==DBS_SUCCESS && got[0] == -1.0);
+  assert(c_datablock_put_int(s, "B", "n", 1)==DBS_SUCCESS);
+  const char* bn[] = {"n"};
+  assert(c_datablock_get_double_many(s, 1, &sections[2], bn, got, NULL)==DBS_WRONG_VALUE_TYPE);
+
+  assert(c_datablock_put_double_many(s, 0, NULL, NULL, NULL, &failed)==DBS_SUCCESS);
+  assert(c_datablock_put_double_many(NULL, 3, sections, names, vals, &failed)==DBS_DATABLOCK_NULL);
+  assert(c_datablock_get_double_many(s, 3, sections, NULL, got, &failed)==DBS_NAME_NULL);
+  destroy_c_datablock(s);
+}
+
+void test_hash(){
+  printf("In test_hash\n");
+  c_datablock* a = make_c_datablock();
+  c_datablock* b = make_c_datablock();
+  double arr[] = {1.0, 2.0, 3.0};
+  uint64_t ha[2], hb[2];
+  assert(c_datablock_put_double_array_1d(a, "P", "v", arr, 3)==DBS_SUCCESS);
+  assert(c_datablock_put_double(a, "Q", "x", 0.5)==DBS_SUCCESS);
+  assert(c_datablock_put_double(b, "q", "X", 0.5)==DBS_SUCCESS);
+  assert(c_datablock_put_double_array_1d(b, "p", "v", arr, 3)==DBS_SUCCESS);
+  assert(c_datablock_hash(a, 0, NULL, ha)==DBS_SUCCESS);
+  assert(c_datablock_hash(b, 0, NULL, hb)==DBS_SUCCESS);
+  assert(ha[0] == hb[0] && ha[1] == hb[1]);
+
+  const char* sections[] = {"p", "Q"};
+  const char* names[] = {"v", "x"};
+  int failed = 7;
+  assert(c_datablock_hash_values(a, 2, sections, names, ha, &failed)==DBS_SUCCESS);
+  assert(failed == -1);
+  arr[2] = 4.0;
+  assert(c_datablock_replace_double_array_1d(b, "p", "v", arr, 3)==DBS_SUCCESS);
+  assert(c_datablock_hash_values(b, 2, sections, names, hb, &failed)==DBS_SUCCESS);
+  assert(ha[0] != hb[0] || ha[1] != hb[1]);
+  assert(c_datablock_hash_values(b, 1, &sections[1], &names[1], hb, NULL)==DBS_SUCCESS);
+  assert(c_datablock_hash_values(a, 1, &sections[1], &names[1], ha, NULL)==DBS_SUCCESS);
+  assert(ha[0] == hb[0] && ha[1] == hb[1]);
+
+  const char* missing[] = {"v", "y"};
+  assert(c_datablock_hash_values(a, 2, sections, missing, ha, &failed)==DBS_NAME_NOT_FOUND);
+  assert(failed == 1);
+  assert(c_datablock_hash(a, 1, sections, NULL)==DBS_VALUE_NULL);
+  assert(c_datablock_hash(NULL, 0, NULL, ha)==DBS_DATABLOCK_NULL);
+  destroy_c_datablock(a);
+  destroy_c_datablock(b);
+}
+
+void test_changed_since(){
+  printf("In test_changed_since\n");
+  c_datablock* a = make_c_datablock();
+  assert(c_datablock_put_double(a, "p", "x", 0.5)==DBS_SUCCESS);
+  uint64_t mark = c_datablock_mark(a);
+  assert(c_datablock_put_int(a, "P", "N", 3)==DBS_SUCCESS);
+  assert(c_datablock_replace_double(a, "p", "x", 1.5)==DBS_SUCCESS);
+  assert(c_datablock_put_double(a, "q", "y", 2.5)==DBS_SUCCESS);
+
+  const char* sections[3];
+  const char* names[3];
+  int n = 0;
+  assert(c_datablock_changed_since(a, mark, 2, sections, names, &n)==DBS_SIZE_INSUFFICIENT);
+  assert(n == 3);
+  assert(c_datablock_changed_since(a, mark, 3, sections, names, &n)==DBS_SUCCESS);
+  assert(n == 3);
+  assert(strcmp(sections[0], "p")==0 && strcmp(names[0], "x")==0);
+  assert(strcmp(sections[1], "p")==0 && strcmp(names[1], "n")==0);
+  assert(strcmp(sections[2], "q")==0 && strcmp(names[2], "y")==0);
+  assert(c_datablock_changed_since(a, c_datablock_mark(a), 0, NULL, NULL, &n)==DBS_SUCCESS);
+  assert(n == 0);
+  assert(c_datablock_changed_since(NULL, mark, 0, NULL, NULL, &n)==DBS_DATABLOCK_NULL);
+  assert(c_datablock_mark(NULL) == 0);
+  destroy_c_datablock(a);
+}
 
 int main()
 {
@@ -334,5 +628,12 @@ int main()
   test_ndim();
   test_c_copy();
   test_clone();
+  test_handles();
+  test_views();
+  test_pool();
+  test_serialize();
+  test_many();
+  test_hash();
+  test_changed_since();
   return 0;
 }
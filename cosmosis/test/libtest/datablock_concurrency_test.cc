@@ -0,0 +1,187 @@
+// A stress test of DataBlock in concurrent mode: many threads read and
+// write the same block at once, in sections of their own and in shared
+// ones, while another adds and removes sections and another serializes
+// the whole block.
+
+#include "datablock.hh"
+#include "c_datablock.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using cosmosis::DataBlock;
+using std::string;
+using std::vector;
+
+int const nthreads = 8;
+int const niterations = 2000;
+int const ncopies = 200;
+
+void work(DataBlock& b, int k)
+{
+  string const own = "thread_" + std::to_string(k);
+  int const h = b.resolve(own, "count");
+  assert(b.put_val(h, 0) == DBS_SUCCESS);
+  for (int i = 0; i != niterations; ++i)
+    {
+      string const name = "v_" + std::to_string(i);
+      assert(b.put_val(own, name, double(i + k)) == DBS_SUCCESS);
+      double x = 0.0;
+      assert(b.get_val(own, name, x) == DBS_SUCCESS);
+      assert(x == i + k);
+      vector<double> common;
+      assert(b.get_val("common", "a", common) == DBS_SUCCESS);
+      assert(common.size() == 100 && common[99] == 99.0);
+      assert(b.replace_val(h, i + 1) == DBS_SUCCESS);
+    }
+  assert(b.put_val("shared", "from_" + std::to_string(k), k) == DBS_SUCCESS);
+}
+
+void copy_and_delete(DataBlock& b)
+{
+  assert(b.put_val("source", "x", 1.5) == DBS_SUCCESS);
+  for (int i = 0; i != ncopies; ++i)
+    {
+      assert(b.copy_section("source", "copy") == DBS_SUCCESS);
+      assert(b.delete_section("copy") == DBS_SUCCESS);
+    }
+}
+
+void serialize_while_running(DataBlock& b, std::atomic<bool>& done)
+{
+  while (not done)
+    {
+      vector<char> bytes;
+      b.serialize(bytes);
+      DataBlock c;
+      assert(c.deserialize(bytes.data(), bytes.size()) == DBS_SUCCESS);
+      assert(c.has_section("common"));
+      b.hash();
+    }
+}
+
+void test_stress()
+{
+  DataBlock b;
+  b.set_log_capacity(1 << 20);
+  assert(b.put_val("common", "a", vector<double>(100)) == DBS_SUCCESS);
+  vector<double> a(100);
+  for (int i = 0; i != 100; ++i) a[i] = i;
+  assert(b.replace_val("common", "a", a) == DBS_SUCCESS);
+  auto const before = b.counts();
+  int const log_before = b.get_log_count();
+
+  b.set_concurrent(true);
+  assert(b.concurrent());
+  std::atomic<bool> done(false);
+  std::thread serializer(serialize_while_running, std::ref(b), std::ref(done));
+  std::thread copier(copy_and_delete, std::ref(b));
+  vector<std::thread> workers;
+  for (int k = 0; k != nthreads; ++k) workers.emplace_back(work, std::ref(b), k);
+  for (auto& t : workers) t.join();
+  copier.join();
+  done = true;
+  serializer.join();
+
+  for (int k = 0; k != nthreads; ++k)
+    {
+      string const own = "thread_" + std::to_string(k);
+      assert(b.num_values(own) == niterations + 1);
+      int count = 0;
+      assert(b.get_val(own, "count", count) == DBS_SUCCESS);
+      assert(count == niterations);
+      double x = 0.0;
+      assert(b.get_val(own, "v_7", x) == DBS_SUCCESS && x == 7 + k);
+      assert(b.get_val("shared", "from_" + std::to_string(k), count) == DBS_SUCCESS && count == k);
+    }
+  assert(not b.has_section("copy"));
+
+  // Each worker makes 1 + 2n writes and 2n reads, the copier one
+  // write, and the checks above 3 reads for each worker.
+  long const reads = nthreads * (2L * niterations + 3);
+  long const writes = nthreads * (2L + 2 * niterations) + 1;
+  auto const after = b.counts();
+  assert(long(after.reads - before.reads) == reads);
+  assert(long(after.writes - before.writes) == writes);
+
+  // Every access is logged, along with the copies and deletions and
+  // the checks above of each worker's section and of "copy".
+  int const logged = b.get_log_count() - log_before;
+  assert(logged == reads + writes + 2 * ncopies + nthreads + 1);
+  b.set_concurrent(false);
+  assert(not b.concurrent());
+  assert(b.get_log_count() - log_before == logged);
+  assert(b.counts().reads == after.reads);
+}
+
+// Readers of the same section do not exclude each other, and a copy
+// of a concurrent block is concurrent too, with its own locks.
+void test_readers()
+{
+  DataBlock b;
+  b.set_log_mode(DBL_OFF);
+  assert(b.put_val("p", "x", 2.5) == DBS_SUCCESS);
+  b.set_concurrent(true);
+  DataBlock c(b);
+  assert(c.concurrent());
+  vector<std::thread> readers;
+  for (int k = 0; k != nthreads; ++k)
+    readers.emplace_back([&b, &c, k]() {
+        DataBlock& d = (k % 2) ? b : c;
+        double x = 0.0;
+        for (int i = 0; i != niterations; ++i)
+          assert(d.get_val("p", "x", x) == DBS_SUCCESS && x == 2.5);
+      });
+  for (auto& t : readers) t.join();
+  assert(b.counts().reads + c.counts().reads == std::uint64_t(nthreads) * niterations);
+}
+
+// Arrays copied out through the C interface, or by a function passed
+// to view, are copied whole while another thread replaces them.
+void test_copy_while_replacing()
+{
+  DataBlock b;
+  b.set_log_mode(DBL_OFF);
+  std::size_t const n = 1000;
+  assert(b.put_val("arr", "v", vector<double>(n, 0.0)) == DBS_SUCCESS);
+  b.set_concurrent(true);
+  std::atomic<bool> done(false);
+  std::thread writer([&b, &done, n]() {
+      for (int i = 1; i != niterations; ++i)
+        assert(b.replace_val("arr", "v", vector<double>(n, i)) == DBS_SUCCESS);
+      done = true;
+    });
+  vector<std::thread> readers;
+  for (int k = 0; k != nthreads; ++k)
+    readers.emplace_back([&b, &done, n, k]() {
+        while (not done)
+          {
+            vector<double> copy;
+            if (k % 2)
+              copy = b.view<vector<double>>("arr", "v", [](vector<double> const& v) { return v; });
+            else
+              {
+                double* val = nullptr;
+                int sz = 0;
+                assert(c_datablock_get_double_array_1d(&b, "arr", "v", &val, &sz) == DBS_SUCCESS);
+                copy.assign(val, val + sz);
+                free(val);
+              }
+            assert(copy.size() == n);
+            for (double x : copy) assert(x == copy[0]);
+          }
+      });
+  writer.join();
+  for (auto& t : readers) t.join();
+}
+
+int main()
+{
+  test_stress();
+  test_readers();
+  test_copy_while_replacing();
+}
@@ -1,5 +1,6 @@
 #include "datablock.hh"
 #include "entry.hh"
+#include "binary_io.hh"
 
 #include <cassert>
 #include <limits>
@@ -9,6 +10,7 @@
 using cosmosis::DataBlock;
 using cosmosis::Section;
 using cosmosis::complex_t;
+using cosmosis::name_id;
 using cosmosis::ndarray;
 using std::string;
 using std::vector;
@@ -152,7 +154,249 @@ void test_copy()
 
 }
 
+void test_clone()
+{
+  // Copies of a DataBlock (and copied sections) share their values
+  // until they are modified.
+  DataBlock b;
+  assert(b.put_val("A", "a", 10) == DBS_SUCCESS);
+  assert(b.put_val("A", "v", vector<double>(1000, 1.0)) == DBS_SUCCESS);
+  assert(b.put_val("B", "b", 2.0) == DBS_SUCCESS);
+  int h = b.resolve("A", "a");
+  int a = 0;
+  assert(b.get_val(h, a) == DBS_SUCCESS && a == 10);
+
+  DataBlock c(b);
+  assert(&b.view<vector<double>>("A", "v") == &c.view<vector<double>>("A", "v"));
+  assert(c.replace_val("A", "a", 11) == DBS_SUCCESS);
+  assert(b.get_val("A", "a", a) == DBS_SUCCESS && a == 10);
+  assert(c.get_val("A", "a", a) == DBS_SUCCESS && a == 11);
+  assert(&b.view<vector<double>>("A", "v") != &c.view<vector<double>>("A", "v"));
+
+  // Writing through a handle resolved before the copy must not affect
+  // the copy.
+  DataBlock d(b);
+  assert(b.replace_val(h, 12) == DBS_SUCCESS);
+  assert(d.get_val("A", "a", a) == DBS_SUCCESS && a == 10);
+  assert(b.get_val(h, a) == DBS_SUCCESS && a == 12);
+
+  // Nor must a handle cached before the section was duplicated by a
+  // different write continue to refer to the old values.
+  DataBlock e(b);
+  assert(b.get_val(h, a) == DBS_SUCCESS && a == 12);
+  assert(b.put_val("A", "z", 0) == DBS_SUCCESS);
+  assert(b.replace_val(h, 13) == DBS_SUCCESS);
+  assert(b.get_val("A", "a", a) == DBS_SUCCESS && a == 13);
+  assert(e.get_val("A", "a", a) == DBS_SUCCESS && a == 12);
+  assert(not e.has_val("A", "z"));
+
+  assert(b.copy_section("A", "C") == DBS_SUCCESS);
+  assert(b.replace_val("C", "a", 14) == DBS_SUCCESS);
+  assert(b.get_val("A", "a", a) == DBS_SUCCESS && a == 13);
+}
+
+
+void test_replace_in_place()
+{
+  DataBlock b;
+  assert(b.put_val("A", "x", vector<double>(1000, 1.0)) == DBS_SUCCESS);
+  double const* data = b.view<vector<double>>("A", "x").data();
+
+  // Replacing with an array of the same shape reuses the storage.
+  vector<double> y(1000, 2.0);
+  int n = 1000;
+  assert(b.overwrite_val<vector<double>>("a", "X", y.data(), 1, &n) == DBS_SUCCESS);
+  assert(b.view<vector<double>>("A", "x").data() == data);
+  assert(b.view<vector<double>>("A", "x")[999] == 2.0);
+  assert(b.replace_val("A", "x", y) == DBS_SUCCESS);
+  assert(b.view<vector<double>>("A", "x").data() == data);
+
+  n = 10;
+  assert(b.overwrite_val<vector<double>>("A", "x", y.data(), 1, &n) == DBS_EXTENTS_MISMATCH);
+  assert(b.overwrite_val<vector<int>>("A", "x", nullptr, 1, &n) == DBS_WRONG_VALUE_TYPE);
+  assert(b.overwrite_val<vector<double>>("A", "y", y.data(), 1, &n) == DBS_NAME_NOT_FOUND);
+  assert(b.overwrite_val<vector<double>>("B", "x", y.data(), 1, &n) == DBS_SECTION_NOT_FOUND);
+
+  // A copy keeps the old values.
+  DataBlock c(b);
+  n = 1000;
+  y[0] = 3.0;
+  assert(b.overwrite_val<vector<double>>("A", "x", y.data(), 1, &n) == DBS_SUCCESS);
+  assert(b.view<vector<double>>("A", "x")[0] == 3.0);
+  assert(c.view<vector<double>>("A", "x")[0] == 2.0);
+
+  // Moving a block moves its values, and leaves the source usable.
+  data = b.view<vector<double>>("A", "x").data();
+  DataBlock d(std::move(b));
+  assert(d.view<vector<double>>("A", "x").data() == data);
+  assert(b.put_val("A", "x", 1) == DBS_SUCCESS);
+  int h = d.resolve("A", "x");
+  assert(d.replace_val(h, std::move(y)) == DBS_SUCCESS);
+  assert(d.view<vector<double>>("A", "x")[0] == 3.0);
+}
+
+void test_reset()
+{
+  DataBlock b;
+  b.set_log_mode(DBL_FAILURES);
+  int h = b.resolve("A", "n");
+  double x[1000];
+  for (int i = 0; i != 1000; ++i) x[i] = i;
+  assert(b.put_val("A", "x", b.make_vector(x, 1000)) == DBS_SUCCESS);
+  assert(b.put_val(h, 2) == DBS_SUCCESS);
+  double const* data = b.view<vector<double>>("A", "x").data();
+  int n;
+  assert(b.get_val("B", "y", n) == DBS_SECTION_NOT_FOUND);
+  assert(b.get_log_count() == 1);
+
+  b.reset();
+  assert(b.num_sections() == 0);
+  assert(b.get_log_count() == 0);
+  assert(b.log_mode() == DBL_FAILURES);
+  assert(b.get_val(h, n) == DBS_SECTION_NOT_FOUND);
 
+  // The next sample's array of the same size reuses the old one.
+  x[0] = -1.0;
+  assert(b.put_val("A", "x", b.make_vector(x, 1000)) == DBS_SUCCESS);
+  assert(b.view<vector<double>>("A", "x").data() == data);
+  assert(b.view<vector<double>>("A", "x")[0] == -1.0);
+  assert(b.put_val(h, 3) == DBS_SUCCESS);
+  assert(b.get_val("a", "N", n) == DBS_SUCCESS && n == 3);
+
+  // Values shared with a copy are not disturbed.
+  DataBlock c(b);
+  b.reset();
+  assert(c.view<vector<double>>("A", "x").data() == data);
+  assert(c.get_val("A", "n", n) == DBS_SUCCESS && n == 3);
+}
+
+void test_serialize()
+{
+  DataBlock b;
+  assert(b.put_val("Params", "n", -3) == DBS_SUCCESS);
+  assert(b.put_val("params", "flag", true) == DBS_SUCCESS);
+  assert(b.put_val("params", "x", 2.5) == DBS_SUCCESS);
+  assert(b.put_val("params", "z", complex_t(1.0, -2.0)) == DBS_SUCCESS);
+  assert(b.put_val("params", "s", string("hello")) == DBS_SUCCESS);
+  assert(b.put_val("arrays", "ss", vector<string>{"a", "", "bcd"}) == DBS_SUCCESS);
+  assert(b.put_val("arrays", "vi", vector<int>{1, 2, 3}) == DBS_SUCCESS);
+  assert(b.put_val("arrays", "vd", vector<double>{0.5, 1.5}) == DBS_SUCCESS);
+  assert(b.put_val("arrays", "vz", vector<complex_t>{{1, 2}}) == DBS_SUCCESS);
+  assert(b.put_val("arrays", "empty", vector<double>()) == DBS_SUCCESS);
+  vector<double> values(3 * 4 * 5);
+  for (size_t i = 0; i != values.size(); ++i) values[i] = i * 0.25;
+  ndarray<double> grid(values, vector<size_t>{3, 4, 5});
+  assert(b.put_val("grids", "pk", grid) == DBS_SUCCESS);
+  assert(b.put_val("grids", "ni", ndarray<int>(vector<int>{1, 2, 3, 4}, vector<size_t>{2, 2})) == DBS_SUCCESS);
+  assert(b.put_val("grids", "nz", ndarray<complex_t>(vector<complex_t>{{1, 1}, {2, 2}}, vector<size_t>{1, 2})) == DBS_SUCCESS);
+  assert(b.put_metadata("params", "x", "unit", "Mpc") == DBS_SUCCESS);
+
+  vector<char> bytes;
+  b.serialize(bytes);
+  assert(bytes.size() == b.serialized_size());
+  // A copy gives equal bytes.
+  vector<char> again;
+  DataBlock(b).serialize(again);
+  assert(again == bytes);
+
+  DataBlock c;
+  int h = c.resolve("params", "n");
+  assert(c.put_val("other", "y", 1) == DBS_SUCCESS);
+  assert(c.deserialize(bytes.data(), bytes.size()) == DBS_SUCCESS);
+  assert(not c.has_section("other"));
+  assert(c.num_sections() == b.num_sections());
+  for (size_t i = 0; i != b.num_sections(); ++i) {
+    string const& sec = b.section_name(i);
+    assert(c.num_values(sec) == b.num_values(sec));
+  }
+  int n;
+  bool flag;
+  double x;
+  complex_t z;
+  string str;
+  assert(c.get_val("params", "n", n) == DBS_SUCCESS && n == -3);
+  assert(c.get_val("params", "flag", flag) == DBS_SUCCESS && flag);
+  assert(c.get_val("params", "x", x) == DBS_SUCCESS && x == 2.5);
+  assert(c.get_val("params", "z", z) == DBS_SUCCESS && z == complex_t(1.0, -2.0));
+  assert(c.get_val("params", "s", str) == DBS_SUCCESS && str == "hello");
+  assert(c.get_metadata("params", "x", "unit", str) == DBS_SUCCESS && str == "Mpc");
+  assert((c.view<vector<string>>("arrays", "ss") == vector<string>{"a", "", "bcd"}));
+  assert((c.view<vector<int>>("arrays", "vi") == vector<int>{1, 2, 3}));
+  assert((c.view<vector<double>>("arrays", "vd") == vector<double>{0.5, 1.5}));
+  assert((c.view<vector<complex_t>>("arrays", "vz") == vector<complex_t>{{1, 2}}));
+  assert(c.view<vector<double>>("arrays", "empty").empty());
+  assert(c.view<ndarray<double>>("grids", "pk") == grid);
+  assert(c.view<ndarray<int>>("grids", "ni")(size_t(1), size_t(0)) == 3);
+  assert(c.view<ndarray<complex_t>>("grids", "nz").extents()[1] == 2);
+  assert(c.get_val(h, n) == DBS_SUCCESS && n == -3);
+
+  // Truncated or damaged input leaves the block alone.
+  for (size_t size : {size_t(0), size_t(3), bytes.size() / 2, bytes.size() - 1})
+    assert(c.deserialize(bytes.data(), size) == DBS_BAD_FORMAT);
+  bytes.push_back(0);
+  assert(c.deserialize(bytes.data(), bytes.size()) == DBS_BAD_FORMAT);
+  bytes[0] = 'X';
+  assert(c.deserialize(bytes.data(), bytes.size()) == DBS_BAD_FORMAT);
+  assert(c.get_val("params", "n", n) == DBS_SUCCESS && n == -3);
+
+  // Extents whose product overflows are rejected. With the extents of
+  // this 2x2 array set to 2^32 each, their product would wrap to zero
+  // and match the (now removed) empty data.
+  DataBlock d;
+  assert(d.put_val("g", "a", ndarray<int>(vector<int>{1, 2, 3, 4}, vector<size_t>{2, 2})) == DBS_SUCCESS);
+  vector<char> grid_bytes;
+  d.serialize(grid_bytes);
+  // Header (12), section "g" (5), count (4), name "a" (5), tag (1),
+  // ndims (4), then the two u64 extents, padding to 48 and the data.
+  size_t const extents_at = 31;
+  assert(grid_bytes.size() == 48 + 4 * sizeof(int) && grid_bytes[extents_at] == 2);
+  grid_bytes.resize(48);
+  for (size_t e = extents_at; e != extents_at + 16; e += 8) {
+    grid_bytes[e] = 0;
+    grid_bytes[e + 4] = 1;
+  }
+  assert(c.deserialize(grid_bytes.data(), grid_bytes.size()) == DBS_BAD_FORMAT);
+  assert(c.get_val("params", "n", n) == DBS_SUCCESS && n == -3);
+}
+
+void test_pool()
+{
+  cosmosis::block_pool pool(1 << 20, 2);
+  // Only max_sections of the recycled Sections are kept.
+  vector<Section> sections(3);
+  for (auto& s : sections)
+    {
+      s = pool.make_section();
+      assert(s.put_val("x", 1) == DBS_SUCCESS);
+    }
+  for (auto& s : sections) pool.recycle(std::move(s));
+  for (int i = 0; i != 3; ++i) pool.make_section();
+  auto c = pool.get_counts();
+  assert(c.allocations == 4 && c.reuses == 2 && c.bytes_held == 0);
+
+  // A request takes the smallest big enough buffer of those of the
+  // same size class, or else one from a larger class.
+  Section s = pool.make_section();
+  assert(s.put_val("big", vector<double>(100)) == DBS_SUCCESS);
+  assert(s.put_val("mid", vector<double>(70)) == DBS_SUCCESS);
+  assert(s.put_val("small", vector<double>(10)) == DBS_SUCCESS);
+  pool.recycle(std::move(s));
+  assert(pool.get_counts().bytes_held == 180 * sizeof(double));
+  double const values[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0};
+  vector<double> v = pool.make_vector(values, 8);
+  assert(v.size() == 8 && v[7] == 8.0 && v.capacity() == 10);
+  v = pool.make_vector(values, 1);
+  assert(v.capacity() == 70);
+  vector<double> w = pool.make_vector(values, 80);
+  assert(w.capacity() == 100 && pool.get_counts().bytes_held == 0);
+  pool.make_vector(values, 1);
+  c = pool.get_counts();
+  assert(c.allocations == 6 && c.reuses == 5);
+
+  pool.release();
+  c = pool.get_counts();
+  assert(c.allocations == 0 && c.reuses == 0 && c.bytes_held == 0);
+}
 
 void test_types()
 {
@@ -186,6 +430,301 @@ void test_types()
   assert (b.get_type("bools","a",t)==DBS_SUCCESS);
   assert(t==DBT_BOOL);
 }
+void test_handles()
+{
+  DataBlock b;
+  int h = b.resolve("Params", "X");
+  assert(h >= 0);
+  assert(b.resolve("params", "x") == h);
+  int g = b.resolve("params", "y");
+  assert(g != h);
+  string section, name;
+  assert(b.handle_key(h, section, name) == DBS_SUCCESS);
+  assert(section == "params" && name == "x");
+
+  double x = 0.0;
+  assert(b.get_val(h, x) == DBS_SECTION_NOT_FOUND);
+  assert(b.put_val(h, 2.5) == DBS_SUCCESS);
+  assert(b.put_val(h, 3.5) == DBS_NAME_ALREADY_EXISTS);
+  assert(b.get_val("PARAMS", "x", x) == DBS_SUCCESS);
+  assert(x == 2.5);
+  assert(b.get_val(g, x) == DBS_NAME_NOT_FOUND);
+  assert(b.replace_val(h, 4.5) == DBS_SUCCESS);
+  assert(b.get_val(h, x) == DBS_SUCCESS);
+  assert(x == 4.5);
+  int i = 0;
+  assert(b.get_val(h, i) == DBS_WRONG_VALUE_TYPE);
+  assert(b.replace_val(h, 1) == DBS_WRONG_VALUE_TYPE);
+
+  // Values put by name are found through handles resolved earlier.
+  assert(b.put_val("params", "y", 7) == DBS_SUCCESS);
+  assert(b.get_val(g, i) == DBS_SUCCESS);
+  assert(i == 7);
+
+  // Copies have their own cached locations.
+  DataBlock c(b);
+  assert(c.replace_val(h, 5.5) == DBS_SUCCESS);
+  assert(b.get_val(h, x) == DBS_SUCCESS);
+  assert(x == 4.5);
+  assert(c.get_val(h, x) == DBS_SUCCESS);
+  assert(x == 5.5);
+
+  // Handles survive delete_section and clear.
+  assert(b.delete_section("params") == DBS_SUCCESS);
+  assert(b.get_val(h, x) == DBS_SECTION_NOT_FOUND);
+  assert(b.put_val("params", "x", 6.5) == DBS_SUCCESS);
+  assert(b.get_val(h, x) == DBS_SUCCESS);
+  assert(x == 6.5);
+  b.clear();
+  assert(b.replace_val(h, 1.0) == DBS_SECTION_NOT_FOUND);
+  assert(b.put_val(h, 1.0) == DBS_SUCCESS);
+  assert(b.get_val("params", "x", x) == DBS_SUCCESS);
+  assert(x == 1.0);
+
+  assert(b.get_val(-1, x) == DBS_HANDLE_INVALID);
+  assert(b.put_val(g + 1, x) == DBS_HANDLE_INVALID);
+  assert(b.handle_key(g + 1, section, name) == DBS_HANDLE_INVALID);
+}
+void test_handle_storage_reuse()
+{
+  // A handle must not use its cached Entry once the Section has moved
+  // to new storage, even when the new storage is given the address of
+  // storage freed earlier. Here each round moves the section to new
+  // storage, freeing the storage of the round before, with unrelated
+  // allocations in between to stir the heap.
+  DataBlock b;
+  assert(b.put_val("s", "x", 1) == DBS_SUCCESS);
+  int h = b.resolve("s", "x");
+  int x = 0;
+  for (int i = 0; i < 50; ++i)
+    {
+      assert(b.get_val(h, x) == DBS_SUCCESS && x == 1 + 2 * i);
+      std::vector<std::vector<char>> others;
+      for (int round = 1; round <= 2; ++round)
+        {
+          Section copy = b.get_section("s");
+          others.emplace_back(504);
+          assert(b.replace_val("s", "x", 1 + 2 * i + round) == DBS_SUCCESS);
+          others.emplace_back(128);
+        }
+      assert(b.get_val(h, x) == DBS_SUCCESS && x == 3 + 2 * i);
+    }
+}
+
+void test_pin()
+{
+  DataBlock b;
+  assert(b.put_val("s", "x", vector<double>(1000, 1.0)) == DBS_SUCCESS);
+  assert(b.put_val("s", "y", 1) == DBS_SUCCESS);
+  std::shared_ptr<cosmosis::Entry const> p;
+  assert(b.pin_val("t", "x", p) == DBS_SECTION_NOT_FOUND && not p);
+  assert(b.pin_val("s", "z", p) == DBS_NAME_NOT_FOUND && not p);
+  assert(b.pin_val("S", "X", p) == DBS_SUCCESS);
+  double const* data = p->view<vector<double>>().data();
+
+  // Putting and replacing other values does not duplicate the section.
+  assert(b.put_val("s", "z", 2) == DBS_SUCCESS);
+  assert(b.replace_val("s", "y", 3) == DBS_SUCCESS);
+  assert(b.view<vector<double>>("s", "x").data() == data);
+
+  // A copy of the block still sees its own values.
+  DataBlock c(b);
+  assert(b.put_val("s", "w", 4) == DBS_SUCCESS);
+  assert(not c.has_val("s", "w"));
+
+  // Replacing the pinned value leaves the pinned one as it was, even
+  // once the block is gone.
+  assert(b.replace_val("s", "x", vector<double>(2, 5.0)) == DBS_SUCCESS);
+  assert(b.view<vector<double>>("s", "x").size() == 2);
+  b = DataBlock();
+  c = DataBlock();
+  assert(p->view<vector<double>>().data() == data && data[999] == 1.0);
+}
+
+void test_hash()
+{
+  // The hasher computes MurmurHash3_x64_128, whatever the pieces it is
+  // given the bytes in.
+  string const fox = "The quick brown fox jumps over the lazy dog";
+  cosmosis::binary_io::hasher whole, pieces;
+  whole.bytes(fox.data(), fox.size());
+  for (char c : fox) pieces.bytes(&c, 1);
+  assert(whole.digest()[0] == 0xe34bbc7bbc071b6cULL);
+  assert(whole.digest()[1] == 0x7a433ca9c49a9347ULL);
+  assert(pieces.digest() == whole.digest());
+
+  DataBlock a, b;
+  vector<double> pk(1000, 0.5);
+  assert(a.put_val("params", "x", 2.5) == DBS_SUCCESS);
+  assert(a.put_val("params", "n", 3) == DBS_SUCCESS);
+  assert(a.put_val("power", "pk", pk) == DBS_SUCCESS);
+  // Sections made in the other order, and names in other cases.
+  assert(b.put_val("Power", "PK", pk) == DBS_SUCCESS);
+  assert(b.put_val("params", "n", 3) == DBS_SUCCESS);
+  assert(b.put_val("params", "x", 2.5) == DBS_SUCCESS);
+  assert(a.hash() == b.hash());
+  assert(a.hash({"power"}) == b.hash({"POWER"}));
+  assert(a.hash({"params"}) != a.hash({"power"}));
+  assert(a.hash({"params", "power"}) != a.hash({"power", "params"}));
+  assert(a.hash({"missing"}) != a.hash());
+
+  DataBlock::hash_value h1, h2;
+  vector<std::pair<string, string>> keys{{"params", "x"}, {"power", "pk"}};
+  assert(a.hash(keys, h1) == DBS_SUCCESS);
+  assert(b.hash(keys, h2) == DBS_SUCCESS && h1 == h2);
+  pk[999] = 0.25;
+  assert(b.replace_val("power", "pk", pk) == DBS_SUCCESS);
+  assert(b.hash(keys, h2) == DBS_SUCCESS && h1 != h2);
+  assert(a.hash() != b.hash());
+  assert(a.hash({"params"}) == b.hash({"params"}));
+  // A value of another type hashes differently.
+  DataBlock c(a);
+  assert(c.delete_section("params") == DBS_SUCCESS);
+  assert(c.put_val("params", "x", complex_t(2.5, 0.0)) == DBS_SUCCESS);
+  assert(c.put_val("params", "n", 3) == DBS_SUCCESS);
+  assert(c.hash({"params"}) != a.hash({"params"}));
+
+  std::size_t failed = 99;
+  keys.emplace_back("params", "nope");
+  assert(a.hash(keys, h1, &failed) == DBS_NAME_NOT_FOUND && failed == 2);
+  keys.emplace(keys.begin(), "nope", "x");
+  assert(a.hash(keys, h1, &failed) == DBS_SECTION_NOT_FOUND && failed == 0);
+}
+
+void test_changed_since()
+{
+  typedef vector<std::pair<name_id, name_id>> changes;
+  DataBlock a;
+  assert(a.put_val("params", "x", 2.5) == DBS_SUCCESS);
+  assert(a.put_val("params", "y", 1.5) == DBS_SUCCESS);
+  assert(a.put_val("power", "pk", vector<double>(10, 0.5)) == DBS_SUCCESS);
+  auto const m = a.mark();
+  assert(a.changed_since(m).empty());
+
+  // Put, replace, overwrite, and replace through a handle all count.
+  assert(a.put_val("Params", "Z", 1) == DBS_SUCCESS);
+  assert(a.replace_val("params", "x", 3.5) == DBS_SUCCESS);
+  assert((a.changed_since(m) == changes{{"params", "x"}, {"params", "z"}}));
+  auto const m2 = a.mark();
+  double pk[10] = {};
+  int n = 10;
+  assert(a.overwrite_val<vector<double>>("power", "pk", pk, 1, &n) == DBS_SUCCESS);
+  assert(a.replace_val(a.resolve("params", "y"), 0.5) == DBS_SUCCESS);
+  assert((a.changed_since(m2) == changes{{"params", "y"}, {"power", "pk"}}));
+  // Failed writes do not.
+  assert(a.replace_val("params", "y", 1) == DBS_WRONG_VALUE_TYPE);
+  assert(a.put_val("params", "y", 1.0) == DBS_NAME_ALREADY_EXISTS);
+  assert(a.changed_since(a.mark()).empty());
+
+  // A copy has the same changes; writing to it does not change a.
+  DataBlock b(a);
+  assert(b.changed_since(m) == a.changed_since(m));
+  auto const m3 = a.mark();
+  assert(b.replace_val("params", "z", 2) == DBS_SUCCESS);
+  assert(a.changed_since(m3).empty());
+  assert((b.changed_since(m3) == changes{{"params", "z"}}));
+
+  // All the values of a copied section are new; deleted ones are not reported.
+  assert(a.copy_section("params", "saved") == DBS_SUCCESS);
+  assert(a.delete_section("power") == DBS_SUCCESS);
+  assert(a.changed_since(m3).size() == 3);
+  assert(a.changed_since(m3)[0].first == name_id("saved"));
+}
+
+void test_access_counts()
+{
+  DataBlock a;
+  a.set_log_mode(DBL_OFF);
+  assert(a.put_val("p", "x", 2.5) == DBS_SUCCESS);
+  assert(a.put_val("p", "v", vector<double>(10, 0.5)) == DBS_SUCCESS);
+  assert(a.put_val("p", "s", string("text")) == DBS_SUCCESS);
+  assert(a.put_val("p", "x", 1.5) == DBS_NAME_ALREADY_EXISTS);
+  double x;
+  vector<double> v;
+  assert(a.get_val("p", "x", x) == DBS_SUCCESS);
+  assert(a.get_val("p", "v", v) == DBS_SUCCESS);
+  assert(a.get_val("p", "nope", x) == DBS_NAME_NOT_FOUND);
+  assert(a.view<vector<double>>("p", "v").size() == 10);
+  int h = a.resolve("p", "x");
+  assert(a.replace_val(h, 3.5) == DBS_SUCCESS);
+  auto c = a.counts();
+  assert(c.reads == 3 && c.read_bytes == 8 + 80 + 80);
+  assert(c.writes == 4 && c.write_bytes == 8 + 80 + 4 + 8);
+  DataBlock b(a);
+  assert(b.counts().writes == 4);
+  b.reset();
+  assert(b.counts().reads == 0 && b.counts().write_bytes == 0);
+}
+
+void test_names()
+{
+  // Names are interned exactly as spelled; folded() gives the id of
+  // the lower-case form.
+  assert(name_id("Omega_M") == name_id(string("Omega_M")));
+  assert(name_id("Omega_M") != name_id("omega_m"));
+  assert(name_id::folded("Omega_M") == name_id("omega_m"));
+  assert(name_id::folded("OMEGA_M") == name_id::folded("omega_M"));
+  assert(name_id::folded("Omega_M").str() == "omega_m");
+  assert(name_id("Omega_M").str() == "Omega_M");
+
+  // DataBlock folds section and value names on every access.
+  DataBlock b;
+  int x = 0;
+  assert(b.put_val("Cosmo", "Omega_M", 3) == DBS_SUCCESS);
+  assert(b.has_section("COSMO"));
+  assert(b.has_val("cosmo", "OMEGA_m"));
+  assert(b.get_val("cOsMo", "omega_m", x) == DBS_SUCCESS && x == 3);
+  assert(b.put_val("cosmo", "omega_M", 4) == DBS_NAME_ALREADY_EXISTS);
+  assert(b.section_name(0) == "cosmo");
+  assert(b.value_name(0, 0) == "omega_m");
+  assert(b.value_name("COSMO", 0) == "omega_m");
+}
+
+void test_log_modes()
+{
+  DataBlock b;
+  string log_type, section, name, type;
+  double x = 0.0;
+  assert(b.log_mode() == DBL_FULL);
+  assert(b.put_val("a", "x", 1.0) == DBS_SUCCESS);
+  assert(b.get_val("a", "x", x) == DBS_SUCCESS);
+  assert(b.get_val("a", "y", x) == DBS_NAME_NOT_FOUND);
+  assert(b.get_log_count() == 3);
+  assert(b.get_log_entry(2, log_type, section, name, type) == DBS_SUCCESS);
+  assert(log_type == BLOCK_LOG_READ_FAIL && section == "a" && name == "y");
+  assert(type == "double");
+
+  b.set_log_mode(DBL_FAILURES);
+  assert(b.get_val("a", "x", x) == DBS_SUCCESS);
+  assert(b.replace_val("a", "y", 2.0) == DBS_NAME_NOT_FOUND);
+  assert(b.get_log_count() == 4);
+  assert(b.get_log_entry(3, log_type, section, name, type) == DBS_SUCCESS);
+  assert(log_type == BLOCK_LOG_REPLACE_FAIL && name == "y");
+
+  b.set_log_mode(DBL_OFF);
+  assert(b.get_val("a", "y", x) == DBS_NAME_NOT_FOUND);
+  assert(b.get_log_count() == 4);
+
+  // With a bounded log only the most recent entries are kept.
+  b.set_log_mode(DBL_FULL);
+  b.set_log_capacity(2);
+  assert(b.get_log_count() == 2);
+  assert(b.get_log_entry(0, log_type, section, name, type) == DBS_SUCCESS);
+  assert(log_type == BLOCK_LOG_READ_FAIL);
+  for (int i = 0; i != 5; ++i)
+    b.put_val("a", "n" + std::to_string(i), i);
+  assert(b.get_log_count() == 2);
+  assert(b.get_log_entry(0, log_type, section, name, type) == DBS_SUCCESS);
+  assert(log_type == BLOCK_LOG_WRITE && name == "n3" && type == "int");
+  assert(b.get_log_entry(1, log_type, section, name, type) == DBS_SUCCESS);
+  assert(name == "n4");
+  assert(b.get_log_entry(2, log_type, section, name, type) == DBS_SIZE_INSUFFICIENT);
+  b.set_log_capacity(10);
+  b.put_val("a", "n5", 5);
+  assert(b.get_log_count() == 3);
+  assert(b.get_log_entry(0, log_type, section, name, type) == DBS_SUCCESS);
+  assert(name == "n3");
+}
 
 template <class T>
 void test_multidim(T seed, vector<size_t> const& extents)
@@ -195,6 +734,12 @@ void test_multidim(T seed, vector<size_t> const& extents)
                                         std::multiplies<size_t>());
   ndarray<T> val(std::vector<T>(num_elements, seed), extents);
   b.put_val("multi", "a", val);
+
+  // A fixed-rank view of the stored array, without copying.
+  auto v = b.view<ndarray<T>>("multi", "a").template view<3>();
+  assert(v.data() == b.view<ndarray<T>>("multi", "a").data());
+  assert(v.extent(2) == extents[2]);
+  assert(v(extents[0] - 1, 0, extents[2] - 1) == seed);
 }
 
 int main()
@@ -213,6 +758,19 @@ int main()
   test_types();
   test_delete();
   test_copy();
+  test_clone();
+  test_handles();
+  test_handle_storage_reuse();
+  test_pin();
+  test_replace_in_place();
+  test_reset();
+  test_serialize();
+  test_pool();
+  test_hash();
+  test_changed_since();
+  test_access_counts();
+  test_names();
+  test_log_modes();
 
   test_multidim(1.5, vector<size_t>{3,4,5});
 }
@@ -15,6 +15,8 @@ using cosmosis::vdouble_t;
 using cosmosis::vstring_t;
 using cosmosis::vcomplex_t;
 using cosmosis::ndarray;
+using cosmosis::nd_int_t;
+using cosmosis::nd_double_t;
 using std::vector;
 using std::string;
 
@@ -107,6 +109,53 @@ void test_copy()
   assert(i!=g);
 }
 
+void test_move()
+{
+  vector<double> v(100, 2.5);
+  double const* data = v.data();
+  Entry a(std::move(v));
+  assert(a.view<vdouble_t>().data() == data);
+
+  // Moving an Entry moves the array, rather than copying it.
+  Entry b(std::move(a));
+  assert(b.view<vdouble_t>().data() == data);
+  Entry c(1);
+  c = std::move(b);
+  assert(c.is<vdouble_t>());
+  assert(c.view<vdouble_t>().data() == data);
+
+  Entry d(string("cow"));
+  Entry e(3.5);
+  e = std::move(d);
+  assert(e.view<string>() == "cow");
+  c = Entry(vstring_t{"a", "b"});
+  assert(c.view<vstring_t>().size() == 2);
+}
+
+void test_overwrite()
+{
+  Entry a(vector<int>({1, 2, 3}));
+  int const* data = a.view<vint_t>().data();
+  int vals[] = {4, 5, 6};
+  int n = 3;
+  assert(a.overwrite<vint_t>(vals, 1, &n));
+  assert(a.view<vint_t>().data() == data);
+  assert(a.view<vint_t>()[2] == 6);
+  n = 2;
+  assert(not a.overwrite<vint_t>(vals, 1, &n));
+  assert(not a.overwrite<nd_int_t>(vals, 1, &n));
+
+  ndarray<double> nd(vector<double>(6, 1.0), vector<size_t>{2, 3});
+  Entry b(nd);
+  double dvals[] = {0, 1, 2, 3, 4, 5};
+  int ext[] = {2, 3};
+  assert(b.overwrite<nd_double_t>(dvals, 2, ext));
+  assert(b.view<nd_double_t>().data()[5] == 5.0);
+  int other[] = {3, 2};
+  assert(not b.overwrite<nd_double_t>(dvals, 2, other));
+  assert(b.view<nd_double_t>().data()[5] == 5.0);
+}
+
 void test_mapusage()
 {
   typedef std::map<string, Entry> map_t;
@@ -331,11 +380,15 @@ int main()
   test_ndarray(cary);  
 
   test_copy();
+  test_move();
+  test_overwrite();
   test_mapusage();
 
   // Test copy assignability.
   static_assert(std::is_copy_constructible<Entry>::value, "Entry is not copy constructible");
   static_assert(std::is_copy_assignable<Entry>::value, "Entry is not copy assignable");
+  static_assert(std::is_nothrow_move_constructible<Entry>::value, "Entry move may throw");
+  static_assert(std::is_nothrow_move_assignable<Entry>::value, "Entry move assignment may throw");
 
   Entry e("cats and dogs");
   std::cout << "size of Entry is: " << sizeof(Entry) << std::endl;
@@ -0,0 +1,126 @@
+// Microbenchmark comparing the std::map storage formerly used by
+// DataBlock and Section with hashed_map. The layout mimics a typical
+// pipeline: ~40 sections with a few dozen values each, looked up by
+// (section, name) the way DataBlock::get_val does.
+//
+// Build and run with "make bench".
+
+#include "datablock.hh"
+#include "entry.hh"
+#include "hashed_map.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+using cosmosis::DataBlock;
+using cosmosis::Entry;
+using cosmosis::hashed_map;
+using std::string;
+using std::vector;
+
+namespace {
+  using clock_type = std::chrono::steady_clock;
+
+  double ns_per_op(clock_type::time_point t0, clock_type::time_point t1, std::size_t n)
+  {
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+  }
+
+  vector<string> section_names()
+  {
+    vector<string> names{"cosmological_parameters", "halo_model_parameters",
+                         "distances", "matter_power_lin", "matter_power_nl",
+                         "cmb_cl", "growth_parameters", "shear_cl",
+                         "galaxy_cl", "intrinsic_alignment_parameters",
+                         "likelihoods", "data_vector", "bias_lens",
+                         "nz_source", "nz_lens", "supernova_params"};
+    for (int i = names.size(); i != 40; ++i)
+      names.push_back("nuisance_section_" + std::to_string(i));
+    return names;
+  }
+
+  vector<string> value_names()
+  {
+    vector<string> names{"omega_m", "omega_b", "h0", "n_s", "a_s", "tau",
+                         "w", "wa", "omega_k", "mnu", "sigma_8", "z", "k_h",
+                         "p_k", "d_a", "d_l", "mu", "h", "ell", "bin_1_1"};
+    for (int i = names.size(); i != 30; ++i)
+      names.push_back("value_" + std::to_string(i));
+    return names;
+  }
+
+  template <class Outer>
+  double time_lookups(Outer const& blocks,
+                      vector<string> const& secs,
+                      vector<string> const& names,
+                      std::size_t repeats,
+                      bool copy_keys)
+  {
+    double sum = 0.0;
+    auto t0 = clock_type::now();
+    for (std::size_t r = 0; r != repeats; ++r)
+      for (auto const& s : secs)
+        for (auto const& n : names) {
+          if (copy_keys) {
+            // DataBlock used to lower-case copies of both strings on every call.
+            string sec(s), name(n);
+            cosmosis::downcase(sec);
+            cosmosis::downcase(name);
+            sum += blocks.find(sec)->second.find(name)->second.template view<double>();
+          } else {
+            sum += blocks.find(s)->second.find(n)->second.template view<double>();
+          }
+        }
+    auto t1 = clock_type::now();
+    std::printf("    (checksum %g)\n", sum);
+    return ns_per_op(t0, t1, repeats * secs.size() * names.size());
+  }
+}
+
+int main()
+{
+  auto const secs = section_names();
+  auto const names = value_names();
+  std::size_t const repeats = 2000;
+
+  std::map<string, std::map<string, Entry>> tree;
+  hashed_map<hashed_map<Entry>> hashed;
+  DataBlock block;
+  for (auto const& s : secs)
+    for (auto const& n : names) {
+      tree[s].emplace(n, Entry(1.0));
+      hashed[s].emplace(n, Entry(1.0));
+      block.put_val(s, n, 1.0);
+    }
+
+  std::printf("%zu sections x %zu values, %zu repeats\n",
+              secs.size(), names.size(), repeats);
+  double t_map = time_lookups(tree, secs, names, repeats, false);
+  std::printf("std::map lookup:                  %8.1f ns\n", t_map);
+  double t_hash = time_lookups(hashed, secs, names, repeats, false);
+  std::printf("hashed_map lookup:                %8.1f ns\n", t_hash);
+  std::printf("std::map lookup, copied keys:     %8.1f ns\n",
+              time_lookups(tree, secs, names, repeats, true));
+  std::printf("hashed_map lookup, copied keys:   %8.1f ns\n",
+              time_lookups(hashed, secs, names, repeats, true));
+
+  // Every DataBlock access is also logged, so use fewer repeats here to
+  // keep the size of the access log reasonable.
+  std::size_t const block_repeats = repeats / 10;
+  double sum = 0.0, x = 0.0;
+  auto t0 = clock_type::now();
+  for (std::size_t r = 0; r != block_repeats; ++r)
+    for (auto const& s : secs)
+      for (auto const& n : names) {
+        block.get_val(s, n, x);
+        sum += x;
+      }
+  auto t1 = clock_type::now();
+  std::printf("    (checksum %g)\n", sum);
+  std::printf("DataBlock::get_val:               %8.1f ns\n",
+              ns_per_op(t0, t1, block_repeats * secs.size() * names.size()));
+  std::printf("map/hashed lookup speedup:        %8.2fx\n", t_map / t_hash);
+}
@@ -0,0 +1,119 @@
+#include "hashed_map.hh"
+
+#include <cassert>
+#include <map>
+#include <string>
+#include <type_traits>
+
+using cosmosis::hashed_map;
+using std::string;
+
+void test_insert_find()
+{
+  hashed_map<int> m;
+  assert(m.size() == 0);
+  assert(m.empty());
+  assert(m.find("a") == m.end());
+
+  auto r = m.emplace("a", 1);
+  assert(r.second);
+  assert(r.first->first == "a");
+  assert(r.first->second == 1);
+  r = m.emplace("a", 2);
+  assert(not r.second);
+  assert(r.first->second == 1);
+  assert(m.size() == 1);
+
+  m["b"] = 3;
+  assert(m.find("b")->second == 3);
+  assert(m["b"] == 3);
+  assert(m.size() == 2);
+}
+
+void test_growth_and_order()
+{
+  // Insert enough keys to force several rehashes, checking against
+  // std::map for both lookup and sorted enumeration.
+  hashed_map<int> m;
+  std::map<string, int> ref;
+  int const* first = nullptr;
+  for (int i = 0; i != 1000; ++i) {
+    string key = "name_" + std::to_string((i * 7919) % 1000);
+    m.emplace(key, i);
+    ref.emplace(key, i);
+    if (i == 0) first = &m.find(key)->second;
+  }
+  // References survive insertions.
+  assert(*first == 0);
+  assert(m.size() == ref.size());
+  std::size_t k = 0;
+  for (auto const& kv : ref) {
+    assert(m.find(kv.first)->second == kv.second);
+    assert(m.nth(k).first == kv.first);
+    ++k;
+  }
+  assert(m.find("name_1000") == m.end());
+}
+
+void test_erase()
+{
+  hashed_map<int> m;
+  std::map<string, int> ref;
+  for (int i = 0; i != 200; ++i) {
+    m.emplace("k" + std::to_string(i), i);
+    ref.emplace("k" + std::to_string(i), i);
+  }
+  // Erase every third key, including the most recently inserted one.
+  for (int i = 0; i < 200; i += 3) {
+    string key = "k" + std::to_string(i);
+    m.erase(m.find(key));
+    ref.erase(key);
+  }
+  m.erase(m.find("k199"));
+  ref.erase("k199");
+  assert(m.size() == ref.size());
+  for (int i = 0; i != 200; ++i) {
+    string key = "k" + std::to_string(i);
+    auto it = m.find(key);
+    if (ref.count(key))
+      assert(it != m.end() && it->second == i);
+    else
+      assert(it == m.end());
+  }
+  std::size_t k = 0;
+  for (auto const& kv : ref) assert(m.nth(k++).first == kv.first);
+
+  // Re-inserting erased keys works.
+  assert(m.emplace("k0", -1).second);
+  assert(m.find("k0")->second == -1);
+
+  m.clear();
+  assert(m.size() == 0);
+  assert(m.find("k1") == m.end());
+  assert(m.emplace("k1", 1).second);
+}
+
+void test_copy()
+{
+  hashed_map<string> m;
+  m.emplace("x", "cow");
+  m.emplace("y", "moose");
+  hashed_map<string> c(m);
+  c["x"] = "dog";
+  assert(m.find("x")->second == "cow");
+  assert(c.find("x")->second == "dog");
+  assert(c.find("y")->second == "moose");
+}
+
+static_assert(std::is_nothrow_move_constructible<hashed_map<string>>::value,
+              "hashed_map move may throw");
+static_assert(std::is_nothrow_move_assignable<hashed_map<string>>::value,
+              "hashed_map move assignment may throw");
+
+int main()
+{
+  test_insert_find();
+  test_growth_and_order();
+  test_erase();
+  test_copy();
+}
@@ -0,0 +1,100 @@
+// Microbenchmark of element access to 2-D and 3-D tables held in a
+// DataBlock, as a module interpolating P(k,z) would do it: through
+// ndarray<T>::operator(), which checks the number of indices and loops
+// over the extents on every call, and through ndarray_view<T, N>.
+//
+// Build and run with "make bench".
+
+#include "datablock.hh"
+#include "ndarray.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using cosmosis::DataBlock;
+using cosmosis::nd_double_t;
+using cosmosis::ndarray;
+using std::size_t;
+using std::vector;
+
+namespace {
+  using clock_type = std::chrono::steady_clock;
+
+  double ns_per_op(clock_type::time_point t0, clock_type::time_point t1, size_t n)
+  {
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+  }
+
+  // Bilinear interpolation at a set of points, as fractional indices.
+  template <class Array>
+  double interpolate(Array const& pk, vector<double> const& zs, vector<double> const& ks)
+  {
+    double sum = 0.0;
+    for (double z : zs)
+      for (double k : ks) {
+        size_t const i = static_cast<size_t>(z), j = static_cast<size_t>(k);
+        double const u = z - i, t = k - j;
+        sum += (1 - u) * ((1 - t) * pk(i, j) + t * pk(i, j + 1)) +
+               u * ((1 - t) * pk(i + 1, j) + t * pk(i + 1, j + 1));
+      }
+    return sum;
+  }
+
+  template <class Array>
+  double sum3(Array const& a, size_t n0, size_t n1, size_t n2)
+  {
+    double sum = 0.0;
+    for (size_t i = 0; i != n0; ++i)
+      for (size_t j = 0; j != n1; ++j)
+        for (size_t k = 0; k != n2; ++k)
+          sum += a(i, j, k);
+    return sum;
+  }
+}
+
+int main()
+{
+  size_t const nz = 500, nk = 1000;
+  DataBlock block;
+  vector<double> values(nz * nk);
+  for (size_t i = 0; i != values.size(); ++i) values[i] = 1.0 / (i + 1);
+  block.put_val("matter_power_lin", "p_k", nd_double_t(values, vector<size_t>{nz, nk}));
+  block.put_val("grid", "w", nd_double_t(vector<double>(100 * 100 * 100, 0.5),
+                                         vector<size_t>{100, 100, 100}));
+
+  vector<double> zs, ks;
+  for (size_t i = 0; i != 200; ++i) zs.push_back((nz - 2) * (i + 0.5) / 200);
+  for (size_t j = 0; j != 2000; ++j) ks.push_back((nk - 2) * (j + 0.5) / 2000);
+  size_t const lookups = 4 * zs.size() * ks.size();
+
+  nd_double_t const& pk = block.view<nd_double_t>("matter_power_lin", "p_k");
+  auto t0 = clock_type::now();
+  double s1 = interpolate(pk, zs, ks);
+  auto t1 = clock_type::now();
+  auto pkv = pk.view<2>();
+  auto t2 = clock_type::now();
+  double s2 = interpolate(pkv, zs, ks);
+  auto t3 = clock_type::now();
+  std::printf("    (checksums %g %g)\n", s1, s2);
+  std::printf("2-D lookup, ndarray:              %8.2f ns\n", ns_per_op(t0, t1, lookups));
+  std::printf("2-D lookup, ndarray_view:         %8.2f ns\n", ns_per_op(t2, t3, lookups));
+
+  nd_double_t const& w = block.view<nd_double_t>("grid", "w");
+  t0 = clock_type::now();
+  s1 = sum3(w, 100, 100, 100);
+  t1 = clock_type::now();
+  auto wv = w.view<3>();
+  t2 = clock_type::now();
+  s2 = sum3(wv, 100, 100, 100);
+  t3 = clock_type::now();
+  double s3 = 0.0;
+  for (size_t i = 0; i != 100; ++i)
+    for (size_t j = 0; j != 100; ++j)
+      for (double x : wv.row(i, j)) s3 += x;
+  auto t4 = clock_type::now();
+  std::printf("    (checksums %g %g %g)\n", s1, s2, s3);
+  std::printf("3-D scan, ndarray:                %8.2f ns\n", ns_per_op(t0, t1, w.size()));
+  std::printf("3-D scan, ndarray_view:           %8.2f ns\n", ns_per_op(t2, t3, w.size()));
+  std::printf("3-D scan, ndarray_view rows:      %8.2f ns\n", ns_per_op(t3, t4, w.size()));
+}
@@ -67,4 +67,38 @@ main()
 
   xxx(1ul, 1ul, 1ul) = 100;
   assert(xxx(1ul, 1ul, 1ul) == 100);
+
+  // Fixed-rank views index the same elements.
+  auto v = xxx.view<3>();
+  assert(v.rank() == 3 && v.size() == 12 && v.extent(0) == 3);
+  assert(v.data() == xxx.data());
+  for (int i = 0; i != 3; ++i)
+    for (int j = 0; j != 2; ++j)
+      for (int k = 0; k != 2; ++k) {
+        assert(v(i, j, k) == xxx(size_t(i), size_t(j), size_t(k)));
+        assert(&v.at(i, j, k) == &v(i, j, k));
+      }
+  v(2, 1, 0) = -1;
+  assert(xxx(2ul, 1ul, 0ul) == -1);
+  try {
+    v.at(0, 2, 0);
+    assert("Failed to throw expected exception" == 0);
+  } catch (cosmosis::NDArrayRangeException const&) {
+    //expected
+  }
+  try {
+    xxx.view<2>();
+    assert("Failed to throw expected exception" == 0);
+  } catch (cosmosis::NDArrayIndexException const&) {
+    //expected
+  }
+
+  // Rows are contiguous.
+  ndarray<double> const& cxx = xx;
+  auto row = cxx.view<2>().row(2);
+  assert(row.size() == 2 && row.data() == &xx(2ul, 0ul));
+  double sum = 0;
+  for (double x : row) sum += x;
+  assert(sum == x[2][0] + x[2][1]);
+  assert(cxx(2ul, 1ul) == x[2][1]);
 }
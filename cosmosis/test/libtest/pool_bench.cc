@@ -0,0 +1,96 @@
+// Microbenchmark of building and destroying a block for each sample,
+// as a pipeline does, with and without a block_pool. Each block holds a
+// few parameter sections and the arrays a Boltzmann code would put,
+// about 4 MB in all, written through the C interface. Heap allocations
+// are counted by replacing the global operator new.
+//
+// Build and run with "make bench".
+
+#include "c_datablock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+  std::atomic<std::size_t> heap_allocations(0);
+}
+
+void* operator new(std::size_t n)
+{
+  ++heap_allocations;
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+  using clock_type = std::chrono::steady_clock;
+
+  struct sample_data
+  {
+    std::vector<double> k, z, pk, dist, cl;
+  };
+
+  void fill_block(c_datablock* b, sample_data const& d, int sample)
+  {
+    for (int i = 0; i != 10; ++i)
+      for (int j = 0; j != 10; ++j) {
+        std::string sec = "params_" + std::to_string(i);
+        std::string name = "p_" + std::to_string(j);
+        c_datablock_put_double(b, sec.c_str(), name.c_str(), 0.01 * sample + j);
+      }
+    int const nk = d.k.size(), nz = d.z.size();
+    int const extents[] = {nz, nk};
+    c_datablock_put_double_array_1d(b, "matter_power_lin", "k_h", d.k.data(), nk);
+    c_datablock_put_double_array_1d(b, "matter_power_lin", "z", d.z.data(), nz);
+    c_datablock_put_double_array(b, "matter_power_lin", "p_k", d.pk.data(), 2, extents);
+    for (char const* name : {"z", "a", "d_a", "d_m", "d_l", "h", "mu"})
+      c_datablock_put_double_array_1d(b, "distances", name, d.dist.data(), d.dist.size());
+    for (char const* name : {"ell", "tt", "ee", "te"})
+      c_datablock_put_double_array_1d(b, "cmb_cl", name, d.cl.data(), d.cl.size());
+  }
+
+  void run(char const* label, c_datablock_pool* pool, sample_data const& d, int samples)
+  {
+    std::size_t const before = heap_allocations;
+    auto t0 = clock_type::now();
+    for (int s = 0; s != samples; ++s) {
+      c_datablock* b = pool ? make_c_datablock_pooled(pool) : make_c_datablock();
+      c_datablock_set_log_mode(b, DBL_OFF);
+      fill_block(b, d, s);
+      destroy_c_datablock(b);
+    }
+    auto t1 = clock_type::now();
+    double const us = std::chrono::duration<double, std::micro>(t1 - t0).count() / samples;
+    double const news = double(heap_allocations - before) / samples;
+    std::printf("%-28s %10.1f us %10.1f allocations per sample\n", label, us, news);
+  }
+}
+
+int main()
+{
+  sample_data d;
+  d.k.assign(1000, 0.1);
+  d.z.assign(500, 0.5);
+  d.pk.assign(d.k.size() * d.z.size(), 1.0);
+  d.dist.assign(5000, 2.0);
+  d.cl.assign(5000, 3.0);
+  int const samples = 200;
+  std::printf("%d samples\n", samples);
+
+  run("make_c_datablock:", nullptr, d, samples);
+  c_datablock_pool* pool = make_c_datablock_pool();
+  run("make_c_datablock_pooled:", pool, d, samples);
+  long allocations = 0, reuses = 0, bytes = 0;
+  c_datablock_pool_counts(pool, &allocations, &reuses, &bytes);
+  std::printf("pool: %ld allocations, %ld reuses, %.1f MB held\n",
+              allocations, reuses, bytes / 1048576.0);
+  destroy_c_datablock_pool(pool);
+}
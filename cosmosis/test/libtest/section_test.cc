@@ -133,6 +133,37 @@ void test_type_finding()
 }
 
 
+void test_copy_on_write()
+{
+  Section s;
+  assert(s.put_val("x", 1.5) == DBS_SUCCESS);
+  assert(s.put_val("v", vector<double>({1.0, 2.0})) == DBS_SUCCESS);
+  assert(not s.shared());
+
+  // A copy shares the values until one of the two is modified.
+  Section c(s);
+  assert(s.shared() && c.shared());
+  assert(s.storage() == c.storage());
+  assert(&s.view<vector<double>>("v") == &c.view<vector<double>>("v"));
+
+  assert(c.replace_val("x", 2.5) == DBS_SUCCESS);
+  assert(not s.shared() && not c.shared());
+  assert(s.storage() != c.storage());
+  double x = 0.0;
+  assert(s.get_val("x", x) == DBS_SUCCESS && x == 1.5);
+  assert(c.get_val("x", x) == DBS_SUCCESS && x == 2.5);
+
+  // Failed modifications do not duplicate the values.
+  Section d(s);
+  assert(d.put_val("x", 0.0) == DBS_NAME_ALREADY_EXISTS);
+  assert(d.replace_val("y", 0.0) == DBS_NAME_NOT_FOUND);
+  assert(d.replace_val("x", 1) == DBS_WRONG_VALUE_TYPE);
+  assert(d.storage() == s.storage());
+  assert(d.put_val("y", 3) == DBS_SUCCESS);
+  assert(not s.has_val("y"));
+  assert(d.number_values() == 3 && s.number_values() == 2);
+}
+
 int main()
 {
   test_type(10, 101);
@@ -148,6 +179,7 @@ int main()
   test_size();
   test_section_size();
   test_type_finding();
+  test_copy_on_write();
   
   Section s;
   Section s2(s);
@@ -1,4 +1,5 @@
 from cosmosis.datablock.cosmosis_py import DataBlock
+from cosmosis.datablock.cosmosis_py.block import BlockPool
 import cosmosis.datablock.cosmosis_py.errors as errors
 import numpy as np
 import tempfile
@@ -149,6 +150,313 @@ def test_keys():
         assert k in b
 
 
+def test_clone():
+    b = DataBlock()
+    b.put('a', 'x', np.arange(10.0))
+    b.put('a', 'n', 1)
+    b.put('b', 'y', 2.0)
+    c = b.clone()
+    c['a', 'n'] = 2
+    c.put('b', 'z', 3.0)
+    b.replace('a', 'x', np.zeros(10))
+    assert b['a', 'n'] == 1
+    assert c['a', 'n'] == 2
+    assert not b.has_value('b', 'z')
+    assert np.all(c['a', 'x'] == np.arange(10.0))
+    assert np.all(b['a', 'x'] == 0)
+
+
+def test_view():
+    b = DataBlock()
+    b.put('a', 'x', np.arange(5.0))
+    b.put('a', 'g', np.arange(6).reshape(2, 3))
+    b.put('a', 's', 'str')
+    x = b.view('a', 'x')
+    g = b.view('A', 'G')
+    assert not x.flags.writeable
+    assert g.dtype == np.intc and g.shape == (2, 3) and g[1, 2] == 5
+    with pytest.raises(ValueError):
+        x[0] = 1.0
+    # Views are unaffected by later changes, or the block's deletion
+    b.replace('a', 'x', np.zeros(5))
+    assert np.all(b['a', 'x'] == 0)
+    del b
+    assert np.all(x == np.arange(5.0))
+    b = DataBlock()
+    b.put('a', 's', 'str')
+    with pytest.raises(errors.BlockWrongValueType):
+        b.view('a', 's')
+    with pytest.raises(errors.BlockNameNotFound):
+        b.view('a', 'y')
+
+
+def test_put_move():
+    b = DataBlock()
+    x = DataBlock.new_array((3, 4))
+    x[:] = 2.0
+    b.put_move('a', 'x', x)
+    assert not x.flags.writeable
+    assert b.view('a', 'x').ctypes.data == x.ctypes.data
+    assert b['a', 'x'].sum() == 24.0
+    n = DataBlock.new_array(3, int)
+    n[:] = [1, 2, 3]
+    b.put_move('a', 'n', n)
+    assert b.get_int_array_1d('a', 'n').tolist() == [1, 2, 3]
+    with pytest.raises(errors.BlockNameAlreadyExists):
+        b.put_move('a', 'n', DataBlock.new_array(3, int))
+    # Other arrays are copied
+    b.replace_move('a', 'n', np.array([4, 5]))
+    assert b['a', 'n'].tolist() == [4, 5]
+    del b
+    assert x.sum() == 24.0
+
+
+def test_put_move_then_put():
+    # Putting more values into the section of a moved array does not
+    # copy the array, though the moved array is still in use.
+    b = DataBlock()
+    x = DataBlock.new_array(1000)
+    x[:] = 1.0
+    b.put_move('a', 'x', x)
+    b.put_double('a', 'y', 2.0)
+    b.replace_double('a', 'y', 3.0)
+    assert b.view('a', 'x').ctypes.data == x.ctypes.data
+    # Replacing it leaves the moved array as it was.
+    b.replace('a', 'x', np.zeros(3))
+    del b
+    assert x.sum() == 1000.0
+
+
+def test_pool():
+    pool = BlockPool()
+    for i in range(3):
+        b = DataBlock(pool=pool)
+        b['a', 'x'] = np.arange(10.0)
+        b['b', 'y'] = np.ones((3, 4))
+        b['b', 'n'] = i
+        assert b['b', 'y'].sum() == 12.0
+        del b
+    counts = pool.counts()
+    assert counts['allocations'] == 4
+    assert counts['reuses'] == 8
+    assert counts['bytes_held'] == 22 * 8
+    # Clones share the pool, and may outlive it
+    b = DataBlock(pool=pool)
+    b['a', 'x'] = np.arange(10.0)
+    c = b.clone()
+    del pool
+    c['a', 'y'] = 1.0
+    assert c['a', 'x'][9] == 9.0
+
+
+def test_reset():
+    b = DataBlock()
+    b.set_log_mode("failures")
+    b['a', 'x'] = np.arange(100.0)
+    b['a', 'n'] = 3
+    b.reset()
+    assert not b.has_section('a')
+    assert b.get_log_count() == 0
+    b['a', 'x'] = np.ones(100)
+    assert b['a', 'x'].sum() == 100.0
+    assert b.get_log_mode() == "failures"
+
+    # Blocks made from a pool are reset and reused once collected
+    pool = BlockPool()
+    b = DataBlock(pool=pool)
+    ptr = b._ptr
+    b['a', 'x'] = 1
+    del b
+    c = DataBlock(pool=pool)
+    assert c._ptr == ptr
+    assert not c.has_section('a')
+
+
+def test_bytes():
+    import pickle
+    b = DataBlock()
+    b['a', 'n'] = 3
+    b['a', 's'] = "text"
+    b['a', 'flag'] = True
+    b['b', 'x'] = np.linspace(0.0, 1.0, 11)
+    b['b', 'grid'] = np.arange(12.0).reshape(3, 4)
+    b['b', 'names'] = np.array(["u", "v"])
+    b.put_metadata('a', 'n', 'unit', 'none')
+    c = pickle.loads(pickle.dumps(b))
+    assert c['a', 'n'] == 3
+    assert c['a', 's'] == "text"
+    assert c['a', 'flag'] is True
+    assert np.all(c['b', 'x'] == b['b', 'x'])
+    assert np.all(c['b', 'grid'] == b['b', 'grid'])
+    assert list(c['b', 'names']) == ["u", "v"]
+    assert c.get_metadata('a', 'n', 'unit') == 'none'
+    assert DataBlock.from_bytes(b.to_bytes()).to_bytes() == b.to_bytes()
+
+    with pytest.raises(errors.BlockError):
+        c.load_bytes(b.to_bytes()[:-1])
+    assert c['a', 'n'] == 3
+
+
+def test_many():
+    from cosmosis.datablock.cosmosis_py.block import ScalarKeys
+    b = DataBlock()
+    keys = [('a', 'x'), ('a', 'y'), ('b', 'z')]
+    b.put_many(keys, [1.0, 2.0, 3.0])
+    assert b['b', 'z'] == 3.0
+    assert np.all(b.get_many(keys) == [1.0, 2.0, 3.0])
+    k = ScalarKeys(keys)
+    b.replace_many(k, np.array([4.0, 5.0, 6.0]))
+    assert np.all(b.get_many(k) == [4.0, 5.0, 6.0])
+    assert len(b.get_many([])) == 0
+
+    with pytest.raises(errors.BlockNameAlreadyExists):
+        b.put_many([('a', 'w'), ('a', 'x')], [0.0, 0.0])
+    assert b['a', 'w'] == 0.0
+    with pytest.raises(errors.BlockNameNotFound) as error:
+        b.get_many([('a', 'x'), ('a', 'nope')])
+    assert (error.value.section, error.value.name) == ('a', 'nope')
+    with pytest.raises(ValueError):
+        b.put_many(keys, [1.0])
+
+
+def test_hash():
+    a = DataBlock()
+    a['p', 'x'] = 0.5
+    a['p', 'v'] = np.arange(5.0)
+    a['q', 's'] = "text"
+    b = DataBlock()
+    b['Q', 'S'] = "text"
+    b['p', 'v'] = np.arange(5.0)
+    b['p', 'x'] = 0.5
+    assert a.hash() == b.hash()
+    assert a.hash(['p']) == b.hash(['p']) != a.hash(['q'])
+    keys = [('p', 'x'), ('p', 'v')]
+    h = a.hash_values(keys)
+    assert 0 <= h < 2**128
+    assert b.hash_values(keys) == h
+    b['p', 'v'] = np.arange(1.0, 6.0)
+    assert b.hash_values(keys) != h
+    assert b.hash_values(keys[:1]) == a.hash_values(keys[:1])
+    # The hash of a copy, or of one sent to another process, is the same.
+    assert DataBlock.from_bytes(a.to_bytes()).hash() == a.hash()
+    with pytest.raises(errors.BlockNameNotFound) as error:
+        a.hash_values([('p', 'x'), ('p', 'nope')])
+    assert error.value.name == 'nope'
+
+
+def test_changed_since():
+    a = DataBlock()
+    a['p', 'x'] = 0.5
+    a['p', 'v'] = np.arange(5.0)
+    mark = a.mark()
+    assert a.changed_since(mark) == []
+    a['p', 'x'] = 1.5
+    a['Q', 'S'] = "text"
+    a.replace_double_array_1d('p', 'v', np.ones(5))
+    assert a.changed_since(mark) == [('p', 'x'), ('p', 'v'), ('q', 's')]
+    # Reading does not count.
+    mark = a.mark()
+    a['p', 'x']
+    a.keys()
+    assert a.changed_since(mark) == []
+    a._copy_section('p', 'r')
+    assert sorted(a.changed_since(mark)) == [('r', 'v'), ('r', 'x')]
+
+
+def _access_results(b):
+    # Put, replace, get and list values of many kinds, recording each
+    # result or the type of the error it raised.
+    values = [3, True, 2.5, 1.0 - 2.0j, "text", np.float32(0.5), np.int64(7),
+              2**40, np.arange(4), np.arange(4.0)[::2], [1.0, 2.0], (1, 2),
+              np.arange(6.0).reshape(2, 3), np.arange(6).reshape(3, 2),
+              np.array(["u", "vw"]), np.arange(3, dtype=np.uint8),
+              np.array([1j, 2j]), np.array(2.0), None, {}]
+    results = []
+    def record(f, *args):
+        try:
+            r = f(*args)
+            if isinstance(r, np.ndarray):
+                r = (r.dtype, r.shape, r.tolist())
+            results.append(r)
+        except Exception as e:
+            results.append(type(e))
+    for i, v in enumerate(values):
+        name = "v{}".format(i)
+        record(b.put, "s", name, v)
+        record(b.put, "s", name, v)
+        record(b.get, "S", name.upper())
+        record(b.replace, "s", name, v)
+        record(b.replace, "s", name, 1.5)
+        record(b.__setitem__, ("t", name), v)
+        record(b.__setitem__, ("t", name), v)
+        record(b.__getitem__, ("t", name))
+    record(b.get, "s", "missing")
+    record(b.get, "missing", "x")
+    record(b.replace, "missing", "x", 1)
+    record(b.replace, "s", "v0", "text")
+    record(b.get, "s", "caf\u00e9")
+    record(b.keys)
+    record(b.keys, "T")
+    record(b.keys, "missing")
+    return results
+
+
+def test_extension(monkeypatch):
+    import cosmosis.datablock.cosmosis_py.block as block_module
+    if block_module._ext is None:
+        pytest.skip("The DataBlock extension module was not built")
+    b = DataBlock()
+    b["s", "x"] = 1.0
+    assert block_module._ext.get(b._ptr, "s", "x") == 1.0
+    with_ext = _access_results(DataBlock())
+    monkeypatch.setattr(block_module, "_ext", None)
+    assert _access_results(DataBlock()) == with_ext
+
+
+def test_snapshot():
+    from cosmosis.datablock.cosmosis_py.snapshot import Snapshot
+    b = DataBlock()
+    b['a', 'n'] = 3
+    b['a', 'z'] = 1.0 - 2.0j
+    b['a', 's'] = "text"
+    b['a', 'flag'] = False
+    b['b', 'x'] = np.linspace(0.0, 1.0, 11)
+    b['b', 'grid'] = np.arange(24.0).reshape(2, 3, 4)
+    b['b', 'ints'] = np.arange(5)
+    b['b', 'names'] = np.array(["u", "vw"])
+    b.put_metadata('b', 'x', 'unit', 'Mpc')
+    with tempfile.TemporaryDirectory() as dirname:
+        filename = os.path.join(dirname, "sub", "sample_0")
+        b.save(filename)
+        with pytest.raises(ValueError):
+            b.save_snapshot(filename + ".snap")
+
+        with Snapshot(filename + ".snap") as snap:
+            assert len(snap) == len(b.keys())
+            assert snap.sections() == ['a', 'b']
+            assert snap['A', 'N'] == 3
+            assert snap['a', 'z'] == 1.0 - 2.0j
+            assert snap['a', 's'] == "text"
+            assert snap['a', 'flag'] is False
+            grid = snap['b', 'grid']
+            assert grid.shape == (2, 3, 4) and not grid.flags.writeable
+            # Arrays are page-aligned in the file
+            assert grid.ctypes.data % 4096 == 0
+            assert np.all(grid == b['b', 'grid'])
+            assert np.all(snap['b', 'ints'] == np.arange(5))
+            assert list(snap['b', 'names']) == ["u", "vw"]
+        assert grid[1, 2, 3] == 23.0
+
+        c = DataBlock.from_snapshot(filename + ".snap")
+        assert c.to_bytes() == b.to_bytes()
+        assert c.get_metadata('b', 'x', 'unit') == 'Mpc'
+
+        Snapshot(filename + ".snap").export(filename, format="tgz")
+        assert os.path.exists(filename + ".tgz")
+        with pytest.raises(ValueError):
+            b.save(filename, format="text")
+
+
 def test_wrong_array_type():
     puts = {
         int:   "put_int_array_1d",
@@ -179,6 +487,98 @@ def test_wrong_array_type():
                 get(section, key)
 
 
+def test_handles():
+    b = DataBlock()
+    h = b.resolve('Test', 'X')
+    assert b.resolve('test', 'x') == h
+    assert b.handle_key(h) == ('test', 'x')
+    with pytest.raises(errors.BlockSectionNotFound):
+        b.get_double_h(h)
+    b.put_double_h(h, 1.5)
+    assert b.get_double('test', 'x') == 1.5
+    with pytest.raises(errors.BlockNameAlreadyExists):
+        b.put_double_h(h, 2.0)
+    b.replace_double_h(h, 2.5)
+    assert b.get_double_h(h) == 2.5
+    with pytest.raises(errors.BlockWrongValueType):
+        b.get_int_h(h)
+
+    # Handles survive deletion of their section.
+    b._delete_section('test')
+    with pytest.raises(errors.BlockSectionNotFound):
+        b.get_double_h(h)
+    b.put_int('test', 'x', 3)
+    assert b.get_int_h(h) == 3
+
+    with pytest.raises(errors.BlockHandleInvalid):
+        b.get_int_h(h + 1)
+
+def test_log_mode():
+    b = DataBlock()
+    assert b.get_log_mode() == "full"
+    b['a', 'x'] = 1.0
+    assert b.get_log_count() == 1
+    b.set_log_mode("failures")
+    assert b.get_log_mode() == "failures"
+    b['a', 'x']
+    with pytest.raises(errors.BlockNameNotFound):
+        b.get_double('a', 'y')
+    assert b.get_log_count() == 2
+    assert b.get_log_entry(1)[:3] == ("READ-FAIL", "a", "y")
+    b.set_log_mode("off")
+    b['a', 'z'] = 2.0
+    assert b.get_log_count() == 2
+    with pytest.raises(ValueError):
+        b.set_log_mode("verbose")
+
+    b.set_log_mode("full")
+    b.set_log_capacity(3)
+    for i in range(10):
+        b.put_int('b', 'n{}'.format(i), i)
+    assert b.get_log_count() == 3
+    assert [b.get_log_entry(i)[2] for i in range(3)] == ["n7", "n8", "n9"]
+
+    # Checks for values and sections are logged, but are not failures.
+    b = DataBlock()
+    b['a', 'x'] = 1.0
+    assert ('a', 'y') not in b
+    assert b.has_section('a')
+    b.keys()
+    log = [b.get_log_entry(i)[:3] for i in range(b.get_log_count())]
+    assert log == [("WRITE-OK", "a", "x"), ("CHECK", "a", "y"), ("CHECK", "a", ""),
+                   ("CHECK", "", ""), ("CHECK", "a", "")]
+    b.set_log_mode("failures")
+    b.has_value('a', 'z')
+    assert b.get_log_count() == 5
+
+
+def test_concurrent():
+    import threading
+    b = DataBlock()
+    b['common', 'x'] = 1.5
+    b.set_concurrent()
+    assert b.is_concurrent()
+
+    def work(k):
+        for i in range(200):
+            b['thread_{}'.format(k), 'v{}'.format(i)] = b['common', 'x'] + i
+
+    threads = [threading.Thread(target=work, args=(k,)) for k in range(4)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    for k in range(4):
+        assert b['thread_{}'.format(k), 'v199'] == 200.5
+    counts = b.access_counts()
+    assert counts['writes'] == 1 + 4 * 200
+    # The log of each thread is collected when the log is read.
+    assert b.get_log_count() == 1 + 4 * 400 + 4
+    b.set_concurrent(False)
+    assert not b.is_concurrent()
+    assert b.get_log_count() == 1 + 4 * 400 + 4
+
+
 if __name__ == '__main__':
     # test_string_array()
     # test_string_array_save()
@@ -0,0 +1,195 @@
+import collections
+import sys
+import threading
+import time
+import types
+import pytest
+
+
+class FakeMPI(object):
+    u"""Just enough of mpi4py.MPI to run an MPIPool with threads as its ranks."""
+    ANY_SOURCE = -1
+    ANY_TAG = -1
+
+    class Status(object):
+        source = None
+        tag = None
+
+    class Request(object):
+        def __init__(self):
+            self.waited = False
+
+        def wait(self):
+            self.waited = True
+
+        @staticmethod
+        def waitall(requests):
+            for r in requests:
+                r.wait()
+
+
+class FakeComm(object):
+    def __init__(self, world, rank):
+        self.world = world
+        self.rank = rank
+        self.requests = []
+
+    def Get_rank(self):
+        return self.rank
+
+    def Get_size(self):
+        return len(self.world)
+
+    def send(self, obj, dest, tag=0):
+        box, cond = self.world[dest]
+        with cond:
+            box.append((self.rank, tag, obj))
+            cond.notify_all()
+
+    def isend(self, obj, dest, tag=0):
+        self.send(obj, dest, tag)
+        request = FakeMPI.Request()
+        self.requests.append(request)
+        return request
+
+    def _find(self, source, tag):
+        box, _ = self.world[self.rank]
+        for i, (s, t, _) in enumerate(box):
+            if source in (s, FakeMPI.ANY_SOURCE) and tag in (t, FakeMPI.ANY_TAG):
+                return i
+        return None
+
+    def Iprobe(self, source=FakeMPI.ANY_SOURCE, tag=FakeMPI.ANY_TAG, status=None):
+        _, cond = self.world[self.rank]
+        with cond:
+            return self._find(source, tag) is not None
+
+    def recv(self, source=FakeMPI.ANY_SOURCE, tag=FakeMPI.ANY_TAG, status=None):
+        box, cond = self.world[self.rank]
+        with cond:
+            while True:
+                i = self._find(source, tag)
+                if i is not None:
+                    break
+                cond.wait()
+            s, t, obj = box[i]
+            del box[i]
+        if status is not None:
+            status.source = s
+            status.tag = t
+        return obj
+
+
+@pytest.fixture
+def fake_mpi(monkeypatch):
+    module = types.ModuleType("mpi4py")
+    module.MPI = FakeMPI
+    monkeypatch.setitem(sys.modules, "mpi4py", module)
+
+
+def run_pool(size, tasks, function, run=None, **kwargs):
+    from cosmosis.runtime.mpi_pool import MPIPool
+    world = [(collections.deque(), threading.Condition()) for _ in range(size)]
+    pools = [MPIPool(comm=FakeComm(world, rank), **kwargs) for rank in range(size)]
+    workers = [threading.Thread(target=pool.wait) for pool in pools[1:]]
+    for w in workers:
+        w.start()
+    master = pools[0]
+    if run is None:
+        run = lambda pool: pool.map(function, tasks)
+    try:
+        results = run(master)
+    finally:
+        master.close()
+        for w in workers:
+            w.join()
+    return master, results
+
+
+def slow_square(x):
+    # Every tenth task is ten times slower than the others.
+    time.sleep(0.01 if x % 10 == 0 else 0.001)
+    return x * x
+
+
+@pytest.mark.parametrize("dispatch_only", [False, True])
+@pytest.mark.parametrize("schedule", ["static", "dynamic"])
+def test_mpi_pool_map(fake_mpi, schedule, dispatch_only):
+    tasks = list(range(100))
+    pool, results = run_pool(4, tasks, slow_square, schedule=schedule, chunk_time=0.005,
+                             dispatch_only=dispatch_only)
+    assert results == [x * x for x in tasks]
+    usage = pool.utilization()
+    assert [u["rank"] for u in usage] == [0, 1, 2, 3]
+    assert sum(u["tasks"] for u in usage) == len(tasks)
+    if dispatch_only:
+        assert usage[0]["tasks"] == 0
+    assert all(0 <= u["utilization"] <= 1.0 for u in usage)
+    assert "rank" in pool.utilization_report()
+    if schedule == "dynamic":
+        # Work is handed out in many small chunks, not one per rank.
+        assert sum(u["chunks"] for u in usage) > 4
+        assert all(u["tasks"] > 0 for u in usage[1 if dispatch_only else 0:])
+
+
+def test_mpi_pool_chunk_size(fake_mpi):
+    from cosmosis.runtime.mpi_pool import MPIPool
+    world = [(collections.deque(), threading.Condition())]
+    pool = MPIPool(comm=FakeComm(world, 0), schedule="dynamic", chunk_time=1.0)
+    # Nothing measured yet: one task at a time.
+    assert pool.chunk_size(1000) == 1
+    pool.task_time = 0.01
+    assert pool.chunk_size(1000) == 100
+    # Near the end of a map, chunks shrink to a share of what is left.
+    assert pool.chunk_size(10) == 5
+    assert pool.chunk_size(1) == 1
+    with pytest.raises(ValueError):
+        MPIPool(comm=FakeComm(world, 0), schedule="guided")
+
+
+def test_mpi_pool_imap(fake_mpi):
+    def run(pool):
+        # Tasks come from a generator, and are handed out a few at a time.
+        tasks = (x for x in range(60))
+        ordered = list(pool.imap(slow_square, tasks, max_in_flight=5))
+        unordered = dict(pool.imap_unordered(slow_square, range(30)))
+        # An abandoned iteration does not upset the next one.
+        stream = pool.imap(slow_square, range(100))
+        first = [next(stream) for _ in range(3)]
+        again = pool.map(slow_square, [1, 2, 3])
+        return ordered, unordered, first, again
+
+    pool, (ordered, unordered, first, again) = run_pool(4, None, None, run=run, chunk_time=0.005)
+    assert ordered == [x * x for x in range(60)]
+    assert unordered == {x: x * x for x in range(30)}
+    assert first == [0, 1, 4]
+    assert again == [1, 4, 9]
+    assert pool.outstanding == 0
+    # Every chunk sent, including those of the abandoned iteration, has
+    # had its send completed.
+    assert all(r.waited for r in pool.comm.requests)
+    assert not any(pool.sends)
+
+
+def test_mpi_pool_threads(fake_mpi):
+    idents = collections.defaultdict(set)
+    lock = threading.Lock()
+
+    def square_in_thread(x):
+        time.sleep(0.002)
+        with lock:
+            idents[threading.get_ident()].add(x)
+        return x * x
+
+    tasks = list(range(120))
+    for schedule in ["static", "dynamic"]:
+        idents.clear()
+        pool, results = run_pool(3, tasks, square_in_thread, schedule=schedule, chunk_time=0.01, threads=4)
+        assert results == [x * x for x in tasks]
+        # Each rank shares its tasks between its own threads.
+        assert len(idents) > 3
+        assert "4 threads per rank" in pool.utilization_report()
+    # Chunks keep all the threads of a rank busy.
+    assert pool.chunk_size(None) >= 4
+    assert pool.chunk_size(100) >= 4
+    assert pool.chunk_size(2) == 2
@@ -1,13 +1,16 @@
-from cosmosis.runtime import Inifile, register_new_parameter, LikelihoodPipeline, Parameter, Module
+from cosmosis.runtime import Inifile, register_new_parameter, LikelihoodPipeline, Parameter, Module, FunctionModule
+from cosmosis.runtime.pipeline import Pipeline
 from cosmosis.datablock import DataBlock
 from cosmosis.samplers.sampler import Sampler
 from cosmosis.runtime.prior import TruncatedGaussianPrior, DeltaFunctionPrior
 from cosmosis.output.in_memory_output import InMemoryOutput
 from cosmosis.main import run_cosmosis, parser
 import numpy as np
+import json
 import os
 import tempfile
 import pstats
+import time
 import pytest
 
 root = os.path.split(os.path.abspath(__file__))[0]
@@ -73,6 +76,31 @@ def test_add_param():
 
     return output
 
+def test_starting_block_types():
+    # Integer fixed parameters stay integers in the block, while the
+    # others are put as doubles.
+    with tempfile.TemporaryDirectory() as dirname:
+        values_file = f"{dirname}/values.ini"
+        with open(values_file, "w") as values:
+            values.write(
+                "[parameters]\n"
+                "p1=-3.0  0.0  3.0\n"
+                "p2=2.5\n"
+                "n_bins=3\n")
+        override = {
+            ('runtime', 'root'): root,
+            ("pipeline", "modules"): "test1",
+            ("pipeline", "values"): values_file,
+            ("test1", "file"): "example_module.py",
+        }
+        pipeline = LikelihoodPipeline(Inifile(None, override=override))
+        block = pipeline.build_starting_block([1.5])
+        assert block.get_double("parameters", "p1") == 1.5
+        assert block.get_double("parameters", "p2") == 2.5
+        assert block.get_int("parameters", "n_bins") == 3
+        assert list(range(block["parameters", "n_bins"])) == [0, 1, 2]
+
+
 def test_missing_setup():
     # check the register_new_parameter feature when no
     # setup is currently happening
@@ -164,6 +192,47 @@ def test_profile(capsys):
 
 
 
+def test_module_profile():
+    with tempfile.TemporaryDirectory() as dirname:
+        values_file = f"{dirname}/values.ini"
+        profile = f"{dirname}/modules"
+        with open(values_file, "w") as values:
+            values.write(
+                "[parameters]\n"
+                "p1=-3.0  0.0  3.0\n"
+                "p2=-3.0  0.0  3.0\n")
+
+        params = {
+            ('runtime', 'root'): os.path.split(os.path.abspath(__file__))[0],
+            ('runtime', 'sampler'):  "test",
+            ("pipeline", "modules"): "test1",
+            ("pipeline", "values"): values_file,
+            ("pipeline", "access_log"): "off",
+            ("pipeline", "profile"): profile,
+            ("test1", "file"): "example_module.py",
+        }
+
+        ini = Inifile(None, override=params)
+        run_cosmosis(ini)
+
+        with open(profile + ".json") as f:
+            report = json.load(f)
+        test1, = report["modules"]
+        assert test1["name"] == "test1"
+        assert test1["calls"] == 1 and test1["failures"] == 0
+        assert test1["wall"] > 0 and test1["wall_fraction"] == 1.0
+        # The module reads the two parameters and writes its outputs,
+        # and they are counted even though the access log is off.
+        assert test1["reads"] >= 2 and test1["read_bytes"] >= 16
+        assert test1["writes"] >= 1
+
+        with open(profile + ".trace.json") as f:
+            trace = json.load(f)
+        event, = trace["traceEvents"]
+        assert event["name"] == "test1" and event["ph"] == "X"
+        assert event["args"]["reads"] == test1["reads"]
+
+
 def test_script_skip():
     with tempfile.TemporaryDirectory() as dirname:
         values_file = f"{dirname}/values.ini"
@@ -199,6 +268,269 @@ def test_script_skip():
         finally:
             del os.environ["COSMOSIS_NO_SUBPROCESS"]
 
+def test_skip_unchanged():
+    calls = []
+
+    def derive(block):
+        calls.append("derive")
+        block["derived", "y"] = 2 * block["params", "x"]
+        block["derived", "v"] = np.arange(3.0) * block["params", "x"]
+        return 0
+
+    def like(block):
+        calls.append("like")
+        block["likelihoods", "l_like"] = block["derived", "y"] + block["params", "z"]
+        return 0
+
+    modules = [FunctionModule("derive", lambda config: None, derive),
+               FunctionModule("like", lambda config: None, like)]
+    for module in modules:
+        module.setup(DataBlock())
+    modules[0].inputs = Module.parse_inputs("params/x")
+    modules[1].inputs = Module.parse_inputs("derived params/Z")
+    assert modules[1].inputs == ([("params", "z")], ["derived"])
+    ini = Inifile(None, override={("pipeline", "skip_unchanged"): "T"})
+    pipeline = Pipeline(ini, modules=modules)
+
+    def run(x, z):
+        block = DataBlock()
+        block["params", "x"] = x
+        block["params", "z"] = z
+        assert pipeline.run(block)
+        return block
+
+    run(1.0, 0.5)
+    block = run(1.0, 0.25)
+    assert calls == ["derive", "like", "like"]
+    # The skipped module's outputs are restored.
+    assert block["derived", "y"] == 2.0
+    assert np.all(block["derived", "v"] == np.arange(3.0))
+    assert block["likelihoods", "l_like"] == 2.25
+    block = run(2.0, 0.25)
+    assert calls[3:] == ["derive", "like"]
+    assert block["likelihoods", "l_like"] == 4.25
+    run(2.0, 0.25)
+    assert len(calls) == 5
+
+
+def test_parallel_modules():
+    import threading
+    # Once the pipeline runs modules in parallel, both likelihoods must
+    # be running at the same time to pass the barrier.
+    barrier = threading.Barrier(2, timeout=30)
+    parallel = [False]
+    fail = [False]
+
+    def derive(block):
+        block["derived", "y"] = 2 * block["params", "x"]
+        return 0
+
+    def like(name, offset):
+        def execute(block):
+            if parallel[0]:
+                barrier.wait()
+            if fail[0] and name == "b":
+                return 3
+            block["likelihoods", name + "_like"] = block["derived", "y"] + offset
+            return 0
+        return execute
+
+    def total(block):
+        block["derived", "total"] = block["likelihoods", "a_like"] + block["likelihoods", "b_like"]
+        return 0
+
+    modules = [FunctionModule("derive", lambda config: None, derive),
+               FunctionModule("a", lambda config: None, like("a", 1.0)),
+               FunctionModule("b", lambda config: None, like("b", 2.0)),
+               FunctionModule("total", lambda config: None, total)]
+    for module in modules:
+        module.setup(DataBlock())
+    ini = Inifile(None, override={("pipeline", "parallel_modules"): "2"})
+    pipeline = Pipeline(ini, modules=modules)
+
+    def run(x):
+        block = DataBlock()
+        block["params", "x"] = x
+        return pipeline.run(block), block
+
+    # The first run is in sequence, and finds the dependencies.
+    status, block = run(1.0)
+    assert status
+    assert pipeline.module_graph.dependencies == [set(), {0}, {0}, {1, 2}]
+
+    parallel[0] = True
+    status, block = run(2.0)
+    assert status
+    assert not block.is_concurrent()
+    assert block["derived", "total"] == 11.0
+    log = [block.get_log_entry(i)[:2] for i in range(block.get_log_count())]
+    assert ("MODULE-START", "a") in log and ("MODULE-START", "b") in log
+
+    fail[0] = True
+    status, block = run(3.0)
+    assert status is None
+    assert not block.has_value("derived", "total")
+    pipeline.cleanup()
+
+
+def test_module_graph_checks():
+    # Modules that only check for a value, or list a section or the
+    # block, still depend on the modules that write them.
+    def make(block):
+        block["opt", "flag"] = 1
+        return 0
+
+    def check(block):
+        block["res1", "found"] = int(("opt", "flag") in block)
+        return 0
+
+    def listing(block):
+        block["res2", "n"] = len(block.keys("opt")) if block.has_section("opt") else 0
+        return 0
+
+    def whole(block):
+        block["res3", "n"] = len(block.sections())
+        return 0
+
+    def independent(block):
+        block["other", "x"] = block["params", "x"]
+        return 0
+
+    modules = [FunctionModule(f.__name__, lambda config: None, f)
+               for f in (make, check, listing, whole, independent)]
+    for module in modules:
+        module.setup(DataBlock())
+    ini = Inifile(None, override={("pipeline", "parallel_modules"): "2"})
+    pipeline = Pipeline(ini, modules=modules)
+    block = DataBlock()
+    block["params", "x"] = 1.0
+    assert pipeline.run(block)
+    assert pipeline.module_graph.dependencies == [set(), {0}, {0}, {0, 1, 2}, {3}]
+    pipeline.cleanup()
+
+
+def test_threads():
+    import threading
+    import concurrent.futures
+    # A thread-safe module is run by both threads at once, which must
+    # both be inside it to pass the barrier; the other is run by one
+    # thread at a time.
+    barrier = threading.Barrier(2, timeout=30)
+    inside = [0]
+    most_inside = [0]
+
+    def shared(block):
+        barrier.wait()
+        block["derived", "y"] = 2 * block["params", "x"]
+        return 0
+
+    def serial(block):
+        inside[0] += 1
+        most_inside[0] = max(most_inside[0], inside[0])
+        time.sleep(0.01)
+        block["derived", "z"] = block["derived", "y"] + 1
+        inside[0] -= 1
+        return 0
+
+    modules = [FunctionModule("shared", lambda config: None, shared),
+               FunctionModule("serial", lambda config: None, serial)]
+    modules[0].thread_safe = True
+    for module in modules:
+        module.setup(DataBlock())
+    ini = Inifile(None, override={("runtime", "threads"): "2"})
+    pipeline = Pipeline(ini, modules=modules)
+    assert list(pipeline.module_locks) == [1]
+
+    def run(x):
+        block = DataBlock()
+        block["params", "x"] = x
+        assert pipeline.run(block)
+        return block["derived", "z"]
+
+    with concurrent.futures.ThreadPoolExecutor(2) as executor:
+        results = list(executor.map(run, [1.0, 2.0, 3.0, 4.0]))
+    assert results == [3.0, 5.0, 7.0, 9.0]
+    assert most_inside[0] == 1
+    assert pipeline.run_count == pipeline.run_count_ok == 4
+
+    # Threads are turned off along with features they cannot share.
+    ini = Inifile(None, override={("runtime", "threads"): "2", ("pipeline", "skip_unchanged"): "T"})
+    assert Pipeline(ini, modules=modules).threads == 1
+
+    # The profiler cannot tell modules apart when they run at once.
+    ini = Inifile(None, override={("runtime", "threads"): "2", ("pipeline", "profile"): "unused"})
+    pipeline = Pipeline(ini, modules=modules)
+    assert pipeline.threads == 2 and pipeline.profiler is None
+
+
+def test_fast_slow_checkpoints():
+    calls = []
+
+    def module(name, param, output, extra_writes=0):
+        def execute(block):
+            calls.append(name)
+            block[output] = block["parameters", param] + sum(block[k] for k in block.keys("outputs"))
+            for i in range(extra_writes):
+                block["scratch", f"{name}_{i}"] = i
+            return 0
+        return FunctionModule(name, lambda config: None, execute)
+
+    def likelihood(block):
+        calls.append("like")
+        block["likelihoods", "l_like"] = -block["outputs", "z"]**2
+        return 0
+
+    def make_pipeline(cache_mb, extra_writes=0):
+        values = Inifile(None, override={
+            ("parameters", "p1"): "-1.0 0.0 1.0",
+            ("parameters", "p2"): "-1.0 0.0 1.0",
+            ("parameters", "p3"): "-1.0 0.0 1.0",
+        })
+        ini = Inifile(None, override={
+            ("pipeline", "fast_slow"): "T",
+            ("pipeline", "first_fast_module"): "m3",
+            ("pipeline", "fast_slow_cache_mb"): str(cache_mb),
+            ("pipeline", "likelihoods"): "l",
+        })
+        modules = [module("m1", "p1", ("outputs", "x"), extra_writes),
+                   module("m2", "p2", ("outputs", "y")),
+                   module("m3", "p3", ("outputs", "z")),
+                   FunctionModule("like", lambda config: None, likelihood)]
+        pipeline = LikelihoodPipeline(ini, modules=modules, values=values)
+        pipeline.setup_fast_subspaces()
+        return pipeline
+
+    pipeline = make_pipeline(1.0)
+    cache = pipeline.slow_subspace_cache
+    assert cache.checkpoints == [1, 2]
+    assert [p.name for p in pipeline.slow_params] == ["p1", "p2"]
+
+    def run(*p):
+        del calls[:]
+        like = pipeline.likelihood([0.1 * x for x in p])
+        return calls, like
+
+    expected = run(1, 2, 3)[1]
+    # Changing a parameter restarts from the deepest checkpoint before its first use.
+    assert run(1, 2, 4)[0] == ["m3", "like"]
+    assert run(1, 3, 4)[0] == ["m2", "m3", "like"]
+    assert run(1, 2, 3) == (["m3", "like"], expected)
+    assert run(2, 2, 3)[0] == ["m1", "m2", "m3", "like"]
+    assert 0 < cache.cache.total_size <= 1e6
+
+    # With no room for checkpoints every module always runs.
+    pipeline = make_pipeline(0.0)
+    run(1, 2, 3)
+    assert run(1, 2, 4)[0] == ["m1", "m2", "m3", "like"]
+    assert len(pipeline.slow_subspace_cache.cache) == 0
+
+    # The analysis sees the first use of each parameter even when the
+    # modules make more accesses than a block's log usually holds.
+    pipeline = make_pipeline(1.0, extra_writes=70000)
+    assert pipeline.slow_subspace_cache.checkpoints == [1, 2]
+    assert [p.name for p in pipeline.slow_params] == ["p1", "p2"]
+
+
 def test_prior_override():
     with tempfile.TemporaryDirectory() as dirname:
         values_file = f"{dirname}/values.ini"
@@ -0,0 +1,75 @@
+import os
+import numpy as np
+import pytest
+from cosmosis.runtime.process_pool import Pool, _pack, _unpack
+
+
+def posterior_like(x):
+    # The shape of what samplers' task functions return.
+    return (-0.5 * x * x, 0.0, np.arange(3.0) * x)
+
+
+def worker_pid(x):
+    return os.getpid()
+
+
+def fail_on_three(x):
+    if x == 3:
+        raise ValueError("three")
+    return x
+
+
+def test_pack_round_trip():
+    buf = np.zeros(1024, dtype=np.uint8)
+    value = (1.5, -2, None, [np.arange(5, dtype=np.int32), np.ones((2, 3))], (3.0,))
+    spec, end = _pack(value, buf, 0)
+    out, end2 = _unpack(spec, buf, 0)
+    assert end == end2
+    assert out[:3] == (1.5, -2, None)
+    assert out[3][0].dtype == np.int32
+    assert np.all(out[3][0] == np.arange(5))
+    assert out[3][1].shape == (2, 3)
+    assert out[4] == (3.0,)
+
+
+def test_process_pool_map():
+    with Pool(3, slot_size=256) as pool:
+        tasks = [float(i) for i in range(50)]
+        results = pool.map(posterior_like, tasks)
+        for x, (post, prior, extra) in zip(tasks, results):
+            assert post == -0.5 * x * x
+            assert prior == 0.0
+            assert np.all(extra == np.arange(3.0) * x)
+        assert pool.shared_results == len(tasks)
+
+        # The workers are kept from one map to the next...
+        pids = pool.workers[0].pid, pool.workers[1].pid
+        pool.map(posterior_like, tasks)
+        assert (pool.workers[0].pid, pool.workers[1].pid) == pids
+        # ... but replaced for a new function.
+        assert set(pool.map(worker_pid, range(20))) <= {w.pid for w in pool.workers}
+        assert pool.workers[0].pid not in pids
+
+        # Results that do not fit in a slot are pickled instead.
+        big = pool.map(np.ones, [10, 1000])
+        assert big[1].shape == (1000,)
+        assert pool.pickled_results == 1
+
+        # Errors in the workers are raised in the master.
+        with pytest.raises(ValueError):
+            pool.map(fail_on_three, range(10))
+        assert pool.map(fail_on_three, [1, 2]) == [1, 2]
+    assert pool.workers == []
+
+
+def test_process_pool_imap():
+    with Pool(2) as pool:
+        tasks = (float(x) for x in range(20))
+        results = list(pool.imap(posterior_like, tasks, max_in_flight=3))
+        assert [r[0] for r in results] == [-0.5 * x * x for x in range(20)]
+        indices = sorted(i for i, _ in pool.imap_unordered(posterior_like, [1.0] * 10))
+        assert indices == list(range(10))
+        # An abandoned iteration does not upset the next one.
+        stream = pool.imap(worker_pid, range(50))
+        next(stream)
+        assert pool.map(fail_on_three, [1, 2]) == [1, 2]
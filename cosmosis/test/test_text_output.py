@@ -87,3 +87,34 @@ def test_cosmomc_output():
         assert data.shape == (ns, nparam + 2)
         assert (data[:-1, 0] == 1).all()
         assert data[-1, 0] == 2
+
+def test_background_writer():
+    with tempfile.TemporaryDirectory() as dirname:
+        filename=os.path.join(dirname, 'cosmosis_temp_background_test.txt')
+        out = TextColumnOutput.from_options({'filename':filename, 'format':'text'})
+        out.start_background_writer(max_queued=4)
+        nparam = 3
+        ns = 50
+        populate_table(out, nparam, ns)
+
+        names, data, meta, comments, final = TextColumnOutput.load_from_options({"filename":filename})
+        assert names == ['A', 'B', 'C']
+        assert len(data[0]) == ns
+        assert (data[0][:, 0] == np.arange(ns)).all()
+        assert meta[0]['NP'] == nparam
+        assert final[0]['FINISH'] is True
+
+        # Errors in the writer are raised in the caller
+        out = TextColumnOutput.from_options({'filename':filename, 'format':'text'})
+        out.start_background_writer()
+        out.add_column('A', float)
+        out.parameters([1.0])
+        out.sync()
+        out._file.close()
+        out.parameters([2.0])
+        try:
+            out.sync()
+        except ValueError:
+            pass
+        else:
+            assert False, "writer error was not raised"
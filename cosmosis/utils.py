@@ -80,6 +80,17 @@ def mkdir(path):
             raise
 
 
+def in_order(pairs):
+    u"""Yield the values from an iterable of (index, value) `pairs`, which may come in any order, in the order of their indices from zero, each as soon as all those before it have come."""
+    waiting = {}
+    next_index = 0
+    for index, value in pairs:
+        waiting[index] = value
+        while next_index in waiting:
+            yield waiting.pop(next_index)
+            next_index += 1
+
+
 class Timer(object):
     u"""Object to be use with `with` instruction, so that when enclosed code completes a message will appear with the elapsed wall-clock time."""
     def __init__(self, msg):
@@ -44,7 +44,7 @@ cc_headers = [
     "datablock/section.hh"
 ]
 
-datablock_libs = ["datablock/libcosmosis.so"]
+datablock_libs = ["datablock/libcosmosis.so", "datablock/cosmosis_py/_block*.so"]
 
 sampler_libs = ["samplers/multinest/multinest_src/libnest3.so",
                 "samplers/multinest/multinest_src/libnest3_mpi.so",